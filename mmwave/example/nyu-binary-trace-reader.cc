@@ -0,0 +1,99 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+/**
+ * This program converts the binary trace files written by the
+ * NYUBinaryTraceSink (i.e., when the MmWaveHelper attribute TraceFormat is
+ * Binary) to tab separated text. Without the table argument, it prints the
+ * tables of the file with their columns and number of records, e.g.:
+ * ./ns3 run "scratch/nyu-binary-trace-reader --input=NYUTraces.bin"
+ * ./ns3 run "scratch/nyu-binary-trace-reader --input=NYUTraces.bin --table=rx_packet --output=rx.txt"
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/nyu-binary-trace.h"
+
+#include <fstream>
+#include <iostream>
+
+NS_LOG_COMPONENT_DEFINE("NYUBinaryTraceReaderProgram");
+
+using namespace ns3;
+using namespace mmwave;
+
+int
+main(int argc, char* argv[])
+{
+    std::string input = "NYUTraces.bin";
+    std::string table = "";
+    std::string output = "";
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("input", "The binary trace file", input);
+    cmd.AddValue("table", "The table to convert. If empty, the tables are listed", table);
+    cmd.AddValue("output", "The text file. If empty, the standard output is used", output);
+    cmd.Parse(argc, argv);
+
+    NYUBinaryTraceReader reader;
+    if (!reader.Open(input))
+    {
+        std::cerr << "Cannot read the trace file " << input << std::endl;
+        return 1;
+    }
+
+    if (table.empty())
+    {
+        NYUBinaryTraceReader::Chunk chunk;
+        while (reader.ReadChunk(chunk))
+        {
+        }
+        for (const auto& it : reader.GetTables())
+        {
+            std::cout << it.second.m_name << ": " << it.second.m_numRecords << " records, columns";
+            for (const auto& column : it.second.m_columns)
+            {
+                std::cout << " " << column.m_name;
+            }
+            std::cout << std::endl;
+        }
+        return 0;
+    }
+
+    uint64_t numRecords = 0;
+    if (output.empty())
+    {
+        numRecords = reader.WriteText(table, std::cout);
+    }
+    else
+    {
+        std::ofstream file(output);
+        if (!file.is_open())
+        {
+            std::cerr << "Cannot open the output file " << output << std::endl;
+            return 1;
+        }
+        numRecords = reader.WriteText(table, file);
+    }
+    std::cerr << numRecords << " records of the table " << table << " converted" << std::endl;
+    return 0;
+}
@@ -0,0 +1,344 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+/**
+ * This program measures how the NYUSIM channel model scales in a full-stack
+ * ns3-mmwave simulation. A configurable number of gNBs is placed on a square
+ * grid and a configurable number of UEs is dropped uniformly at random in the
+ * same area. The devices are installed through the MmWaveHelper, each UE is
+ * attached to the closest gNB and a full-buffer (RLC SM) data radio bearer is
+ * activated for each UE.
+ * At the end of the simulation the program prints, and appends to a CSV file,
+ * the setup time, the number of events per second, the ratio between simulated
+ * and wall-clock time, the peak resident set size, the size of the NYU channel
+ * caches and the number of channel params and matrices generated per second.
+ * The caches can be bounded with maxCachedParams and maxCachedMatrices; at each
+ * progress report the program checks that the cached channel params, channel
+ * matrices and long term components stay within these bounds, and aborts
+ * otherwise.
+ * The program can be run for increasing values of numEnbs and numUes to obtain
+ * the scaling curves, e.g.:
+ * for ues in 100 200 400 800; do ./ns3 run "nyu-mmwave-scale-benchmark --numUes=$ues"; done
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/lte-enb-rrc.h"
+#include "ns3/mmwave-component-carrier-enb.h"
+#include "ns3/mmwave-enb-net-device.h"
+#include "ns3/mmwave-enb-phy.h"
+#include "ns3/mmwave-helper.h"
+#include "ns3/mmwave-spectrum-phy.h"
+#include "ns3/mobility-module.h"
+#include "ns3/network-module.h"
+#include "ns3/nyu-channel-model.h"
+#include "ns3/nyu-spectrum-propagation-loss-model.h"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <map>
+
+NS_LOG_COMPONENT_DEFINE("NYUMmWaveScaleBenchmark");
+
+using namespace ns3;
+using namespace mmwave;
+
+/// the NYU channel models, each with the spectrum propagation loss model using it
+typedef std::map<Ptr<NYUChannelModel>, Ptr<NYUSpectrumPropagationLossModel>> NyuChannelModels;
+
+/**
+ * Retrieve the NYU channel models used by the component carriers of the gNBs
+ * \param enbDevices the gNB devices
+ * \return the NYU channel models, one for each component carrier
+ */
+static NyuChannelModels
+GetNyuChannelModels(NetDeviceContainer enbDevices)
+{
+    NyuChannelModels channelModels;
+    for (auto it = enbDevices.Begin(); it != enbDevices.End(); ++it)
+    {
+        Ptr<MmWaveEnbNetDevice> enbDevice = DynamicCast<MmWaveEnbNetDevice>(*it);
+        for (const auto& cc : enbDevice->GetCcMap())
+        {
+            Ptr<MmWaveComponentCarrierEnb> ccEnb =
+                DynamicCast<MmWaveComponentCarrierEnb>(cc.second);
+            Ptr<SpectrumChannel> channel =
+                ccEnb->GetPhy()->GetDlSpectrumPhy()->GetSpectrumChannel();
+            Ptr<NYUSpectrumPropagationLossModel> nyuSplm =
+                DynamicCast<NYUSpectrumPropagationLossModel>(
+                    channel->GetPhasedArraySpectrumPropagationLossModel());
+            if (nyuSplm)
+            {
+                Ptr<NYUChannelModel> channelModel =
+                    DynamicCast<NYUChannelModel>(nyuSplm->GetChannelModel());
+                if (channelModel)
+                {
+                    channelModels[channelModel] = nyuSplm;
+                }
+            }
+        }
+    }
+    return channelModels;
+}
+
+/**
+ * Get the peak resident set size of the process
+ * \return the peak resident set size in MB
+ */
+static double
+GetPeakRssMb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0; // ru_maxrss is in kB on Linux
+}
+
+/**
+ * Check that the caches of the NYU channel models do not exceed their bounds
+ * \param channelModels the NYU channel models
+ * \param maxCachedParams the maximum number of cached channel params per model, 0 if unlimited
+ * \param maxCachedMatrices the maximum number of cached channel matrices per model, 0 if unlimited
+ * \return the memory held by the cached channel matrices and long term components in MB
+ */
+static double
+CheckCacheBounds(const NyuChannelModels& channelModels,
+                 uint32_t maxCachedParams,
+                 uint32_t maxCachedMatrices)
+{
+    size_t residentBytes = 0;
+    for (const auto& entry : channelModels)
+    {
+        size_t cachedParams = entry.first->GetNumCachedChannelParams();
+        size_t cachedMatrices = entry.first->GetNumCachedChannelMatrices();
+        size_t cachedLongTerms = entry.second->GetNumCachedLongTerms();
+        NS_ABORT_MSG_IF(maxCachedParams > 0 && cachedParams > maxCachedParams,
+                        cachedParams << " cached channel params, the limit is " << maxCachedParams);
+        NS_ABORT_MSG_IF(maxCachedMatrices > 0 && cachedMatrices > maxCachedMatrices,
+                        cachedMatrices << " cached channel matrices, the limit is "
+                                       << maxCachedMatrices);
+        // the long terms are dropped with their channel matrix
+        NS_ABORT_MSG_IF(cachedLongTerms > cachedMatrices,
+                        cachedLongTerms << " cached long terms for " << cachedMatrices
+                                        << " cached channel matrices");
+        residentBytes += entry.first->GetCachedChannelMatricesSize();
+        residentBytes += entry.second->GetCachedLongTermsSize();
+    }
+    return residentBytes / 1048576.0;
+}
+
+/**
+ * Print the progress of the simulation, check the bounds of the caches and
+ * schedule the next report
+ * \param interval the simulated time between two reports
+ * \param start the wall-clock time at the start of the simulation
+ * \param channelModels the NYU channel models
+ * \param maxCachedParams the maximum number of cached channel params per model, 0 if unlimited
+ * \param maxCachedMatrices the maximum number of cached channel matrices per model, 0 if unlimited
+ */
+static void
+ReportProgress(Time interval,
+               std::chrono::steady_clock::time_point start,
+               NyuChannelModels channelModels,
+               uint32_t maxCachedParams,
+               uint32_t maxCachedMatrices)
+{
+    double wallTime =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t paramsGenerations = 0;
+    uint64_t matrixGenerations = 0;
+    for (const auto& entry : channelModels)
+    {
+        paramsGenerations += entry.first->GetNumChannelParamsGenerations();
+        matrixGenerations += entry.first->GetNumChannelMatrixGenerations();
+    }
+    double cachedMb = CheckCacheBounds(channelModels, maxCachedParams, maxCachedMatrices);
+    std::cout << "t=" << Simulator::Now().GetSeconds() << " s wall=" << wallTime
+              << " s events=" << Simulator::GetEventCount()
+              << " paramsGenerations=" << paramsGenerations
+              << " matrixGenerations=" << matrixGenerations << " cachedMatrices=" << cachedMb
+              << " MB peakRss=" << GetPeakRssMb() << " MB" << std::endl;
+    Simulator::Schedule(interval,
+                        &ReportProgress,
+                        interval,
+                        start,
+                        channelModels,
+                        maxCachedParams,
+                        maxCachedMatrices);
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t numEnbs = 4;        // number of gNBs
+    uint32_t numUes = 40;        // number of UEs
+    double isd = 200;            // inter-site distance in meters
+    double enbHeight = 25;       // gNB height in meters
+    double ueHeight = 1.5;       // UE height in meters
+    double simTime = 0.5;        // simulated time in seconds
+    double reportInterval = 0.1; // simulated time between two progress reports in seconds
+    uint32_t maxCachedParams = 0;   // maximum number of cached channel params, 0 if unlimited
+    uint32_t maxCachedMatrices = 0; // maximum number of cached channel matrices, 0 if unlimited
+    std::string outputFile = "nyu-scale-benchmark.csv"; // file where the results are appended
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("numEnbs", "number of gNBs", numEnbs);
+    cmd.AddValue("numUes", "number of UEs", numUes);
+    cmd.AddValue("isd", "inter-site distance in meters", isd);
+    cmd.AddValue("simTime", "simulated time in seconds", simTime);
+    cmd.AddValue("reportInterval",
+                 "simulated time between two progress reports in seconds",
+                 reportInterval);
+    cmd.AddValue("maxCachedParams",
+                 "maximum number of channel params cached by each channel model, 0 if unlimited",
+                 maxCachedParams);
+    cmd.AddValue("maxCachedMatrices",
+                 "maximum number of channel matrices cached by each channel model, 0 if unlimited",
+                 maxCachedMatrices);
+    cmd.AddValue("outputFile", "CSV file where the results are appended", outputFile);
+    cmd.Parse(argc, argv);
+
+    Config::SetDefault("ns3::NYUChannelModel::MaxCachedChannelParams",
+                       UintegerValue(maxCachedParams));
+    Config::SetDefault("ns3::NYUChannelModel::MaxCachedChannelMatrices",
+                       UintegerValue(maxCachedMatrices));
+
+    // full-buffer traffic generated by the RLC SM entities
+    Config::SetDefault("ns3::LteEnbRrc::EpsBearerToRlcMapping",
+                       EnumValue(LteEnbRrc::RLC_SM_ALWAYS));
+    Config::SetDefault("ns3::MmWaveHelper::ChannelModel",
+                       StringValue("ns3::NYUSpectrumPropagationLossModel"));
+
+    auto setupStart = std::chrono::steady_clock::now();
+
+    Ptr<MmWaveHelper> mmwaveHelper = CreateObject<MmWaveHelper>();
+
+    NodeContainer enbNodes;
+    NodeContainer ueNodes;
+    enbNodes.Create(numEnbs);
+    ueNodes.Create(numUes);
+
+    // the gNBs are placed on the smallest square grid that contains them
+    uint32_t gridWidth = std::ceil(std::sqrt(numEnbs));
+    Ptr<ListPositionAllocator> enbPositionAlloc = CreateObject<ListPositionAllocator>();
+    for (uint32_t i = 0; i < numEnbs; i++)
+    {
+        enbPositionAlloc->Add(Vector((i % gridWidth) * isd, (i / gridWidth) * isd, enbHeight));
+    }
+    MobilityHelper enbMobility;
+    enbMobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    enbMobility.SetPositionAllocator(enbPositionAlloc);
+    enbMobility.Install(enbNodes);
+
+    double areaSide = std::max(1.0, gridWidth - 1.0) * isd;
+    Ptr<RandomBoxPositionAllocator> uePositionAlloc = CreateObject<RandomBoxPositionAllocator>();
+    uePositionAlloc->SetAttribute(
+        "X",
+        StringValue("ns3::UniformRandomVariable[Min=0.0|Max=" + std::to_string(areaSide) + "]"));
+    uePositionAlloc->SetAttribute(
+        "Y",
+        StringValue("ns3::UniformRandomVariable[Min=0.0|Max=" + std::to_string(areaSide) + "]"));
+    uePositionAlloc->SetAttribute(
+        "Z",
+        StringValue("ns3::ConstantRandomVariable[Constant=" + std::to_string(ueHeight) + "]"));
+    MobilityHelper ueMobility;
+    ueMobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
+    ueMobility.SetPositionAllocator(uePositionAlloc);
+    ueMobility.Install(ueNodes);
+
+    NetDeviceContainer enbDevices = mmwaveHelper->InstallEnbDevice(enbNodes);
+    NetDeviceContainer ueDevices = mmwaveHelper->InstallUeDevice(ueNodes);
+    mmwaveHelper->AttachToClosestEnb(ueDevices, enbDevices);
+    mmwaveHelper->ActivateDataRadioBearer(ueDevices, EpsBearer(EpsBearer::NGBR_VIDEO_TCP_DEFAULT));
+
+    NyuChannelModels channelModels = GetNyuChannelModels(enbDevices);
+    NS_ABORT_MSG_IF(channelModels.empty(), "The NYU channel model is not used by the gNBs");
+
+    double setupTime =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - setupStart).count();
+    std::cout << "Setup of " << numEnbs << " gNBs and " << numUes << " UEs: " << setupTime << " s"
+              << std::endl;
+
+    auto runStart = std::chrono::steady_clock::now();
+    Simulator::Schedule(Seconds(reportInterval),
+                        &ReportProgress,
+                        Seconds(reportInterval),
+                        runStart,
+                        channelModels,
+                        maxCachedParams,
+                        maxCachedMatrices);
+    Simulator::Stop(Seconds(simTime));
+    Simulator::Run();
+    double runTime =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+
+    uint64_t events = Simulator::GetEventCount();
+    size_t cachedParams = 0;
+    size_t cachedMatrices = 0;
+    uint64_t paramsGenerations = 0;
+    uint64_t matrixGenerations = 0;
+    for (const auto& entry : channelModels)
+    {
+        cachedParams += entry.first->GetNumCachedChannelParams();
+        cachedMatrices += entry.first->GetNumCachedChannelMatrices();
+        paramsGenerations += entry.first->GetNumChannelParamsGenerations();
+        matrixGenerations += entry.first->GetNumChannelMatrixGenerations();
+    }
+    double cachedMb = CheckCacheBounds(channelModels, maxCachedParams, maxCachedMatrices);
+    double peakRss = GetPeakRssMb();
+
+    std::cout << "Run time: " << runTime << " s" << std::endl
+              << "Events per second: " << events / runTime << std::endl
+              << "Simulated time / wall-clock time: " << simTime / runTime << std::endl
+              << "Peak RSS: " << peakRss << " MB" << std::endl
+              << "Cached channel params: " << cachedParams << std::endl
+              << "Cached channel matrices: " << cachedMatrices << std::endl
+              << "Memory of the cached matrices and long terms: " << cachedMb << " MB"
+              << std::endl
+              << "Channel params generations per second: " << paramsGenerations / runTime
+              << std::endl
+              << "Channel matrix generations per second: " << matrixGenerations / runTime
+              << std::endl;
+
+    // append the results to the CSV file, the header is written only for a new file
+    bool newFile = !std::ifstream(outputFile).good();
+    std::ofstream f(outputFile, std::ios::out | std::ios::app);
+    if (newFile)
+    {
+        f << "numEnbs,numUes,simTime,setupTime,runTime,events,eventsPerSecond,simWallRatio,"
+             "peakRssMb,cachedParams,cachedMatrices,paramsGenerations,matrixGenerations,"
+             "paramsGenerationsPerSecond,matrixGenerationsPerSecond"
+          << std::endl;
+    }
+    f << numEnbs << "," << numUes << "," << simTime << "," << setupTime << "," << runTime << ","
+      << events << "," << events / runTime << "," << simTime / runTime << "," << peakRss << ","
+      << cachedParams << "," << cachedMatrices << "," << paramsGenerations << ","
+      << matrixGenerations << "," << paramsGenerations / runTime << ","
+      << matrixGenerations / runTime << std::endl;
+    f.close();
+
+    Simulator::Destroy();
+    return 0;
+}
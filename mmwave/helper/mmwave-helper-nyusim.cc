@@ -34,25 +34,33 @@
 #include "mmwave-helper.h"
 
 #include <ns3/abort.h>
+#include <ns3/attribute.h>
+#include <ns3/boolean.h>
 #include <ns3/cc-helper.h>
 #include <ns3/channel-condition-model.h>
 #include <ns3/double.h>
+#include <ns3/enum.h>
 #include <ns3/epc-enb-application.h>
 #include <ns3/epc-x2.h>
 #include <ns3/file-beamforming-codebook.h>
 #include <ns3/friis-spectrum-propagation-loss.h>
+#include <ns3/global-value.h>
 #include <ns3/ipv4.h>
 #include <ns3/isotropic-antenna-model.h>
 #include <ns3/log.h>
 #include <ns3/lte-chunk-processor.h>
 #include <ns3/lte-enb-component-carrier-manager.h>
+#include <ns3/lte-enb-rrc.h>
 #include <ns3/lte-spectrum-phy.h>
 #include <ns3/lte-ue-component-carrier-manager.h>
+#include <ns3/lte-ue-rrc.h>
 #include <ns3/mmwave-beamforming-model.h>
 #include <ns3/mmwave-lte-rrc-protocol-real.h>
 #include <ns3/mmwave-propagation-loss-model.h>
 #include <ns3/mmwave-rrc-protocol-ideal.h>
 #include <ns3/multi-model-spectrum-channel.h>
+#include <ns3/nstime.h>
+#include <ns3/nyu-binary-trace.h>
 #include <ns3/object-map.h>
 #include <ns3/pointer.h>
 #include <ns3/string.h>
@@ -62,8 +70,10 @@
 #include <ns3/uniform-planar-array.h>
 
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <string>
+#include <vector>
 
 namespace ns3
 {
@@ -76,6 +86,452 @@ namespace mmwave
 
 NS_OBJECT_ENSURE_REGISTERED(MmWaveHelper);
 
+/**
+ * Objects shared by all the devices installed on a mmWave component carrier.
+ * They are resolved when the first device is installed on the carrier and
+ * reused for the following ones, so that installing a large number of devices
+ * does not repeat the lookup of the channel objects and of the beamforming
+ * model attributes for each device.
+ */
+struct CcInstallContext
+{
+    Ptr<SpectrumPropagationLossModel> m_splm;              //!< the spectrum propagation loss model
+    Ptr<PhasedArraySpectrumPropagationLossModel> m_pSplm;  //!< the phased array SPLM
+    Ptr<MatrixBasedChannelModel> m_channelModel;           //!< the NYU channel model
+    ObjectFactory m_bfModelFactory; //!< beamforming model factory with the carrier attributes set
+    bool m_isCodebookBeamforming;   //!< true if the beamforming model uses a codebook
+};
+
+/**
+ * Install contexts of a MmWaveHelper, indexed by component carrier id. The
+ * object is aggregated to the helper when the first device is installed, so
+ * that the contexts have the lifetime of the helper they belong to.
+ */
+class MmWaveCcInstallContexts : public Object
+{
+  public:
+    /**
+     * Get the type ID
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId(void);
+
+    std::map<uint8_t, CcInstallContext> m_contexts; //!< the install context of each carrier
+
+  protected:
+    void DoDispose(void) override;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(MmWaveCcInstallContexts);
+
+TypeId
+MmWaveCcInstallContexts::GetTypeId(void)
+{
+    static TypeId tid = TypeId("ns3::MmWaveCcInstallContexts")
+                            .SetParent<Object>()
+                            .SetGroupName("mmwave")
+                            .AddConstructor<MmWaveCcInstallContexts>();
+    return tid;
+}
+
+void
+MmWaveCcInstallContexts::DoDispose(void)
+{
+    m_contexts.clear();
+    Object::DoDispose();
+}
+
+/**
+ * Sets an attribute on a factory only if the type of the factory supports it
+ * \param factory the factory
+ * \param name the name of the attribute
+ * \param value the value of the attribute
+ */
+static void
+SetFactoryAttributeFailSafe(ObjectFactory& factory, std::string name, const AttributeValue& value)
+{
+    TypeId::AttributeInformation info;
+    if (factory.GetTypeId().LookupAttributeByName(name, &info))
+    {
+        factory.Set(name, value);
+    }
+}
+
+/**
+ * Get the install context of a component carrier, creating it if needed
+ * \param helper the helper installing the devices
+ * \param ccId the component carrier id
+ * \param channel the spectrum channel of the component carrier
+ * \param bfModelFactory the beamforming model factory of the helper
+ * \param phyMacCommon the configuration of the component carrier
+ * \return the install context
+ */
+static const CcInstallContext&
+GetCcInstallContext(Ptr<MmWaveHelper> helper,
+                    uint8_t ccId,
+                    Ptr<SpectrumChannel> channel,
+                    const ObjectFactory& bfModelFactory,
+                    Ptr<MmWavePhyMacCommon> phyMacCommon)
+{
+    Ptr<MmWaveCcInstallContexts> installContexts = helper->GetObject<MmWaveCcInstallContexts>();
+    if (!installContexts)
+    {
+        installContexts = CreateObject<MmWaveCcInstallContexts>();
+        helper->AggregateObject(installContexts);
+    }
+    std::map<uint8_t, CcInstallContext>& contexts = installContexts->m_contexts;
+    auto it = contexts.find(ccId);
+    if (it != contexts.end())
+    {
+        return it->second;
+    }
+
+    CcInstallContext context;
+    // the NYUSpectrumPropagationLossModel is installed in the channel as a
+    // PhasedArraySpectrumPropagationLossModel by MmWaveChannelModelInitialization
+    Ptr<NYUSpectrumPropagationLossModel> nyuSplm;
+    context.m_pSplm = channel->GetPhasedArraySpectrumPropagationLossModel();
+    if (context.m_pSplm)
+    {
+        nyuSplm = DynamicCast<NYUSpectrumPropagationLossModel>(context.m_pSplm);
+    }
+    else
+    {
+        context.m_splm = channel->GetSpectrumPropagationLossModel();
+        nyuSplm = DynamicCast<NYUSpectrumPropagationLossModel>(context.m_splm);
+    }
+    NS_ABORT_MSG_IF(!nyuSplm, "The channel does not use the NYUSpectrumPropagationLossModel");
+    context.m_channelModel = nyuSplm->GetChannelModel();
+
+    // the attributes which do not depend on the device are set once in the factory
+    context.m_bfModelFactory = bfModelFactory;
+    SetFactoryAttributeFailSafe(context.m_bfModelFactory,
+                                "ChannelModel",
+                                PointerValue(context.m_channelModel));
+    if (context.m_pSplm)
+    {
+        SetFactoryAttributeFailSafe(context.m_bfModelFactory,
+                                    "PhasedArraySpectrumPropagationLossModel",
+                                    PointerValue(context.m_pSplm));
+    }
+    else if (context.m_splm)
+    {
+        SetFactoryAttributeFailSafe(context.m_bfModelFactory,
+                                    "SpectrumPropagationLossModel",
+                                    PointerValue(context.m_splm));
+    }
+    SetFactoryAttributeFailSafe(context.m_bfModelFactory,
+                                "MmWavePhyMacCommon",
+                                PointerValue(phyMacCommon));
+    context.m_isCodebookBeamforming =
+        (bfModelFactory.GetTypeId() == MmWaveCodebookBeamforming::GetTypeId());
+
+    return contexts.emplace(ccId, context).first->second;
+}
+
+/**
+ * Removes the install contexts of a helper, e.g., because the configuration
+ * of the beamforming model changed
+ * \param helper the helper
+ */
+static void
+ClearCcInstallContexts(Ptr<const MmWaveHelper> helper)
+{
+    Ptr<MmWaveCcInstallContexts> installContexts = helper->GetObject<MmWaveCcInstallContexts>();
+    if (installContexts)
+    {
+        installContexts->m_contexts.clear();
+    }
+}
+
+/// if true, AttachToClosestEnb selects the mmWave eNB with the largest RSRP
+static GlobalValue g_nyuRsrpCellSelection(
+    "NYURsrpCellSelection",
+    "If true, MmWaveHelper::AttachToClosestEnb attaches each UE to the mmWave eNB with the "
+    "largest RSRP on the first component carrier instead of the closest one, computed from "
+    "the NYU ray table and the large scale loss without generating the channel matrices",
+    BooleanValue(false),
+    MakeBooleanChecker());
+
+/// period of the RSRP handover check of the UEs attached by AttachToClosestEnb
+static GlobalValue g_nyuRsrpHandoverPeriod(
+    "NYURsrpHandoverPeriod",
+    "If NYURsrpCellSelection is true and this period is not zero, the RSRP of every candidate "
+    "mmWave eNB is evaluated periodically for each UE attached by "
+    "MmWaveHelper::AttachToClosestEnb, and a handover is requested towards the strongest "
+    "one when it exceeds the serving one by NYURsrpHandoverHysteresis. The eNBs must be "
+    "connected by X2 interfaces",
+    TimeValue(Seconds(0)),
+    MakeTimeChecker());
+
+/// hysteresis of the RSRP handover check
+static GlobalValue g_nyuRsrpHandoverHysteresis(
+    "NYURsrpHandoverHysteresis",
+    "The margin in dB by which the RSRP of a candidate mmWave eNB must exceed the one of the "
+    "serving eNB to trigger the handover requested by the NYURsrpHandoverPeriod check",
+    DoubleValue(3.0),
+    MakeDoubleChecker<double>(0.0));
+
+/**
+ * Computes the RSRP of each mmWave eNB at a UE on a component carrier.
+ * The RSRP is computed by the NYUSpectrumPropagationLossModel from the NYU ray
+ * table and the large scale loss, with both arrays steered towards the
+ * strongest ray, hence no channel matrix is generated for the candidate cells
+ * \param ueDevice the UE device
+ * \param enbDevices the candidate eNB devices
+ * \param ccId the component carrier id
+ * \param splm the spectrum propagation loss model of the component carrier
+ * \param plm the propagation loss model of the component carrier
+ * \return the RSRP in dBm of each eNB, -infinity for the devices which cannot be evaluated
+ */
+static std::vector<double>
+GetEnbRsrps(Ptr<NetDevice> ueDevice,
+            NetDeviceContainer enbDevices,
+            uint8_t ccId,
+            Ptr<NYUSpectrumPropagationLossModel> splm,
+            Ptr<PropagationLossModel> plm)
+{
+    std::vector<double> rsrps(enbDevices.GetN(), -std::numeric_limits<double>::infinity());
+    Ptr<MmWaveUeNetDevice> ue = ueDevice->GetObject<MmWaveUeNetDevice>();
+    if (!ue || ue->GetCcMap().find(ccId) == ue->GetCcMap().end())
+    {
+        return rsrps;
+    }
+    Ptr<PhasedArrayModel> ueAntenna = ue->GetCcMap().at(ccId)->GetAntenna();
+    Ptr<MobilityModel> ueMob = ueDevice->GetNode()->GetObject<MobilityModel>();
+
+    for (uint32_t i = 0; i < enbDevices.GetN(); ++i)
+    {
+        Ptr<MmWaveEnbNetDevice> enb = enbDevices.Get(i)->GetObject<MmWaveEnbNetDevice>();
+        if (!enb || enb->GetCcMap().find(ccId) == enb->GetCcMap().end())
+        {
+            continue;
+        }
+        Ptr<MmWaveComponentCarrierEnb> enbCc =
+            DynamicCast<MmWaveComponentCarrierEnb>(enb->GetCcMap().at(ccId));
+        if (!enbCc)
+        {
+            continue;
+        }
+        Ptr<MobilityModel> enbMob = enbDevices.Get(i)->GetNode()->GetObject<MobilityModel>();
+        rsrps[i] = splm->CalcRsrp(enbCc->GetPhy()->GetTxPower(),
+                                  enbMob,
+                                  ueMob,
+                                  enbCc->GetAntenna(),
+                                  ueAntenna,
+                                  plm,
+                                  NYUSpectrumPropagationLossModel::STRONGEST_RAY_RSRP);
+        NS_LOG_LOGIC("RSRP from eNB " << i << " " << rsrps[i] << " dBm");
+    }
+    return rsrps;
+}
+
+/**
+ * Finds the mmWave eNB with the largest RSRP at a UE on a component carrier
+ * \param ueDevice the UE device
+ * \param enbDevices the candidate eNB devices
+ * \param ccId the component carrier id
+ * \param splm the spectrum propagation loss model of the component carrier
+ * \param plm the propagation loss model of the component carrier
+ * \return the index of the eNB with the largest RSRP, -1 if none of the devices can be evaluated
+ */
+static int
+GetStrongestEnbIndex(Ptr<NetDevice> ueDevice,
+                     NetDeviceContainer enbDevices,
+                     uint8_t ccId,
+                     Ptr<NYUSpectrumPropagationLossModel> splm,
+                     Ptr<PropagationLossModel> plm)
+{
+    std::vector<double> rsrps = GetEnbRsrps(ueDevice, enbDevices, ccId, splm, plm);
+    double maxRsrp = -std::numeric_limits<double>::infinity();
+    int strongestEnbIndex = -1;
+    for (uint32_t i = 0; i < rsrps.size(); ++i)
+    {
+        if (rsrps[i] > maxRsrp)
+        {
+            maxRsrp = rsrps[i];
+            strongestEnbIndex = i;
+        }
+    }
+    return strongestEnbIndex;
+}
+
+/**
+ * Compares the RSRP of the serving mmWave eNB of a UE with the ones of the
+ * other candidate eNBs, requests a handover towards the strongest one if it
+ * exceeds the serving one by the hysteresis, and schedules the next check
+ * \param ueDevice the UE device
+ * \param enbDevices the candidate eNB devices
+ * \param ccId the component carrier id
+ * \param splm the spectrum propagation loss model of the component carrier
+ * \param plm the propagation loss model of the component carrier
+ * \param period the period of the check
+ * \param hysteresis the hysteresis in dB
+ */
+static void
+CheckRsrpHandover(Ptr<NetDevice> ueDevice,
+                  NetDeviceContainer enbDevices,
+                  uint8_t ccId,
+                  Ptr<NYUSpectrumPropagationLossModel> splm,
+                  Ptr<PropagationLossModel> plm,
+                  Time period,
+                  double hysteresis)
+{
+    Simulator::Schedule(period,
+                        &CheckRsrpHandover,
+                        ueDevice,
+                        enbDevices,
+                        ccId,
+                        splm,
+                        plm,
+                        period,
+                        hysteresis);
+
+    Ptr<LteUeRrc> ueRrc = ueDevice->GetObject<MmWaveUeNetDevice>()->GetRrc();
+    if (ueRrc->GetState() != LteUeRrc::CONNECTED_NORMALLY)
+    {
+        return;
+    }
+
+    std::vector<double> rsrps = GetEnbRsrps(ueDevice, enbDevices, ccId, splm, plm);
+    int servingEnbIndex = -1;
+    int strongestEnbIndex = -1;
+    for (uint32_t i = 0; i < rsrps.size(); ++i)
+    {
+        Ptr<MmWaveEnbNetDevice> enb = enbDevices.Get(i)->GetObject<MmWaveEnbNetDevice>();
+        if (enb && enb->GetCellId() == ueRrc->GetCellId())
+        {
+            servingEnbIndex = i;
+        }
+        if (strongestEnbIndex < 0 || rsrps[i] > rsrps[strongestEnbIndex])
+        {
+            strongestEnbIndex = i;
+        }
+    }
+    if (servingEnbIndex < 0 || strongestEnbIndex == servingEnbIndex ||
+        rsrps[strongestEnbIndex] <= rsrps[servingEnbIndex] + hysteresis)
+    {
+        return;
+    }
+
+    Ptr<MmWaveEnbNetDevice> servingEnb =
+        enbDevices.Get(servingEnbIndex)->GetObject<MmWaveEnbNetDevice>();
+    uint16_t targetCellId =
+        enbDevices.Get(strongestEnbIndex)->GetObject<MmWaveEnbNetDevice>()->GetCellId();
+    NS_LOG_INFO("RSRP handover of RNTI " << ueRrc->GetRnti() << " from cell "
+                                         << servingEnb->GetCellId() << " ("
+                                         << rsrps[servingEnbIndex] << " dBm) to cell "
+                                         << targetCellId << " (" << rsrps[strongestEnbIndex]
+                                         << " dBm)");
+    servingEnb->GetRrc()->SendHandoverRequest(ueRrc->GetRnti(), targetCellId);
+}
+
+/// the formats of the traces enabled by MmWaveHelper::EnableTraces
+enum TraceFormat
+{
+    TEXT_TRACES,  //!< text files written by the trace classes of the mmwave module
+    BINARY_TRACES //!< binary file written by a NYUBinaryTraceSink
+};
+
+/**
+ * Trace configuration of a MmWaveHelper, aggregated to the helper when a
+ * format other than the default one is selected
+ */
+class MmWaveTraceConfiguration : public Object
+{
+  public:
+    /**
+     * Get the type ID
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId(void);
+
+    int m_format{TEXT_TRACES}; //!< the format of the traces enabled by EnableTraces
+};
+
+NS_OBJECT_ENSURE_REGISTERED(MmWaveTraceConfiguration);
+
+TypeId
+MmWaveTraceConfiguration::GetTypeId(void)
+{
+    static TypeId tid = TypeId("ns3::MmWaveTraceConfiguration")
+                            .SetParent<Object>()
+                            .SetGroupName("mmwave")
+                            .AddConstructor<MmWaveTraceConfiguration>();
+    return tid;
+}
+
+/**
+ * Get the trace format of a helper
+ * \param helper the helper
+ * \return the trace format
+ */
+static int
+GetTraceFormat(const MmWaveHelper* helper)
+{
+    Ptr<MmWaveTraceConfiguration> configuration = helper->GetObject<MmWaveTraceConfiguration>();
+    return configuration ? configuration->m_format : TEXT_TRACES;
+}
+
+/**
+ * Accessor of the TraceFormat attribute of the MmWaveHelper. The format is
+ * stored in the MmWaveTraceConfiguration aggregated to the helper. Selecting
+ * the binary format also aggregates a NYUBinaryTraceSink to the helper, so
+ * that it can be configured before EnableTraces is called.
+ */
+class TraceFormatAccessor : public AttributeAccessor
+{
+  public:
+    bool Set(ObjectBase* object, const AttributeValue& value) const override
+    {
+        MmWaveHelper* helper = dynamic_cast<MmWaveHelper*>(object);
+        const EnumValue* format = dynamic_cast<const EnumValue*>(&value);
+        if (!helper || !format)
+        {
+            return false;
+        }
+        Ptr<MmWaveTraceConfiguration> configuration =
+            helper->GetObject<MmWaveTraceConfiguration>();
+        if (!configuration)
+        {
+            if (format->Get() == TEXT_TRACES)
+            {
+                return true;
+            }
+            configuration = CreateObject<MmWaveTraceConfiguration>();
+            helper->AggregateObject(configuration);
+        }
+        configuration->m_format = format->Get();
+        if (format->Get() == BINARY_TRACES && !helper->GetObject<NYUBinaryTraceSink>())
+        {
+            helper->AggregateObject(CreateObject<NYUBinaryTraceSink>());
+        }
+        return true;
+    }
+
+    bool Get(const ObjectBase* object, AttributeValue& value) const override
+    {
+        const MmWaveHelper* helper = dynamic_cast<const MmWaveHelper*>(object);
+        EnumValue* format = dynamic_cast<EnumValue*>(&value);
+        if (!helper || !format)
+        {
+            return false;
+        }
+        format->Set(GetTraceFormat(helper));
+        return true;
+    }
+
+    bool HasGetter() const override
+    {
+        return true;
+    }
+
+    bool HasSetter() const override
+    {
+        return true;
+    }
+};
+
 MmWaveHelper::MmWaveHelper(void)
     : m_imsiCounter(0),
       m_cellIdCounter(1),
@@ -266,7 +722,15 @@ MmWaveHelper::GetTypeId(void)
                           "If it is more than one and m_lteUseCa is false, it will raise an error ",
                           UintegerValue(1),
                           MakeUintegerAccessor(&MmWaveHelper::m_noOfLteCcs),
-                          MakeUintegerChecker<uint16_t>(MIN_NO_CC, MAX_NO_CC));
+                          MakeUintegerChecker<uint16_t>(MIN_NO_CC, MAX_NO_CC))
+            .AddAttribute("TraceFormat",
+                          "The format of the traces enabled by EnableTraces. With Binary, the "
+                          "PHY, MAC, RLC and PDCP traces are written by a NYUBinaryTraceSink as "
+                          "typed records in column chunks, configured through its attributes "
+                          "(e.g., ns3::NYUBinaryTraceSink::FileName)",
+                          EnumValue(TEXT_TRACES),
+                          Create<TraceFormatAccessor>(),
+                          MakeEnumChecker(TEXT_TRACES, "Text", BINARY_TRACES, "Binary"));
 
     return tid;
 }
@@ -365,6 +829,23 @@ MmWaveHelper::MmWaveChannelModelInitialization(void)
                 plm->SetAttributeFailSafe("Frequency",
                                           DoubleValue(phyMacCommon->GetCenterFrequency()));
 
+                // if the CCs share a NYULargeScaleState, they also share the
+                // channel condition model: the first CC registers its model in
+                // the state and the following ones reuse it
+                Ptr<NYUPropagationLossModel> nyuPlm = DynamicCast<NYUPropagationLossModel>(plm);
+                if (nyuPlm && nyuPlm->GetLargeScaleState())
+                {
+                    Ptr<NYULargeScaleState> state = nyuPlm->GetLargeScaleState();
+                    if (state->GetChannelConditionModel())
+                    {
+                        ccm = state->GetChannelConditionModel();
+                    }
+                    else if (ccm)
+                    {
+                        state->SetChannelConditionModel(ccm);
+                    }
+                }
+
                 // associate the channel condition model to the propagation loss model (if needed)
                 if (ccm)
                 {
@@ -529,6 +1010,7 @@ MmWaveHelper::SetBeamformingModelType(std::string type)
 {
     NS_LOG_FUNCTION(this << type);
     m_bfModelFactory = ObjectFactory(type);
+    ClearCcInstallContexts(this);
 }
 
 void
@@ -623,6 +1105,7 @@ MmWaveHelper::SetBeamformingModelAttribute(std::string name, const AttributeValu
 {
     NS_LOG_FUNCTION(this);
     m_bfModelFactory.Set(name, value);
+    ClearCcInstallContexts(this);
 }
 
 void
@@ -740,6 +1223,7 @@ MmWaveHelper::SetCcPhyParams(std::map<uint8_t, MmWaveComponentCarrier> ccMapPara
 {
     NS_LOG_FUNCTION(this);
     m_componentCarrierPhyParams = ccMapParams;
+    ClearCcInstallContexts(this);
 }
 
 std::map<uint8_t, MmWaveComponentCarrier>
@@ -939,29 +1423,20 @@ MmWaveHelper::InstallSingleMcUeDevice(Ptr<Node> n)
         Ptr<PhasedArrayModel> antenna = m_uePhasedArrayModelFactory.Create<PhasedArrayModel>();
         NS_ASSERT_MSG(antenna, "error in creating the AntennaModel object");
 
-        // initialize the NYU channel model
-
-        [[maybe_unused]] Ptr<SpectrumPropagationLossModel> splm;
-        [[maybe_unused]] Ptr<PhasedArraySpectrumPropagationLossModel> pSplm;
-
-        Ptr<NYUSpectrumPropagationLossModel> nyuSplm;
-
-        if (m_spectrumPropagationLossModelType == "ns3::NYUSpectrumPropagationLossModel")
-        {
-            pSplm = m_channel.at(it->first)->GetPhasedArraySpectrumPropagationLossModel();
-            nyuSplm = DynamicCast<NYUSpectrumPropagationLossModel>(pSplm);
-        }
-        else
-        {
-            splm = m_channel.at(it->first)->GetSpectrumPropagationLossModel();
-            nyuSplm = DynamicCast<NYUSpectrumPropagationLossModel>(splm);
-        }
-
-        auto channelModel = nyuSplm->GetChannelModel();
-        Ptr<MmWaveBeamformingModel> bfModel = m_bfModelFactory.Create<MmWaveBeamformingModel>();
+        // initialize the NYU channel model, the attributes shared by all the
+        // devices on this carrier are already set in the factory of the context
+        const CcInstallContext& ccContext =
+            GetCcInstallContext(this,
+                                it->first,
+                                m_channel.at(it->first),
+                                m_bfModelFactory,
+                                m_componentCarrierPhyParams.at(it->first)
+                                    .GetConfigurationParameters());
+
+        Ptr<MmWaveBeamformingModel> bfModel =
+            ccContext.m_bfModelFactory.Create<MmWaveBeamformingModel>();
         bfModel->SetAttributeFailSafe("Device", PointerValue(device));
         bfModel->SetAttributeFailSafe("Antenna", PointerValue(antenna));
-        bfModel->SetAttributeFailSafe("ChannelModel", PointerValue(channelModel));
         dlPhy->SetBeamformingModel(bfModel);
 
         it->second->SetPhy(phy);
@@ -1596,44 +2071,20 @@ MmWaveHelper::InstallSingleUeDevice(Ptr<Node> n)
         Ptr<PhasedArrayModel> antenna = m_uePhasedArrayModelFactory.Create<PhasedArrayModel>();
         NS_ASSERT_MSG(antenna, "error in creating the AntennaModel object");
 
-        // initialize the NYU channel model
-
-        [[maybe_unused]] Ptr<SpectrumPropagationLossModel> splm;
-        [[maybe_unused]] Ptr<PhasedArraySpectrumPropagationLossModel> pSplm;
-
-        Ptr<NYUSpectrumPropagationLossModel> nyuSplm;
-
-        if (m_spectrumPropagationLossModelType == "ns3::NYUSpectrumPropagationLossModel")
-        {
-            pSplm = m_channel.at(it->first)->GetPhasedArraySpectrumPropagationLossModel();
-            nyuSplm = DynamicCast<NYUSpectrumPropagationLossModel>(pSplm);
-        }
-        else
-        {
-            splm = m_channel.at(it->first)->GetSpectrumPropagationLossModel();
-            nyuSplm = DynamicCast<NYUSpectrumPropagationLossModel>(splm);
-        }
-
-        auto channelModel = nyuSplm->GetChannelModel();
-
-        Ptr<MmWaveBeamformingModel> bfModel = m_bfModelFactory.Create<MmWaveBeamformingModel>();
+        // initialize the NYU channel model, the attributes shared by all the
+        // devices on this carrier are already set in the factory of the context
+        const CcInstallContext& ccContext =
+            GetCcInstallContext(this,
+                                it->first,
+                                m_channel.at(it->first),
+                                m_bfModelFactory,
+                                it->second->GetConfigurationParameters());
+
+        Ptr<MmWaveBeamformingModel> bfModel =
+            ccContext.m_bfModelFactory.Create<MmWaveBeamformingModel>();
         bfModel->SetAttributeFailSafe("Device", PointerValue(device));
         bfModel->SetAttributeFailSafe("Antenna", PointerValue(antenna));
-        bfModel->SetAttributeFailSafe("ChannelModel", PointerValue(channelModel));
-
-        if (pSplm)
-        {
-            bfModel->SetAttributeFailSafe("PhasedArraySpectrumPropagationLossModel",
-                                          PointerValue(pSplm));
-        }
-        else if (splm)
-        {
-            bfModel->SetAttributeFailSafe("SpectrumPropagationLossModel", PointerValue(splm));
-        }
-
-        bfModel->SetAttributeFailSafe("MmWavePhyMacCommon",
-                                      PointerValue(it->second->GetConfigurationParameters()));
-        if (m_bfModelFactory.GetTypeId() == MmWaveCodebookBeamforming::GetTypeId())
+        if (ccContext.m_isCodebookBeamforming)
         {
             DynamicCast<MmWaveCodebookBeamforming>(bfModel)->SetBeamformingCodebookFactory(
                 m_ueBeamformingCodebookFactory);
@@ -1856,43 +2307,20 @@ MmWaveHelper::InstallSingleEnbDevice(Ptr<Node> n)
         Ptr<PhasedArrayModel> antenna = m_enbPhasedArrayModelFactory.Create<PhasedArrayModel>();
         NS_ASSERT_MSG(antenna, "error in creating the AntennaModel object");
 
-        // initialize the NYU channel model
-        [[maybe_unused]] Ptr<SpectrumPropagationLossModel> splm;
-        [[maybe_unused]] Ptr<PhasedArraySpectrumPropagationLossModel> pSplm;
-
-        Ptr<NYUSpectrumPropagationLossModel> nyuSplm;
-
-        if (m_spectrumPropagationLossModelType == "ns3::NYUSpectrumPropagationLossModel")
-        {
-            pSplm = m_channel.at(it->first)->GetPhasedArraySpectrumPropagationLossModel();
-            nyuSplm = DynamicCast<NYUSpectrumPropagationLossModel>(pSplm);
-        }
-        else
-        {
-            splm = m_channel.at(it->first)->GetSpectrumPropagationLossModel();
-            nyuSplm = DynamicCast<NYUSpectrumPropagationLossModel>(splm);
-        }
-
-        auto channelModel = nyuSplm->GetChannelModel();
-
-        Ptr<MmWaveBeamformingModel> bfModel = m_bfModelFactory.Create<MmWaveBeamformingModel>();
+        // initialize the NYU channel model, the attributes shared by all the
+        // devices on this carrier are already set in the factory of the context
+        const CcInstallContext& ccContext =
+            GetCcInstallContext(this,
+                                it->first,
+                                m_channel.at(it->first),
+                                m_bfModelFactory,
+                                it->second->GetConfigurationParameters());
+
+        Ptr<MmWaveBeamformingModel> bfModel =
+            ccContext.m_bfModelFactory.Create<MmWaveBeamformingModel>();
         bfModel->SetAttributeFailSafe("Device", PointerValue(device));
         bfModel->SetAttributeFailSafe("Antenna", PointerValue(antenna));
-        bfModel->SetAttributeFailSafe("ChannelModel", PointerValue(channelModel));
-
-        if (pSplm)
-        {
-            bfModel->SetAttributeFailSafe("PhasedArraySpectrumPropagationLossModel",
-                                          PointerValue(pSplm));
-        }
-        else if (splm)
-        {
-            bfModel->SetAttributeFailSafe("SpectrumPropagationLossModel", PointerValue(splm));
-        }
-
-        bfModel->SetAttributeFailSafe("MmWavePhyMacCommon",
-                                      PointerValue(it->second->GetConfigurationParameters()));
-        if (m_bfModelFactory.GetTypeId() == MmWaveCodebookBeamforming::GetTypeId())
+        if (ccContext.m_isCodebookBeamforming)
         {
             DynamicCast<MmWaveCodebookBeamforming>(bfModel)->SetBeamformingCodebookFactory(
                 m_enbBeamformingCodebookFactory);
@@ -2514,6 +2942,47 @@ MmWaveHelper::AttachToClosestEnb(Ptr<NetDevice> ueDevice, NetDeviceContainer enb
 {
     NS_LOG_FUNCTION(this << ueDevice << enbDevices.GetN());
     NS_ASSERT_MSG(enbDevices.GetN() > 0, "empty enb device container");
+
+    BooleanValue rsrpCellSelection;
+    g_nyuRsrpCellSelection.GetValue(rsrpCellSelection);
+    if (rsrpCellSelection.Get() && !m_channel.empty())
+    {
+        uint8_t ccId = m_channel.begin()->first;
+        Ptr<NYUSpectrumPropagationLossModel> splm = DynamicCast<NYUSpectrumPropagationLossModel>(
+            m_channel.at(ccId)->GetPhasedArraySpectrumPropagationLossModel());
+        if (splm && m_pathlossModel.find(ccId) != m_pathlossModel.end())
+        {
+            int strongestEnbIndex = GetStrongestEnbIndex(ueDevice,
+                                                         enbDevices,
+                                                         ccId,
+                                                         splm,
+                                                         GetPathLossModel(ccId));
+            if (strongestEnbIndex >= 0)
+            {
+                AttachToEnbWithIndex(ueDevice, enbDevices, strongestEnbIndex);
+
+                TimeValue handoverPeriod;
+                g_nyuRsrpHandoverPeriod.GetValue(handoverPeriod);
+                if (!handoverPeriod.Get().IsZero())
+                {
+                    DoubleValue hysteresis;
+                    g_nyuRsrpHandoverHysteresis.GetValue(hysteresis);
+                    Simulator::Schedule(handoverPeriod.Get(),
+                                        &CheckRsrpHandover,
+                                        ueDevice,
+                                        enbDevices,
+                                        ccId,
+                                        splm,
+                                        GetPathLossModel(ccId),
+                                        handoverPeriod.Get(),
+                                        hysteresis.Get());
+                }
+                return;
+            }
+        }
+        NS_LOG_WARN("The RSRP cell selection needs the NYU models, attaching to the closest eNB");
+    }
+
     Vector uePos = ueDevice->GetNode()->GetObject<MobilityModel>()->GetPosition();
 
     // find the closest BS
@@ -2988,6 +3457,16 @@ MmWaveHelper::ActivateDataRadioBearer(Ptr<NetDevice> ueDevice, EpsBearer bearer)
 void
 MmWaveHelper::EnableTraces(void)
 {
+    if (GetTraceFormat(this) == BINARY_TRACES)
+    {
+        // the binary sink replaces the PHY, MAC, RLC and PDCP text traces,
+        // the multi-connectivity events are still written as text
+        Ptr<NYUBinaryTraceSink> sink = GetObject<NYUBinaryTraceSink>();
+        NS_ASSERT_MSG(sink, "The binary trace sink is aggregated with the TraceFormat");
+        sink->EnableMmWaveTraces();
+        EnableMcTraces();
+        return;
+    }
     EnableDlPhyTrace();
     EnableUlPhyTrace();
     EnableEnbSchedTrace();
@@ -0,0 +1,1100 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+#include "nyu-binary-trace.h"
+
+#include <ns3/abort.h>
+#include <ns3/boolean.h>
+#include <ns3/config.h>
+#include <ns3/log.h>
+#include <ns3/mmwave-mac-sched-sap.h>
+#include <ns3/mmwave-phy-mac-common.h>
+#include <ns3/simulator.h>
+#include <ns3/string.h>
+#include <ns3/uinteger.h>
+
+#include <cmath>
+#include <sstream>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("NYUBinaryTrace");
+
+namespace mmwave
+{
+
+NS_OBJECT_ENSURE_REGISTERED(NYUBinaryTraceSink);
+
+/// the version of the file format
+static const uint32_t NYU_TRACE_VERSION = 2;
+
+/// the magic string at the beginning of the file
+static const char NYU_TRACE_MAGIC[] = "NYUTRACE";
+
+/// the number of sinks with a running writer thread
+static uint32_t g_numOpenSinks = 0;
+
+/// the layers of the records of the PDU table
+enum PduLayer : uint8_t
+{
+    RLC_LAYER = 0,
+    PDCP_LAYER = 1
+};
+
+/**
+ * Appends an integer to a string, little endian
+ * \param out the string
+ * \param value the integer
+ * \param numBytes the number of bytes of the integer
+ */
+static void
+PutInteger(std::string& out, uint64_t value, uint32_t numBytes)
+{
+    for (uint32_t i = 0; i < numBytes; i++)
+    {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+}
+
+/**
+ * Appends a variable length integer to a string, 7 bits per byte
+ * \param out the string
+ * \param value the integer
+ */
+static void
+PutVarint(std::string& out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+/**
+ * Appends a string to a string, preceded by its length (16 bit)
+ * \param out the string
+ * \param value the string to append
+ */
+static void
+PutString(std::string& out, const std::string& value)
+{
+    PutInteger(out, value.size(), 2);
+    out.append(value);
+}
+
+/**
+ * Appends the XOR of two consecutive doubles to a string, without its leading
+ * and trailing zero bytes: a byte holding the number of trailing zero bytes
+ * (high nibble) and the number of the remaining bytes (low nibble), followed
+ * by the remaining bytes, little endian. A null XOR takes a single byte.
+ * \param out the string
+ * \param value the XOR
+ */
+static void
+PutXor(std::string& out, uint64_t value)
+{
+    if (value == 0)
+    {
+        out.push_back(0);
+        return;
+    }
+    uint32_t trailingBytes = 0;
+    while (((value >> (8 * trailingBytes)) & 0xff) == 0)
+    {
+        trailingBytes++;
+    }
+    uint32_t numBytes = 8 - trailingBytes;
+    while (((value >> (8 * (trailingBytes + numBytes - 1))) & 0xff) == 0)
+    {
+        numBytes--;
+    }
+    out.push_back(static_cast<char>((trailingBytes << 4) | numBytes));
+    PutInteger(out, value >> (8 * trailingBytes), numBytes);
+}
+
+/**
+ * Reads the values of a payload in order
+ */
+class ByteCursor
+{
+  public:
+    /**
+     * Constructor
+     * \param data the payload
+     */
+    ByteCursor(const std::string& data)
+        : m_data(data),
+          m_pos(0),
+          m_ok(true)
+    {
+    }
+
+    /**
+     * Reads an integer, little endian
+     * \param numBytes the number of bytes of the integer
+     * \return the integer
+     */
+    uint64_t GetInteger(uint32_t numBytes)
+    {
+        if (m_pos + numBytes > m_data.size())
+        {
+            m_ok = false;
+            return 0;
+        }
+        uint64_t value = 0;
+        for (uint32_t i = 0; i < numBytes; i++)
+        {
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(m_data[m_pos++])) << (8 * i);
+        }
+        return value;
+    }
+
+    /**
+     * Reads a variable length integer
+     * \return the integer
+     */
+    uint64_t GetVarint()
+    {
+        uint64_t value = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7)
+        {
+            if (m_pos >= m_data.size())
+            {
+                break;
+            }
+            uint8_t byte = static_cast<uint8_t>(m_data[m_pos++]);
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+            {
+                return value;
+            }
+        }
+        m_ok = false;
+        return 0;
+    }
+
+    /**
+     * Reads the XOR of two consecutive doubles written by PutXor
+     * \return the XOR
+     */
+    uint64_t GetXor()
+    {
+        uint64_t header = GetInteger(1);
+        uint32_t trailingBytes = header >> 4;
+        uint32_t numBytes = header & 0x0f;
+        if (trailingBytes + numBytes > 8)
+        {
+            m_ok = false;
+            return 0;
+        }
+        return numBytes == 0 ? 0 : GetInteger(numBytes) << (8 * trailingBytes);
+    }
+
+    /**
+     * Reads a string preceded by its length (16 bit)
+     * \return the string
+     */
+    std::string GetString()
+    {
+        uint64_t size = GetInteger(2);
+        return m_ok ? GetBytes(size) : std::string();
+    }
+
+    /**
+     * Reads a sequence of bytes
+     * \param numBytes the number of bytes
+     * \return the bytes
+     */
+    std::string GetBytes(uint64_t numBytes)
+    {
+        if (m_pos + numBytes > m_data.size())
+        {
+            m_ok = false;
+            return std::string();
+        }
+        std::string value = m_data.substr(m_pos, numBytes);
+        m_pos += numBytes;
+        return value;
+    }
+
+    /**
+     * Checks that all the values read so far were within the payload
+     * \return true if the payload was long enough
+     */
+    bool IsOk() const
+    {
+        return m_ok;
+    }
+
+  private:
+    const std::string& m_data; //!< the payload
+    size_t m_pos;              //!< the position of the next value
+    bool m_ok;                 //!< false if a read went past the end of the payload
+};
+
+/**
+ * Records a PHY transmission
+ * \param sink the sink
+ * \param tableId the id of the table
+ * \param isUplink true for an uplink transmission
+ * \param params the parameters of the transmission
+ */
+static void
+RecordPhyTransmission(Ptr<NYUBinaryTraceSink> sink,
+                      uint32_t tableId,
+                      bool isUplink,
+                      PhyTransmissionTraceParams params)
+{
+    sink->AddRecord(tableId,
+                    {isUplink,
+                     params.m_cellId,
+                     params.m_rnti,
+                     params.m_ccId,
+                     params.m_frameNum,
+                     params.m_sfNum,
+                     params.m_slotNum,
+                     params.m_symStart,
+                     params.m_numSym,
+                     params.m_tbSize,
+                     params.m_mcs,
+                     params.m_rv});
+}
+
+/**
+ * Records a received transport block
+ * \param sink the sink
+ * \param tableId the id of the table
+ * \param isUplink true if the transport block is received by the eNB
+ * \param params the parameters of the reception
+ */
+static void
+RecordRxPacket(Ptr<NYUBinaryTraceSink> sink,
+               uint32_t tableId,
+               bool isUplink,
+               RxPacketTraceParams params)
+{
+    sink->AddRecord(tableId,
+                    {isUplink,
+                     params.m_cellId,
+                     params.m_rnti,
+                     params.m_ccId,
+                     params.m_frameNum,
+                     params.m_sfNum,
+                     params.m_slotNum,
+                     params.m_symStart,
+                     params.m_numSym,
+                     params.m_tbSize,
+                     params.m_mcs,
+                     params.m_rv,
+                     10 * std::log10(params.m_sinr),
+                     params.m_corrupt,
+                     params.m_tbler});
+}
+
+/**
+ * Records the data allocations of a subframe scheduled by an eNB
+ * \param sink the sink
+ * \param tableId the id of the table
+ * \param schedParams the scheduling decisions
+ */
+static void
+RecordSchedulingInfo(Ptr<NYUBinaryTraceSink> sink,
+                     uint32_t tableId,
+                     MmWaveMacSchedSapUser::SchedConfigIndParameters schedParams)
+{
+    for (const SlotAllocInfo& slotAlloc : schedParams.m_sfAllocInfo.m_slotAllocInfo)
+    {
+        if (slotAlloc.m_slotType == SlotAllocInfo::CTRL)
+        {
+            continue;
+        }
+        const DciInfoElementTdma& dci = slotAlloc.m_dci;
+        sink->AddRecord(tableId,
+                        {schedParams.m_sfnSf.m_frameNum,
+                         schedParams.m_sfnSf.m_sfNum,
+                         schedParams.m_sfnSf.m_slotNum,
+                         dci.m_rnti,
+                         dci.m_format,
+                         dci.m_symStart,
+                         dci.m_numSym,
+                         dci.m_tbSize,
+                         dci.m_mcs,
+                         dci.m_ndi,
+                         dci.m_rv,
+                         dci.m_harqProcess});
+    }
+}
+
+/**
+ * Records a transmitted RLC or PDCP PDU
+ * \param sink the sink
+ * \param tableId the id of the table
+ * \param layer the layer
+ * \param isUe true if the PDU is transmitted by the UE
+ * \param imsi the IMSI of the UE
+ * \param cellId the cell id
+ * \param rnti the RNTI of the UE
+ * \param lcid the logical channel id
+ * \param size the size of the PDU
+ */
+static void
+RecordTxPdu(Ptr<NYUBinaryTraceSink> sink,
+            uint32_t tableId,
+            uint8_t layer,
+            bool isUe,
+            uint64_t imsi,
+            uint16_t cellId,
+            uint16_t rnti,
+            uint8_t lcid,
+            uint32_t size)
+{
+    sink->AddRecord(tableId, {layer, isUe, false, imsi, cellId, rnti, lcid, size, 0});
+}
+
+/**
+ * Records a received RLC or PDCP PDU
+ * \param sink the sink
+ * \param tableId the id of the table
+ * \param layer the layer
+ * \param isUe true if the PDU is received by the UE
+ * \param imsi the IMSI of the UE
+ * \param cellId the cell id
+ * \param rnti the RNTI of the UE
+ * \param lcid the logical channel id
+ * \param size the size of the PDU
+ * \param delay the delay of the PDU in nanoseconds
+ */
+static void
+RecordRxPdu(Ptr<NYUBinaryTraceSink> sink,
+            uint32_t tableId,
+            uint8_t layer,
+            bool isUe,
+            uint64_t imsi,
+            uint16_t cellId,
+            uint16_t rnti,
+            uint8_t lcid,
+            uint32_t size,
+            uint64_t delay)
+{
+    sink->AddRecord(tableId, {layer, isUe, true, imsi, cellId, rnti, lcid, size, delay});
+}
+
+NYUBinaryTraceSink::NYUBinaryTraceSink()
+    : m_open(false),
+      m_writerRunning(false),
+      m_stop(false),
+      m_phyTxTable(0),
+      m_rxPacketTable(0),
+      m_schedTable(0),
+      m_pduTable(0),
+      m_mmWaveTracesEnabled(false)
+{
+    NS_LOG_FUNCTION(this);
+}
+
+NYUBinaryTraceSink::~NYUBinaryTraceSink()
+{
+    NS_LOG_FUNCTION(this);
+    Close();
+}
+
+TypeId
+NYUBinaryTraceSink::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::NYUBinaryTraceSink")
+            .SetParent<Object>()
+            .AddConstructor<NYUBinaryTraceSink>()
+            .AddAttribute("FileName",
+                          "The name of the trace file",
+                          StringValue("NYUTraces.bin"),
+                          MakeStringAccessor(&NYUBinaryTraceSink::m_fileName),
+                          MakeStringChecker())
+            .AddAttribute("ChunkSize",
+                          "The number of records of a table which are buffered before "
+                          "they are handed over to the writer thread",
+                          UintegerValue(16384),
+                          MakeUintegerAccessor(&NYUBinaryTraceSink::m_chunkSize),
+                          MakeUintegerChecker<uint32_t>(1))
+            .AddAttribute("Compression",
+                          "If true, the integer columns are delta encoded, the floating "
+                          "point columns are XORed with the previous value and both are "
+                          "written as variable length integers",
+                          BooleanValue(false),
+                          MakeBooleanAccessor(&NYUBinaryTraceSink::m_compression),
+                          MakeBooleanChecker())
+            .AddAttribute("MaxPendingChunks",
+                          "The maximum number of chunks waiting for the writer thread. When "
+                          "it is reached, the simulation waits for the writer.",
+                          UintegerValue(16),
+                          MakeUintegerAccessor(&NYUBinaryTraceSink::m_maxPendingChunks),
+                          MakeUintegerChecker<uint32_t>(1));
+    return tid;
+}
+
+void
+NYUBinaryTraceSink::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    Close();
+    m_tables.clear();
+    m_connectedBearers[0].clear();
+    m_connectedBearers[1].clear();
+    Object::DoDispose();
+}
+
+void
+NYUBinaryTraceSink::Open()
+{
+    NS_LOG_FUNCTION(this);
+    if (m_open)
+    {
+        return;
+    }
+    m_open = true;
+    Simulator::ScheduleDestroy(&NYUBinaryTraceSink::Close, Ptr<NYUBinaryTraceSink>(this));
+}
+
+void
+NYUBinaryTraceSink::StartWriter()
+{
+    NS_LOG_FUNCTION(this << m_fileName);
+    m_file.open(m_fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+    NS_ABORT_MSG_IF(!m_file.is_open(), "Cannot open the trace file " << m_fileName);
+
+    std::string header(NYU_TRACE_MAGIC, sizeof(NYU_TRACE_MAGIC) - 1);
+    PutInteger(header, NYU_TRACE_VERSION, 4);
+    m_file.write(header.data(), header.size());
+
+    m_stop = false;
+    m_writerRunning = true;
+    g_numOpenSinks++;
+    m_writer = std::thread(&NYUBinaryTraceSink::WriterLoop, this);
+}
+
+void
+NYUBinaryTraceSink::Close()
+{
+    NS_LOG_FUNCTION(this);
+    if (!m_open)
+    {
+        return;
+    }
+    for (Table& table : m_tables)
+    {
+        FlushTable(table);
+    }
+    // the file is written even if no chunk was handed over, with the schemas only
+    if (!m_writerRunning)
+    {
+        StartWriter();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_queueCv.notify_one();
+    m_writer.join();
+    m_file.close();
+    m_writerRunning = false;
+    m_open = false;
+    g_numOpenSinks--;
+}
+
+uint32_t
+NYUBinaryTraceSink::GetNumOpenSinks()
+{
+    return g_numOpenSinks;
+}
+
+uint32_t
+NYUBinaryTraceSink::AddTable(const std::string& name, const std::vector<Column>& columns)
+{
+    NS_LOG_FUNCTION(this << name);
+    NS_ASSERT_MSG(m_open, "Open the trace file before adding the tables");
+
+    uint32_t tableId = m_tables.size();
+    Table table;
+    table.m_name = name;
+    table.m_chunk.m_tableId = tableId;
+    table.m_chunk.m_types.push_back(INT64);
+    for (const Column& column : columns)
+    {
+        table.m_chunk.m_types.push_back(column.m_type);
+    }
+    table.m_chunk.m_values.resize(table.m_chunk.m_types.size());
+    m_tables.push_back(std::move(table));
+
+    PendingBlock block;
+    block.m_kind = 'S';
+    PutInteger(block.m_bytes, tableId, 4);
+    PutString(block.m_bytes, name);
+    PutInteger(block.m_bytes, columns.size() + 1, 2);
+    PutInteger(block.m_bytes, INT64, 1);
+    PutString(block.m_bytes, "time_ns");
+    for (const Column& column : columns)
+    {
+        PutInteger(block.m_bytes, column.m_type, 1);
+        PutString(block.m_bytes, column.m_name);
+    }
+    Enqueue(std::move(block));
+    return tableId;
+}
+
+void
+NYUBinaryTraceSink::AddRecord(uint32_t tableId, std::initializer_list<Value> values)
+{
+    NS_ASSERT_MSG(tableId < m_tables.size(), "Unknown table " << tableId);
+    Table& table = m_tables[tableId];
+    Chunk& chunk = table.m_chunk;
+    NS_ASSERT_MSG(values.size() + 1 == chunk.m_values.size(),
+                  "Wrong number of values for the table " << table.m_name);
+
+    chunk.m_values[0].push_back(static_cast<uint64_t>(Simulator::Now().GetNanoSeconds()));
+    uint32_t column = 1;
+    for (const Value& value : values)
+    {
+        chunk.m_values[column++].push_back(value.m_bits);
+    }
+    if (++chunk.m_numRecords >= m_chunkSize)
+    {
+        FlushTable(table);
+    }
+}
+
+void
+NYUBinaryTraceSink::FlushTable(Table& table)
+{
+    if (table.m_chunk.m_numRecords == 0)
+    {
+        return;
+    }
+    PendingBlock block;
+    block.m_kind = 'C';
+    block.m_chunk = std::move(table.m_chunk);
+    block.m_chunk.m_compressed = m_compression;
+
+    // the columns of the next chunk are allocated here, so that the writer
+    // thread never touches the tables
+    table.m_chunk = Chunk();
+    table.m_chunk.m_tableId = block.m_chunk.m_tableId;
+    table.m_chunk.m_types = block.m_chunk.m_types;
+    table.m_chunk.m_values.resize(block.m_chunk.m_values.size());
+    for (std::vector<uint64_t>& values : table.m_chunk.m_values)
+    {
+        values.reserve(m_chunkSize);
+    }
+    Enqueue(std::move(block));
+}
+
+void
+NYUBinaryTraceSink::Enqueue(PendingBlock&& block)
+{
+    if (!m_writerRunning)
+    {
+        if (block.m_kind != 'C')
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(std::move(block));
+            return;
+        }
+        StartWriter();
+    }
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_spaceCv.wait(lock, [this] { return m_queue.size() < m_maxPendingChunks; });
+        m_queue.push_back(std::move(block));
+    }
+    m_queueCv.notify_one();
+}
+
+void
+NYUBinaryTraceSink::WriterLoop()
+{
+    std::string payload;
+    std::string blockHeader;
+    while (true)
+    {
+        PendingBlock block;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_queueCv.wait(lock, [this] { return !m_queue.empty() || m_stop; });
+            if (m_queue.empty())
+            {
+                break;
+            }
+            block = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+        m_spaceCv.notify_one();
+
+        payload.clear();
+        if (block.m_kind == 'C')
+        {
+            EncodeChunk(block.m_chunk, payload);
+        }
+        else
+        {
+            payload.swap(block.m_bytes);
+        }
+        blockHeader.clear();
+        blockHeader.push_back(block.m_kind);
+        PutInteger(blockHeader, payload.size(), 4);
+        m_file.write(blockHeader.data(), blockHeader.size());
+        m_file.write(payload.data(), payload.size());
+    }
+    m_file.flush();
+}
+
+void
+NYUBinaryTraceSink::EncodeChunk(const Chunk& chunk, std::string& out) const
+{
+    PutInteger(out, chunk.m_tableId, 4);
+    PutInteger(out, chunk.m_numRecords, 4);
+    PutInteger(out, chunk.m_compressed, 1);
+
+    std::string column;
+    for (uint32_t c = 0; c < chunk.m_values.size(); c++)
+    {
+        const std::vector<uint64_t>& values = chunk.m_values[c];
+        column.clear();
+        if (!chunk.m_compressed)
+        {
+            column.reserve(values.size() * 8);
+            for (uint64_t value : values)
+            {
+                PutInteger(column, value, 8);
+            }
+        }
+        else if (chunk.m_types[c] == DOUBLE)
+        {
+            // consecutive values share the sign, the exponent and the high
+            // order bits of the mantissa, which are cleared by the XOR, and
+            // round values also clear the low order bits: both runs of zero
+            // bytes are dropped
+            uint64_t previous = 0;
+            for (uint64_t value : values)
+            {
+                PutXor(column, value ^ previous);
+                previous = value;
+            }
+        }
+        else
+        {
+            // zigzag encoding of the difference with the previous value
+            uint64_t previous = 0;
+            for (uint64_t value : values)
+            {
+                int64_t delta = static_cast<int64_t>(value - previous);
+                PutVarint(column,
+                          (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63));
+                previous = value;
+            }
+        }
+        PutInteger(out, column.size(), 4);
+        out.append(column);
+    }
+}
+
+void
+NYUBinaryTraceSink::EnableMmWaveTraces()
+{
+    NS_LOG_FUNCTION(this);
+    if (m_mmWaveTracesEnabled)
+    {
+        return;
+    }
+    m_mmWaveTracesEnabled = true;
+    Open();
+
+    m_phyTxTable = AddTable("phy_tx",
+                            {{"uplink", UINT64},
+                             {"cellId", UINT64},
+                             {"rnti", UINT64},
+                             {"ccId", UINT64},
+                             {"frame", UINT64},
+                             {"subframe", UINT64},
+                             {"slot", UINT64},
+                             {"symStart", UINT64},
+                             {"numSym", UINT64},
+                             {"tbSize", UINT64},
+                             {"mcs", UINT64},
+                             {"rv", UINT64}});
+    m_rxPacketTable = AddTable("rx_packet",
+                               {{"uplink", UINT64},
+                                {"cellId", UINT64},
+                                {"rnti", UINT64},
+                                {"ccId", UINT64},
+                                {"frame", UINT64},
+                                {"subframe", UINT64},
+                                {"slot", UINT64},
+                                {"symStart", UINT64},
+                                {"numSym", UINT64},
+                                {"tbSize", UINT64},
+                                {"mcs", UINT64},
+                                {"rv", UINT64},
+                                {"sinrDb", DOUBLE},
+                                {"corrupt", UINT64},
+                                {"tbler", DOUBLE}});
+    m_schedTable = AddTable("enb_sched",
+                            {{"frame", UINT64},
+                             {"subframe", UINT64},
+                             {"slot", UINT64},
+                             {"rnti", UINT64},
+                             {"format", UINT64},
+                             {"symStart", UINT64},
+                             {"numSym", UINT64},
+                             {"tbSize", UINT64},
+                             {"mcs", UINT64},
+                             {"ndi", UINT64},
+                             {"rv", UINT64},
+                             {"harqProcess", UINT64}});
+    m_pduTable = AddTable("pdu",
+                          {{"pdcp", UINT64},
+                           {"ue", UINT64},
+                           {"rx", UINT64},
+                           {"imsi", UINT64},
+                           {"cellId", UINT64},
+                           {"rnti", UINT64},
+                           {"lcid", UINT64},
+                           {"size", UINT64},
+                           {"delayNs", UINT64}});
+
+    Ptr<NYUBinaryTraceSink> sink = this;
+    Config::ConnectWithoutContextFailSafe(
+        "/NodeList/*/DeviceList/*/ComponentCarrierMap/*/MmWaveEnbPhy/ReportDlPhyTransmission",
+        MakeBoundCallback(&RecordPhyTransmission, sink, m_phyTxTable, false));
+    Config::ConnectWithoutContextFailSafe(
+        "/NodeList/*/DeviceList/*/ComponentCarrierMap/*/MmWaveUePhy/ReportUlPhyTransmission",
+        MakeBoundCallback(&RecordPhyTransmission, sink, m_phyTxTable, true));
+
+    Config::ConnectWithoutContextFailSafe(
+        "/NodeList/*/DeviceList/*/ComponentCarrierMap/*/MmWaveUePhy/DlSpectrumPhy/RxPacketTraceUe",
+        MakeBoundCallback(&RecordRxPacket, sink, m_rxPacketTable, false));
+    Config::ConnectWithoutContextFailSafe(
+        "/NodeList/*/DeviceList/*/MmWaveComponentCarrierMapUe/*/MmWaveUePhy/DlSpectrumPhy/"
+        "RxPacketTraceUe",
+        MakeBoundCallback(&RecordRxPacket, sink, m_rxPacketTable, false));
+    Config::ConnectWithoutContextFailSafe(
+        "/NodeList/*/DeviceList/*/ComponentCarrierMap/*/MmWaveEnbPhy/DlSpectrumPhy/"
+        "RxPacketTraceEnb",
+        MakeBoundCallback(&RecordRxPacket, sink, m_rxPacketTable, true));
+
+    Config::ConnectWithoutContextFailSafe(
+        "/NodeList/*/DeviceList/*/ComponentCarrierMap/*/MmWaveEnbMac/SchedulingTraceEnb",
+        MakeBoundCallback(&RecordSchedulingInfo, sink, m_schedTable));
+
+    // the bearers are created when the UEs connect, hence their RLC and PDCP
+    // traces are connected at the reconfiguration of the RRC connection and
+    // after each handover, as done by the MmWaveBearerStatsConnector
+    Config::ConnectFailSafe("/NodeList/*/DeviceList/*/LteEnbRrc/ConnectionReconfiguration",
+                            MakeCallback(&NYUBinaryTraceSink::ConnectEnbBearers, this));
+    Config::ConnectFailSafe("/NodeList/*/DeviceList/*/LteEnbRrc/HandoverEndOk",
+                            MakeCallback(&NYUBinaryTraceSink::ConnectEnbBearers, this));
+    Config::ConnectFailSafe("/NodeList/*/DeviceList/*/LteUeRrc/ConnectionReconfiguration",
+                            MakeCallback(&NYUBinaryTraceSink::ConnectUeBearers, this));
+    Config::ConnectFailSafe("/NodeList/*/DeviceList/*/LteUeRrc/HandoverEndOk",
+                            MakeCallback(&NYUBinaryTraceSink::ConnectUeBearers, this));
+}
+
+void
+NYUBinaryTraceSink::ConnectEnbBearers(std::string context,
+                                      uint64_t imsi,
+                                      uint16_t cellId,
+                                      uint16_t rnti)
+{
+    NS_LOG_FUNCTION(this << context << imsi << cellId << rnti);
+    if (!m_connectedBearers[0].insert(std::make_tuple(imsi, cellId, rnti)).second)
+    {
+        return;
+    }
+    std::ostringstream basePath;
+    basePath << context.substr(0, context.rfind('/')) << "/UeMap/" << rnti;
+    ConnectBearers(basePath.str(), false, imsi, cellId);
+}
+
+void
+NYUBinaryTraceSink::ConnectUeBearers(std::string context,
+                                     uint64_t imsi,
+                                     uint16_t cellId,
+                                     uint16_t rnti)
+{
+    NS_LOG_FUNCTION(this << context << imsi << cellId << rnti);
+    if (!m_connectedBearers[1].insert(std::make_tuple(imsi, cellId, rnti)).second)
+    {
+        return;
+    }
+    ConnectBearers(context.substr(0, context.rfind('/')), true, imsi, cellId);
+}
+
+void
+NYUBinaryTraceSink::ConnectBearers(const std::string& basePath,
+                                   bool isUe,
+                                   uint64_t imsi,
+                                   uint16_t cellId)
+{
+    NS_LOG_FUNCTION(this << basePath << isUe << imsi << cellId);
+    Ptr<NYUBinaryTraceSink> sink = this;
+    const std::pair<std::string, uint8_t> layers[] = {{"LteRlc", RLC_LAYER},
+                                                      {"LtePdcp", PDCP_LAYER}};
+    for (const auto& layer : layers)
+    {
+        std::string path = basePath + "/DataRadioBearerMap/*/" + layer.first;
+        Config::ConnectWithoutContextFailSafe(
+            path + "/TxPDU",
+            MakeBoundCallback(&RecordTxPdu, sink, m_pduTable, layer.second, isUe, imsi, cellId));
+        Config::ConnectWithoutContextFailSafe(
+            path + "/RxPDU",
+            MakeBoundCallback(&RecordRxPdu, sink, m_pduTable, layer.second, isUe, imsi, cellId));
+    }
+}
+
+bool
+NYUBinaryTraceReader::Open(const std::string& fileName)
+{
+    NS_LOG_FUNCTION(this << fileName);
+    if (m_file.is_open())
+    {
+        m_file.close();
+    }
+    m_tables.clear();
+    m_fileName = fileName;
+    m_file.open(fileName, std::ios::in | std::ios::binary);
+    if (!m_file.is_open())
+    {
+        return false;
+    }
+
+    std::string header(sizeof(NYU_TRACE_MAGIC) - 1 + 4, '\0');
+    if (!m_file.read(&header[0], header.size()) ||
+        header.compare(0, sizeof(NYU_TRACE_MAGIC) - 1, NYU_TRACE_MAGIC) != 0)
+    {
+        NS_LOG_WARN(fileName << " is not a trace file");
+        return false;
+    }
+    std::string version = header.substr(sizeof(NYU_TRACE_MAGIC) - 1);
+    ByteCursor cursor(version);
+    if (cursor.GetInteger(4) != NYU_TRACE_VERSION)
+    {
+        NS_LOG_WARN(fileName << " has an unsupported version");
+        return false;
+    }
+    return true;
+}
+
+bool
+NYUBinaryTraceReader::ReadChunk(Chunk& chunk)
+{
+    std::string blockHeader(5, '\0');
+    std::string payload;
+    while (m_file.read(&blockHeader[0], blockHeader.size()))
+    {
+        ByteCursor cursor(blockHeader);
+        cursor.GetInteger(1);
+        payload.resize(cursor.GetInteger(4));
+        if (!m_file.read(&payload[0], payload.size()))
+        {
+            NS_LOG_WARN("Truncated block in " << m_fileName);
+            return false;
+        }
+        if (blockHeader[0] == 'S')
+        {
+            if (!DecodeSchema(payload))
+            {
+                NS_LOG_WARN("Malformed schema in " << m_fileName);
+                return false;
+            }
+        }
+        else if (blockHeader[0] == 'C')
+        {
+            if (!DecodeChunk(payload, chunk))
+            {
+                NS_LOG_WARN("Malformed chunk in " << m_fileName);
+                return false;
+            }
+            return true;
+        }
+        else
+        {
+            NS_LOG_WARN("Unknown block in " << m_fileName);
+            return false;
+        }
+    }
+    return false;
+}
+
+const std::map<uint32_t, NYUBinaryTraceReader::Table>&
+NYUBinaryTraceReader::GetTables() const
+{
+    return m_tables;
+}
+
+bool
+NYUBinaryTraceReader::DecodeSchema(const std::string& payload)
+{
+    ByteCursor cursor(payload);
+    uint32_t tableId = cursor.GetInteger(4);
+    Table table;
+    table.m_name = cursor.GetString();
+    uint32_t numColumns = cursor.GetInteger(2);
+    for (uint32_t c = 0; c < numColumns && cursor.IsOk(); c++)
+    {
+        NYUBinaryTraceSink::Column column;
+        column.m_type = static_cast<NYUBinaryTraceSink::ColumnType>(cursor.GetInteger(1));
+        column.m_name = cursor.GetString();
+        table.m_columns.push_back(column);
+    }
+    if (!cursor.IsOk())
+    {
+        return false;
+    }
+    m_tables[tableId] = table;
+    return true;
+}
+
+bool
+NYUBinaryTraceReader::DecodeChunk(const std::string& payload, Chunk& chunk)
+{
+    ByteCursor cursor(payload);
+    chunk.m_tableId = cursor.GetInteger(4);
+    chunk.m_numRecords = cursor.GetInteger(4);
+    bool compressed = cursor.GetInteger(1);
+    auto tableIt = m_tables.find(chunk.m_tableId);
+    if (!cursor.IsOk() || tableIt == m_tables.end())
+    {
+        return false;
+    }
+
+    const std::vector<NYUBinaryTraceSink::Column>& columns = tableIt->second.m_columns;
+    chunk.m_values.resize(columns.size());
+    for (uint32_t c = 0; c < columns.size(); c++)
+    {
+        std::string column = cursor.GetBytes(cursor.GetInteger(4));
+        if (!cursor.IsOk())
+        {
+            return false;
+        }
+        ByteCursor columnCursor(column);
+        std::vector<uint64_t>& values = chunk.m_values[c];
+        values.resize(chunk.m_numRecords);
+        uint64_t previous = 0;
+        for (uint32_t i = 0; i < chunk.m_numRecords; i++)
+        {
+            if (!compressed)
+            {
+                values[i] = columnCursor.GetInteger(8);
+            }
+            else if (columns[c].m_type == NYUBinaryTraceSink::DOUBLE)
+            {
+                values[i] = columnCursor.GetXor() ^ previous;
+            }
+            else
+            {
+                uint64_t zigzag = columnCursor.GetVarint();
+                values[i] = previous + ((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+            }
+            previous = values[i];
+        }
+        if (!columnCursor.IsOk())
+        {
+            return false;
+        }
+    }
+    tableIt->second.m_numRecords += chunk.m_numRecords;
+    return true;
+}
+
+void
+NYUBinaryTraceReader::WriteValue(uint64_t bits,
+                                 NYUBinaryTraceSink::ColumnType type,
+                                 std::ostream& os)
+{
+    switch (type)
+    {
+    case NYUBinaryTraceSink::INT64:
+        os << static_cast<int64_t>(bits);
+        break;
+    case NYUBinaryTraceSink::DOUBLE: {
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        os << value;
+        break;
+    }
+    default:
+        os << bits;
+        break;
+    }
+}
+
+uint64_t
+NYUBinaryTraceReader::WriteText(const std::string& tableName, std::ostream& os)
+{
+    NS_LOG_FUNCTION(this << tableName);
+    // the file is read again from the beginning
+    if (!Open(m_fileName))
+    {
+        return 0;
+    }
+
+    uint64_t numRecords = 0;
+    bool headerWritten = false;
+    Chunk chunk;
+    while (ReadChunk(chunk))
+    {
+        const Table& table = m_tables[chunk.m_tableId];
+        if (table.m_name != tableName)
+        {
+            continue;
+        }
+        if (!headerWritten)
+        {
+            for (uint32_t c = 0; c < table.m_columns.size(); c++)
+            {
+                os << (c ? "\t" : "") << table.m_columns[c].m_name;
+            }
+            os << std::endl;
+            headerWritten = true;
+        }
+        for (uint32_t i = 0; i < chunk.m_numRecords; i++)
+        {
+            for (uint32_t c = 0; c < table.m_columns.size(); c++)
+            {
+                if (c)
+                {
+                    os << "\t";
+                }
+                WriteValue(chunk.m_values[c][i], table.m_columns[c].m_type, os);
+            }
+            os << "\n";
+        }
+        numRecords += chunk.m_numRecords;
+    }
+    return numRecords;
+}
+
+} // namespace mmwave
+
+} // namespace ns3
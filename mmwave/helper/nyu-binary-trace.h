@@ -0,0 +1,399 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+#ifndef NYU_BINARY_TRACE_H
+#define NYU_BINARY_TRACE_H
+
+#include <ns3/object.h>
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <initializer_list>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace ns3
+{
+
+namespace mmwave
+{
+
+/**
+ * \ingroup mmwave
+ * \brief A trace sink which writes typed binary records in column chunks
+ *
+ * The records of each table are buffered in memory by column. When a table
+ * holds ChunkSize records, its columns are handed over to a writer thread,
+ * which encodes them and appends them to the file, so that the simulator
+ * thread does not format or write the traces. The file is created and the
+ * writer thread is started when the first chunk is handed over (or when the
+ * sink is closed), hence a sink can be opened before the process is forked,
+ * e.g., by NYUReplicationRunner, as long as no chunk is full yet; FileName is
+ * read at that time. If Compression is true, the
+ * integer columns are delta encoded and written as variable length integers,
+ * and the floating point columns are XORed with the previous value and
+ * written without the leading and trailing zero bytes of the XOR, after a
+ * one byte header (at most 9 bytes, 1 for a repeated value); otherwise each
+ * value takes 8 bytes.
+ *
+ * The first column of each table holds the simulation time of the record in
+ * nanoseconds. The file can be read with NYUBinaryTraceReader, e.g., through
+ * the program mmwave/example/nyu-binary-trace-reader.cc.
+ *
+ * The file is made of a header ("NYUTRACE" followed by the version as a 32 bit
+ * integer) and a sequence of blocks. Each block starts with its kind (one byte,
+ * 'S' for the schema of a table and 'C' for a chunk of records) and the size of
+ * its payload (32 bit). All the integers are little endian.
+ */
+class NYUBinaryTraceSink : public Object
+{
+  public:
+    /**
+     * Constructor
+     */
+    NYUBinaryTraceSink();
+
+    /**
+     * Destructor
+     */
+    ~NYUBinaryTraceSink() override;
+
+    /**
+     * Get the type ID
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * The type of the values of a column
+     */
+    enum ColumnType : uint8_t
+    {
+        UINT64 = 0, //!< unsigned integer
+        INT64 = 1,  //!< signed integer
+        DOUBLE = 2  //!< double precision floating point
+    };
+
+    /**
+     * The description of a column
+     */
+    struct Column
+    {
+        std::string m_name; //!< the name of the column
+        ColumnType m_type;  //!< the type of the values
+    };
+
+    /**
+     * A value of a record, stored as the 64 bits of the value
+     */
+    struct Value
+    {
+        /**
+         * Constructs a value from an integer or an enum
+         * \param v the value
+         */
+        template <typename T,
+                  typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value,
+                                          int>::type = 0>
+        Value(T v)
+            : m_bits(static_cast<uint64_t>(v))
+        {
+        }
+
+        /**
+         * Constructs a value from a double
+         * \param v the value
+         */
+        Value(double v)
+        {
+            std::memcpy(&m_bits, &v, sizeof(m_bits));
+        }
+
+        uint64_t m_bits; //!< the bits of the value
+    };
+
+    /**
+     * Opens the sink, so that tables and records can be added. The file and the
+     * writer thread are created with the first chunk. The sink is closed when
+     * the simulator is destroyed.
+     */
+    void Open();
+
+    /**
+     * Writes the records buffered so far, waits for the writer thread to finish
+     * and closes the file
+     */
+    void Close();
+
+    /**
+     * Returns the number of sinks with a running writer thread in this process.
+     * A process must not be forked while a writer is running, since the children
+     * would share its file and the thread would not exist in them
+     * \return the number of sinks with a running writer thread
+     */
+    static uint32_t GetNumOpenSinks();
+
+    /**
+     * Adds a table. The column holding the time is added by the sink.
+     * \param name the name of the table
+     * \param columns the columns of the table
+     * \return the id of the table
+     */
+    uint32_t AddTable(const std::string& name, const std::vector<Column>& columns);
+
+    /**
+     * Adds a record to a table, with the current simulation time
+     * \param tableId the id of the table
+     * \param values the values of the record, one for each column passed to AddTable
+     */
+    void AddRecord(uint32_t tableId, std::initializer_list<Value> values);
+
+    /**
+     * Connects the sink to the PHY, MAC, RLC and PDCP traces of the mmWave
+     * devices, in place of MmWavePhyTrace, MmWaveMacTrace and the
+     * MmWaveBearerStatsCalculator. It opens the sink if needed.
+     */
+    void EnableMmWaveTraces();
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /**
+     * A chunk of records of a table, stored by column
+     */
+    struct Chunk
+    {
+        uint32_t m_tableId{0};                       //!< the id of the table
+        uint32_t m_numRecords{0};                    //!< the number of records
+        bool m_compressed{false};                    //!< true if the chunk is compressed
+        std::vector<ColumnType> m_types;             //!< the type of each column
+        std::vector<std::vector<uint64_t>> m_values; //!< the values of each column
+    };
+
+    /**
+     * A block waiting for the writer thread
+     */
+    struct PendingBlock
+    {
+        char m_kind;         //!< 'S' for a schema, 'C' for a chunk
+        std::string m_bytes; //!< the payload of a schema
+        Chunk m_chunk;       //!< the records of a chunk
+    };
+
+    /**
+     * The state of a table
+     */
+    struct Table
+    {
+        std::string m_name; //!< the name
+        Chunk m_chunk;      //!< the records not yet handed over to the writer
+    };
+
+    /**
+     * Hands over a block to the writer thread, waiting if MaxPendingChunks
+     * blocks are already queued. The writer thread is started by the first
+     * chunk, the schemas added before are queued without waiting.
+     * \param block the block
+     */
+    void Enqueue(PendingBlock&& block);
+
+    /**
+     * Creates the file, writes its header and starts the writer thread
+     */
+    void StartWriter();
+
+    /**
+     * Hands over the records buffered by a table to the writer thread
+     * \param table the table
+     */
+    void FlushTable(Table& table);
+
+    /**
+     * The loop of the writer thread
+     */
+    void WriterLoop();
+
+    /**
+     * Encodes a chunk, called by the writer thread
+     * \param chunk the chunk
+     * \param out the string where the payload of the block is appended
+     */
+    void EncodeChunk(const Chunk& chunk, std::string& out) const;
+
+    /**
+     * Connects the RLC and PDCP traces of the bearers of a UE at the eNB
+     * \param context the context of the trace
+     * \param imsi the IMSI of the UE
+     * \param cellId the cell id
+     * \param rnti the RNTI of the UE
+     */
+    void ConnectEnbBearers(std::string context, uint64_t imsi, uint16_t cellId, uint16_t rnti);
+
+    /**
+     * Connects the RLC and PDCP traces of the bearers of a UE
+     * \param context the context of the trace
+     * \param imsi the IMSI of the UE
+     * \param cellId the cell id
+     * \param rnti the RNTI of the UE
+     */
+    void ConnectUeBearers(std::string context, uint64_t imsi, uint16_t cellId, uint16_t rnti);
+
+    /**
+     * Connects the RLC and PDCP traces below a path
+     * \param basePath the path of the RRC (UE) or of the UE manager (eNB)
+     * \param isUe true if the traces are at the UE
+     * \param imsi the IMSI of the UE
+     * \param cellId the cell id
+     */
+    void ConnectBearers(const std::string& basePath, bool isUe, uint64_t imsi, uint16_t cellId);
+
+    std::string m_fileName;      //!< the name of the file
+    uint32_t m_chunkSize;        //!< the number of records of a chunk
+    bool m_compression;          //!< true if the chunks are compressed
+    uint32_t m_maxPendingChunks; //!< max number of blocks waiting for the writer thread
+
+    std::vector<Table> m_tables; //!< the tables
+    bool m_open;                 //!< true if the sink is open
+    bool m_writerRunning;        //!< true if the file is open and the writer thread is running
+
+    std::ofstream m_file;              //!< the file, written only by the writer thread
+    std::thread m_writer;              //!< the writer thread
+    std::mutex m_mutex;                //!< protects the queue and the stop flag
+    std::condition_variable m_queueCv; //!< notifies the writer of a new block
+    std::condition_variable m_spaceCv; //!< notifies the simulator thread of free space
+    std::deque<PendingBlock> m_queue;  //!< blocks waiting for the writer thread
+    bool m_stop;                       //!< true when the writer thread must exit
+
+    uint32_t m_phyTxTable;      //!< the table of the PHY transmissions
+    uint32_t m_rxPacketTable;   //!< the table of the received transport blocks
+    uint32_t m_schedTable;      //!< the table of the eNB scheduling decisions
+    uint32_t m_pduTable;        //!< the table of the RLC and PDCP PDUs
+    bool m_mmWaveTracesEnabled; //!< true if EnableMmWaveTraces was called
+
+    /// the bearers already connected, as (IMSI, cell id, RNTI), at the eNB and at the UE
+    std::set<std::tuple<uint64_t, uint16_t, uint16_t>> m_connectedBearers[2];
+};
+
+/**
+ * \ingroup mmwave
+ * \brief Reads the files written by NYUBinaryTraceSink
+ *
+ * The file is read one chunk at a time, hence traces larger than the memory can
+ * be converted.
+ */
+class NYUBinaryTraceReader
+{
+  public:
+    /**
+     * A table of the file
+     */
+    struct Table
+    {
+        std::string m_name;                                //!< the name
+        std::vector<NYUBinaryTraceSink::Column> m_columns; //!< the columns, time included
+        uint64_t m_numRecords{0};                          //!< the records read so far
+    };
+
+    /**
+     * A chunk of records of a table
+     */
+    struct Chunk
+    {
+        uint32_t m_tableId{0};                       //!< the id of the table
+        uint32_t m_numRecords{0};                    //!< the number of records
+        std::vector<std::vector<uint64_t>> m_values; //!< the bits of the values of each column
+    };
+
+    /**
+     * Opens a file and checks its header
+     * \param fileName the name of the file
+     * \return false if the file cannot be opened or it is not a trace file
+     */
+    bool Open(const std::string& fileName);
+
+    /**
+     * Reads the next chunk of records. The schemas found before the chunk are
+     * added to the tables.
+     * \param chunk the chunk
+     * \return false at the end of the file
+     */
+    bool ReadChunk(Chunk& chunk);
+
+    /**
+     * Get the tables whose schema has been read so far
+     * \return the tables, indexed by table id
+     */
+    const std::map<uint32_t, Table>& GetTables() const;
+
+    /**
+     * Writes the records of a table as tab separated text, with a header line
+     * \param tableName the name of the table
+     * \param os the output stream
+     * \return the number of records written
+     */
+    uint64_t WriteText(const std::string& tableName, std::ostream& os);
+
+    /**
+     * Formats a value according to the type of its column
+     * \param bits the bits of the value
+     * \param type the type of the column
+     * \param os the output stream
+     */
+    static void WriteValue(uint64_t bits, NYUBinaryTraceSink::ColumnType type, std::ostream& os);
+
+  private:
+    /**
+     * Decodes the payload of a chunk
+     * \param payload the payload
+     * \param chunk the decoded chunk
+     * \return false if the payload is malformed
+     */
+    bool DecodeChunk(const std::string& payload, Chunk& chunk);
+
+    /**
+     * Decodes the payload of a schema and adds the table
+     * \param payload the payload
+     * \return false if the payload is malformed
+     */
+    bool DecodeSchema(const std::string& payload);
+
+    std::string m_fileName;             //!< the name of the file
+    std::ifstream m_file;               //!< the file
+    std::map<uint32_t, Table> m_tables; //!< the tables
+};
+
+} // namespace mmwave
+
+} // namespace ns3
+
+#endif /* NYU_BINARY_TRACE_H */
@@ -0,0 +1,322 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+#include "nyu-replication-runner.h"
+
+#include "nyu-binary-trace.h"
+
+#include <ns3/abort.h>
+#include <ns3/config.h>
+#include <ns3/log.h>
+#include <ns3/mmwave-component-carrier-enb.h>
+#include <ns3/mmwave-enb-net-device.h>
+#include <ns3/mmwave-enb-phy.h>
+#include <ns3/mmwave-spectrum-phy.h>
+#include <ns3/mmwave-ue-net-device.h>
+#include <ns3/mobility-model.h>
+#include <ns3/nyu-checkpoint.h>
+#include <ns3/nyu-spectrum-propagation-loss-model.h>
+#include <ns3/propagation-loss-model.h>
+#include <ns3/rng-seed-manager.h>
+#include <ns3/simulator.h>
+#include <ns3/string.h>
+#include <ns3/uinteger.h>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("NYUReplicationRunner");
+
+namespace mmwave
+{
+
+NS_OBJECT_ENSURE_REGISTERED(NYUReplicationRunner);
+
+NYUReplicationRunner::NYUReplicationRunner()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+NYUReplicationRunner::~NYUReplicationRunner()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+TypeId
+NYUReplicationRunner::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::NYUReplicationRunner")
+            .SetParent<Object>()
+            .AddConstructor<NYUReplicationRunner>()
+            .AddAttribute("MaxParallel",
+                          "The maximum number of replications running at the same time. "
+                          "If 0, the number of hardware threads is used",
+                          UintegerValue(0),
+                          MakeUintegerAccessor(&NYUReplicationRunner::m_maxParallel),
+                          MakeUintegerChecker<uint32_t>())
+            .AddAttribute("TempDirectory",
+                          "The directory where the replications write their results",
+                          StringValue("/tmp"),
+                          MakeStringAccessor(&NYUReplicationRunner::m_tempDirectory),
+                          MakeStringChecker());
+    return tid;
+}
+
+void
+NYUReplicationRunner::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    m_replications.clear();
+    m_replicationCallback = MakeNullCallback<void, uint32_t>();
+    m_resultCallback = MakeNullCallback<std::string, uint32_t>();
+    Object::DoDispose();
+}
+
+void
+NYUReplicationRunner::WarmUp(NetDeviceContainer enbDevices, NetDeviceContainer ueDevices)
+{
+    NS_LOG_FUNCTION(this);
+    for (auto enbIt = enbDevices.Begin(); enbIt != enbDevices.End(); ++enbIt)
+    {
+        Ptr<MmWaveEnbNetDevice> enbDevice = DynamicCast<MmWaveEnbNetDevice>(*enbIt);
+        NS_ABORT_MSG_IF(!enbDevice, "WarmUp supports only MmWaveEnbNetDevice");
+        Ptr<MobilityModel> enbMob = enbDevice->GetNode()->GetObject<MobilityModel>();
+
+        for (const auto& enbCc : enbDevice->GetCcMap())
+        {
+            Ptr<MmWaveComponentCarrierEnb> ccEnb =
+                DynamicCast<MmWaveComponentCarrierEnb>(enbCc.second);
+            Ptr<SpectrumChannel> channel =
+                ccEnb->GetPhy()->GetDlSpectrumPhy()->GetSpectrumChannel();
+            Ptr<NYUSpectrumPropagationLossModel> nyuSplm =
+                DynamicCast<NYUSpectrumPropagationLossModel>(
+                    channel->GetPhasedArraySpectrumPropagationLossModel());
+            Ptr<PropagationLossModel> pathloss = channel->GetPropagationLossModel();
+
+            for (auto ueIt = ueDevices.Begin(); ueIt != ueDevices.End(); ++ueIt)
+            {
+                Ptr<MmWaveUeNetDevice> ueDevice = DynamicCast<MmWaveUeNetDevice>(*ueIt);
+                NS_ABORT_MSG_IF(!ueDevice, "WarmUp supports only MmWaveUeNetDevice");
+                Ptr<MobilityModel> ueMob = ueDevice->GetNode()->GetObject<MobilityModel>();
+
+                // the channel condition, the shadowing and the O2I losses are
+                // cached by the propagation loss model
+                if (pathloss)
+                {
+                    pathloss->CalcRxPower(0.0, enbMob, ueMob);
+                }
+
+                // the channel params and matrix are cached by the channel model
+                auto ueCcMap = ueDevice->GetCcMap();
+                auto ueCc = ueCcMap.find(enbCc.first);
+                if (nyuSplm && ueCc != ueCcMap.end())
+                {
+                    nyuSplm->GetChannelModel()->GetChannel(enbMob,
+                                                           ueMob,
+                                                           enbCc.second->GetAntenna(),
+                                                           ueCc->second->GetAntenna());
+                }
+            }
+        }
+    }
+}
+
+void
+NYUReplicationRunner::AddReplication(uint32_t run, const std::vector<AttributeOverride>& overrides)
+{
+    NS_LOG_FUNCTION(this << run);
+    m_replications.push_back({run, overrides});
+}
+
+uint32_t
+NYUReplicationRunner::GetNumReplications() const
+{
+    return m_replications.size();
+}
+
+void
+NYUReplicationRunner::SetReplicationCallback(Callback<void, uint32_t> cb)
+{
+    NS_LOG_FUNCTION(this);
+    m_replicationCallback = cb;
+}
+
+void
+NYUReplicationRunner::SetResultCallback(Callback<std::string, uint32_t> cb)
+{
+    NS_LOG_FUNCTION(this);
+    m_resultCallback = cb;
+}
+
+std::vector<std::string>
+NYUReplicationRunner::Run(Time stopTime)
+{
+    NS_LOG_FUNCTION(this << stopTime);
+
+    // the writer threads would not exist in the children, which would deadlock on
+    // their queues, and the children would write to the same file
+    NS_ABORT_MSG_IF(NYUBinaryTraceSink::GetNumOpenSinks() > 0,
+                    "Cannot fork the replications after a binary trace sink started writing: "
+                    "enable the traces in the replication callback");
+    NS_ABORT_MSG_IF(NYUCheckpoint::GetNumRunningWriters() > 0,
+                    "Cannot fork the replications with a started NYUCheckpoint: close it "
+                    "before Run() or start it in the replication callback");
+
+    uint32_t maxParallel = m_maxParallel;
+    if (maxParallel == 0)
+    {
+        maxParallel = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    std::vector<std::string> resultFiles(m_replications.size());
+    std::vector<bool> succeeded(m_replications.size(), false);
+    std::map<pid_t, uint32_t> running; // pid of the child -> index of the replication
+
+    // reaps one child and records whether the replication terminated correctly
+    auto waitChild = [&running, &succeeded]() {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        NS_ABORT_MSG_IF(pid < 0, "waitpid failed");
+        auto it = running.find(pid);
+        NS_ASSERT_MSG(it != running.end(), "Unknown child " << pid);
+        succeeded[it->second] = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        if (!succeeded[it->second])
+        {
+            NS_LOG_WARN("Replication " << it->second << " did not terminate correctly");
+        }
+        running.erase(it);
+    };
+
+    for (uint32_t i = 0; i < m_replications.size(); i++)
+    {
+        if (running.size() >= maxParallel)
+        {
+            waitChild();
+        }
+
+        std::string fileTemplate = m_tempDirectory + "/nyu-replication-XXXXXX";
+        int fd = mkstemp(&fileTemplate[0]);
+        NS_ABORT_MSG_IF(fd < 0, "Cannot create a file in " << m_tempDirectory);
+        close(fd);
+        resultFiles[i] = fileTemplate;
+
+        // flush the buffers, otherwise their content would be printed also by the child
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(nullptr);
+
+        pid_t pid = fork();
+        NS_ABORT_MSG_IF(pid < 0, "fork failed");
+        if (pid == 0)
+        {
+            RunReplication(i, stopTime, resultFiles[i]);
+            // the destructors of the static objects shared with the parent are
+            // skipped, the objects of the simulation are released by
+            // Simulator::Destroy in RunReplication
+            _exit(0);
+        }
+        NS_LOG_DEBUG("Replication " << i << " with RngRun " << m_replications[i].m_run
+                                    << " started in process " << pid);
+        running[pid] = i;
+    }
+
+    while (!running.empty())
+    {
+        waitChild();
+    }
+
+    std::vector<std::string> results(m_replications.size());
+    for (uint32_t i = 0; i < m_replications.size(); i++)
+    {
+        if (succeeded[i])
+        {
+            std::ifstream f(resultFiles[i]);
+            std::stringstream ss;
+            ss << f.rdbuf();
+            results[i] = ss.str();
+        }
+        std::remove(resultFiles[i].c_str());
+    }
+    return results;
+}
+
+void
+NYUReplicationRunner::RunReplication(uint32_t index, Time stopTime, std::string resultFile)
+{
+    NS_LOG_FUNCTION(this << index << stopTime << resultFile);
+
+    const Replication& replication = m_replications[index];
+    RngSeedManager::SetRun(replication.m_run);
+    for (const auto& attributeOverride : replication.m_overrides)
+    {
+        if (!attributeOverride.first.empty() && attributeOverride.first[0] == '/')
+        {
+            Config::Set(attributeOverride.first, StringValue(attributeOverride.second));
+        }
+        else
+        {
+            Config::SetDefault(attributeOverride.first, StringValue(attributeOverride.second));
+        }
+    }
+
+    if (!m_replicationCallback.IsNull())
+    {
+        m_replicationCallback(index);
+    }
+
+    Simulator::Stop(stopTime);
+    Simulator::Run();
+
+    std::string result;
+    if (!m_resultCallback.IsNull())
+    {
+        result = m_resultCallback(index);
+    }
+    std::ofstream f(resultFile);
+    f << result;
+    f.close();
+
+    // run the ScheduleDestroy events, e.g., the trace sinks and the
+    // checkpoints started by the replication flush and close their files
+    Simulator::Destroy();
+
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(nullptr);
+}
+
+} // namespace mmwave
+
+} // namespace ns3
@@ -0,0 +1,175 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+#ifndef NYU_REPLICATION_RUNNER_H
+#define NYU_REPLICATION_RUNNER_H
+
+#include <ns3/callback.h>
+#include <ns3/net-device-container.h>
+#include <ns3/nstime.h>
+#include <ns3/object.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+namespace mmwave
+{
+
+/**
+ * \ingroup mmwave
+ * \brief Runs several replications of the same topology sharing the NYU channel state
+ *
+ * The topology is built once in the parent process and the NYU caches (channel
+ * params and matrices, channel conditions, shadowing and O2I losses) are filled for
+ * every gNB-UE pair through WarmUp. Run then forks a child process for each
+ * replication: the child sets its RngRun, applies its attribute overrides, calls the
+ * replication callback, runs the simulation and returns the string produced by the
+ * result callback to the parent. The children share the pages holding the channel
+ * state with the parent until they modify them (copy-on-write), so the cost of
+ * generating the channels is paid only once.
+ *
+ * Note that the random variable streams created before the fork keep the run
+ * number of the parent: RngRun seeds only the streams created or re-assigned in
+ * the child. The replication callback is the place to re-assign the streams
+ * (e.g., through MmWaveHelper::AssignStreams) so that they are seeded with the
+ * run number of the replication. Similarly, overrides of default values (i.e.,
+ * "ns3::Class::Attribute") affect only the objects created in the child.
+ *
+ * A process must not be forked while other threads are running. Run aborts if
+ * the writer thread of a NYUBinaryTraceSink is running or a NYUCheckpoint is
+ * started. A sink starts its writer with the first full chunk, hence the binary
+ * traces can be enabled before Run, as long as the replication callback sets a
+ * different FileName on the sink; the checkpoints must be started in the callback.
+ * The batch threads of NYUSpectrumPropagationLossModel are created again in the
+ * child when needed.
+ */
+class NYUReplicationRunner : public Object
+{
+  public:
+    /**
+     * Constructor
+     */
+    NYUReplicationRunner();
+
+    /**
+     * Destructor
+     */
+    ~NYUReplicationRunner() override;
+
+    /**
+     * Get the type ID
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * An attribute override: the first element is either a Config path
+     * (e.g., "/NodeList/0/DeviceList/0/...") or the name of a default value
+     * (e.g., "ns3::MmWaveHelper::HarqEnabled"), the second element is the value
+     */
+    typedef std::pair<std::string, std::string> AttributeOverride;
+
+    /**
+     * Computes the channel between each gNB and each UE, for each component
+     * carrier, so that the NYU caches are filled before the replications are forked
+     * \param enbDevices the gNB devices
+     * \param ueDevices the UE devices
+     */
+    void WarmUp(NetDeviceContainer enbDevices, NetDeviceContainer ueDevices);
+
+    /**
+     * Adds a replication
+     * \param run the RngRun used by the replication
+     * \param overrides the attribute overrides applied by the replication
+     */
+    void AddReplication(uint32_t run,
+                        const std::vector<AttributeOverride>& overrides =
+                            std::vector<AttributeOverride>());
+
+    /**
+     * Get the number of replications
+     * \return the number of replications
+     */
+    uint32_t GetNumReplications() const;
+
+    /**
+     * Sets the callback invoked in each child process before the simulation
+     * starts, with the index of the replication as parameter
+     * \param cb the callback
+     */
+    void SetReplicationCallback(Callback<void, uint32_t> cb);
+
+    /**
+     * Sets the callback invoked in each child process when the simulation ends,
+     * with the index of the replication as parameter. The returned string is
+     * collected by the parent.
+     * \param cb the callback
+     */
+    void SetResultCallback(Callback<std::string, uint32_t> cb);
+
+    /**
+     * Forks the replications and waits for them to finish. It must be called
+     * before Simulator::Run in the parent process.
+     * \param stopTime the simulated time of each replication
+     * \return the results of the replications, in the order they were added. The
+     *         result of a replication which did not terminate correctly is empty.
+     */
+    std::vector<std::string> Run(Time stopTime);
+
+  protected:
+    void DoDispose() override;
+
+  private:
+    /**
+     * Runs a replication, called in the child process
+     * \param index the index of the replication
+     * \param stopTime the simulated time of the replication
+     * \param resultFile the file where the result is written
+     */
+    void RunReplication(uint32_t index, Time stopTime, std::string resultFile);
+
+    /**
+     * Holds the configuration of a replication
+     */
+    struct Replication
+    {
+        uint32_t m_run;                              //!< the RngRun
+        std::vector<AttributeOverride> m_overrides; //!< the attribute overrides
+    };
+
+    std::vector<Replication> m_replications;            //!< the replications
+    Callback<void, uint32_t> m_replicationCallback;     //!< called before each replication
+    Callback<std::string, uint32_t> m_resultCallback;   //!< called at the end of each replication
+    uint32_t m_maxParallel;                             //!< max number of concurrent children
+    std::string m_tempDirectory;                        //!< directory of the result files
+};
+
+} // namespace mmwave
+
+} // namespace ns3
+
+#endif /* NYU_REPLICATION_RUNNER_H */
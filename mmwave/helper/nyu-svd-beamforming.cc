@@ -0,0 +1,94 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+#include "nyu-svd-beamforming.h"
+
+#include <ns3/abort.h>
+#include <ns3/log.h>
+#include <ns3/mobility-model.h>
+#include <ns3/node.h>
+#include <ns3/pointer.h>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE("NYUSvdBeamforming");
+
+namespace mmwave
+{
+
+NS_OBJECT_ENSURE_REGISTERED(NYUSvdBeamforming);
+
+NYUSvdBeamforming::NYUSvdBeamforming()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+NYUSvdBeamforming::~NYUSvdBeamforming()
+{
+    NS_LOG_FUNCTION(this);
+}
+
+TypeId
+NYUSvdBeamforming::GetTypeId()
+{
+    static TypeId tid =
+        TypeId("ns3::NYUSvdBeamforming")
+            .SetParent<MmWaveBeamformingModel>()
+            .AddConstructor<NYUSvdBeamforming>()
+            .AddAttribute("ChannelModel",
+                          "The NYU channel model computing the dominant beams",
+                          PointerValue(),
+                          MakePointerAccessor(&NYUSvdBeamforming::m_channelModel),
+                          MakePointerChecker<NYUChannelModel>());
+    return tid;
+}
+
+void
+NYUSvdBeamforming::DoDispose()
+{
+    NS_LOG_FUNCTION(this);
+    m_channelModel = nullptr;
+    MmWaveBeamformingModel::DoDispose();
+}
+
+void
+NYUSvdBeamforming::SetBeamformingVectorForDevice(Ptr<NetDevice> otherDevice,
+                                                 Ptr<PhasedArrayModel> otherAntenna)
+{
+    NS_LOG_FUNCTION(this << otherDevice);
+    NS_ABORT_MSG_IF(!m_channelModel, "The ChannelModel attribute must be set");
+    NS_ABORT_MSG_IF(!otherAntenna, "The antenna of the other device must be provided");
+
+    Ptr<MobilityModel> thisMob = m_device->GetNode()->GetObject<MobilityModel>();
+    Ptr<MobilityModel> otherMob = otherDevice->GetNode()->GetObject<MobilityModel>();
+    Ptr<const NYUChannelModel::DominantBeams> beams =
+        m_channelModel->GetDominantBeams(thisMob, otherMob, m_antenna, otherAntenna);
+    NS_LOG_DEBUG("Dominant beam towards node " << otherDevice->GetNode()->GetId() << " with gain "
+                                               << beams->m_gain);
+    m_antenna->SetBeamformingVector(beams->m_aW);
+}
+
+} // namespace mmwave
+
+} // namespace ns3
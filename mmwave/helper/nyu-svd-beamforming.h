@@ -0,0 +1,91 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+#ifndef NYU_SVD_BEAMFORMING_H
+#define NYU_SVD_BEAMFORMING_H
+
+#include <ns3/mmwave-beamforming-model.h>
+#include <ns3/nyu-channel-model.h>
+
+namespace ns3
+{
+
+namespace mmwave
+{
+
+/**
+ * \ingroup mmwave
+ * \brief SVD beamforming with the dominant beams cached by the NYUChannelModel
+ *
+ * Sets the beamforming vector of the device to the dominant right singular
+ * vector of the narrowband channel matrix towards the other device, as
+ * MmWaveSvdBeamforming does, but takes it from
+ * NYUChannelModel::GetDominantBeams. The beams are obtained by power iteration
+ * on the factorized ray representation, without generating the channel matrix,
+ * and are computed again only when the channel params of the link are
+ * regenerated, hence repeated beam updates towards the same device are cheap.
+ * It can be selected through the BeamformingModel attribute of the MmWaveHelper
+ * ("ns3::NYUSvdBeamforming"), which sets the ChannelModel attribute.
+ */
+class NYUSvdBeamforming : public MmWaveBeamformingModel
+{
+  public:
+    /**
+     * Constructor
+     */
+    NYUSvdBeamforming();
+
+    /**
+     * Destructor
+     */
+    ~NYUSvdBeamforming() override;
+
+    /**
+     * Get the type ID
+     * \return the object TypeId
+     */
+    static TypeId GetTypeId();
+
+    /**
+     * Sets the beamforming vector of the antenna of this device towards the other device
+     * \param otherDevice the device towards which the beam is pointed
+     * \param otherAntenna the antenna array of the other device
+     */
+    void SetBeamformingVectorForDevice(Ptr<NetDevice> otherDevice,
+                                       Ptr<PhasedArrayModel> otherAntenna) override;
+
+  protected:
+    /**
+     * Dispose
+     */
+    void DoDispose() override;
+
+  private:
+    Ptr<NYUChannelModel> m_channelModel; //!< the channel model computing the dominant beams
+};
+
+} // namespace mmwave
+
+} // namespace ns3
+
+#endif /* NYU_SVD_BEAMFORMING_H */
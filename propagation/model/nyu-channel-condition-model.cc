@@ -33,7 +33,9 @@
 #include "ns3/simulator.h"
 #include "ns3/string.h"
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 
 namespace ns3
 {
@@ -52,16 +54,48 @@ NYUChannelConditionModel::GetTypeId (void)
                    TimeValue (MilliSeconds (0)),
                    MakeTimeAccessor (&NYUChannelConditionModel::m_updatePeriod),
                    MakeTimeChecker ())
+    .AddAttribute ("LosTableDistanceStep",
+                   "The 2D distance resolution, in meters, of the pLos table used by GetChannelConditions. "
+                   "The pLos is interpolated linearly between the grid points",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&NYUChannelConditionModel::m_losTableDistanceStep),
+                   MakeDoubleChecker<double> (1e-3))
+    .AddAttribute ("LosTableMaxDistance",
+                   "The largest 2D distance, in meters, covered by the pLos table. Longer links are evaluated exactly",
+                   DoubleValue (5000.0),
+                   MakeDoubleAccessor (&NYUChannelConditionModel::m_losTableMaxDistance),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("LosTableHeightStep",
+                   "The UT height resolution, in meters, of the pLos table for the scenarios where pLos depends on h_UT",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&NYUChannelConditionModel::m_losTableHeightStep),
+                   MakeDoubleChecker<double> (1e-3))
+    .AddAttribute ("LosTableMaxCellSpread",
+                   "The largest difference between the pLos values at the corners of a cell of the pLos table "
+                   "for which pLos is interpolated. In the cells with a larger spread pLos is evaluated exactly",
+                   DoubleValue (0.02),
+                   MakeDoubleAccessor (&NYUChannelConditionModel::m_losTableMaxCellSpread),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("LosTableMaxHeight",
+                   "The largest UT height, in meters, covered by the pLos table. Higher UTs are evaluated exactly",
+                   DoubleValue (23.0),
+                   MakeDoubleAccessor (&NYUChannelConditionModel::m_losTableMaxHeight),
+                   MakeDoubleChecker<double> (0.0))
   ;
   return tid;
 }
 
 NYUChannelConditionModel::NYUChannelConditionModel ()
-  : ChannelConditionModel ()
+  : ChannelConditionModel (),
+    m_plosTableNumDistances (0),
+    m_plosTableNumHeights (0),
+    m_plosTableDistanceStep (0),
+    m_plosTableMaxDistance (0),
+    m_plosTableHeightStep (0),
+    m_plosTableMaxHeight (0)
 {
-  m_uniformVar = CreateObject<UniformRandomVariable> ();
-  m_uniformVar->SetAttribute ("Min", DoubleValue (0));
-  m_uniformVar->SetAttribute ("Max", DoubleValue (1));
+  m_uniformVar.Get ()->SetAttribute ("Min", DoubleValue (0));
+  m_uniformVar.Get ()->SetAttribute ("Max", DoubleValue (1));
 }
 
 NYUChannelConditionModel::~NYUChannelConditionModel ()
@@ -71,6 +105,9 @@ void NYUChannelConditionModel::DoDispose ()
 {
   m_channelConditionMap.clear();
   m_updatePeriod = Seconds(0.0);
+  m_plosTable.clear ();
+  m_plosTableNumDistances = 0;
+  m_plosTableNumHeights = 0;
 }
 
 Ptr<ChannelCondition>
@@ -119,6 +156,176 @@ NYUChannelConditionModel::GetChannelCondition (Ptr<const MobilityModel> a,
   return cond;
 }
 
+std::vector<Ptr<ChannelCondition>>
+NYUChannelConditionModel::GetChannelConditions (
+    const std::vector<std::pair<Ptr<const MobilityModel>, Ptr<const MobilityModel>>> &links) const
+{
+  NS_LOG_FUNCTION (this << links.size ());
+  std::vector<Ptr<ChannelCondition>> conditions (links.size ());
+
+  // first pass: reuse the cached conditions and collect the links that need
+  // a new one. pending maps the key of each new link to its position in the
+  // draw block, so that a link repeated in the batch is drawn only once
+  std::unordered_map<uint32_t, uint32_t> pending;
+  std::vector<uint32_t> linkDraw (links.size ());
+  std::vector<uint32_t> drawKey;
+  std::vector<double> pLos;
+  for (size_t i = 0; i < links.size (); ++i)
+    {
+      Ptr<const MobilityModel> a = links[i].first;
+      Ptr<const MobilityModel> b = links[i].second;
+      uint32_t key = GetKey (a, b);
+
+      auto pendingIt = pending.find (key);
+      if (pendingIt != pending.end ())
+        {
+          linkDraw[i] = pendingIt->second;
+          continue;
+        }
+
+      auto mapItem = m_channelConditionMap.find (key);
+      if (mapItem != m_channelConditionMap.end ()
+          && (m_updatePeriod.IsZero () || Simulator::Now () - mapItem->second.m_generatedTime <= m_updatePeriod))
+        {
+          conditions[i] = mapItem->second.m_condition;
+          continue;
+        }
+
+      Vector posA = a->GetPosition ();
+      Vector posB = b->GetPosition ();
+      linkDraw[i] = drawKey.size ();
+      pending[key] = drawKey.size ();
+      drawKey.push_back (key);
+      pLos.push_back (GetTabulatedPlos (Calculate2dDistance (posA, posB), GetUtHeight (posA, posB)));
+    }
+
+  if (drawKey.empty ())
+    {
+      return conditions;
+    }
+
+  // draw the uniform values as one block and compare them against the LOS
+  // probabilities in a single pass
+  std::vector<double> pRef (drawKey.size ());
+  for (double &u : pRef)
+    {
+      u = m_uniformVar.GetValue ();
+    }
+  std::vector<Ptr<ChannelCondition>> drawn (drawKey.size ());
+  Time now = Simulator::Now ();
+  for (size_t j = 0; j < drawKey.size (); ++j)
+    {
+      NS_LOG_DEBUG ("pRef " << pRef[j] << " pLos " << pLos[j]);
+      drawn[j] = CreateObject<ChannelCondition> ();
+      drawn[j]->SetLosCondition (pRef[j] <= pLos[j] ? ChannelCondition::LosConditionValue::LOS
+                                                     : ChannelCondition::LosConditionValue::NLOS);
+      // store the channel condition in m_channelConditionMap, used as cache.
+      // For this reason you see a const_cast.
+      Item mapItem;
+      mapItem.m_condition = drawn[j];
+      mapItem.m_generatedTime = now;
+      const_cast<NYUChannelConditionModel*> (this)->m_channelConditionMap [drawKey[j]] = mapItem;
+    }
+
+  for (size_t i = 0; i < links.size (); ++i)
+    {
+      if (!conditions[i])
+        {
+          conditions[i] = drawn[linkDraw[i]];
+        }
+    }
+  return conditions;
+}
+
+bool
+NYUChannelConditionModel::IsPlosHeightDependent (void) const
+{
+  return false;
+}
+
+void
+NYUChannelConditionModel::BuildPlosTable (void) const
+{
+  NS_LOG_FUNCTION (this);
+  m_plosTableDistanceStep = m_losTableDistanceStep;
+  m_plosTableMaxDistance = m_losTableMaxDistance;
+  m_plosTableHeightStep = m_losTableHeightStep;
+  m_plosTableMaxHeight = m_losTableMaxHeight;
+  m_plosTableNumDistances = static_cast<uint32_t> (std::floor (m_losTableMaxDistance / m_losTableDistanceStep)) + 1;
+  m_plosTableNumHeights = IsPlosHeightDependent ()
+    ? static_cast<uint32_t> (std::floor (m_losTableMaxHeight / m_losTableHeightStep)) + 1
+    : 1;
+
+  m_plosTable.resize (static_cast<size_t> (m_plosTableNumDistances) * m_plosTableNumHeights);
+  for (uint32_t h = 0; h < m_plosTableNumHeights; ++h)
+    {
+      double hUt = h * m_losTableHeightStep;
+      double *row = &m_plosTable[static_cast<size_t> (h) * m_plosTableNumDistances];
+      for (uint32_t d = 0; d < m_plosTableNumDistances; ++d)
+        {
+          // some formulas exceed 1, which is equivalent to 1 when drawing the condition.
+          // A non finite sample is stored as is, so that the tabulated condition
+          // matches the exact one, which draws NLOS when compared with it
+          double pLos = ComputePlosFromGeometry (d * m_losTableDistanceStep, hUt);
+          row[d] = std::isfinite (pLos) ? std::min (1.0, pLos) : pLos;
+        }
+    }
+  NS_LOG_DEBUG ("pLos table with " << m_plosTableNumDistances << " distances and "
+                << m_plosTableNumHeights << " heights");
+}
+
+double
+NYUChannelConditionModel::GetTabulatedPlos (double distance2D, double hUt) const
+{
+  // the table is built again if the LosTable* attributes have been changed
+  if (m_plosTable.empty () || m_plosTableDistanceStep != m_losTableDistanceStep
+      || m_plosTableMaxDistance != m_losTableMaxDistance || m_plosTableHeightStep != m_losTableHeightStep
+      || m_plosTableMaxHeight != m_losTableMaxHeight)
+    {
+      BuildPlosTable ();
+    }
+
+  bool heightDependent = m_plosTableNumHeights > 1;
+  if (distance2D > m_losTableMaxDistance || (heightDependent && (hUt < 0.0 || hUt > m_losTableMaxHeight)))
+    {
+      return ComputePlosFromGeometry (distance2D, hUt);
+    }
+
+  // bilinear interpolation on the (d2D, h_UT) grid; the last grid point is
+  // clamped so that the interpolation never reads past the end of a row
+  double dPos = distance2D / m_losTableDistanceStep;
+  uint32_t d0 = std::min (static_cast<uint32_t> (dPos), m_plosTableNumDistances - 1);
+  uint32_t d1 = std::min (d0 + 1, m_plosTableNumDistances - 1);
+  double dFrac = dPos - d0;
+
+  uint32_t h0 = 0;
+  uint32_t h1 = 0;
+  double hFrac = 0.0;
+  if (heightDependent)
+    {
+      double hPos = hUt / m_losTableHeightStep;
+      h0 = std::min (static_cast<uint32_t> (hPos), m_plosTableNumHeights - 1);
+      h1 = std::min (h0 + 1, m_plosTableNumHeights - 1);
+      hFrac = hPos - h0;
+    }
+
+  const double *row0 = &m_plosTable[static_cast<size_t> (h0) * m_plosTableNumDistances];
+  const double *row1 = &m_plosTable[static_cast<size_t> (h1) * m_plosTableNumDistances];
+
+  // pLos is discontinuous or steep in some cells (e.g., at the breakpoint
+  // distance of UMi, or where the h_UT term of UMa starts), where it is
+  // evaluated exactly instead of interpolated
+  double cellMin = std::min (std::min (row0[d0], row0[d1]), std::min (row1[d0], row1[d1]));
+  double cellMax = std::max (std::max (row0[d0], row0[d1]), std::max (row1[d0], row1[d1]));
+  if (cellMax - cellMin > m_losTableMaxCellSpread)
+    {
+      return ComputePlosFromGeometry (distance2D, hUt);
+    }
+  double p0 = row0[d0] + (row0[d1] - row0[d0]) * dFrac;
+  double p1 = row1[d0] + (row1[d1] - row1[d0]) * dFrac;
+  return p0 + (p1 - p0) * hFrac;
+}
+
 Ptr<ChannelCondition>
 NYUChannelConditionModel::ComputeChannelCondition (Ptr<const MobilityModel> a,
                                                    Ptr<const MobilityModel> b) const
@@ -130,7 +337,7 @@ NYUChannelConditionModel::ComputeChannelCondition (Ptr<const MobilityModel> a,
   double pLos = ComputePlos(a, b);
 
   // draw a random value
-  double pRef = m_uniformVar->GetValue();
+  double pRef = m_uniformVar.GetValue ();
 
   NS_LOG_DEBUG ("pRef " << pRef << " pLos " << pLos );
 
@@ -151,10 +358,101 @@ NYUChannelConditionModel::ComputeChannelCondition (Ptr<const MobilityModel> a,
 int64_t
 NYUChannelConditionModel::AssignStreams(int64_t stream)
 {
-  m_uniformVar->SetStream (stream);
+  m_uniformVar.SetStream (stream);
   return 1;
 }
 
+/**
+ * Writes the condition of a link in the form used by the checkpoints
+ * \param item the bytes of the condition
+ * \param condition the channel condition
+ * \param generatedTime the time when the condition was generated
+ */
+static void
+GetCheckpointItem (uint8_t (&item)[16], Ptr<const ChannelCondition> condition, Time generatedTime)
+{
+  int32_t los = condition->GetLosCondition ();
+  int32_t o2i = condition->GetO2iCondition ();
+  int64_t timeStep = generatedTime.GetTimeStep ();
+  std::memcpy (item, &los, sizeof (los));
+  std::memcpy (item + 4, &o2i, sizeof (o2i));
+  std::memcpy (item + 8, &timeStep, sizeof (timeStep));
+}
+
+void
+NYUChannelConditionModel::SaveCheckpoint (std::vector<uint8_t> &buffer, bool full)
+{
+  NS_LOG_FUNCTION (this << full);
+  if (full)
+    {
+      m_checkpointTracker.Clear ();
+    }
+  NYUCheckpoint::Append<uint8_t> (buffer, full ? 1 : 0);
+  m_uniformVar.SaveCheckpoint (buffer);
+
+  // the conditions are small, their bytes are their version
+  std::vector<uint8_t> changed;
+  uint64_t numChanged = 0;
+  uint8_t item[16];
+  for (const auto &entry : m_channelConditionMap)
+    {
+      GetCheckpointItem (item, entry.second.m_condition, entry.second.m_generatedTime);
+      if (m_checkpointTracker.Update (entry.first, NYUCheckpoint::Hash (item, sizeof (item))))
+        {
+          NYUCheckpoint::Append<uint32_t> (changed, entry.first);
+          changed.insert (changed.end (), item, item + sizeof (item));
+          numChanged++;
+        }
+    }
+  std::vector<uint64_t> removed = m_checkpointTracker.EndCheckpoint ();
+
+  NYUCheckpoint::Append<uint64_t> (buffer, numChanged);
+  buffer.insert (buffer.end (), changed.begin (), changed.end ());
+  NYUCheckpoint::Append<uint64_t> (buffer, removed.size ());
+  for (uint64_t key : removed)
+    {
+      NYUCheckpoint::Append<uint32_t> (buffer, key);
+    }
+}
+
+void
+NYUChannelConditionModel::RestoreCheckpoint (const std::vector<uint8_t> &buffer)
+{
+  NS_LOG_FUNCTION (this);
+  size_t offset = 0;
+  if (NYUCheckpoint::Read<uint8_t> (buffer, offset))
+    {
+      m_channelConditionMap.clear ();
+      m_checkpointTracker.Clear ();
+    }
+  m_uniformVar.RestoreCheckpoint (buffer, offset);
+
+  uint64_t numChanged = NYUCheckpoint::Read<uint64_t> (buffer, offset);
+  uint8_t item[16];
+  for (uint64_t i = 0; i < numChanged; i++)
+    {
+      uint32_t key = NYUCheckpoint::Read<uint32_t> (buffer, offset);
+      Ptr<ChannelCondition> condition = CreateObject<ChannelCondition> ();
+      condition->SetLosCondition (static_cast<ChannelCondition::LosConditionValue> (NYUCheckpoint::Read<int32_t> (buffer, offset)));
+      condition->SetO2iCondition (static_cast<ChannelCondition::O2iConditionValue> (NYUCheckpoint::Read<int32_t> (buffer, offset)));
+      Item mapItem;
+      mapItem.m_condition = condition;
+      mapItem.m_generatedTime = TimeStep (NYUCheckpoint::Read<int64_t> (buffer, offset));
+      m_channelConditionMap[key] = mapItem;
+      GetCheckpointItem (item, condition, mapItem.m_generatedTime);
+      m_checkpointTracker.Set (key, NYUCheckpoint::Hash (item, sizeof (item)));
+    }
+
+  uint64_t numRemoved = NYUCheckpoint::Read<uint64_t> (buffer, offset);
+  for (uint64_t i = 0; i < numRemoved; i++)
+    {
+      uint32_t key = NYUCheckpoint::Read<uint32_t> (buffer, offset);
+      m_channelConditionMap.erase (key);
+      m_checkpointTracker.Erase (key);
+    }
+  NS_ASSERT_MSG (offset == buffer.size (), "Malformed checkpoint of the channel conditions");
+}
+
 double
 NYUChannelConditionModel::Calculate2dDistance (const Vector &a, const Vector &b)
 {
@@ -164,6 +462,12 @@ NYUChannelConditionModel::Calculate2dDistance (const Vector &a, const Vector &b)
   return distance2D;
 }
 
+double
+NYUChannelConditionModel::GetUtHeight (const Vector &a, const Vector &b)
+{
+  return std::min (a.z, b.z);
+}
+
 uint32_t
 NYUChannelConditionModel::GetKey (Ptr<const MobilityModel> a, Ptr<const MobilityModel> b)
 {
@@ -203,10 +507,15 @@ double
 NYURmaChannelConditionModel::ComputePlos (Ptr<const MobilityModel> a,
                                           Ptr<const MobilityModel> b) const
 {
-  // NYU Channel model doesnt have a PLOS for RMa, thus using 3GPP Channel Model.
   // compute the 2D distance between a and b
   double distance2D = Calculate2dDistance (a->GetPosition (), b->GetPosition ());
+  return ComputePlosFromGeometry (distance2D, GetUtHeight (a->GetPosition (), b->GetPosition ()));
+}
 
+double
+NYURmaChannelConditionModel::ComputePlosFromGeometry (double distance2D, double hUt) const
+{
+  // NYU Channel model doesnt have a PLOS for RMa, thus using 3GPP Channel Model.
   // NOTE: no indication is given about the heights of the BS and the UT used
   // to derive the LOS probability
 
@@ -249,16 +558,28 @@ double
 NYUUmaChannelConditionModel::ComputePlos (Ptr<const MobilityModel> a,
                                           Ptr<const MobilityModel> b) const
 {
-  // https://ieeexplore.ieee.org/stamp/stamp.jsp?arnumber=7999294 (table II, row 2)
   // compute the 2D distance between a and b
   double distance2D = Calculate2dDistance (a->GetPosition (), b->GetPosition ());
 
   // retrieve h_UT, it should be smaller than 23 m
-  double h_UT = std::min (a->GetPosition ().z, b->GetPosition ().z);
+  double h_UT = GetUtHeight (a->GetPosition (), b->GetPosition ());
   if (h_UT > 23.0)
     {
       NS_LOG_WARN ("The height of the UT should be smaller than 23 m (see TR 38.901, Table 7.4.2-1)");
     }
+  return ComputePlosFromGeometry (distance2D, h_UT);
+}
+
+bool
+NYUUmaChannelConditionModel::IsPlosHeightDependent (void) const
+{
+  return true;
+}
+
+double
+NYUUmaChannelConditionModel::ComputePlosFromGeometry (double distance2D, double h_UT) const
+{
+  // https://ieeexplore.ieee.org/stamp/stamp.jsp?arnumber=7999294 (table II, row 2)
 
   // NOTE: no idication is given about the UT height used to derive the
   // LOS probability compute the LOS probability
@@ -315,7 +636,12 @@ NYUUmiChannelConditionModel::ComputePlos (Ptr<const MobilityModel> a,
 {
   // compute the 2D distance between a and b
   double distance2D = Calculate2dDistance (a->GetPosition (), b->GetPosition ());
+  return ComputePlosFromGeometry (distance2D, GetUtHeight (a->GetPosition (), b->GetPosition ()));
+}
 
+double
+NYUUmiChannelConditionModel::ComputePlosFromGeometry (double distance2D, double hUt) const
+{
   // NOTE: no idication is given about the UT height used to derive the
   // LOS probability compute the LOS probability
   // NYU Squared Model : https://ieeexplore.ieee.org/stamp/stamp.jsp?arnumber=7999294 (Table I, Row 2)
@@ -357,10 +683,16 @@ double
 NYUInHChannelConditionModel::ComputePlos (Ptr<const MobilityModel> a,
                                           Ptr<const MobilityModel> b) const
 {
-  // NYU doesnt have a PLOS model for InH. Using 5GCM model for PLOS.
-  // https://ieeexplore.ieee.org/stamp/stamp.jsp?arnumber=7999294 (table III, row 2)
   // compute the 2D distance between a and b
   double distance2D = Calculate2dDistance (a->GetPosition (), b->GetPosition ());
+  return ComputePlosFromGeometry (distance2D, GetUtHeight (a->GetPosition (), b->GetPosition ()));
+}
+
+double
+NYUInHChannelConditionModel::ComputePlosFromGeometry (double distance2D, double hUt) const
+{
+  // NYU doesnt have a PLOS model for InH. Using 5GCM model for PLOS.
+  // https://ieeexplore.ieee.org/stamp/stamp.jsp?arnumber=7999294 (table III, row 2)
 
   // NOTE: no idication is given about the UT height used to derive the
   // LOS probability compute the LOS probability
@@ -406,11 +738,17 @@ NYUInFChannelConditionModel::~NYUInFChannelConditionModel ()
 double
 NYUInFChannelConditionModel::ComputePlos (Ptr<const MobilityModel> a,
                                           Ptr<const MobilityModel> b) const
+{
+  double distance2D = Calculate2dDistance (a->GetPosition (), b->GetPosition ());
+  return ComputePlosFromGeometry (distance2D, GetUtHeight (a->GetPosition (), b->GetPosition ()));
+}
+
+double
+NYUInFChannelConditionModel::ComputePlosFromGeometry (double distance2D, double hUt) const
 {
   // NYU Channel model doesnt have a PLOS for InF. To be extended with NYU Probability model for InF later
   double pLos = 0.0;
-  double distance2D = Calculate2dDistance (a->GetPosition (), b->GetPosition ());
-  pLos = 2.38 * exp (pow (-distance2D, 0.16) / 0.91);
+  pLos = 2.38 * exp (-pow (distance2D, 0.16) / 0.91);
   return pLos;
 }
 
@@ -32,8 +32,11 @@
 #include "ns3/random-variable-stream.h"
 #include "ns3/vector.h"
 #include "ns3/channel-condition-model.h"
+#include "ns3/nyu-checkpoint.h"
 
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 namespace ns3
 {
@@ -77,6 +80,23 @@ public:
    */
   Ptr<ChannelCondition> GetChannelCondition (Ptr<const MobilityModel> a,
                                              Ptr<const MobilityModel> b) const override;
+
+  /**
+   * \brief Retrieve the conditions of many channels in a single call.
+   *
+   * Cached conditions are reused following the "UpdatePeriod" parameter, as in
+   * GetChannelCondition. For the links that need a new condition, the LOS
+   * probability is read from a per-scenario table of pLos(d2D, h_UT), built
+   * once on first use, and the uniform draws are taken as one block, in the
+   * order in which the new links appear in the batch. A link that appears more
+   * than once in the batch is drawn only once.
+   *
+   * \param links the (a, b) mobility model pairs
+   * \return the condition of each link, in the same order as links
+   */
+  std::vector<Ptr<ChannelCondition>> GetChannelConditions (
+      const std::vector<std::pair<Ptr<const MobilityModel>, Ptr<const MobilityModel>>> &links) const;
+
   /**
    * If this  model uses objects of type RandomVariableStream,
    * set the stream numbers to the integers starting with the offset
@@ -88,6 +108,21 @@ public:
    */
   int64_t AssignStreams (int64_t stream) override;
 
+  /**
+   * \brief Appends the state of the model to a checkpoint, see NYUCheckpoint.
+   * \param buffer the buffer
+   * \param full if false, only the conditions changed since the previous
+   *        checkpoint are written
+   */
+  void SaveCheckpoint (std::vector<uint8_t> &buffer, bool full);
+
+  /**
+   * \brief Restores the state of the model from a buffer written by
+   * SaveCheckpoint. The pLos table is not checkpointed, it is rebuilt on use.
+   * \param buffer the buffer
+   */
+  void RestoreCheckpoint (const std::vector<uint8_t> &buffer);
+
 protected:
   virtual void DoDispose () override;
 
@@ -99,7 +134,15 @@ protected:
   */
   static double Calculate2dDistance (const Vector &a, const Vector &b);
 
-  Ptr<UniformRandomVariable> m_uniformVar;  //!< uniform random variable
+  /**
+   * \brief Returns the height of the UT, i.e., the lower of the two nodes
+   * \param a the first 3D vector
+   * \param b the second 3D vector
+   * \return the height of the UT
+   */
+  static double GetUtHeight (const Vector &a, const Vector &b);
+
+  NYUCheckpointRandomVariable<UniformRandomVariable> m_uniformVar;  //!< uniform random variable
 
 private:
   /**
@@ -122,6 +165,41 @@ private:
    */
   virtual double ComputePlos (Ptr<const MobilityModel> a, Ptr<const MobilityModel> b) const = 0;
 
+  /**
+   * Compute the LOS probability from the link geometry. This is the function
+   * tabulated for GetChannelConditions.
+   *
+   * \param distance2D the 2D distance between tx and rx in meters
+   * \param hUt the height of the UT in meters
+   * \return the LOS probability
+   */
+  virtual double ComputePlosFromGeometry (double distance2D, double hUt) const = 0;
+
+  /**
+   * \brief Returns true if the LOS probability of the scenario depends on the
+   * UT height, in which case the pLos table is two-dimensional.
+   * \return true if pLos depends on h_UT
+   */
+  virtual bool IsPlosHeightDependent (void) const;
+
+  /**
+   * \brief Fill m_plosTable by sampling ComputePlosFromGeometry on the
+   * (d2D, h_UT) grid defined by the LosTable* attributes. With the default
+   * grid the table takes 40 kB, or 0.96 MB if pLos depends on h_UT.
+   */
+  void BuildPlosTable (void) const;
+
+  /**
+   * \brief Read the LOS probability from m_plosTable, interpolating linearly
+   * between the grid points. Falls back to ComputePlosFromGeometry outside
+   * the grid and in the cells where the pLos values at the corners differ by
+   * more than LosTableMaxCellSpread.
+   * \param distance2D the 2D distance between tx and rx in meters
+   * \param hUt the height of the UT in meters
+   * \return the LOS probability
+   */
+  double GetTabulatedPlos (double distance2D, double hUt) const;
+
   /**
    * \brief Returns a unique and reciprocal key for the channel between a and b.
    * \param a tx mobility model
@@ -140,7 +218,21 @@ private:
   };
 
   std::unordered_map<uint32_t, Item> m_channelConditionMap;//!< map to store the channel conditions
+  NYUCheckpointTracker m_checkpointTracker;//!< the entries of m_channelConditionMap written to the checkpoints
   Time m_updatePeriod;//!< the update period for the channel condition
+
+  double m_losTableDistanceStep;//!< the 2D distance resolution of the pLos table in meters
+  double m_losTableMaxDistance;//!< the largest 2D distance covered by the pLos table in meters
+  double m_losTableHeightStep;//!< the h_UT resolution of the pLos table in meters
+  double m_losTableMaxHeight;//!< the largest h_UT covered by the pLos table in meters
+  double m_losTableMaxCellSpread;//!< the largest spread of the pLos values in an interpolated cell
+  mutable std::vector<double> m_plosTable;//!< pLos samples, row-major with one row per h_UT grid point
+  mutable uint32_t m_plosTableNumDistances;//!< number of 2D distance grid points per row
+  mutable uint32_t m_plosTableNumHeights;//!< number of h_UT grid points
+  mutable double m_plosTableDistanceStep;//!< the 2D distance resolution m_plosTable has been built with
+  mutable double m_plosTableMaxDistance;//!< the largest 2D distance m_plosTable has been built with
+  mutable double m_plosTableHeightStep;//!< the h_UT resolution m_plosTable has been built with
+  mutable double m_plosTableMaxHeight;//!< the largest h_UT m_plosTable has been built with
 };
 
 /**
@@ -181,6 +273,15 @@ private:
    */
   double ComputePlos (Ptr<const MobilityModel> a,
                       Ptr<const MobilityModel> b) const override;
+
+  /**
+   * Compute the LOS probability from the link geometry.
+   *
+   * \param distance2D the 2D distance between tx and rx in meters
+   * \param hUt the height of the UT in meters
+   * \return the LOS probability
+   */
+  double ComputePlosFromGeometry (double distance2D, double hUt) const override;
 };
 
 /**
@@ -222,6 +323,21 @@ private:
    */
   double ComputePlos (Ptr<const MobilityModel> a,
                       Ptr<const MobilityModel> b) const override;
+
+  /**
+   * Compute the LOS probability from the link geometry.
+   *
+   * \param distance2D the 2D distance between tx and rx in meters
+   * \param hUt the height of the UT in meters
+   * \return the LOS probability
+   */
+  double ComputePlosFromGeometry (double distance2D, double hUt) const override;
+
+  /**
+   * The UMa LOS probability depends on h_UT through C'(h_UT).
+   * \return true
+   */
+  bool IsPlosHeightDependent (void) const override;
 };
 
 /**
@@ -262,6 +378,15 @@ private:
    */
   double ComputePlos (Ptr<const MobilityModel> a,
                       Ptr<const MobilityModel> b) const override;
+
+  /**
+   * Compute the LOS probability from the link geometry.
+   *
+   * \param distance2D the 2D distance between tx and rx in meters
+   * \param hUt the height of the UT in meters
+   * \return the LOS probability
+   */
+  double ComputePlosFromGeometry (double distance2D, double hUt) const override;
 };
 
 /**
@@ -302,6 +427,15 @@ private:
    */
   double ComputePlos (Ptr<const MobilityModel> a,
                       Ptr<const MobilityModel> b) const override;
+
+  /**
+   * Compute the LOS probability from the link geometry.
+   *
+   * \param distance2D the 2D distance between tx and rx in meters
+   * \param hUt the height of the UT in meters
+   * \return the LOS probability
+   */
+  double ComputePlosFromGeometry (double distance2D, double hUt) const override;
 };
 
 /**
@@ -343,6 +477,15 @@ private:
    */
   double ComputePlos (Ptr<const MobilityModel> a,
                       Ptr<const MobilityModel> b) const override;
+
+  /**
+   * Compute the LOS probability from the link geometry.
+   *
+   * \param distance2D the 2D distance between tx and rx in meters
+   * \param hUt the height of the UT in meters
+   * \return the LOS probability
+   */
+  double ComputePlosFromGeometry (double distance2D, double hUt) const override;
 };
 
 } // namespace ns3
@@ -0,0 +1,596 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+#include "ns3/nyu-checkpoint.h"
+#include "ns3/abort.h"
+#include "ns3/log.h"
+#include "ns3/random-variable-stream.h"
+#include "ns3/rng-seed-manager.h"
+#include "ns3/simulator.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+
+namespace ns3
+{
+
+NS_LOG_COMPONENT_DEFINE ("NYUCheckpoint");
+
+NS_OBJECT_ENSURE_REGISTERED (NYUCheckpoint);
+
+/// the first bytes of a checkpoint file
+static const char checkpointMagic[8] = {'N', 'Y', 'U', 'C', 'K', 'P', 'T', '1'};
+
+/// the number of checkpoint writers started and not closed yet
+static uint32_t g_numRunningWriters = 0;
+
+/**
+ * Writes a buffer to a file descriptor, aborting on failure
+ * \param fd the file descriptor
+ * \param data the buffer
+ * \param fileName the name of the file, for the error message
+ */
+static void
+WriteAll (int fd, const std::vector<uint8_t> &data, const std::string &fileName)
+{
+  size_t written = 0;
+  while (written < data.size ())
+    {
+      ssize_t n = write (fd, data.data () + written, data.size () - written);
+      if (n < 0 && errno == EINTR)
+        {
+          continue;
+        }
+      if (n < 0)
+        {
+          NS_FATAL_ERROR ("Cannot write the checkpoint file " << fileName << ": " << std::strerror (errno));
+        }
+      written += n;
+    }
+  if (fsync (fd) != 0)
+    {
+      NS_FATAL_ERROR ("Cannot sync the checkpoint file " << fileName << ": " << std::strerror (errno));
+    }
+}
+
+NYUCheckpointTracker::NYUCheckpointTracker ()
+  : m_pass (1)
+{
+}
+
+bool
+NYUCheckpointTracker::Update (uint64_t key, uint64_t version)
+{
+  auto it = m_entries.find (key);
+  if (it == m_entries.end ())
+    {
+      m_entries[key] = std::make_pair (version, m_pass);
+      return true;
+    }
+  it->second.second = m_pass;
+  if (it->second.first != version)
+    {
+      it->second.first = version;
+      return true;
+    }
+  return false;
+}
+
+void
+NYUCheckpointTracker::Set (uint64_t key, uint64_t version)
+{
+  // the entry belongs to the previous checkpoint, the one it has been read from
+  m_entries[key] = std::make_pair (version, m_pass - 1);
+}
+
+void
+NYUCheckpointTracker::Invalidate (uint64_t key)
+{
+  auto it = m_entries.find (key);
+  if (it != m_entries.end ())
+    {
+      // no entry gets this version from GetVersion, nor from Hash in practice
+      it->second.first = UINT64_MAX;
+    }
+}
+
+void
+NYUCheckpointTracker::Erase (uint64_t key)
+{
+  m_entries.erase (key);
+}
+
+void
+NYUCheckpointTracker::Clear ()
+{
+  m_entries.clear ();
+}
+
+std::vector<uint64_t>
+NYUCheckpointTracker::EndCheckpoint ()
+{
+  std::vector<uint64_t> removed;
+  for (auto it = m_entries.begin (); it != m_entries.end ();)
+    {
+      if (it->second.second != m_pass)
+        {
+          removed.push_back (it->first);
+          it = m_entries.erase (it);
+        }
+      else
+        {
+          ++it;
+        }
+    }
+  m_pass++;
+  return removed;
+}
+
+uint64_t
+NYUCheckpointTracker::GetVersion (const void *entry, Time generatedTime)
+{
+  // SplitMix64 finalizer of the address combined with the generation time
+  uint64_t z = reinterpret_cast<uintptr_t> (entry) ^ (static_cast<uint64_t> (generatedTime.GetTimeStep ()) * 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z = z ^ (z >> 31);
+  return z >= EXTERNAL_VERSION ? 0 : z;
+}
+
+TypeId
+NYUCheckpoint::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::NYUCheckpoint")
+    .SetParent<Object> ()
+    .SetGroupName ("Propagation")
+    .AddConstructor<NYUCheckpoint> ()
+    .AddAttribute ("FileName",
+                   "The name of the checkpoint file",
+                   StringValue ("nyu-checkpoint.bin"),
+                   MakeStringAccessor (&NYUCheckpoint::m_fileName),
+                   MakeStringChecker ())
+    .AddAttribute ("Interval",
+                   "The interval between two periodic checkpoints. If set to 0, the checkpoints are written only by Checkpoint",
+                   TimeValue (Seconds (1)),
+                   MakeTimeAccessor (&NYUCheckpoint::m_interval),
+                   MakeTimeChecker ())
+    .AddAttribute ("FullCheckpointInterval",
+                   "The number of incremental checkpoints written after a full one, before the file is rewritten with a new full checkpoint. If set to 0, every checkpoint is a full one",
+                   UintegerValue (10),
+                   MakeUintegerAccessor (&NYUCheckpoint::m_fullInterval),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxPendingCheckpoints",
+                   "The maximum number of checkpoints waiting to be written. When it is reached, the simulation waits for the writer",
+                   UintegerValue (2),
+                   MakeUintegerAccessor (&NYUCheckpoint::m_maxPendingGroups),
+                   MakeUintegerChecker<uint32_t> (1))
+  ;
+  return tid;
+}
+
+NYUCheckpoint::NYUCheckpoint ()
+  : m_started (false),
+    m_needFull (true),
+    m_numIncremental (0),
+    m_numCheckpoints (0),
+    m_restoredLength (0),
+    m_fd (-1),
+    m_stop (false)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+NYUCheckpoint::~NYUCheckpoint ()
+{
+  NS_LOG_FUNCTION (this);
+  Close ();
+}
+
+void
+NYUCheckpoint::DoDispose ()
+{
+  NS_LOG_FUNCTION (this);
+  Close ();
+  m_states.clear ();
+  Object::DoDispose ();
+}
+
+void
+NYUCheckpoint::AddState (SaveCallback save, RestoreCallback restore)
+{
+  NS_LOG_FUNCTION (this);
+  m_states.emplace_back (save, restore);
+}
+
+void
+NYUCheckpoint::Start (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (m_started)
+    {
+      return;
+    }
+
+  if (!m_restoredFileName.empty () && m_restoredFileName == m_fileName)
+    {
+      // drop the torn group, if any, and append to the restored checkpoints
+      if (truncate (m_fileName.c_str (), m_restoredLength) != 0)
+        {
+          NS_FATAL_ERROR ("Cannot truncate the checkpoint file " << m_fileName << ": " << std::strerror (errno));
+        }
+      m_fd = open (m_fileName.c_str (), O_WRONLY | O_APPEND);
+      if (m_fd < 0)
+        {
+          NS_FATAL_ERROR ("Cannot open the checkpoint file " << m_fileName << ": " << std::strerror (errno));
+        }
+      m_needFull = false;
+    }
+  else
+    {
+      m_needFull = true;
+    }
+
+  m_started = true;
+  m_stop = false;
+  m_numIncremental = 0;
+  m_numCheckpoints = 0;
+  m_writer = std::thread (&NYUCheckpoint::WriterLoop, this);
+  g_numRunningWriters++;
+  if (m_interval.IsStrictlyPositive ())
+    {
+      m_event = Simulator::Schedule (m_interval, &NYUCheckpoint::PeriodicCheckpoint, this);
+    }
+  Simulator::ScheduleDestroy (&NYUCheckpoint::Close, Ptr<NYUCheckpoint> (this));
+}
+
+void
+NYUCheckpoint::PeriodicCheckpoint (void)
+{
+  NS_LOG_FUNCTION (this);
+  Checkpoint ();
+  m_event = Simulator::Schedule (m_interval, &NYUCheckpoint::PeriodicCheckpoint, this);
+}
+
+void
+NYUCheckpoint::Checkpoint (void)
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_started)
+    {
+      Start ();
+    }
+
+  bool full = m_needFull || m_numIncremental >= m_fullInterval;
+  std::vector<uint8_t> group;
+  std::vector<uint8_t> state;
+  for (uint32_t i = 0; i < m_states.size (); i++)
+    {
+      state.clear ();
+      m_states[i].first (state, full);
+      AppendRecord (group, 'M', i, state);
+    }
+  std::vector<uint8_t> commit;
+  Append<int64_t> (commit, Simulator::Now ().GetTimeStep ());
+  Append<uint8_t> (commit, full ? 1 : 0);
+  AppendRecord (group, 'C', m_states.size (), commit);
+
+  NS_LOG_DEBUG ("Checkpoint " << m_numCheckpoints << " at " << Simulator::Now ().As (Time::S)
+                << (full ? " (full): " : ": ") << group.size () << " bytes");
+  m_needFull = false;
+  m_numIncremental = full ? 0 : m_numIncremental + 1;
+  m_numCheckpoints++;
+
+  std::unique_lock<std::mutex> lock (m_mutex);
+  m_spaceCv.wait (lock, [this] { return m_queue.size () < m_maxPendingGroups; });
+  m_queue.push_back (PendingGroup {std::move (group), full});
+  m_queueCv.notify_one ();
+}
+
+void
+NYUCheckpoint::WriterLoop (void)
+{
+  std::unique_lock<std::mutex> lock (m_mutex);
+  while (true)
+    {
+      m_queueCv.wait (lock, [this] { return m_stop || !m_queue.empty (); });
+      if (m_queue.empty ())
+        {
+          return;
+        }
+      PendingGroup group = std::move (m_queue.front ());
+      m_queue.pop_front ();
+      lock.unlock ();
+
+      if (group.m_full)
+        {
+          // the previous file stays valid until the new one replaces it
+          std::string tmpName = m_fileName + ".tmp";
+          int fd = open (tmpName.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+          if (fd < 0)
+            {
+              NS_FATAL_ERROR ("Cannot open the checkpoint file " << tmpName << ": " << std::strerror (errno));
+            }
+          group.m_data.insert (group.m_data.begin (), checkpointMagic, checkpointMagic + sizeof (checkpointMagic));
+          WriteAll (fd, group.m_data, tmpName);
+          if (std::rename (tmpName.c_str (), m_fileName.c_str ()) != 0)
+            {
+              NS_FATAL_ERROR ("Cannot rename the checkpoint file " << tmpName << ": " << std::strerror (errno));
+            }
+          if (m_fd >= 0)
+            {
+              close (m_fd);
+            }
+          m_fd = fd;
+        }
+      else
+        {
+          NS_ASSERT (m_fd >= 0);
+          WriteAll (m_fd, group.m_data, m_fileName);
+        }
+
+      lock.lock ();
+      m_spaceCv.notify_all ();
+    }
+}
+
+void
+NYUCheckpoint::Close (void)
+{
+  NS_LOG_FUNCTION (this);
+  m_event.Cancel ();
+  if (m_writer.joinable ())
+    {
+      {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        m_stop = true;
+      }
+      m_queueCv.notify_all ();
+      m_writer.join ();
+      g_numRunningWriters--;
+    }
+  if (m_fd >= 0)
+    {
+      close (m_fd);
+      m_fd = -1;
+    }
+  m_started = false;
+}
+
+uint64_t
+NYUCheckpoint::GetNumCheckpoints (void) const
+{
+  return m_numCheckpoints;
+}
+
+uint32_t
+NYUCheckpoint::GetNumRunningWriters (void)
+{
+  return g_numRunningWriters;
+}
+
+void
+NYUCheckpoint::AppendRecord (std::vector<uint8_t> &group, uint8_t kind, uint32_t index,
+                             const std::vector<uint8_t> &payload)
+{
+  Append<uint8_t> (group, kind);
+  Append<uint32_t> (group, index);
+  AppendBuffer (group, payload);
+}
+
+uint64_t
+NYUCheckpoint::Scan (const std::string &fileName,
+                     const std::function<void (const std::vector<std::pair<uint32_t, std::vector<uint8_t> > > &, Time)> &apply,
+                     uint64_t &validLength)
+{
+  validLength = 0;
+  std::ifstream file (fileName, std::ios::binary | std::ios::ate);
+  if (!file)
+    {
+      return 0;
+    }
+  uint64_t fileSize = file.tellg ();
+  file.seekg (0);
+  char magic[sizeof (checkpointMagic)];
+  if (!file.read (magic, sizeof (magic)) || std::memcmp (magic, checkpointMagic, sizeof (magic)) != 0)
+    {
+      NS_LOG_WARN ("The file " << fileName << " is not a checkpoint file");
+      return 0;
+    }
+  validLength = sizeof (checkpointMagic);
+
+  uint64_t numGroups = 0;
+  uint64_t position = validLength;
+  std::vector<std::pair<uint32_t, std::vector<uint8_t> > > records;
+  while (true)
+    {
+      uint8_t kind;
+      uint32_t index;
+      uint64_t size;
+      if (!file.read (reinterpret_cast<char *> (&kind), sizeof (kind))
+          || !file.read (reinterpret_cast<char *> (&index), sizeof (index))
+          || !file.read (reinterpret_cast<char *> (&size), sizeof (size)))
+        {
+          break;
+        }
+      position += sizeof (kind) + sizeof (index) + sizeof (size);
+      if (size > fileSize - position)
+        {
+          break;
+        }
+      std::vector<uint8_t> payload (size);
+      if (size > 0 && !file.read (reinterpret_cast<char *> (payload.data ()), size))
+        {
+          break;
+        }
+      position += size;
+
+      if (kind == 'M')
+        {
+          records.emplace_back (index, std::move (payload));
+        }
+      else if (kind == 'C')
+        {
+          size_t offset = 0;
+          Time time = TimeStep (Read<int64_t> (payload, offset));
+          apply (records, time);
+          records.clear ();
+          numGroups++;
+          validLength = position;
+        }
+      else
+        {
+          break;
+        }
+    }
+  if (validLength < fileSize)
+    {
+      NS_LOG_WARN ("Ignoring the last " << fileSize - validLength << " bytes of the checkpoint file " << fileName);
+    }
+  return numGroups;
+}
+
+bool
+NYUCheckpoint::Restore (const std::string &fileName)
+{
+  NS_LOG_FUNCTION (this << fileName);
+  Time lastTime = TimeStep (-1);
+  uint64_t numGroups = Scan (
+      fileName,
+      [this, &lastTime] (const std::vector<std::pair<uint32_t, std::vector<uint8_t> > > &records, Time time)
+        {
+          for (const auto &record : records)
+            {
+              NS_ABORT_MSG_IF (record.first >= m_states.size (),
+                               "The checkpoint has more states than the registered ones");
+              m_states[record.first].second (record.second);
+            }
+          lastTime = time;
+        },
+      m_restoredLength);
+  if (numGroups == 0)
+    {
+      return false;
+    }
+
+  NS_LOG_INFO ("Restored " << numGroups << " checkpoints of " << fileName << " up to "
+               << lastTime.As (Time::S));
+  if (lastTime != Simulator::Now ())
+    {
+      NS_LOG_WARN ("The checkpoint of " << lastTime.As (Time::S) << " has been restored at "
+                   << Simulator::Now ().As (Time::S));
+    }
+  m_restoredFileName = fileName;
+  return true;
+}
+
+Time
+NYUCheckpoint::GetLastCheckpointTime (const std::string &fileName)
+{
+  Time lastTime = TimeStep (-1);
+  uint64_t validLength;
+  Scan (
+      fileName,
+      [&lastTime] (const std::vector<std::pair<uint32_t, std::vector<uint8_t> > > &, Time time)
+        {
+          lastTime = time;
+        },
+      validLength);
+  return lastTime;
+}
+
+void
+NYUCheckpoint::AppendBuffer (std::vector<uint8_t> &buffer, const std::vector<uint8_t> &nested)
+{
+  Append<uint64_t> (buffer, nested.size ());
+  buffer.insert (buffer.end (), nested.begin (), nested.end ());
+}
+
+void
+NYUCheckpoint::ReadBuffer (const std::vector<uint8_t> &buffer, size_t &offset, std::vector<uint8_t> &nested)
+{
+  uint64_t size = Read<uint64_t> (buffer, offset);
+  NS_ASSERT_MSG (offset + size <= buffer.size (), "Truncated checkpoint record");
+  nested.assign (buffer.begin () + offset, buffer.begin () + offset + size);
+  offset += size;
+}
+
+uint64_t
+NYUCheckpoint::Hash (const uint8_t *data, size_t size)
+{
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < size; i++)
+    {
+      hash = (hash ^ data[i]) * 0x100000001b3ULL;
+    }
+  return hash;
+}
+
+void
+NYUCheckpoint::SaveRandomVariable (Ptr<const RandomVariableStream> rv, uint64_t numDraws, std::vector<uint8_t> &buffer)
+{
+  Append<uint32_t> (buffer, RngSeedManager::GetSeed ());
+  Append<uint64_t> (buffer, RngSeedManager::GetRun ());
+  Append<int64_t> (buffer, rv->GetStream ());
+  Append<uint64_t> (buffer, numDraws);
+}
+
+uint64_t
+NYUCheckpoint::RestoreRandomVariable (Ptr<RandomVariableStream> rv, uint64_t numDraws, const std::vector<uint8_t> &buffer, size_t &offset)
+{
+  uint32_t seed = Read<uint32_t> (buffer, offset);
+  uint64_t run = Read<uint64_t> (buffer, offset);
+  int64_t stream = Read<int64_t> (buffer, offset);
+  uint64_t savedDraws = Read<uint64_t> (buffer, offset);
+  NS_ABORT_MSG_IF (seed != RngSeedManager::GetSeed () || run != RngSeedManager::GetRun (),
+                   "The checkpoint was written with RngSeed " << seed << " and RngRun " << run);
+  NS_ABORT_MSG_IF (stream != rv->GetStream (),
+                   "The checkpoint was written with stream " << stream << " instead of " << rv->GetStream ());
+
+  if (stream >= 0)
+    {
+      // go back to the beginning of the stream
+      rv->SetStream (stream);
+      numDraws = 0;
+    }
+  else
+    {
+      // an automatic stream cannot be rewound, but it is the same as in the
+      // checkpointed run if the scenario is built in the same order
+      NS_ABORT_MSG_IF (numDraws > savedDraws,
+                       "Cannot rewind a random variable with an automatic stream, assign the streams of the NYU models");
+    }
+  NS_LOG_DEBUG ("Replay " << savedDraws - numDraws << " draws of stream " << stream);
+  for (; numDraws < savedDraws; numDraws++)
+    {
+      rv->GetValue ();
+    }
+  return numDraws;
+}
+
+} // namespace ns3
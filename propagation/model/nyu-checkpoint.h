@@ -0,0 +1,484 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+
+#ifndef NYU_CHECKPOINT_H
+#define NYU_CHECKPOINT_H
+
+#include "ns3/assert.h"
+#include "ns3/callback.h"
+#include "ns3/event-id.h"
+#include "ns3/nstime.h"
+#include "ns3/object.h"
+#include "ns3/ptr.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+class RandomVariableStream;
+
+/**
+ * \ingroup propagation
+ *
+ * \brief Keeps track of the entries of a map written to the checkpoints, so
+ * that an incremental checkpoint contains only the entries added or changed
+ * since the previous checkpoint and the keys of the removed ones
+ */
+class NYUCheckpointTracker
+{
+public:
+  /**
+   * Constructor for the NYUCheckpointTracker class
+   */
+  NYUCheckpointTracker ();
+
+  /**
+   * Marks an entry as present in the checkpoint being written
+   * \param key the key of the entry
+   * \param version a value which changes whenever the entry changes
+   * \return true if the entry has to be written, i.e., if it is new or if its
+   *         version differs from the one of the previous checkpoint
+   */
+  bool Update (uint64_t key, uint64_t version);
+
+  /**
+   * Records the version of an entry read from a checkpoint
+   * \param key the key of the entry
+   * \param version the version of the entry
+   */
+  void Set (uint64_t key, uint64_t version);
+
+  /**
+   * Forces the next checkpoint to write an entry, e.g., when an entry with
+   * EXTERNAL_VERSION is moved back to the map
+   * \param key the key of the entry
+   */
+  void Invalidate (uint64_t key);
+
+  /**
+   * Forgets an entry read from a checkpoint
+   * \param key the key of the entry
+   */
+  void Erase (uint64_t key);
+
+  /**
+   * Forgets all the entries, e.g., before a full checkpoint
+   */
+  void Clear ();
+
+  /**
+   * Ends the checkpoint being written
+   * \return the keys of the entries of the previous checkpoint which have
+   *         not been marked by Update, i.e., the removed ones
+   */
+  std::vector<uint64_t> EndCheckpoint ();
+
+  /**
+   * Returns a version built from the address of an immutable entry and from
+   * the time of its generation. It is never EXTERNAL_VERSION.
+   * \param entry the address of the entry
+   * \param generatedTime the time of the generation of the entry
+   * \return the version
+   */
+  static uint64_t GetVersion (const void *entry, Time generatedTime);
+
+  /// the version of the entries stored outside the map, e.g., in a spill
+  /// file, which do not change until they are moved back to the map
+  static const uint64_t EXTERNAL_VERSION = UINT64_MAX - 1;
+
+private:
+  /// the version and the index of the last checkpoint of each entry
+  std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t> > m_entries;
+  uint64_t m_pass; //!< the index of the checkpoint being written
+};
+
+/**
+ * \ingroup propagation
+ *
+ * \brief Writes periodic checkpoints of the state of the NYU models and
+ * restores it, so that a long simulation can be resumed after a crash
+ *
+ * The models are registered with Add, which binds their SaveCheckpoint and
+ * RestoreCheckpoint methods. SaveCheckpoint (buffer, full) appends the state
+ * of the model to the buffer: all of it if full is true, only the changes
+ * since the previous checkpoint otherwise. RestoreCheckpoint (buffer) applies
+ * a buffer written by SaveCheckpoint.
+ *
+ * Every checkpoint is a group of one record per model followed by a commit
+ * record holding the simulation time. The groups are appended to the file
+ * by a background thread, so that the simulation is stalled only while the
+ * models serialize their state. Every FullCheckpointInterval checkpoints, the
+ * file is rewritten from scratch with a full checkpoint, written to a
+ * temporary file which atomically replaces the previous one, so that the file
+ * does not grow without bounds. A crash while a group is written leaves a
+ * torn group at the end of the file, which Restore ignores.
+ *
+ * To resume, the script builds the same scenario, registers the models in
+ * the same order, schedules Restore at the time of the last checkpoint (see
+ * GetLastCheckpointTime) and then calls Start to continue writing the same
+ * file. Only the state of the registered models is checkpointed: the rest of
+ * the scenario (e.g., the positions of the nodes, the protocol stacks and the
+ * other random variables) has to be rebuilt by the script.
+ */
+class NYUCheckpoint : public Object
+{
+public:
+  /**
+   * Get the type ID.
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId (void);
+
+  /**
+   * Constructor for the NYUCheckpoint class
+   */
+  NYUCheckpoint ();
+
+  /**
+   * Destructor for the NYUCheckpoint class
+   */
+  ~NYUCheckpoint () override;
+
+  /// callback which appends the state of a model to a buffer, all of it if the bool is true
+  typedef Callback<void, std::vector<uint8_t> &, bool> SaveCallback;
+  /// callback which applies a buffer written by the SaveCallback
+  typedef Callback<void, const std::vector<uint8_t> &> RestoreCallback;
+
+  /**
+   * Registers a state to be checkpointed. The states have to be registered
+   * in the same order when the checkpoint is restored.
+   * \param save the callback which writes the state
+   * \param restore the callback which reads the state
+   */
+  void AddState (SaveCallback save, RestoreCallback restore);
+
+  /**
+   * Registers a model with the SaveCheckpoint and RestoreCheckpoint methods
+   * \param model the model
+   */
+  template <class T>
+  void Add (Ptr<T> model)
+  {
+    AddState (MakeCallback (&T::SaveCheckpoint, model), MakeCallback (&T::RestoreCheckpoint, model));
+  }
+
+  /**
+   * Starts writing the checkpoints every Interval. If the file has been read
+   * by Restore, the checkpoints following the restored one are discarded and
+   * the new ones are appended to it, otherwise the file is overwritten.
+   */
+  void Start (void);
+
+  /**
+   * Writes a checkpoint now, starting the writer if needed
+   */
+  void Checkpoint (void);
+
+  /**
+   * Reads a checkpoint file and restores the state of the registered models
+   * to the last complete checkpoint. It has to be called at the time of that
+   * checkpoint, e.g., by scheduling it at GetLastCheckpointTime.
+   * \param fileName the name of the file
+   * \return true if a checkpoint has been restored
+   */
+  bool Restore (const std::string &fileName);
+
+  /**
+   * Returns the simulation time of the last complete checkpoint of a file
+   * \param fileName the name of the file
+   * \return the time of the checkpoint, a negative time if there is none
+   */
+  static Time GetLastCheckpointTime (const std::string &fileName);
+
+  /**
+   * Waits for the pending checkpoints to be written and stops the writer
+   */
+  void Close (void);
+
+  /**
+   * Returns the number of checkpoints written since Start
+   * \return the number of checkpoints
+   */
+  uint64_t GetNumCheckpoints (void) const;
+
+  /**
+   * Returns the number of checkpoint writers started and not closed yet, in
+   * this process. A process must not be forked while a writer thread is running
+   * \return the number of running writers
+   */
+  static uint32_t GetNumRunningWriters (void);
+
+  /**
+   * Appends the bytes of a value to a buffer
+   * \param buffer the buffer
+   * \param value the value
+   */
+  template <class T>
+  static void Append (std::vector<uint8_t> &buffer, const T &value)
+  {
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *> (&value);
+    buffer.insert (buffer.end (), bytes, bytes + sizeof (T));
+  }
+
+  /**
+   * Reads a value written by Append
+   * \param buffer the buffer
+   * \param offset the position of the value, moved after the value
+   * \return the value
+   */
+  template <class T>
+  static T Read (const std::vector<uint8_t> &buffer, size_t &offset)
+  {
+    NS_ASSERT_MSG (offset + sizeof (T) <= buffer.size (), "Truncated checkpoint record");
+    T value;
+    std::memcpy (&value, buffer.data () + offset, sizeof (T));
+    offset += sizeof (T);
+    return value;
+  }
+
+  /**
+   * Appends the size and the bytes of a nested buffer to a buffer
+   * \param buffer the buffer
+   * \param nested the nested buffer
+   */
+  static void AppendBuffer (std::vector<uint8_t> &buffer, const std::vector<uint8_t> &nested);
+
+  /**
+   * Reads a nested buffer written by AppendBuffer
+   * \param buffer the buffer
+   * \param offset the position of the nested buffer, moved after it
+   * \param nested set to the nested buffer
+   */
+  static void ReadBuffer (const std::vector<uint8_t> &buffer, size_t &offset, std::vector<uint8_t> &nested);
+
+  /**
+   * Returns the 64-bit FNV-1a hash of some bytes, used as the version of the
+   * small entries which are cheaper to hash than to track
+   * \param data the bytes
+   * \param size the number of bytes
+   * \return the hash
+   */
+  static uint64_t Hash (const uint8_t *data, size_t size);
+
+  /**
+   * Appends the position of a random variable in its stream: the seed, the
+   * run and the stream number, and the number of values drawn from it
+   * \param rv the random variable
+   * \param numDraws the number of values drawn from the random variable
+   * \param buffer the buffer
+   */
+  static void SaveRandomVariable (Ptr<const RandomVariableStream> rv, uint64_t numDraws, std::vector<uint8_t> &buffer);
+
+  /**
+   * Moves a random variable to a position written by SaveRandomVariable, by
+   * setting its stream again and drawing the same number of values. The
+   * seed, the run and the stream number must be the ones of the checkpoint.
+   * \param rv the random variable
+   * \param numDraws the number of values drawn from the random variable so far
+   * \param buffer the buffer
+   * \param offset the position of the state, moved after it
+   * \return the number of values drawn from the random variable after the restore
+   */
+  static uint64_t RestoreRandomVariable (Ptr<RandomVariableStream> rv, uint64_t numDraws, const std::vector<uint8_t> &buffer, size_t &offset);
+
+protected:
+  void DoDispose () override;
+
+private:
+  /**
+   * Writes a checkpoint and schedules the next one
+   */
+  void PeriodicCheckpoint (void);
+
+  /**
+   * Body of the writer thread
+   */
+  void WriterLoop (void);
+
+  /**
+   * Appends a record to a checkpoint
+   * \param group the checkpoint
+   * \param kind the kind of record, 'M' for a model and 'C' for the commit
+   * \param index the index of the model
+   * \param payload the payload of the record
+   */
+  static void AppendRecord (std::vector<uint8_t> &group, uint8_t kind, uint32_t index,
+                            const std::vector<uint8_t> &payload);
+
+  /**
+   * Scans a checkpoint file, calling a function for each complete group
+   * \param fileName the name of the file
+   * \param apply called with the model records and the time of each group
+   * \param validLength set to the length of the complete groups
+   * \return the number of complete groups
+   */
+  static uint64_t Scan (const std::string &fileName,
+                        const std::function<void (const std::vector<std::pair<uint32_t, std::vector<uint8_t> > > &, Time)> &apply,
+                        uint64_t &validLength);
+
+  /**
+   * A checkpoint waiting to be written
+   */
+  struct PendingGroup
+  {
+    std::vector<uint8_t> m_data; //!< the records of the checkpoint
+    bool m_full; //!< true if the checkpoint replaces the file
+  };
+
+  std::vector<std::pair<SaveCallback, RestoreCallback> > m_states; //!< the registered states
+  std::string m_fileName; //!< the name of the checkpoint file
+  Time m_interval; //!< the interval between the periodic checkpoints, zero to disable them
+  uint32_t m_fullInterval; //!< the number of checkpoints between two full ones
+  uint32_t m_maxPendingGroups; //!< the maximum number of checkpoints waiting to be written
+  EventId m_event; //!< the next periodic checkpoint
+  bool m_started; //!< true if the writer has been started
+  bool m_needFull; //!< true if the next checkpoint has to be a full one
+  uint32_t m_numIncremental; //!< the number of incremental checkpoints since the last full one
+  uint64_t m_numCheckpoints; //!< the number of checkpoints written since Start
+  std::string m_restoredFileName; //!< the file read by Restore, empty if none
+  uint64_t m_restoredLength; //!< the length of the complete groups of the restored file
+  int m_fd; //!< the descriptor of the checkpoint file, owned by the writer thread
+
+  std::thread m_writer; //!< the writer thread
+  std::mutex m_mutex; //!< protects the members below
+  std::condition_variable m_queueCv; //!< signaled when a checkpoint is queued or the writer is stopped
+  std::condition_variable m_spaceCv; //!< signaled when a checkpoint has been written
+  std::deque<PendingGroup> m_queue; //!< the checkpoints waiting to be written
+  bool m_stop; //!< true when the writer has to exit after emptying the queue
+};
+
+/**
+ * \ingroup propagation
+ *
+ * \brief A random variable of the NYU models which counts the values drawn
+ * from it, so that its position can be checkpointed
+ *
+ * ns-3 does not expose the position of a random variable in its stream, so
+ * NYUCheckpoint saves the stream and the number of values drawn and restores
+ * the position by drawing them again with GetValue (). Hence each draw must
+ * consume as many uniform values as a call to GetValue () with the attributes
+ * of the random variable, e.g., the bounds of a uniform random variable can be
+ * passed to GetValue, but the attributes must not be changed between the draws.
+ */
+template <class T>
+class NYUCheckpointRandomVariable
+{
+public:
+  /**
+   * Creates the random variable
+   */
+  NYUCheckpointRandomVariable ()
+    : m_rv (CreateObject<T> ()),
+      m_numDraws (0)
+  {
+  }
+
+  /**
+   * \return the random variable, to set its attributes
+   */
+  Ptr<T> Get (void) const
+  {
+    return m_rv;
+  }
+
+  /**
+   * Sets the stream of the random variable and rewinds it
+   * \param stream the stream number
+   */
+  void SetStream (int64_t stream)
+  {
+    m_rv->SetStream (stream);
+    m_numDraws = 0;
+  }
+
+  /**
+   * \return a value drawn with the attributes of the random variable
+   */
+  double GetValue (void) const
+  {
+    m_numDraws++;
+    return m_rv->GetValue ();
+  }
+
+  /**
+   * \param a the first parameter (e.g., the minimum of a uniform random variable)
+   * \param b the second parameter (e.g., the maximum of a uniform random variable)
+   * \return a value drawn with the given parameters
+   */
+  double GetValue (double a, double b) const
+  {
+    m_numDraws++;
+    return m_rv->GetValue (a, b);
+  }
+
+  /**
+   * \param min the minimum value
+   * \param max the maximum value
+   * \return an integer drawn uniformly in [min, max]
+   */
+  uint32_t GetInteger (uint32_t min, uint32_t max) const
+  {
+    m_numDraws++;
+    return m_rv->GetInteger (min, max);
+  }
+
+  /**
+   * Appends the position of the random variable to a checkpoint
+   * \param buffer the buffer
+   */
+  void SaveCheckpoint (std::vector<uint8_t> &buffer) const
+  {
+    NYUCheckpoint::SaveRandomVariable (m_rv, m_numDraws, buffer);
+  }
+
+  /**
+   * Moves the random variable to the position read from a checkpoint
+   * \param buffer the buffer
+   * \param offset the position of the state, moved after it
+   */
+  void RestoreCheckpoint (const std::vector<uint8_t> &buffer, size_t &offset)
+  {
+    m_numDraws = NYUCheckpoint::RestoreRandomVariable (m_rv, m_numDraws, buffer, offset);
+  }
+
+private:
+  Ptr<T> m_rv; //!< the random variable
+  mutable uint64_t m_numDraws; //!< the number of values drawn since the stream was set
+};
+
+} // namespace ns3
+
+#endif /* NYU_CHECKPOINT_H */
@@ -27,6 +27,7 @@
 #include "ns3/nyu-propagation-loss-model.h"
 #include "ns3/nyu-channel-condition-model.h"
 #include "ns3/log.h"
+#include "ns3/abort.h"
 #include "ns3/mobility-model.h"
 #include "ns3/double.h"
 #include "ns3/boolean.h"
@@ -131,6 +132,395 @@ static const double water[35][7] =  {
   {1780.00000, 2230.00000,  0.952,  17.620,  30.50,  2.00,  5.00},
 };
 
+/**
+ * The frequency independent terms of a spectral line of the atmospheric model,
+ * which depend only on the weather
+ */
+struct SpectralLine
+{
+  double m_frequency; //!< the center frequency of the line in GHz
+  double m_strength; //!< the strength of the line
+  double m_width; //!< the width of the line in GHz
+  double m_interference; //!< the interference coefficient of the line
+};
+
+/**
+ * \brief Computes the terms of the oxygen lines
+ * \param v the reciprocal of temperature in Kelvins
+ * \param pd the partial pressure for dry air in mbar
+ * \param e the partial pressure for water vapor (mb)
+ * \return the terms of each line
+ */
+static std::vector<SpectralLine>
+GetO2LineTerms (double v, double pd, double e)
+{
+  std::vector<SpectralLine> lines (44);
+  double p = pd + e;
+  for (int k = 0; k < 44; k++)
+  {
+    const double *a = oxygen[k];
+    double gamma = a[3] * (pd * pow(v,(0.8 - a[4])) + 1.1 * e * v) * pow(10,-3);
+    lines[k].m_frequency = a[0];
+    lines[k].m_strength = a[1] * pd * pow(v,3) *exp(a[2]*(1-v)) * pow(10,-6);
+    lines[k].m_width = pow((pow(gamma,2) + pow(25*0.6*pow(10,-4),2)),0.5);
+    lines[k].m_interference = ( a[5] + a[6] * v) * p * (pow(v,0.8)) * pow(10,-3);
+  }
+  return lines;
+}
+
+/**
+ * \brief Computes the terms of the water vapor lines
+ * \param v the reciprocal of temperature in Kelvins
+ * \param pd the partial pressure for dry air in mbar
+ * \param e the partial pressure for water vapor (mb)
+ * \return the terms of each line
+ */
+static std::vector<SpectralLine>
+GetH2oLineTerms (double v, double pd, double e)
+{
+  std::vector<SpectralLine> lines (35);
+  for (int k = 0; k < 35; k++)
+  {
+    const double *b = water[k];
+    double gamh = b[3] * (pd * pow(v,b[5]) + b[4] * e * pow(v,b[6])) * pow(10,-3);
+    double gamd2 = pow(10,-12)/ (v * pow(1.46 * b[0],2));
+    lines[k].m_frequency = b[0];
+    lines[k].m_strength = b[1] * e * pow(v,3.5) * exp(b[2]*(1-v));
+    lines[k].m_width = 0.535 * gamh + pow((0.217 * pow(gamh,2) + gamd2),0.5);
+    lines[k].m_interference = 0;
+  }
+  return lines;
+}
+
+/**
+ * \brief Sums the contributions of the spectral lines at a frequency
+ * \param lines the terms of the lines
+ * \param freqGHz the frequency in GHz
+ * \return the imaginary part of the sum of the line shapes
+ */
+static double
+SumSpectralLines (const std::vector<SpectralLine> &lines, double freqGHz)
+{
+  std::complex<double> zn (0,0);
+  for (const SpectralLine &line : lines)
+  {
+    std::complex<double> zf = freqGHz/line.m_frequency * ((std::complex<double>(1,0) - std::complex<double>(0,line.m_interference))/(std::complex<double>((line.m_frequency - freqGHz),0) - std::complex<double>(0,line.m_width)) - (std::complex<double>(1,0) + std::complex<double>(0,line.m_interference))/(std::complex<double>((line.m_frequency + freqGHz),0) + std::complex<double>(0,line.m_width)));
+    zn = zn + line.m_strength * zf;
+  }
+  return imag(zn);
+}
+
+/**
+ * Appends to a checkpoint the entries of a map added or changed since the
+ * previous checkpoint, followed by the keys of the removed ones. The bytes of
+ * each entry are hashed to detect the changes.
+ * \param map the map
+ * \param tracker the entries written to the previous checkpoints
+ * \param pack appends the bytes of an entry to a buffer
+ * \param buffer the buffer
+ */
+template <class Map, class Pack>
+static void
+SaveCheckpointEntries (const Map &map, NYUCheckpointTracker &tracker, Pack pack, std::vector<uint8_t> &buffer)
+{
+  std::vector<uint8_t> changed;
+  std::vector<uint8_t> entry;
+  uint64_t numChanged = 0;
+  for (const auto &item : map)
+    {
+      entry.clear ();
+      pack (item.second, entry);
+      if (tracker.Update (item.first, NYUCheckpoint::Hash (entry.data (), entry.size ())))
+        {
+          NYUCheckpoint::Append<uint32_t> (changed, item.first);
+          changed.insert (changed.end (), entry.begin (), entry.end ());
+          numChanged++;
+        }
+    }
+  std::vector<uint64_t> removed = tracker.EndCheckpoint ();
+
+  NYUCheckpoint::Append<uint64_t> (buffer, numChanged);
+  buffer.insert (buffer.end (), changed.begin (), changed.end ());
+  NYUCheckpoint::Append<uint64_t> (buffer, removed.size ());
+  for (uint64_t key : removed)
+    {
+      NYUCheckpoint::Append<uint32_t> (buffer, key);
+    }
+}
+
+/**
+ * Applies the entries written by SaveCheckpointEntries to a map
+ * \param map the map
+ * \param tracker the entries written to the previous checkpoints
+ * \param pack appends the bytes of an entry to a buffer
+ * \param unpack reads the bytes of an entry from a buffer
+ * \param buffer the buffer
+ * \param offset the position of the entries, moved after them
+ */
+template <class Map, class Pack, class Unpack>
+static void
+RestoreCheckpointEntries (Map &map, NYUCheckpointTracker &tracker, Pack pack, Unpack unpack,
+                          const std::vector<uint8_t> &buffer, size_t &offset)
+{
+  std::vector<uint8_t> entry;
+  uint64_t numChanged = NYUCheckpoint::Read<uint64_t> (buffer, offset);
+  for (uint64_t i = 0; i < numChanged; i++)
+    {
+      uint32_t key = NYUCheckpoint::Read<uint32_t> (buffer, offset);
+      auto &value = map[key];
+      unpack (buffer, offset, value);
+      entry.clear ();
+      pack (value, entry);
+      tracker.Set (key, NYUCheckpoint::Hash (entry.data (), entry.size ()));
+    }
+  uint64_t numRemoved = NYUCheckpoint::Read<uint64_t> (buffer, offset);
+  for (uint64_t i = 0; i < numRemoved; i++)
+    {
+      uint32_t key = NYUCheckpoint::Read<uint32_t> (buffer, offset);
+      map.erase (key);
+      tracker.Erase (key);
+    }
+}
+
+/**
+ * Appends a vector to a checkpoint buffer
+ * \param buffer the buffer
+ * \param vector the vector
+ */
+static void
+AppendVector (std::vector<uint8_t> &buffer, const Vector &vector)
+{
+  NYUCheckpoint::Append<double> (buffer, vector.x);
+  NYUCheckpoint::Append<double> (buffer, vector.y);
+  NYUCheckpoint::Append<double> (buffer, vector.z);
+}
+
+/**
+ * Reads a vector written by AppendVector
+ * \param buffer the buffer
+ * \param offset the position of the vector, moved after it
+ * \return the vector
+ */
+static Vector
+ReadVector (const std::vector<uint8_t> &buffer, size_t &offset)
+{
+  double x = NYUCheckpoint::Read<double> (buffer, offset);
+  double y = NYUCheckpoint::Read<double> (buffer, offset);
+  double z = NYUCheckpoint::Read<double> (buffer, offset);
+  return Vector (x, y, z);
+}
+
+// ------------------------------------------------------------------------- //
+
+NS_OBJECT_ENSURE_REGISTERED (NYULargeScaleState);
+
+TypeId
+NYULargeScaleState::GetTypeId (void)
+{
+  static TypeId tid =
+    TypeId ("ns3::NYULargeScaleState")
+    .SetParent<Object> ()
+    .SetGroupName ("Propagation")
+    .AddConstructor<NYULargeScaleState> ()
+    .AddAttribute ("ChannelConditionModel",
+                   "Pointer to the channel condition model shared by the component carriers.",
+                   PointerValue (),
+                   MakePointerAccessor (&NYULargeScaleState::SetChannelConditionModel,
+                                        &NYULargeScaleState::GetChannelConditionModel),
+                   MakePointerChecker<ChannelConditionModel> ());
+  return tid;
+}
+
+NYULargeScaleState::NYULargeScaleState ()
+{
+  NS_LOG_FUNCTION (this);
+  m_uniformVar.Get ()->SetAttribute ("Min", DoubleValue (0));
+  m_uniformVar.Get ()->SetAttribute ("Max", DoubleValue (1));
+  m_normRandomVariable.Get ()->SetAttribute ("Mean", DoubleValue (0));
+  m_normRandomVariable.Get ()->SetAttribute ("Variance", DoubleValue (1));
+}
+
+NYULargeScaleState::~NYULargeScaleState ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+NYULargeScaleState::DoDispose ()
+{
+  m_channelConditionModel = nullptr;
+  m_links.clear ();
+}
+
+void
+NYULargeScaleState::SetChannelConditionModel (Ptr<ChannelConditionModel> model)
+{
+  NS_LOG_FUNCTION (this);
+  m_channelConditionModel = model;
+}
+
+Ptr<ChannelConditionModel>
+NYULargeScaleState::GetChannelConditionModel () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_channelConditionModel;
+}
+
+NYULargeScaleState::LinkItem &
+NYULargeScaleState::GetLinkItem (uint32_t key)
+{
+  auto it = m_links.find (key);
+  bool renew = false;
+  if (it == m_links.end ())
+    {
+      it = m_links.emplace (key, LinkItem ()).first;
+      renew = true;
+    }
+  else
+    {
+      renew = (it->second.m_drawTime != Simulator::Now ());
+    }
+
+  if (renew)
+    {
+      it->second.m_drawTime = Simulator::Now ();
+      it->second.m_o2iDraw = m_normRandomVariable.GetValue ();
+      it->second.m_foliageDraw = m_uniformVar.GetValue ();
+    }
+  return it->second;
+}
+
+double
+NYULargeScaleState::GetNormalizedShadowing (uint32_t key,
+                                            const Vector &distance,
+                                            ChannelCondition::LosConditionValue cond,
+                                            double correlationDistance)
+{
+  NS_LOG_FUNCTION (this << key << cond);
+  LinkItem &item = GetLinkItem (key);
+
+  if (!item.m_hasShadowing || item.m_condition != cond)
+    {
+      // generate a new independent realization
+      item.m_shadowing = m_normRandomVariable.GetValue ();
+      item.m_hasShadowing = true;
+    }
+  else
+    {
+      Vector2D displacement (distance.x - item.m_distance.x, distance.y - item.m_distance.y);
+      if (displacement.GetLength () == 0)
+        {
+          // same position, e.g., another carrier at the same time: keep the value
+          return item.m_shadowing;
+        }
+      // compute a new correlated shadowing loss - as per 3GPP
+      double R = exp (-1 * displacement.GetLength () / correlationDistance);
+      item.m_shadowing = R * item.m_shadowing + sqrt (1 - R * R) * m_normRandomVariable.GetValue ();
+    }
+  item.m_distance = distance;
+  item.m_condition = cond;
+  return item.m_shadowing;
+}
+
+double
+NYULargeScaleState::GetO2iDraw (uint32_t key)
+{
+  NS_LOG_FUNCTION (this << key);
+  return GetLinkItem (key).m_o2iDraw;
+}
+
+double
+NYULargeScaleState::GetFoliageDraw (uint32_t key)
+{
+  NS_LOG_FUNCTION (this << key);
+  return GetLinkItem (key).m_foliageDraw;
+}
+
+bool
+NYULargeScaleState::GetStoredShadowing (uint32_t key,
+                                        ChannelCondition::LosConditionValue cond,
+                                        double &shadowing) const
+{
+  NS_LOG_FUNCTION (this << key << cond);
+  auto it = m_links.find (key);
+  if (it == m_links.end () || !it->second.m_hasShadowing || it->second.m_condition != cond)
+    {
+      return false;
+    }
+  shadowing = it->second.m_shadowing;
+  return true;
+}
+
+size_t
+NYULargeScaleState::GetNumLinks () const
+{
+  return m_links.size ();
+}
+
+int64_t
+NYULargeScaleState::AssignStreams (int64_t stream)
+{
+  NS_LOG_FUNCTION (this << stream);
+  m_uniformVar.SetStream (stream);
+  m_normRandomVariable.SetStream (stream + 1);
+  return 2;
+}
+
+void
+NYULargeScaleState::SaveCheckpoint (std::vector<uint8_t> &buffer, bool full)
+{
+  NS_LOG_FUNCTION (this << full);
+  if (full)
+    {
+      m_checkpointTracker.Clear ();
+    }
+  NYUCheckpoint::Append<uint8_t> (buffer, full ? 1 : 0);
+  m_uniformVar.SaveCheckpoint (buffer);
+  m_normRandomVariable.SaveCheckpoint (buffer);
+  SaveCheckpointEntries (m_links, m_checkpointTracker, &NYULargeScaleState::PackLinkItem, buffer);
+}
+
+void
+NYULargeScaleState::RestoreCheckpoint (const std::vector<uint8_t> &buffer)
+{
+  NS_LOG_FUNCTION (this);
+  size_t offset = 0;
+  if (NYUCheckpoint::Read<uint8_t> (buffer, offset))
+    {
+      m_links.clear ();
+      m_checkpointTracker.Clear ();
+    }
+  m_uniformVar.RestoreCheckpoint (buffer, offset);
+  m_normRandomVariable.RestoreCheckpoint (buffer, offset);
+  RestoreCheckpointEntries (m_links, m_checkpointTracker, &NYULargeScaleState::PackLinkItem,
+                            &NYULargeScaleState::UnpackLinkItem, buffer, offset);
+  NS_ASSERT_MSG (offset == buffer.size (), "Malformed checkpoint of the large-scale state");
+}
+
+void
+NYULargeScaleState::PackLinkItem (const LinkItem &item, std::vector<uint8_t> &buffer)
+{
+  NYUCheckpoint::Append<double> (buffer, item.m_shadowing);
+  NYUCheckpoint::Append<uint8_t> (buffer, item.m_hasShadowing ? 1 : 0);
+  NYUCheckpoint::Append<int32_t> (buffer, item.m_condition);
+  AppendVector (buffer, item.m_distance);
+  NYUCheckpoint::Append<int64_t> (buffer, item.m_drawTime.GetTimeStep ());
+  NYUCheckpoint::Append<double> (buffer, item.m_o2iDraw);
+  NYUCheckpoint::Append<double> (buffer, item.m_foliageDraw);
+}
+
+void
+NYULargeScaleState::UnpackLinkItem (const std::vector<uint8_t> &buffer, size_t &offset, LinkItem &item)
+{
+  item.m_shadowing = NYUCheckpoint::Read<double> (buffer, offset);
+  item.m_hasShadowing = NYUCheckpoint::Read<uint8_t> (buffer, offset) != 0;
+  item.m_condition = static_cast<ChannelCondition::LosConditionValue> (NYUCheckpoint::Read<int32_t> (buffer, offset));
+  item.m_distance = ReadVector (buffer, offset);
+  item.m_drawTime = TimeStep (NYUCheckpoint::Read<int64_t> (buffer, offset));
+  item.m_o2iDraw = NYUCheckpoint::Read<double> (buffer, offset);
+  item.m_foliageDraw = NYUCheckpoint::Read<double> (buffer, offset);
+}
+
 // ------------------------------------------------------------------------- //
 TypeId
 NYUPropagationLossModel::GetTypeId (void)
@@ -182,17 +572,26 @@ NYUPropagationLossModel::GetTypeId (void)
                    PointerValue (),
                    MakePointerAccessor (&NYUPropagationLossModel::SetChannelConditionModel,
                                         &NYUPropagationLossModel::GetChannelConditionModel),
-                   MakePointerChecker<ChannelConditionModel> ());
+                   MakePointerChecker<ChannelConditionModel> ())
+    .AddAttribute ("LargeScaleState",
+                   "Pointer to the large-scale state (shadowing, O2I and foliage draws) "
+                   "shared with the propagation loss models of the other component carriers. "
+                   "If not set, the state is local to this model.",
+                   PointerValue (),
+                   MakePointerAccessor (&NYUPropagationLossModel::SetLargeScaleState,
+                                        &NYUPropagationLossModel::GetLargeScaleState),
+                   MakePointerChecker<NYULargeScaleState> ());
   return tid;
 }
 
-NYUPropagationLossModel::NYUPropagationLossModel () : PropagationLossModel ()
+NYUPropagationLossModel::NYUPropagationLossModel ()
+  : PropagationLossModel (),
+    m_atmosphericAttenuationFactor (0),
+    m_atmosphericAttenuationFactorValid (false)
 {
   NS_LOG_FUNCTION (this);
-  m_uniformVar = CreateObject<UniformRandomVariable> ();
-  m_normRandomVariable = CreateObject<NormalRandomVariable> ();
-  m_normRandomVariable->SetAttribute ("Mean", DoubleValue (0));
-  m_normRandomVariable->SetAttribute ("Variance", DoubleValue (1));
+  m_normRandomVariable.Get ()->SetAttribute ("Mean", DoubleValue (0));
+  m_normRandomVariable.Get ()->SetAttribute ("Variance", DoubleValue (1));
 }
 
 NYUPropagationLossModel::~NYUPropagationLossModel ()
@@ -205,7 +604,9 @@ NYUPropagationLossModel::DoDispose ()
 {
   m_channelConditionModel->Dispose ();
   m_channelConditionModel = nullptr;
+  m_largeScaleState = nullptr;
   m_shadowingMap.clear ();
+  m_linkMap.clear ();
 }
 
 void
@@ -222,12 +623,100 @@ NYUPropagationLossModel::GetChannelConditionModel () const
   return m_channelConditionModel;
 }
 
+void
+NYUPropagationLossModel::SetLargeScaleState (Ptr<NYULargeScaleState> state)
+{
+  NS_LOG_FUNCTION (this);
+  m_largeScaleState = state;
+}
+
+Ptr<NYULargeScaleState>
+NYUPropagationLossModel::GetLargeScaleState () const
+{
+  NS_LOG_FUNCTION (this);
+  return m_largeScaleState;
+}
+
 int64_t
 NYUPropagationLossModel::DoAssignStreams (int64_t stream)
 {
   NS_LOG_FUNCTION (this);
-  m_uniformVar->SetStream (stream);
-  return 1;
+  m_uniformVar.SetStream (stream);
+  m_normRandomVariable.SetStream (stream + 1);
+  return 2;
+}
+
+void
+NYUPropagationLossModel::SaveCheckpoint (std::vector<uint8_t> &buffer, bool full)
+{
+  NS_LOG_FUNCTION (this << full);
+  if (full)
+    {
+      m_checkpointTracker.Clear ();
+      m_linkCheckpointTracker.Clear ();
+    }
+  NYUCheckpoint::Append<uint8_t> (buffer, full ? 1 : 0);
+  m_uniformVar.SaveCheckpoint (buffer);
+  m_normRandomVariable.SaveCheckpoint (buffer);
+  SaveCheckpointEntries (m_shadowingMap, m_checkpointTracker, &NYUPropagationLossModel::PackShadowingMapItem, buffer);
+  SaveCheckpointEntries (m_linkMap, m_linkCheckpointTracker, &NYUPropagationLossModel::PackLinkMapItem, buffer);
+}
+
+void
+NYUPropagationLossModel::RestoreCheckpoint (const std::vector<uint8_t> &buffer)
+{
+  NS_LOG_FUNCTION (this);
+  size_t offset = 0;
+  if (NYUCheckpoint::Read<uint8_t> (buffer, offset))
+    {
+      m_shadowingMap.clear ();
+      m_checkpointTracker.Clear ();
+      m_linkMap.clear ();
+      m_linkCheckpointTracker.Clear ();
+    }
+  m_uniformVar.RestoreCheckpoint (buffer, offset);
+  m_normRandomVariable.RestoreCheckpoint (buffer, offset);
+  RestoreCheckpointEntries (m_shadowingMap, m_checkpointTracker, &NYUPropagationLossModel::PackShadowingMapItem,
+                            &NYUPropagationLossModel::UnpackShadowingMapItem, buffer, offset);
+  RestoreCheckpointEntries (m_linkMap, m_linkCheckpointTracker, &NYUPropagationLossModel::PackLinkMapItem,
+                            &NYUPropagationLossModel::UnpackLinkMapItem, buffer, offset);
+  NS_ASSERT_MSG (offset == buffer.size (), "Malformed checkpoint of the propagation loss model");
+}
+
+void
+NYUPropagationLossModel::PackShadowingMapItem (const ShadowingMapItem &item, std::vector<uint8_t> &buffer)
+{
+  NYUCheckpoint::Append<double> (buffer, item.m_shadowing);
+  NYUCheckpoint::Append<int32_t> (buffer, item.m_condition);
+  AppendVector (buffer, item.m_distance);
+}
+
+void
+NYUPropagationLossModel::UnpackShadowingMapItem (const std::vector<uint8_t> &buffer, size_t &offset,
+                                                 ShadowingMapItem &item)
+{
+  item.m_shadowing = NYUCheckpoint::Read<double> (buffer, offset);
+  item.m_condition = static_cast<ChannelCondition::LosConditionValue> (NYUCheckpoint::Read<int32_t> (buffer, offset));
+  item.m_distance = ReadVector (buffer, offset);
+}
+
+void
+NYUPropagationLossModel::PackLinkMapItem (const LinkMapItem &item, std::vector<uint8_t> &buffer)
+{
+  NYUCheckpoint::Append<int32_t> (buffer, item.m_losCondition);
+  NYUCheckpoint::Append<int32_t> (buffer, item.m_o2iCondition);
+  NYUCheckpoint::Append<double> (buffer, item.m_o2iDraw);
+  NYUCheckpoint::Append<double> (buffer, item.m_foliageDraw);
+}
+
+void
+NYUPropagationLossModel::UnpackLinkMapItem (const std::vector<uint8_t> &buffer, size_t &offset,
+                                            LinkMapItem &item)
+{
+  item.m_losCondition = static_cast<ChannelCondition::LosConditionValue> (NYUCheckpoint::Read<int32_t> (buffer, offset));
+  item.m_o2iCondition = static_cast<ChannelCondition::O2iConditionValue> (NYUCheckpoint::Read<int32_t> (buffer, offset));
+  item.m_o2iDraw = NYUCheckpoint::Read<double> (buffer, offset);
+  item.m_foliageDraw = NYUCheckpoint::Read<double> (buffer, offset);
 }
 
 void
@@ -237,6 +726,7 @@ NYUPropagationLossModel::SetFrequency (double frequency)
   NS_ASSERT_MSG (frequency >= 500.0e6 && frequency <= 150.0e9,
                  "Frequency should be between 0.5 and 150 GHz but is " << frequency);
   m_frequency = frequency;
+  m_atmosphericAttenuationFactorValid = false;
 }
 
 double
@@ -269,6 +759,7 @@ NYUPropagationLossModel::SetAtmosphericPressure (double pressure)
   NS_ASSERT_MSG (pressure >= 1e-5 && pressure <= 1013.25,
                  "Barometric pressure should be between 1e-5 mbar to 1013.5 mbar but is " << pressure);
   m_pressure = pressure;
+  m_atmosphericAttenuationFactorValid = false;
 }
 
 double
@@ -285,6 +776,7 @@ NYUPropagationLossModel::SetHumidity (double humidity)
   NS_ASSERT_MSG (humidity >= 0 && humidity <= 100,
                  "Humidity should be between 0 to 100 but is " << humidity);
   m_humidity = humidity;
+  m_atmosphericAttenuationFactorValid = false;
 }
 
 double
@@ -301,6 +793,7 @@ NYUPropagationLossModel::SetTemperature (double temperature)
   NS_ASSERT_MSG (temperature >= -100 && temperature <= 50,
                  "Temperature should be between -100 to 50 celcius but is " << temperature);
   m_temperature = temperature;
+  m_atmosphericAttenuationFactorValid = false;
 }
 
 double
@@ -317,6 +810,7 @@ NYUPropagationLossModel::SetRainRate (double rainRate)
   NS_ASSERT_MSG (rainRate >= 0 && rainRate <= 150,
                  "Rain rate should be between 0 to 150 mm/hr but is " << rainRate);
   m_rainRate = rainRate;
+  m_atmosphericAttenuationFactorValid = false;
 }
 
 double
@@ -363,23 +857,69 @@ NYUPropagationLossModel::DoCalcRxPower (double txPowerDbm,
   double PL = 0;
   double atmosphericAttenuationFactor = 0;
 
-  PL = GetLoss (cond, distance2D, heights.second);
+  PL = GetLoss (cond, distance2D, heights.second, m_frequency);
+
+  // the condition and the draws are stored for CalcRxPowerSweep
+  uint32_t key = GetKey (a, b);
+  LinkMapItem &link = m_linkMap[key];
+  link.m_losCondition = cond->GetLosCondition ();
+  link.m_o2iCondition = cond->GetO2iCondition ();
+  link.m_o2iDraw = 0;
+  link.m_foliageDraw = 0;
 
-  if (m_shadowingEnabled)
+  if (m_largeScaleState)
+    {
+      // the random large-scale terms are shared with the other carriers,
+      // only their frequency-dependent scaling is computed here
+      if (m_shadowingEnabled)
+        {
+          ChannelCondition::LosConditionValue los = cond->GetLosCondition ();
+          PL += GetShadowingStd (los, m_frequency) *
+            m_largeScaleState->GetNormalizedShadowing (key, GetVectorDifference (a, b), los,
+                                                       GetShadowingCorrelationDistance (los));
+        }
+      if (cond->GetO2iCondition () == ChannelCondition::O2I)
+        {
+          link.m_o2iDraw = m_largeScaleState->GetO2iDraw (key);
+        }
+      if (m_foilageLossEnabled)
+        {
+          link.m_foliageDraw = m_largeScaleState->GetFoliageDraw (key);
+        }
+    }
+  else
     {
-      PL += GetShadowing (a, b, cond->GetLosCondition ());
+      if (m_shadowingEnabled)
+        {
+          PL += GetShadowing (a, b, cond->GetLosCondition ());
+        }
+      if (cond->GetO2iCondition () == ChannelCondition::O2I)
+        {
+          link.m_o2iDraw = m_normRandomVariable.GetValue ();
+        }
+      if (m_foilageLossEnabled)
+        {
+          link.m_foliageDraw = m_uniformVar.GetValue (0, 1);
+        }
     }
   if (cond->GetO2iCondition () == ChannelCondition::O2I)
     {
-      PL += GetO2IPathLoss (m_o2iLossType, m_frequency);
+      PL += GetO2IPathLoss (m_o2iLossType, m_frequency, link.m_o2iDraw);
     }
   if (m_foilageLossEnabled)
     {
-      PL += GetFoliagePathLoss (distance2D);
+      PL += GetFoliagePathLoss (distance2D, link.m_foliageDraw);
     }
   if (m_atmosphericLossEnabled)
     {
-      atmosphericAttenuationFactor = GetAtmoshperticAttenuationFactor(m_frequency, GetAtmosphericPressure(), GetHumidity(), GetTemperature(), GetRainRate());
+      // the attenuation factor depends only on the frequency and on the
+      // weather attributes, so it is computed once and refreshed by the setters
+      if (!m_atmosphericAttenuationFactorValid)
+        {
+          m_atmosphericAttenuationFactor = GetAtmoshperticAttenuationFactor(m_frequency, GetAtmosphericPressure(), GetHumidity(), GetTemperature(), GetRainRate());
+          m_atmosphericAttenuationFactorValid = true;
+        }
+      atmosphericAttenuationFactor = m_atmosphericAttenuationFactor;
       PL += GetAtmoshperticAttenuation(atmosphericAttenuationFactor, distance2D);
     }
   rxPow -= PL;
@@ -395,6 +935,91 @@ NYUPropagationLossModel::GetAtmoshperticAttenuation (double atmosphericAttenuati
   return atmoshpericAttenuation;
 }
 
+std::vector<double>
+NYUPropagationLossModel::CalcRxPowerSweep (double txPowerDbm,
+                                           Ptr<MobilityModel> a,
+                                           Ptr<MobilityModel> b,
+                                           const std::vector<double> &frequencies) const
+{
+  NS_LOG_FUNCTION (this << txPowerDbm << frequencies.size ());
+  NS_ASSERT_MSG (m_frequency != 0.0, "First set the centre frequency");
+
+  // the condition is the one of the last CalcRxPower of the link, the channel
+  // condition model is not queried since it could generate a new one
+  uint32_t key = GetKey (a, b);
+  auto link = m_linkMap.find (key);
+  NS_ABORT_MSG_IF (link == m_linkMap.end (), "No state for this link, call CalcRxPower before CalcRxPowerSweep");
+  ChannelCondition::LosConditionValue los = link->second.m_losCondition;
+  Ptr<ChannelCondition> cond = CreateObject<ChannelCondition> ();
+  cond->SetLosCondition (los);
+  cond->SetO2iCondition (link->second.m_o2iCondition);
+
+  double distance2D = Calculate2dDistance (a->GetPosition (), b->GetPosition ());
+  std::pair<double, double> heights = GetUtAndBsHeights (a->GetPosition ().z, b->GetPosition ().z);
+
+  // the random terms are the ones stored by the last CalcRxPower of the link,
+  // kept normalized so that they can be scaled at each frequency
+  double normalizedShadowing = 0;
+  double o2iDraw = link->second.m_o2iDraw;
+  double foliageLoss = 0;
+  bool o2i = (link->second.m_o2iCondition == ChannelCondition::O2I);
+  if (m_foilageLossEnabled)
+    {
+      foliageLoss = GetFoliagePathLoss (distance2D, link->second.m_foliageDraw);
+    }
+  if (m_largeScaleState)
+    {
+      if (m_shadowingEnabled)
+        {
+          bool stored = m_largeScaleState->GetStoredShadowing (key, los, normalizedShadowing);
+          NS_ABORT_MSG_IF (!stored, "No shadowing for this link, call CalcRxPower before CalcRxPowerSweep");
+        }
+    }
+  else
+    {
+      if (m_shadowingEnabled)
+        {
+          auto it = m_shadowingMap.find (key);
+          NS_ABORT_MSG_IF (it == m_shadowingMap.end () || it->second.m_condition != los,
+                           "No shadowing for this link, call CalcRxPower before CalcRxPowerSweep");
+          double shadowingStd = GetShadowingStd (los, m_frequency);
+          normalizedShadowing = (shadowingStd > 0) ? it->second.m_shadowing / shadowingStd : 0;
+        }
+    }
+
+  std::vector<double> atmosphericAttenuationFactors;
+  if (m_atmosphericLossEnabled)
+    {
+      atmosphericAttenuationFactors =
+        GetAtmoshperticAttenuationFactors (frequencies, GetAtmosphericPressure (), GetHumidity (),
+                                           GetTemperature (), GetRainRate ());
+    }
+
+  std::vector<double> rxPow (frequencies.size ());
+  for (std::size_t i = 0; i < frequencies.size (); i++)
+    {
+      double frequency = frequencies[i];
+      NS_ASSERT_MSG (frequency >= 500.0e6 && frequency <= 150.0e9,
+                     "Frequency should be between 0.5 and 150 GHz but is " << frequency);
+      double PL = GetLoss (cond, distance2D, heights.second, frequency);
+      if (m_shadowingEnabled)
+        {
+          PL += GetShadowingStd (los, frequency) * normalizedShadowing;
+        }
+      if (o2i)
+        {
+          PL += GetO2IPathLoss (m_o2iLossType, frequency, o2iDraw);
+        }
+      PL += foliageLoss;
+      if (m_atmosphericLossEnabled)
+        {
+          PL += GetAtmoshperticAttenuation (atmosphericAttenuationFactors[i], distance2D);
+        }
+      rxPow[i] = txPowerDbm - PL;
+    }
+  return rxPow;
+}
+
 double 
 NYUPropagationLossModel::GetAtmoshperticAttenuationFactor(double frequency, 
                                                           double pressure, 
@@ -403,8 +1028,17 @@ NYUPropagationLossModel::GetAtmoshperticAttenuationFactor(double frequency,
                                                           double rainRate) const
 {
   NS_LOG_FUNCTION (this << frequency << pressure << humidity << temperature << rainRate);
-  double atmosphericAttenuationFactor = 0;
-  double freqGHz = frequency/1e9;
+  return GetAtmoshperticAttenuationFactors ({frequency}, pressure, humidity, temperature, rainRate)[0];
+}
+
+std::vector<double>
+NYUPropagationLossModel::GetAtmoshperticAttenuationFactors(const std::vector<double> &frequencies,
+                                                           double pressure,
+                                                           double humidity,
+                                                           double temperature,
+                                                           double rainRate) const
+{
+  NS_LOG_FUNCTION (this << frequencies.size () << pressure << humidity << temperature << rainRate);
   bool ice = 0;
   double w = 0;
   double es = 0;
@@ -412,18 +1046,8 @@ NYUPropagationLossModel::GetAtmoshperticAttenuationFactor(double frequency,
   double pd = 0;
   double eps = 0;
   double v = 0;
-  double o2Lines = 0;
-  double dryAir = 0;
-  double h2oVapor = 0;
-  double h2oLiquid = 0;
-  double rain = 0;
   double n0 = 0;
 
-  if (freqGHz < 1)
-  {
-    freqGHz = 1;
-  }
-
   if (humidity > 99.5)
   {
     w = 1;
@@ -453,25 +1077,38 @@ NYUPropagationLossModel::GetAtmoshperticAttenuationFactor(double frequency,
   }
   
   eps = GetH2oPermittivity(v,ice);
-  
-  o2Lines = GetO2Lines(freqGHz,v,pd,e);
 
-  dryAir = GetDryCont(freqGHz,v,pd,e);
+  n0 = GetNonDispRef(v,pd,e,rainRate,w,eps);
 
-  h2oVapor = GetH2oVapor(freqGHz,v,pd,e);
+  // the line strengths, widths and interference terms depend only on the
+  // weather, so they are computed once for all the frequencies
+  std::vector<SpectralLine> o2LineTerms = GetO2LineTerms (v, pd, e);
+  std::vector<SpectralLine> h2oLineTerms = GetH2oLineTerms (v, pd, e);
 
-  h2oLiquid = GetH2oLiquid(freqGHz,v,w,ice,eps);
+  NS_LOG_DEBUG("Es:" << es << " e:" << e << " pd:" << pd << " Eps:" << eps << " ice:" <<ice << " W:" << w << " v:" << v << " n0:" << n0);
 
-  rain = GetRainAttenuation(freqGHz,rainRate);
+  std::vector<double> atmosphericAttenuationFactors (frequencies.size ());
+  for (std::size_t i = 0; i < frequencies.size (); i++)
+  {
+    double freqGHz = frequencies[i]/1e9;
+    if (freqGHz < 1)
+    {
+      freqGHz = 1;
+    }
 
-  n0 = GetNonDispRef(v,pd,e,rainRate,w,eps);
+    double o2Lines = SumSpectralLines (o2LineTerms, freqGHz);
+    double dryAir = GetDryCont(freqGHz,v,pd,e);
+    double h2oVapor = SumSpectralLines (h2oLineTerms, freqGHz);
+    double h2oLiquid = GetH2oLiquid(freqGHz,v,w,ice,eps);
+    double rain = GetRainAttenuation(freqGHz,rainRate);
 
-  atmosphericAttenuationFactor = 0.182 * freqGHz * (o2Lines + dryAir + h2oVapor + h2oLiquid + rain) * 1e-3;
+    atmosphericAttenuationFactors[i] = 0.182 * freqGHz * (o2Lines + dryAir + h2oVapor + h2oLiquid + rain) * 1e-3;
 
-  NS_LOG_DEBUG("attenuation factor:" << atmosphericAttenuationFactor << " Es:" << es << " e:" << e << " pd:" << pd << " Eps:" << eps << " ice:" <<ice << " W:" << w << " v:" << v << " O2Lines:" << o2Lines);
-  NS_LOG_DEBUG("dryAir:" << dryAir << " h2oVapor:" << h2oVapor << " h2oLiquid:" << h2oLiquid << " rain:" << rain << " n0:" << n0);
+    NS_LOG_DEBUG("attenuation factor:" << atmosphericAttenuationFactors[i] << " O2Lines:" << o2Lines);
+    NS_LOG_DEBUG("dryAir:" << dryAir << " h2oVapor:" << h2oVapor << " h2oLiquid:" << h2oLiquid << " rain:" << rain);
+  }
 
-  return atmosphericAttenuationFactor;
+  return atmosphericAttenuationFactors;
 }
 
 double 
@@ -505,42 +1142,6 @@ NYUPropagationLossModel::GetH2oPermittivity(double v, bool ice) const
   return Eps;
 }
 
-double 
-NYUPropagationLossModel::GetO2Lines(double freqGHz, double v, double pd, double e) const
-{
-  double foO2[44], a1[44], a2[44], a3[44], a4[44], a5[44], a6[44];
-  double p = 0;
-  double s = 0;
-  double gamma = 0;
-  double delta = 0;
-  std::complex<double> zf (0,0);
-  std::complex<double> zn (0,0);
-
-  for (int i = 0; i< 44; i++)
-  {
-    foO2[i] = oxygen[i][0];
-    a1[i] = oxygen[i][1];
-    a2[i] = oxygen[i][2];
-    a3[i] = oxygen[i][3];
-    a4[i] = oxygen[i][4];
-    a5[i] = oxygen[i][5];
-    a6[i] = oxygen[i][6];
-  }
-  
-  p = pd + e;
-
-  for(int k = 0; k < 44; k++)
-  {
-    s = a1[k] * pd * pow(v,3) *exp(a2[k]*(1-v)) * pow(10,-6);
-    gamma = a3[k] * (pd * pow(v,(0.8 - a4[k])) + 1.1 * e * v) * pow(10,-3);
-    gamma = pow((pow(gamma,2) + pow(25*0.6*pow(10,-4),2)),0.5);
-    delta = ( a5[k] + a6[k] * v) * p * (pow(v,0.8)) * pow(10,-3);
-    zf = freqGHz/foO2[k] * ((std::complex<double>(1,0) - std::complex<double>(0,delta))/(std::complex<double>((foO2[k] - freqGHz),0) - std::complex<double>(0,gamma)) - (std::complex<double>(1,0) + std::complex<double>(0,delta))/(std::complex<double>((foO2[k] + freqGHz),0) + std::complex<double>(0,gamma)));
-    zn = zn + s * zf;
-  }
-  return imag(zn);
-}
-
 double 
 NYUPropagationLossModel::GetDryCont(double freqGHz, double v, double pd, double e) const
 {
@@ -562,41 +1163,6 @@ NYUPropagationLossModel::GetDryCont(double freqGHz, double v, double pd, double
 	return imag(zn);
 }
 
-double 
-NYUPropagationLossModel::GetH2oVapor(double freqGHz, double v, double pd, double e) const
-{
-  double foH2o[44], b1[44], b2[44], b3[44], b4[44], b5[44], b6[44];      
-  double s = 0;
-  double gamh = 0;
-  double gamd2 = 0;
-  double delh = 0;
-  std::complex<double> zf (0,0);
-  std::complex<double> zn (0,0);
-    
-	for (int i = 0; i < 35; i++)
-  {
-    foH2o[i] = water[i][0];
-    b1[i] = water[i][1];
-    b2[i] = water[i][2];
-    b3[i] = water[i][3];
-    b4[i] = water[i][4];
-    b5[i] = water[i][5];
-    b6[i] = water[i][6];
-  }
-    
-  for(int k = 0; k < 35; k++)
-  {
-    s = b1[k] * e * pow(v,3.5) * exp(b2[k]*(1-v));
-    gamh = b3[k] * (pd * pow(v,b5[k]) + b4[k] * e * pow(v,b6[k])) * pow(10,-3);
-    gamd2 = pow(10,-12)/ (v * pow(1.46 * foH2o[k],2));
-    gamh = 0.535 * gamh + pow((0.217 * pow(gamh,2) + gamd2),0.5);
-    delh = 0;
-    zf = freqGHz/foH2o[k] * ((std::complex<double>(1,-delh))/(std::complex<double>(foH2o[k] - freqGHz,-gamh)) - (std::complex<double>(1,delh))/(std::complex<double>(foH2o[k] + freqGHz,gamh)));
-    zn = zn + s*zf;
-  }
-  return imag(zn);
-}
-
 double
 NYUPropagationLossModel::GetH2oLiquid (double freqGHz, double v, double w, bool ice, double eps) const
 {
@@ -725,17 +1291,18 @@ NYUPropagationLossModel::GetNonDispRef (double v, double pd, double e, double ra
 }
 
 double
-NYUPropagationLossModel::GetLoss (Ptr<ChannelCondition> cond, double distance2D, double hBs) const
+NYUPropagationLossModel::GetLoss (Ptr<ChannelCondition> cond, double distance2D, double hBs,
+                                  double frequency) const
 {
   NS_LOG_FUNCTION (this);
   double loss = 0;
   if (cond->GetLosCondition () == ChannelCondition::LosConditionValue::LOS)
     {
-      loss = GetLossLos (distance2D, hBs);
+      loss = GetLossLos (distance2D, hBs, frequency);
     }
   else if (cond->GetLosCondition () == ChannelCondition::LosConditionValue::NLOS)
     {
-      loss = GetLossNlos (distance2D, hBs);
+      loss = GetLossNlos (distance2D, hBs, frequency);
     }
   else
     {
@@ -824,7 +1391,7 @@ NYUPropagationLossModel::GetShadowing (Ptr<MobilityModel> a, Ptr<MobilityModel>
   if (notFound || newCondition)
     {
       // generate a new independent realization
-      shadowingValue = GetShadowingStd (cond) * m_normRandomVariable->GetValue ();
+      shadowingValue = GetShadowingStd (cond, m_frequency) * m_normRandomVariable.GetValue ();
     }
   else
     {
@@ -833,8 +1400,8 @@ NYUPropagationLossModel::GetShadowing (Ptr<MobilityModel> a, Ptr<MobilityModel>
                              newDistance.y - it->second.m_distance.y);
       double R = exp (-1 * displacement.GetLength () / GetShadowingCorrelationDistance (cond));
       shadowingValue = R * it->second.m_shadowing + sqrt (1 - R * R) *
-        m_normRandomVariable->GetValue () *
-        GetShadowingStd (cond);
+        m_normRandomVariable.GetValue () *
+        GetShadowingStd (cond, m_frequency);
     }
 
   // update the entry in the map
@@ -874,17 +1441,26 @@ double
 NYUPropagationLossModel::GetO2IPathLoss (const std::string &o2iLossType, double frequency) const
 {
   NS_LOG_FUNCTION (this);
+  return GetO2IPathLoss (o2iLossType, frequency, m_normRandomVariable.GetValue ());
+}
+
+double
+NYUPropagationLossModel::GetO2IPathLoss (const std::string &o2iLossType,
+                                         double frequency,
+                                         double normalDraw) const
+{
+  NS_LOG_FUNCTION (this << normalDraw);
 
   double freqGHz = frequency / 1e9;
   double o2iLoss = 0;
 
   if (o2iLossType.compare ("Low Loss") == 0)
     {
-      o2iLoss = 10 * log10 (5 + 0.03 * pow (freqGHz, 2)) + 4 * m_normRandomVariable->GetValue ();
+      o2iLoss = 10 * log10 (5 + 0.03 * pow (freqGHz, 2)) + 4 * normalDraw;
     }
   else if (o2iLossType.compare ("High Loss") == 0)
     {
-      o2iLoss = 10 * log10 (10 + 5 * pow (freqGHz, 2)) + 6 * m_normRandomVariable->GetValue ();
+      o2iLoss = 10 * log10 (10 + 5 * pow (freqGHz, 2)) + 6 * normalDraw;
     }
   else
     {
@@ -899,10 +1475,17 @@ NYUPropagationLossModel::GetFoliagePathLoss (double distance2D) const
   NS_LOG_FUNCTION (this << distance2D);
 
   double foliagePathLoss = 0;
-  foliagePathLoss = m_foliageLoss * m_uniformVar->GetValue (0, distance2D);
+  foliagePathLoss = m_foliageLoss * m_uniformVar.GetValue (0, distance2D);
   return foliagePathLoss;
 }
 
+double
+NYUPropagationLossModel::GetFoliagePathLoss (double distance2D, double uniformDraw) const
+{
+  NS_LOG_FUNCTION (this << distance2D << uniformDraw);
+  return m_foliageLoss * uniformDraw * distance2D;
+}
+
 NS_OBJECT_ENSURE_REGISTERED (NYUUmiPropagationLossModel);
 
 TypeId
@@ -928,22 +1511,22 @@ NYUUmiPropagationLossModel::~NYUUmiPropagationLossModel ()
 }
 
 double
-NYUUmiPropagationLossModel::GetLossLos (double distance2D, double hBs) const
+NYUUmiPropagationLossModel::GetLossLos (double distance2D, double hBs, double frequency) const
 {
   NS_LOG_FUNCTION (this);
 
   double lambda; // wavelength in meters
   double freeSpacePathLoss; // Free Space Path Loss (FSPL)
   double pathLossLos = 0; // Path loss without SF (dB)
-  double ple = GetCalibratedParameter (2, 2, m_frequency); //Path Loss Exponent (UMi LOS)
+  double ple = GetCalibratedParameter (2, 2, frequency); //Path Loss Exponent (UMi LOS)
 
-  lambda = M_C / (m_frequency);
+  lambda = M_C / (frequency);
 
   freeSpacePathLoss = 20 * log10 (4 * M_PI * refdistance / lambda);
 
   pathLossLos = freeSpacePathLoss + 10 * ple * log10 (distance2D);
 
-  NS_LOG_DEBUG ("m_frequency: " << m_frequency << " 2d-distance: " << distance2D
+  NS_LOG_DEBUG ("frequency: " << frequency << " 2d-distance: " << distance2D
                                 << " labmda: " << lambda << " FSPL: " << freeSpacePathLoss
                                 << " pathLossLos: " << pathLossLos
                                 << " scenario:" << "Umi LOS");
@@ -951,22 +1534,22 @@ NYUUmiPropagationLossModel::GetLossLos (double distance2D, double hBs) const
 }
 
 double
-NYUUmiPropagationLossModel::GetLossNlos (double distance2D, double hBs) const
+NYUUmiPropagationLossModel::GetLossNlos (double distance2D, double hBs, double frequency) const
 {
   NS_LOG_FUNCTION (this);
 
   double lambda; // wavelength in meters
   double freeSpacePathLoss; // Free Space Path Loss (FSPL)
   double pathLossNlos = 0; // Path loss without SF (dB)
-  double ple = GetCalibratedParameter (3.2,2.9,m_frequency); //Path Loss Exponent (UMi NLOS)
+  double ple = GetCalibratedParameter (3.2,2.9,frequency); //Path Loss Exponent (UMi NLOS)
 
-  lambda = M_C / (m_frequency);
+  lambda = M_C / (frequency);
 
   freeSpacePathLoss = 20 * log10 (4 * M_PI * refdistance / lambda);
 
   pathLossNlos = freeSpacePathLoss + 10 * ple * log10 (distance2D);
 
-  NS_LOG_DEBUG ("m_frequency: " << m_frequency << " 2d-distance: " << distance2D
+  NS_LOG_DEBUG ("frequency: " << frequency << " 2d-distance: " << distance2D
                                 << " labmda: " << lambda << " FSPL: " << freeSpacePathLoss
                                 << " pathLossNlos: " << pathLossNlos
                                 << " scenario:" << "Umi NLOS");
@@ -975,17 +1558,17 @@ NYUUmiPropagationLossModel::GetLossNlos (double distance2D, double hBs) const
 }
 
 double
-NYUUmiPropagationLossModel::GetShadowingStd (ChannelCondition::LosConditionValue cond) const
+NYUUmiPropagationLossModel::GetShadowingStd (ChannelCondition::LosConditionValue cond, double frequency) const
 {
   NS_LOG_FUNCTION (this);
   double shadowingStd;
   if (cond == ChannelCondition::LosConditionValue::LOS)
     {
-      shadowingStd = GetCalibratedParameter (4.0, 2.6, m_frequency);
+      shadowingStd = GetCalibratedParameter (4.0, 2.6, frequency);
     }
   else if (cond == ChannelCondition::LosConditionValue::NLOS)
     {
-      shadowingStd = GetCalibratedParameter (7.0, 8.2, m_frequency);
+      shadowingStd = GetCalibratedParameter (7.0, 8.2, frequency);
     }
   else
     {
@@ -1041,7 +1624,7 @@ NYUInHPropagationLossModel::~NYUInHPropagationLossModel ()
   NS_LOG_FUNCTION (this);
 }
 double
-NYUInHPropagationLossModel::GetLossLos (double distance2D, double hBs) const
+NYUInHPropagationLossModel::GetLossLos (double distance2D, double hBs, double frequency) const
 {
   NS_LOG_FUNCTION (this);
 
@@ -1051,22 +1634,22 @@ NYUInHPropagationLossModel::GetLossLos (double distance2D, double hBs) const
   double ple = 0;
 
   // Frequency dependent PLE for InH Los
-  if (m_frequency < 28e9)
+  if (frequency < 28e9)
     {
-      ple = m_frequency / 1e9 * (1.2 - 1.8) / (28 - 1) + (28 * 1.8 - 1.2) / 27;
+      ple = frequency / 1e9 * (1.2 - 1.8) / (28 - 1) + (28 * 1.8 - 1.2) / 27;
     }
   else
     {
-      ple = GetCalibratedParameter (1.2, 1.8, m_frequency); //Path Loss Exponent InH LOS
+      ple = GetCalibratedParameter (1.2, 1.8, frequency); //Path Loss Exponent InH LOS
     }
 
-  lambda = M_C / (m_frequency);
+  lambda = M_C / (frequency);
 
   freeSpacePathLoss = 20 * log10 (4 * M_PI * refdistance / lambda);
 
   pathLossLos = freeSpacePathLoss + 10 * ple * log10 (distance2D);
 
-  NS_LOG_DEBUG ("m_frequency: " << m_frequency << " 2d-distance: " << distance2D
+  NS_LOG_DEBUG ("frequency: " << frequency << " 2d-distance: " << distance2D
                                 << " labmda: " << lambda << " FSPL: " << freeSpacePathLoss
                                 << " pathLossLos: " << pathLossLos
                                 << " scenario:" << "InH LOS");
@@ -1074,22 +1657,22 @@ NYUInHPropagationLossModel::GetLossLos (double distance2D, double hBs) const
 }
 
 double
-NYUInHPropagationLossModel::GetLossNlos (double distance2D, double hBs) const
+NYUInHPropagationLossModel::GetLossNlos (double distance2D, double hBs, double frequency) const
 {
   NS_LOG_FUNCTION (this);
 
   double lambda; // wavelength in meters
   double freeSpacePathLoss; // Free Space Path Loss (FSPL)
   double pathLossNlos = 0; // Path loss without SF (dB)
-  double ple = GetCalibratedParameter (2.7, 2.7, m_frequency); //Path Loss Exponent InH NLOS
+  double ple = GetCalibratedParameter (2.7, 2.7, frequency); //Path Loss Exponent InH NLOS
 
-  lambda = M_C / (m_frequency);
+  lambda = M_C / (frequency);
 
   freeSpacePathLoss = 20 * log10 (4 * M_PI * refdistance / lambda);
 
   pathLossNlos = freeSpacePathLoss + 10 * ple * log10 (distance2D);
 
-  NS_LOG_DEBUG ("m_frequency: " << m_frequency << " 2d-distance: " << distance2D
+  NS_LOG_DEBUG ("frequency: " << frequency << " 2d-distance: " << distance2D
                                 << " labmda: " << lambda << " FSPL: " << freeSpacePathLoss
                                 << " pathLossNlos: " << pathLossNlos
                                 << " scenario:" << "InH NLOS");
@@ -1098,17 +1681,17 @@ NYUInHPropagationLossModel::GetLossNlos (double distance2D, double hBs) const
 }
 
 double
-NYUInHPropagationLossModel::GetShadowingStd (ChannelCondition::LosConditionValue cond) const
+NYUInHPropagationLossModel::GetShadowingStd (ChannelCondition::LosConditionValue cond, double frequency) const
 {
   NS_LOG_FUNCTION (this);
   double shadowingStd;
   if (cond == ChannelCondition::LosConditionValue::LOS)
     {
-      shadowingStd = GetCalibratedParameter (3, 2.9, m_frequency);
+      shadowingStd = GetCalibratedParameter (3, 2.9, frequency);
     }
   else if (cond == ChannelCondition::LosConditionValue::NLOS)
     {
-      shadowingStd = GetCalibratedParameter (9.8, 6.6, m_frequency);
+      shadowingStd = GetCalibratedParameter (9.8, 6.6, frequency);
     }
   else
     {
@@ -1163,22 +1746,22 @@ NYUUmaPropagationLossModel::~NYUUmaPropagationLossModel ()
   NS_LOG_FUNCTION (this);
 }
 double
-NYUUmaPropagationLossModel::GetLossLos (double distance2D, double hBs) const
+NYUUmaPropagationLossModel::GetLossLos (double distance2D, double hBs, double frequency) const
 {
   NS_LOG_FUNCTION (this);
 
   double lambda; // wavelength in meters
   double freeSpacePathLoss; // Free Space Path Loss (FSPL)
   double pathLossLos = 0; // Path loss without SF (dB)
-  double ple = GetCalibratedParameter (2, 2, m_frequency); //Path Loss Exponent UMa LOS
+  double ple = GetCalibratedParameter (2, 2, frequency); //Path Loss Exponent UMa LOS
 
-  lambda = M_C / (m_frequency);
+  lambda = M_C / (frequency);
 
   freeSpacePathLoss = 20 * log10 (4 * M_PI * refdistance / lambda);
 
   pathLossLos = freeSpacePathLoss + 10 * ple * log10 (distance2D);
 
-  NS_LOG_DEBUG ("m_frequency: " << m_frequency << " 2d-distance: " << distance2D
+  NS_LOG_DEBUG ("frequency: " << frequency << " 2d-distance: " << distance2D
                                 << " labmda: " << lambda << " FSPL: " << freeSpacePathLoss
                                 << " pathLossLos: " << pathLossLos
                                 << " scenario:" << "Uma LOS");
@@ -1186,22 +1769,22 @@ NYUUmaPropagationLossModel::GetLossLos (double distance2D, double hBs) const
 }
 
 double
-NYUUmaPropagationLossModel::GetLossNlos (double distance2D, double hBs) const
+NYUUmaPropagationLossModel::GetLossNlos (double distance2D, double hBs, double frequency) const
 {
   NS_LOG_FUNCTION (this);
 
   double lambda; // wavelength in meters
   double freeSpacePathLoss; // Free Space Path Loss (FSPL)
   double pathLossNlos = 0; // Path loss without SF (dB)
-  double ple = GetCalibratedParameter (2.9, 2.9, m_frequency); //Path Loss Exponent UMa NLOS
+  double ple = GetCalibratedParameter (2.9, 2.9, frequency); //Path Loss Exponent UMa NLOS
 
-  lambda = M_C / (m_frequency);
+  lambda = M_C / (frequency);
 
   freeSpacePathLoss = 20 * log10 (4 * M_PI * refdistance / lambda);
 
   pathLossNlos = freeSpacePathLoss + 10 * ple * log10 (distance2D);
 
-  NS_LOG_DEBUG ("m_frequency: " << m_frequency << " 2d-distance: " << distance2D
+  NS_LOG_DEBUG ("frequency: " << frequency << " 2d-distance: " << distance2D
                                 << " labmda: " << lambda << " FSPL: " << freeSpacePathLoss
                                 << " pathLossNlos: " << pathLossNlos
                                 << " scenario:" << "Uma NLOS");
@@ -1210,17 +1793,17 @@ NYUUmaPropagationLossModel::GetLossNlos (double distance2D, double hBs) const
 }
 
 double
-NYUUmaPropagationLossModel::GetShadowingStd (ChannelCondition::LosConditionValue cond) const
+NYUUmaPropagationLossModel::GetShadowingStd (ChannelCondition::LosConditionValue cond, double frequency) const
 {
   NS_LOG_FUNCTION (this);
   double shadowingStd;
   if (cond == ChannelCondition::LosConditionValue::LOS)
     {
-      shadowingStd = GetCalibratedParameter (4.0, 2.6, m_frequency);
+      shadowingStd = GetCalibratedParameter (4.0, 2.6, frequency);
     }
   else if (cond == ChannelCondition::LosConditionValue::NLOS)
     {
-      shadowingStd = GetCalibratedParameter (7.0, 8.2, m_frequency);
+      shadowingStd = GetCalibratedParameter (7.0, 8.2, frequency);
     }
   else
     {
@@ -1275,7 +1858,7 @@ NYURmaPropagationLossModel::~NYURmaPropagationLossModel ()
   NS_LOG_FUNCTION (this);
 }
 double
-NYURmaPropagationLossModel::GetLossLos (double distance2D, double hBs) const
+NYURmaPropagationLossModel::GetLossLos (double distance2D, double hBs, double frequency) const
 {
   NS_LOG_FUNCTION (this);
 
@@ -1283,13 +1866,13 @@ NYURmaPropagationLossModel::GetLossLos (double distance2D, double hBs) const
   double freeSpacePathLoss; // Free Space Path Loss (FSPL)
   double pathLossLos = 0; // Path loss without SF (dB)
 
-  lambda = M_C / (m_frequency);
+  lambda = M_C / (frequency);
 
   freeSpacePathLoss = 20 * log10 (4 * M_PI * refdistance / lambda);
 
   pathLossLos = freeSpacePathLoss + 23.1 * (1 - 0.03 * ((hBs - 35) / 35)) * log10 (distance2D);
 
-  NS_LOG_DEBUG ("m_frequency: " << m_frequency << " 2d-distance: " << distance2D
+  NS_LOG_DEBUG ("frequency: " << frequency << " 2d-distance: " << distance2D
                                 << " labmda: " << lambda << " FSPL: " << freeSpacePathLoss
                                 << " pathLossLos: " << pathLossLos
                                 << " scenario:" << "Rma LOS");
@@ -1297,7 +1880,7 @@ NYURmaPropagationLossModel::GetLossLos (double distance2D, double hBs) const
 }
 
 double
-NYURmaPropagationLossModel::GetLossNlos (double distance2D, double hBs) const
+NYURmaPropagationLossModel::GetLossNlos (double distance2D, double hBs, double frequency) const
 {
   NS_LOG_FUNCTION (this);
 
@@ -1305,13 +1888,13 @@ NYURmaPropagationLossModel::GetLossNlos (double distance2D, double hBs) const
   double freeSpacePathLoss; // Free Space Path Loss (FSPL)
   double pathLossNlos = 0; // Path loss without SF (dB)
 
-  lambda = M_C / (m_frequency);
+  lambda = M_C / (frequency);
 
   freeSpacePathLoss = 20 * log10 (4 * M_PI * refdistance / lambda);
 
   pathLossNlos = freeSpacePathLoss + 30.7 * (1 - 0.049 * ((hBs - 35) / 35)) * log10 (distance2D);
 
-  NS_LOG_DEBUG ("m_frequency: " << m_frequency << " 2d-distance: " << distance2D
+  NS_LOG_DEBUG ("frequency: " << frequency << " 2d-distance: " << distance2D
                                 << " labmda: " << lambda << " FSPL: " << freeSpacePathLoss
                                 << " pathLossNlos: " << pathLossNlos
                                 << " scenario:" << "Rma NLOS");
@@ -1320,17 +1903,17 @@ NYURmaPropagationLossModel::GetLossNlos (double distance2D, double hBs) const
 }
 
 double
-NYURmaPropagationLossModel::GetShadowingStd (ChannelCondition::LosConditionValue cond) const
+NYURmaPropagationLossModel::GetShadowingStd (ChannelCondition::LosConditionValue cond, double frequency) const
 {
   NS_LOG_FUNCTION (this);
   double shadowingStd;
   if (cond == ChannelCondition::LosConditionValue::LOS)
     {
-      shadowingStd = GetCalibratedParameter (1.7, 1.7, m_frequency);
+      shadowingStd = GetCalibratedParameter (1.7, 1.7, frequency);
     }
   else if (cond == ChannelCondition::LosConditionValue::NLOS)
     {
-      shadowingStd = GetCalibratedParameter (6.7, 6.7, m_frequency);
+      shadowingStd = GetCalibratedParameter (6.7, 6.7, frequency);
     }
   else
     {
@@ -1387,22 +1970,22 @@ NYUInFPropagationLossModel::~NYUInFPropagationLossModel ()
 }
 
 double
-NYUInFPropagationLossModel::GetLossLos (double distance2D, double hBs) const
+NYUInFPropagationLossModel::GetLossLos (double distance2D, double hBs, double frequency) const
 {
   NS_LOG_FUNCTION (this);
 
   double lambda; // wavelength in meters
   double freeSpacePathLoss; // Free Space Path Loss (FSPL)
   double pathLossLos = 0; // Path loss without SF (dB)
-  double ple = GetCalibratedParameter (1.7, 1.7, m_frequency); //Path Loss Exponent InF LOS
+  double ple = GetCalibratedParameter (1.7, 1.7, frequency); //Path Loss Exponent InF LOS
 
-  lambda = M_C / (m_frequency);
+  lambda = M_C / (frequency);
 
   freeSpacePathLoss = 20 * log10 (4 * M_PI * refdistance / lambda);
 
   pathLossLos = freeSpacePathLoss + 10 * ple * log10 (distance2D);
 
-  NS_LOG_DEBUG ("m_frequency: " << m_frequency << " 2d-distance: " << distance2D
+  NS_LOG_DEBUG ("frequency: " << frequency << " 2d-distance: " << distance2D
                                 << " labmda: " << lambda << " FSPL: " << freeSpacePathLoss
                                 << " pathLossLos: " << pathLossLos
                                 << " scenario:" << "InF LOS");
@@ -1410,22 +1993,22 @@ NYUInFPropagationLossModel::GetLossLos (double distance2D, double hBs) const
 }
 
 double
-NYUInFPropagationLossModel::GetLossNlos (double distance2D, double hBs) const
+NYUInFPropagationLossModel::GetLossNlos (double distance2D, double hBs, double frequency) const
 {
   NS_LOG_FUNCTION (this);
 
   double lambda; // wavelength in meters
   double freeSpacePathLoss; // Free Space Path Loss (FSPL)
   double pathLossNlos = 0; // Path loss without SF (dB)
-  double ple = GetCalibratedParameter (3.1, 3.1, m_frequency); //Path Loss Exponent InF NLOS
+  double ple = GetCalibratedParameter (3.1, 3.1, frequency); //Path Loss Exponent InF NLOS
 
-  lambda = M_C / (m_frequency);
+  lambda = M_C / (frequency);
 
   freeSpacePathLoss = 20 * log10 (4 * M_PI * refdistance / lambda);
 
   pathLossNlos = freeSpacePathLoss + 10 * ple * log10 (distance2D);
 
-  NS_LOG_DEBUG ("m_frequency: " << m_frequency << " 2d-distance: " << distance2D
+  NS_LOG_DEBUG ("frequency: " << frequency << " 2d-distance: " << distance2D
                                 << " labmda: " << lambda << " FSPL: " << freeSpacePathLoss
                                 << " pathLossNlos: " << pathLossNlos
                                 << " scenario:" << "InF NLOS");
@@ -1434,17 +2017,17 @@ NYUInFPropagationLossModel::GetLossNlos (double distance2D, double hBs) const
 }
 
 double
-NYUInFPropagationLossModel::GetShadowingStd (ChannelCondition::LosConditionValue cond) const
+NYUInFPropagationLossModel::GetShadowingStd (ChannelCondition::LosConditionValue cond, double frequency) const
 {
   NS_LOG_FUNCTION (this);
   double shadowingStd;
   if (cond == ChannelCondition::LosConditionValue::LOS)
     {
-      shadowingStd = GetCalibratedParameter (3.0, 3.0, m_frequency);
+      shadowingStd = GetCalibratedParameter (3.0, 3.0, frequency);
     }
   else if (cond == ChannelCondition::LosConditionValue::NLOS)
     {
-      shadowingStd = GetCalibratedParameter (7.0, 7.0, m_frequency);
+      shadowingStd = GetCalibratedParameter (7.0, 7.0, frequency);
     }
   else
     {
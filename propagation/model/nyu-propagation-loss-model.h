@@ -29,10 +29,179 @@
 
 #include "ns3/propagation-loss-model.h"
 #include "ns3/nyu-channel-condition-model.h"
+#include "ns3/nyu-checkpoint.h"
 #include "ns3/string.h"
+#include "ns3/nstime.h"
+
+#include <unordered_map>
+#include <vector>
 
 namespace ns3 {
 
+/**
+ * \ingroup propagation
+ *
+ * \brief Large-scale link state shared by the NYU propagation loss models of
+ * several component carriers
+ *
+ * With intra-band carrier aggregation the shadowing, the LOS/NLOS and O2I
+ * condition and the random part of the O2I and foliage losses are common to
+ * all the carriers of a link. A NYUPropagationLossModel that points to a
+ * NYULargeScaleState (attribute "LargeScaleState") takes these quantities from
+ * it, and computes only the frequency-dependent terms (path loss, calibrated
+ * shadowing standard deviation, O2I mean and atmospheric loss) on its own.
+ *
+ * The shadowing is stored as a unit-variance correlated process that each
+ * carrier scales by its own standard deviation. The O2I and foliage draws are
+ * renewed once per link and simulation time instant, so that all the carriers
+ * evaluated at the same time see the same realization.
+ */
+class NYULargeScaleState : public Object
+{
+public:
+  /**
+   * \brief Get the type ID.
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId(void);
+
+  /**
+   * Constructor
+   */
+  NYULargeScaleState();
+
+  /**
+   * Destructor
+   */
+  ~NYULargeScaleState() override;
+
+  /**
+   * \brief Set the channel condition model shared by the carriers
+   * \param model pointer to the channel condition model
+   */
+  void SetChannelConditionModel(Ptr<ChannelConditionModel> model);
+
+  /**
+   * \brief Returns the channel condition model shared by the carriers
+   * \return the channel condition model, or nullptr if not set yet
+   */
+  Ptr<ChannelConditionModel> GetChannelConditionModel(void) const;
+
+  /**
+   * \brief Returns the unit-variance shadowing of a link. The value is
+   *        correlated with the previous one according to the displacement,
+   *        as in NYUPropagationLossModel, and regenerated when the channel
+   *        condition changes.
+   * \param key the reciprocal key of the link
+   * \param distance the vector difference between the two nodes
+   * \param cond the LOS/NLOS channel condition
+   * \param correlationDistance the shadowing correlation distance in meters
+   * \return the unit-variance shadowing
+   */
+  double GetNormalizedShadowing(uint32_t key,
+                                const Vector &distance,
+                                ChannelCondition::LosConditionValue cond,
+                                double correlationDistance);
+
+  /**
+   * \brief Returns the standard normal draw of the O2I loss of a link
+   * \param key the reciprocal key of the link
+   * \return the standard normal draw
+   */
+  double GetO2iDraw(uint32_t key);
+
+  /**
+   * \brief Returns the uniform draw in [0, 1) of the foliage loss of a link
+   * \param key the reciprocal key of the link
+   * \return the uniform draw
+   */
+  double GetFoliageDraw(uint32_t key);
+
+  /**
+   * \brief Returns the unit-variance shadowing of a link stored by the last
+   *        call to GetNormalizedShadowing, without generating a new one
+   * \param key the reciprocal key of the link
+   * \param cond the LOS/NLOS channel condition
+   * \param shadowing set to the unit-variance shadowing
+   * \return false if the shadowing of the link has not been generated for
+   *         the given condition
+   */
+  bool GetStoredShadowing(uint32_t key,
+                          ChannelCondition::LosConditionValue cond,
+                          double &shadowing) const;
+
+  /**
+   * \brief Returns the number of links with a stored state
+   * \return the number of links
+   */
+  size_t GetNumLinks(void) const;
+
+  /**
+   * \brief Assign a fixed random variable stream number to the random variables used by this object.
+   * \param stream first stream index to use
+   * \return the number of stream indices assigned
+   */
+  int64_t AssignStreams(int64_t stream);
+
+  /**
+   * \brief Appends the state of the links to a checkpoint, see NYUCheckpoint
+   * \param buffer the buffer
+   * \param full if false, only the links changed since the previous checkpoint are written
+   */
+  void SaveCheckpoint(std::vector<uint8_t> &buffer, bool full);
+
+  /**
+   * \brief Restores the state of the links from a buffer written by SaveCheckpoint
+   * \param buffer the buffer
+   */
+  void RestoreCheckpoint(const std::vector<uint8_t> &buffer);
+
+protected:
+  void DoDispose() override;
+
+private:
+  /** Define a struct for the m_links entries */
+  struct LinkItem
+  {
+    double m_shadowing {0.0}; //!< the unit-variance shadowing
+    bool m_hasShadowing {false}; //!< true once the shadowing has been generated
+    ChannelCondition::LosConditionValue m_condition {ChannelCondition::LC_ND}; //!< the LOS/NLOS condition of m_shadowing
+    Vector m_distance; //!< the vector AB when m_shadowing was generated
+    Time m_drawTime; //!< the time of m_o2iDraw and m_foliageDraw
+    double m_o2iDraw {0.0}; //!< standard normal draw of the O2I loss
+    double m_foliageDraw {0.0}; //!< uniform draw of the foliage loss
+  };
+
+  /**
+   * \brief Returns the entry of a link, renewing the per-instant draws if
+   *        they were taken at an earlier simulation time
+   * \param key the reciprocal key of the link
+   * \return the entry of the link
+   */
+  LinkItem &GetLinkItem(uint32_t key);
+
+  /**
+   * \brief Appends the bytes of a link entry to a checkpoint buffer
+   * \param item the entry
+   * \param buffer the buffer
+   */
+  static void PackLinkItem(const LinkItem &item, std::vector<uint8_t> &buffer);
+
+  /**
+   * \brief Reads a link entry written by PackLinkItem
+   * \param buffer the buffer
+   * \param offset the position of the entry, moved after it
+   * \param item set to the entry
+   */
+  static void UnpackLinkItem(const std::vector<uint8_t> &buffer, size_t &offset, LinkItem &item);
+
+  Ptr<ChannelConditionModel> m_channelConditionModel; //!< the shared channel condition model
+  NYUCheckpointRandomVariable<UniformRandomVariable> m_uniformVar; //!< uniform random variable
+  NYUCheckpointRandomVariable<NormalRandomVariable> m_normRandomVariable; //!< normal random variable
+  std::unordered_map<uint32_t, LinkItem> m_links; //!< the state of each link
+  NYUCheckpointTracker m_checkpointTracker; //!< the entries of m_links written to the checkpoints
+};
+
 /**
  * \ingroup propagation
  *
@@ -75,6 +244,35 @@ public:
    */
   Ptr<ChannelConditionModel> GetChannelConditionModel(void) const;
 
+  /**
+   * \brief Set the large-scale state shared with the models of the other
+   *        component carriers
+   * \param state pointer to the shared state, or nullptr to keep the state local
+   */
+  void SetLargeScaleState(Ptr<NYULargeScaleState> state);
+
+  /**
+   * \brief Returns the shared large-scale state
+   * \return the shared state, or nullptr if the state is local
+   */
+  Ptr<NYULargeScaleState> GetLargeScaleState(void) const;
+
+  /**
+   * \brief Appends the state of the model to a checkpoint, see NYUCheckpoint.
+   *        The channel condition model and the NYULargeScaleState are shared
+   *        by several models, they are added to the checkpoint on their own.
+   * \param buffer the buffer
+   * \param full if false, only the shadowing values changed since the
+   *        previous checkpoint are written
+   */
+  void SaveCheckpoint(std::vector<uint8_t> &buffer, bool full);
+
+  /**
+   * \brief Restores the state of the model from a buffer written by SaveCheckpoint
+   * \param buffer the buffer
+   */
+  void RestoreCheckpoint(const std::vector<uint8_t> &buffer);
+
   /**
    * \brief Set the central frequency of the model
    * \param frequency the central frequency in the range in Hz, between 500.0e6 and 100.0e9 Hz
@@ -170,6 +368,45 @@ public:
                                           double temperature,
                                           double rainRate) const;
 
+  /**
+   * \brief the atmospheric attenuation factors in dB/m at a set of frequencies.
+   *        The terms that depend only on the weather are computed once for the
+   *        whole set
+   * \param frequencies the frequencies in Hz
+   * \param pressure the atmospheric pressure in mbar
+   * \param humidity the humidity in percentage
+   * \param temperature the temperature in celcius
+   * \param rainRate the rain rate in mm/hr
+   * \return the atmoshperic attenuation factor at each frequency
+   */
+  std::vector<double> GetAtmoshperticAttenuationFactors(const std::vector<double> &frequencies,
+                                                        double pressure,
+                                                        double humidity,
+                                                        double temperature,
+                                                        double rainRate) const;
+
+  /**
+   * \brief Computes the received power of a link at a set of frequencies.
+   *        The channel condition, the geometry and the random terms (shadowing,
+   *        O2I and foliage draws) are evaluated once, and only the
+   *        frequency-dependent scaling of each term is recomputed for each
+   *        frequency, as in NYUSIM frequency sweeps.
+   *
+   * The sweep does not draw random numbers and does not change the state of
+   * the model or of the channel condition model: the channel condition and
+   * the random terms are the ones stored by the last CalcRxPower of the link,
+   * which must have been called before.
+   * \param txPowerDbm tx power in dBm
+   * \param a tx mobility model
+   * \param b rx mobility model
+   * \param frequencies the frequencies in Hz, between 0.5 GHz and 150 GHz
+   * \return the rx power in dBm at each frequency
+   */
+  std::vector<double> CalcRxPowerSweep(double txPowerDbm,
+                                       Ptr<MobilityModel> a,
+                                       Ptr<MobilityModel> b,
+                                       const std::vector<double> &frequencies) const;
+
   /**
    * \brief the saturation pressure depednds on temperature and ice
    * \param temperature the temperature in celcius
@@ -186,16 +423,6 @@ public:
    */
   double GetH2oPermittivity(double v, bool ice) const;
 
-  /**
-   * \brief calculates the attenuation factor due to oxygen in atmosphere
-   * \param freqGHz the frequency of operation in GHz
-   * \param v the reciprocal of temperature in Kelvins
-   * \param pd the partial pressure for dry air in mbar
-   * \param e the partial pressure for water vapor (mb)
-   * \return the attenuation factor due to oxygen
-   */
-  double GetO2Lines(double freqGHz, double v, double pd, double e) const;
-  
   /**
    * \brief calculates the attenuation factor due to dry air in atmosphere
    * \param freqGHz the frequency of operation in GHz
@@ -206,16 +433,6 @@ public:
    */
   double GetDryCont(double freqGHz, double v, double pd, double e) const;
 
-  /**
-   * \brief calculates the attenuation factor due to water vapor in atmosphere
-   * \param freqGHz the frequency of operation in GHz
-   * \param v the reciprocal of temperature in Kelvins
-   * \param pd the partial pressure for dry air in mbar
-   * \param e the partial pressure for water vapor (mb)
-   * \return the attenuation factor due to dry air
-   */
-  double GetH2oVapor(double freqGHz, double v, double pd, double e) const;
-  
   /**
    * \brief calculates the attenuation factor due to liquid water in atmosphere
    * \param freqGHz the frequency of operation in GHz
@@ -266,6 +483,15 @@ public:
    */
   double GetO2IPathLoss(const std::string &o2ilosstype, double frequency) const;
 
+  /**
+   * \brief Find Path Loss due to Outdoor to Indoor (O2I) penetration for a given random draw
+   * \param o2iLossType the O2I Loss Type - High Loss or Low Loss
+   * \param frequency the central frequency of operation
+   * \param normalDraw the standard normal draw of the link
+   * \return the pathloss value in dB
+   */
+  double GetO2IPathLoss(const std::string &o2ilosstype, double frequency, double normalDraw) const;
+
   /**
    * \brief Find Path Loss due to Foliage Loss
    * \param distance2D the 2D distance between Tx and Rx
@@ -273,6 +499,14 @@ public:
    */
   double GetFoliagePathLoss(double distance2D) const;
 
+  /**
+   * \brief Find Path Loss due to Foliage Loss for a given random draw
+   * \param distance2D the 2D distance between Tx and Rx
+   * \param uniformDraw the uniform draw in [0, 1) of the link
+   * \return the pathloss value in dB
+   */
+  double GetFoliagePathLoss(double distance2D, double uniformDraw) const;
+
   /**
    * \brief Calibrate Parameters for frequncy range 0.5 GHz - 150 GHz
    * \param ple1 value at 28 GHz
@@ -305,31 +539,37 @@ private:
    * \param cond the channel condition
    * \param distance2D the 2D distance between Tx and Rx
    * \param hBs the height of the BS in meters
+   * \param frequency the frequency in Hz
    * \return pathloss value in dB
    */
   double GetLoss(Ptr<ChannelCondition> cond,
                  double distance2D,
-                 double hBs) const;
+                 double hBs,
+                 double frequency) const;
 
   /**
    * \brief Computes the pathloss between a and b considering that the line of
    *        sight is not obstructed
    * \param distance2D the 2D distance between Tx and Rx
    * \param hBs the height of the BS in meters
+   * \param frequency the frequency in Hz
    * \return pathloss value in dB
    */
   virtual double GetLossLos(double distance2D,
-                            double hBs) const = 0;
+                            double hBs,
+                            double frequency) const = 0;
 
   /**
    * \brief Computes the pathloss between a and b considering that the line of
    *        sight is obstructed
    * \param distance2D the 2D distance between Tx and Rx
    * \param hBs the height of the BS in meters
+   * \param frequency the frequency in Hz
    * \return pathloss value in dB
    */
   virtual double GetLossNlos(double distance2D,
-                             double hBs) const = 0;
+                             double hBs,
+                             double frequency) const = 0;
 
   /**
    * \brief Determines hUT and hBS. The default implementation assumes that
@@ -361,9 +601,10 @@ private:
    * \param a tx mobility model
    * \param b rx mobility model
    * \param cond the LOS/NLOS channel condition
+   * \param frequency the frequency in Hz
    * \return shadowing std in dB
    */
-  virtual double GetShadowingStd(ChannelCondition::LosConditionValue cond) const = 0;
+  virtual double GetShadowingStd(ChannelCondition::LosConditionValue cond, double frequency) const = 0;
 
   /**
    * \brief Returns the shadow fading correlation distance
@@ -419,8 +660,11 @@ protected:
   bool m_shadowingEnabled; //!< enable/disable shadowing
   bool m_foilageLossEnabled; //!< enable/disable foliage loss
   bool m_atmosphericLossEnabled; //!< enable/disable atmospheric loss
-  Ptr<UniformRandomVariable> m_uniformVar; //!< uniform random variable
-  Ptr<NormalRandomVariable> m_normRandomVariable; //!< normal random variable
+  NYUCheckpointRandomVariable<UniformRandomVariable> m_uniformVar; //!< uniform random variable
+  NYUCheckpointRandomVariable<NormalRandomVariable> m_normRandomVariable; //!< normal random variable
+  Ptr<NYULargeScaleState> m_largeScaleState; //!< large-scale state shared across component carriers
+  mutable double m_atmosphericAttenuationFactor; //!< cached atmospheric attenuation factor in dB/m
+  mutable bool m_atmosphericAttenuationFactorValid; //!< true if m_atmosphericAttenuationFactor is up to date
 
   /** Define a struct for the m_shadowingMap entries */
   struct ShadowingMapItem
@@ -432,6 +676,50 @@ protected:
 
   mutable std::unordered_map<uint32_t, ShadowingMapItem>
   m_shadowingMap;//!< map to store the shadowing values
+  NYUCheckpointTracker m_checkpointTracker; //!< the entries of m_shadowingMap written to the checkpoints
+
+  /** Define a struct for the m_linkMap entries */
+  struct LinkMapItem
+  {
+    ChannelCondition::LosConditionValue m_losCondition; //!< the LOS/NLOS condition
+    ChannelCondition::O2iConditionValue m_o2iCondition; //!< the O2I/O2O condition
+    double m_o2iDraw; //!< the standard normal draw of the O2I loss
+    double m_foliageDraw; //!< the uniform draw in [0, 1) of the foliage loss
+  };
+
+  mutable std::unordered_map<uint32_t, LinkMapItem>
+  m_linkMap;//!< map to store the condition and the draws of the last CalcRxPower of each link, read by CalcRxPowerSweep
+  NYUCheckpointTracker m_linkCheckpointTracker; //!< the entries of m_linkMap written to the checkpoints
+
+  /**
+   * \brief Appends the bytes of a shadowing entry to a checkpoint buffer
+   * \param item the entry
+   * \param buffer the buffer
+   */
+  static void PackShadowingMapItem(const ShadowingMapItem &item, std::vector<uint8_t> &buffer);
+
+  /**
+   * \brief Reads a shadowing entry written by PackShadowingMapItem
+   * \param buffer the buffer
+   * \param offset the position of the entry, moved after it
+   * \param item set to the entry
+   */
+  static void UnpackShadowingMapItem(const std::vector<uint8_t> &buffer, size_t &offset, ShadowingMapItem &item);
+
+  /**
+   * \brief Appends the bytes of a link entry to a checkpoint buffer
+   * \param item the entry
+   * \param buffer the buffer
+   */
+  static void PackLinkMapItem(const LinkMapItem &item, std::vector<uint8_t> &buffer);
+
+  /**
+   * \brief Reads a link entry written by PackLinkMapItem
+   * \param buffer the buffer
+   * \param offset the position of the entry, moved after it
+   * \param item set to the entry
+   */
+  static void UnpackLinkMapItem(const std::vector<uint8_t> &buffer, size_t &offset, LinkMapItem &item);
 };
 
 /**
@@ -469,27 +757,30 @@ private:
    *        sight is not obstructed
    * \param distance2D the 2D distance between Tx and Rx
    * \param hBs the height of the BS in meters
+   * \param frequency the frequency in Hz
    * \return pathloss value in dB
    */
-  double GetLossLos(double distance2D, double hBs) const override;
+  double GetLossLos(double distance2D, double hBs, double frequency) const override;
 
   /**
    * \brief Computes the pathloss between a and b considering that the line of
    *        sight is obstructed
    * \param distance2D the 2D distance between Tx and Rx
    * \param hBs the height of the BS in meters
+   * \param frequency the frequency in Hz
    * \return pathloss value in dB
    */
-  double GetLossNlos(double distance2D, double hBs) const override;
+  double GetLossNlos(double distance2D, double hBs, double frequency) const override;
 
   /**
    * \brief Returns the shadow fading standard deviation
    * \param a tx mobility model
    * \param b rx mobility model
    * \param cond the LOS/NLOS channel condition
+   * \param frequency the frequency in Hz
    * \return shadowing std in dB
    */
-  double GetShadowingStd(ChannelCondition::LosConditionValue cond) const override;
+  double GetShadowingStd(ChannelCondition::LosConditionValue cond, double frequency) const override;
 
   /**
         * \brief Returns the shadow fading correlation distance
@@ -535,27 +826,30 @@ private:
    *        sight is not obstructed
    * \param distance2D the 2D distance between Tx and Rx
    * \param hBs the height of the BS in meters
+   * \param frequency the frequency in Hz
    * \return pathloss value in dB
    */
-  double GetLossLos(double distance2D, double hBs) const override;
+  double GetLossLos(double distance2D, double hBs, double frequency) const override;
 
   /**
    * \brief Computes the pathloss between a and b considering that the line of
    *        sight is obstructed.
    * \param distance2D the 2D distance between Tx and Rx
    * \param hBs the height of the BS in meters
+   * \param frequency the frequency in Hz
    * \return pathloss value in dB
    */
-  double GetLossNlos(double distance2D,double hBs) const override;
+  double GetLossNlos(double distance2D, double hBs, double frequency) const override;
 
   /**
    * \brief Returns the shadow fading standard deviation
    * \param a tx mobility model
    * \param b rx mobility model
    * \param cond the LOS/NLOS channel condition
+   * \param frequency the frequency in Hz
    * \return shadowing std in dB
    */
-  double GetShadowingStd(ChannelCondition::LosConditionValue cond) const override;
+  double GetShadowingStd(ChannelCondition::LosConditionValue cond, double frequency) const override;
 
   /**
    * \brief Returns the shadow fading correlation distance
@@ -600,27 +894,30 @@ private:
    *        sight is not obstructed
    * \param distance2D the 3D distance between tx and rx in meters
    * \param hBs the height of the BS in meters
+   * \param frequency the frequency in Hz
    * \return pathloss value in dB
    */
-  double GetLossLos (double distance2D, double hBs) const override;
+  double GetLossLos(double distance2D, double hBs, double frequency) const override;
 
   /**
    * \brief Computes the pathloss between a and b considering that the line of
    *        sight is obstructed
    * \param distance2D the 2D distance between Tx and Rx
    * \param hBs the height of the BS in meters
+   * \param frequency the frequency in Hz
    * \return pathloss value in dB
    */
-  double GetLossNlos(double distance2D, double hBs) const override;
+  double GetLossNlos(double distance2D, double hBs, double frequency) const override;
 
   /**
    * \brief Returns the shadow fading standard deviation
    * \param a tx mobility model
    * \param b rx mobility model
    * \param cond the LOS/NLOS channel condition
+   * \param frequency the frequency in Hz
    * \return shadowing std in dB
    */
-  double GetShadowingStd (ChannelCondition::LosConditionValue cond) const override;
+  double GetShadowingStd(ChannelCondition::LosConditionValue cond, double frequency) const override;
 
   /**
    * \brief Returns the shadow fading correlation distance
@@ -665,27 +962,30 @@ private:
    *        sight is not obstructed
    * \param distance2D the 2D distance between Tx and Rx
    * \param hBs the height of the BS in meters
+   * \param frequency the frequency in Hz
    * \return pathloss value in dB
    */
-  double GetLossLos(double distance2D, double hBs) const override;
+  double GetLossLos(double distance2D, double hBs, double frequency) const override;
 
   /**
    * \brief Computes the pathloss between a and b considering that the line of
    *        sight is obstructed
    * \param distance2D the 2D distance between Tx and Rx
    * \param hBs the height of the BS in meters
+   * \param frequency the frequency in Hz
    * \return pathloss value in dB
    */
-  double GetLossNlos(double distance2D, double hBs) const override;
+  double GetLossNlos(double distance2D, double hBs, double frequency) const override;
 
   /**
    * \brief Returns the shadow fading standard deviation
    * \param a tx mobility model
    * \param b rx mobility model
    * \param cond the LOS/NLOS channel condition
+   * \param frequency the frequency in Hz
    * \return shadowing std in dB
    */
-  double GetShadowingStd (ChannelCondition::LosConditionValue cond) const override;
+  double GetShadowingStd(ChannelCondition::LosConditionValue cond, double frequency) const override;
 
   /**
    * \brief Returns the shadow fading correlation distance
@@ -730,27 +1030,30 @@ private:
    *        sight is not obstructed
    * \param distance2D the 2D distance between Tx and Rx
    * \param hBs the height of the BS in meters
+   * \param frequency the frequency in Hz
    * \return pathloss value in dB
    */
-  double GetLossLos(double distance2D, double hBs) const override;
+  double GetLossLos(double distance2D, double hBs, double frequency) const override;
 
   /**
    * \brief Computes the pathloss between a and b considering that the line of
    *        sight is obstructed
    * \param distance2D the 2D distance between Tx and Rx
    * \param hBs the height of the BS in meters
+   * \param frequency the frequency in Hz
    * \return pathloss value in dB
    */
-  double GetLossNlos(double distance2D, double hBs) const override;
+  double GetLossNlos(double distance2D, double hBs, double frequency) const override;
 
   /**
    * \brief Returns the shadow fading standard deviation
    * \param a tx mobility model
    * \param b rx mobility model
    * \param cond the LOS/NLOS channel condition
+   * \param frequency the frequency in Hz
    * \return shadowing std in dB
    */
-  double GetShadowingStd (ChannelCondition::LosConditionValue cond) const override;
+  double GetShadowingStd(ChannelCondition::LosConditionValue cond, double frequency) const override;
 
   /**
    * \brief Returns the shadow fading correlation distance
@@ -0,0 +1,326 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS
+*	publications regarding this work.
+*
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+/**
+ * This example checks that a simulation resumed from an NYUCheckpoint
+ * continues as the uninterrupted one. A tx node with a uniform planar array
+ * is connected to a set of moving rx nodes, and the received power (path loss,
+ * shadowing and beamforming gain) of each link is sampled every samplePeriod,
+ * with the channels updated every updatePeriod. The same scenario is run three
+ * times:
+ * 1. with periodic checkpoints, stopped at crashTime as if it crashed;
+ * 2. restored from the last checkpoint of the first run and continued until simTime;
+ * 3. from the beginning until simTime, without checkpoints.
+ * The program prints the largest difference between the received powers of
+ * the second and the third run after the restore, which is zero if the
+ * checkpoint holds the whole state of the NYU models, including the position
+ * of their random variables. The long term components cached by the
+ * NYUSpectrumPropagationLossModel are not checkpointed: they are computed
+ * again from the restored channel matrices, with the same values.
+ */
+
+#include "ns3/constant-velocity-mobility-model.h"
+#include "ns3/core-module.h"
+#include "ns3/lte-spectrum-value-helper.h"
+#include "ns3/node-container.h"
+#include "ns3/node.h"
+#include "ns3/nyu-channel-condition-model.h"
+#include "ns3/nyu-channel-model.h"
+#include "ns3/nyu-checkpoint.h"
+#include "ns3/nyu-propagation-loss-model.h"
+#include "ns3/nyu-spectrum-propagation-loss-model.h"
+#include "ns3/spectrum-signal-parameters.h"
+#include "ns3/uniform-planar-array.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+NS_LOG_COMPONENT_DEFINE("NYUCheckpointResume");
+
+using namespace ns3;
+
+/// the received power of each link at each sample time, in dBm
+typedef std::map<std::pair<int64_t, uint32_t>, double> RxPowerSamples;
+
+/**
+ * The NYU models and the nodes of a run
+ */
+struct NyuResumeScenario
+{
+    Ptr<NYUChannelConditionModel> conditionModel;              //!< the channel condition model
+    Ptr<NYUPropagationLossModel> propagationLossModel;         //!< the propagation loss model
+    Ptr<NYUChannelModel> channelModel;                         //!< the channel model
+    Ptr<NYUSpectrumPropagationLossModel> spectrumLossModel;    //!< the spectrum loss model
+    Ptr<NYUCheckpoint> checkpoint;                             //!< the checkpoint of the models
+    NodeContainer nodes;                                       //!< the tx node and the rx nodes
+    std::vector<Ptr<PhasedArrayModel>> antennas;               //!< the arrays of the nodes
+    Ptr<SpectrumSignalParameters> txParams;                    //!< the transmitted signal
+    RxPowerSamples samples;                                    //!< the received powers
+};
+
+/**
+ * Compute the DFT beamforming vector of an antenna array towards a direction
+ * \param antenna the antenna array
+ * \param direction the direction of the beam
+ * \return the beamforming vector
+ */
+static PhasedArrayModel::ComplexVector
+GetDftBeam(Ptr<PhasedArrayModel> antenna, Angles direction)
+{
+    uint64_t totNoArrayElements = antenna->GetNumberOfElements();
+    PhasedArrayModel::ComplexVector antennaWeights(totNoArrayElements);
+    double power = 1.0 / sqrt(totNoArrayElements);
+    for (uint64_t ind = 0; ind < totNoArrayElements; ind++)
+    {
+        Vector loc = antenna->GetElementLocation(ind);
+        double phase = -2 * M_PI *
+                       (sin(direction.GetInclination()) * cos(direction.GetAzimuth()) * loc.x +
+                        sin(direction.GetInclination()) * sin(direction.GetAzimuth()) * loc.y +
+                        cos(direction.GetInclination()) * loc.z);
+        antennaWeights[ind] = exp(std::complex<double>(0, phase)) * power;
+    }
+    return antennaWeights;
+}
+
+/**
+ * Build the scenario, with the same random streams and node positions in every run
+ * \param numUes the number of rx nodes
+ * \param updatePeriod the channel update period
+ * \param fileName the name of the checkpoint file
+ * \param scenario the scenario to fill
+ */
+static void
+BuildScenario(uint32_t numUes,
+              Time updatePeriod,
+              std::string fileName,
+              NyuResumeScenario& scenario)
+{
+    double frequency = 28.0e9;
+
+    scenario.conditionModel = CreateObject<NYUUmiChannelConditionModel>();
+    scenario.conditionModel->AssignStreams(0);
+    scenario.propagationLossModel = CreateObject<NYUUmiPropagationLossModel>();
+    scenario.propagationLossModel->SetAttribute("Frequency", DoubleValue(frequency));
+    scenario.propagationLossModel->SetAttribute("ChannelConditionModel",
+                                                PointerValue(scenario.conditionModel));
+    scenario.propagationLossModel->AssignStreams(10);
+    scenario.channelModel = CreateObject<NYUChannelModel>();
+    scenario.channelModel->SetAttribute("Frequency", DoubleValue(frequency));
+    scenario.channelModel->SetAttribute("Scenario", StringValue("Umi"));
+    scenario.channelModel->SetAttribute("ChannelConditionModel",
+                                        PointerValue(scenario.conditionModel));
+    scenario.channelModel->SetAttribute("UpdatePeriod", TimeValue(updatePeriod));
+    scenario.channelModel->AssignStreams(100);
+    scenario.spectrumLossModel = CreateObject<NYUSpectrumPropagationLossModel>();
+    scenario.spectrumLossModel->SetChannelModel(scenario.channelModel);
+
+    // the models are registered in the same order in every run
+    scenario.checkpoint =
+        CreateObjectWithAttributes<NYUCheckpoint>("FileName", StringValue(fileName));
+    scenario.checkpoint->Add(scenario.conditionModel);
+    scenario.checkpoint->Add(scenario.propagationLossModel);
+    scenario.checkpoint->Add(scenario.channelModel);
+    scenario.checkpoint->Add(scenario.spectrumLossModel);
+
+    // the positions and the velocities of the rx nodes are drawn from a stream
+    // which is not checkpointed, before the simulation starts
+    Ptr<UniformRandomVariable> positionRv = CreateObject<UniformRandomVariable>();
+    positionRv->SetStream(1000);
+    scenario.nodes.Create(numUes + 1);
+    for (uint32_t i = 0; i <= numUes; i++)
+    {
+        Ptr<ConstantVelocityMobilityModel> mob = CreateObject<ConstantVelocityMobilityModel>();
+        if (i == 0)
+        {
+            mob->SetPosition(Vector(0.0, 0.0, 10.0));
+        }
+        else
+        {
+            mob->SetPosition(
+                Vector(positionRv->GetValue(20.0, 200.0), positionRv->GetValue(-100, 100), 1.6));
+            mob->SetVelocity(
+                Vector(positionRv->GetValue(-1.5, 1.5), positionRv->GetValue(-1.5, 1.5), 0.0));
+        }
+        scenario.nodes.Get(i)->AggregateObject(mob);
+        uint32_t size = (i == 0 ? 8 : 2);
+        scenario.antennas.push_back(
+            CreateObjectWithAttributes<UniformPlanarArray>("NumColumns",
+                                                           UintegerValue(size),
+                                                           "NumRows",
+                                                           UintegerValue(size)));
+    }
+
+    std::vector<int> activeRbs(100);
+    for (int i = 0; i < 100; i++)
+    {
+        activeRbs[i] = i;
+    }
+    scenario.txParams = Create<SpectrumSignalParameters>();
+    scenario.txParams->psd =
+        LteSpectrumValueHelper::CreateTxPowerSpectralDensity(2100, 100, 30.0, activeRbs);
+}
+
+/**
+ * Sample the received power of every link
+ * \param scenario the scenario
+ */
+static void
+SampleRxPower(NyuResumeScenario* scenario)
+{
+    Ptr<MobilityModel> txMob = scenario->nodes.Get(0)->GetObject<MobilityModel>();
+    Ptr<PhasedArrayModel> txAntenna = scenario->antennas[0];
+    double txPower = 10 * log10(Integral(*scenario->txParams->psd)) + 30;
+    for (uint32_t i = 1; i < scenario->nodes.GetN(); i++)
+    {
+        Ptr<MobilityModel> rxMob = scenario->nodes.Get(i)->GetObject<MobilityModel>();
+        Ptr<PhasedArrayModel> rxAntenna = scenario->antennas[i];
+        txAntenna->SetBeamformingVector(
+            GetDftBeam(txAntenna, Angles(rxMob->GetPosition(), txMob->GetPosition())));
+        rxAntenna->SetBeamformingVector(
+            GetDftBeam(rxAntenna, Angles(txMob->GetPosition(), rxMob->GetPosition())));
+
+        double rxPower = scenario->propagationLossModel->CalcRxPower(txPower, txMob, rxMob);
+        Ptr<SpectrumValue> rxPsd =
+            scenario->spectrumLossModel->CalcRxPowerSpectralDensity(scenario->txParams,
+                                                                    txMob,
+                                                                    rxMob,
+                                                                    txAntenna,
+                                                                    rxAntenna);
+        rxPower += 10 * log10(Sum(*rxPsd) / Sum(*scenario->txParams->psd));
+        scenario->samples[std::make_pair(Simulator::Now().GetMicroSeconds(), i)] = rxPower;
+    }
+}
+
+/**
+ * Schedule the samples in a time interval
+ * \param scenario the scenario
+ * \param samplePeriod the interval between two samples
+ * \param after only the samples after this time are scheduled
+ * \param stop the time of the last sample
+ */
+static void
+ScheduleSamples(NyuResumeScenario& scenario, Time samplePeriod, Time after, Time stop)
+{
+    for (Time t = Seconds(0); t <= stop; t += samplePeriod)
+    {
+        if (t > after)
+        {
+            Simulator::Schedule(t, &SampleRxPower, &scenario);
+        }
+    }
+}
+
+/**
+ * Restore the last checkpoint and keep writing the checkpoint file
+ * \param scenario the scenario
+ * \param fileName the name of the checkpoint file
+ */
+static void
+RestoreCheckpoint(NyuResumeScenario* scenario, std::string fileName)
+{
+    NS_ABORT_MSG_IF(!scenario->checkpoint->Restore(fileName), "No checkpoint in " << fileName);
+    scenario->checkpoint->Start();
+}
+
+int
+main(int argc, char* argv[])
+{
+    uint32_t numUes = 20;              // number of rx nodes
+    Time simTime = Seconds(10);        // duration of the simulation
+    Time crashTime = Seconds(5.5);     // time at which the first run is stopped
+    Time samplePeriod = MilliSeconds(100); // interval between two samples of the received power
+    Time updatePeriod = MilliSeconds(500); // channel update period
+    Time checkpointInterval = Seconds(1); // interval between two checkpoints
+    std::string fileName = "nyu-checkpoint-resume.bin"; // the checkpoint file
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("numUes", "number of rx nodes", numUes);
+    cmd.AddValue("simTime", "duration of the simulation", simTime);
+    cmd.AddValue("crashTime", "time at which the first run is stopped", crashTime);
+    cmd.AddValue("samplePeriod", "interval between two samples of the received power", samplePeriod);
+    cmd.AddValue("updatePeriod", "channel update period", updatePeriod);
+    cmd.AddValue("checkpointInterval", "interval between two checkpoints", checkpointInterval);
+    cmd.AddValue("fileName", "name of the checkpoint file", fileName);
+    cmd.Parse(argc, argv);
+
+    RngSeedManager::SetSeed(1);
+    RngSeedManager::SetRun(1);
+    Config::SetDefault("ns3::NYUCheckpoint::Interval", TimeValue(checkpointInterval));
+
+    // 1. the interrupted run, the samples at the time of a checkpoint precede it
+    {
+        NyuResumeScenario scenario;
+        BuildScenario(numUes, updatePeriod, fileName, scenario);
+        ScheduleSamples(scenario, samplePeriod, Seconds(-1), crashTime);
+        scenario.checkpoint->Start();
+        Simulator::Stop(crashTime);
+        Simulator::Run();
+        scenario.checkpoint->Close();
+        Simulator::Destroy();
+    }
+
+    Time restoreTime = NYUCheckpoint::GetLastCheckpointTime(fileName);
+    NS_ABORT_MSG_IF(restoreTime.IsStrictlyNegative(), "No checkpoint written before crashTime");
+
+    // 2. the resumed run, sampled only after the restored checkpoint
+    RxPowerSamples resumed;
+    {
+        NyuResumeScenario scenario;
+        BuildScenario(numUes, updatePeriod, fileName, scenario);
+        Simulator::Schedule(restoreTime, &RestoreCheckpoint, &scenario, fileName);
+        ScheduleSamples(scenario, samplePeriod, restoreTime, simTime);
+        Simulator::Stop(simTime);
+        Simulator::Run();
+        scenario.checkpoint->Close();
+        resumed = scenario.samples;
+        Simulator::Destroy();
+    }
+
+    // 3. the uninterrupted run
+    RxPowerSamples uninterrupted;
+    {
+        NyuResumeScenario scenario;
+        BuildScenario(numUes, updatePeriod, fileName, scenario);
+        ScheduleSamples(scenario, samplePeriod, Seconds(-1), simTime);
+        Simulator::Stop(simTime);
+        Simulator::Run();
+        uninterrupted = scenario.samples;
+        Simulator::Destroy();
+    }
+
+    double maxDifference = 0;
+    for (const auto& sample : resumed)
+    {
+        auto it = uninterrupted.find(sample.first);
+        NS_ABORT_MSG_IF(it == uninterrupted.end(), "Missing sample in the uninterrupted run");
+        maxDifference = std::max(maxDifference, std::abs(sample.second - it->second));
+    }
+
+    std::cout << "Restored the checkpoint at " << restoreTime.As(Time::S) << ", compared "
+              << resumed.size() << " samples of the received power" << std::endl;
+    std::cout << "Max difference between the resumed and the uninterrupted run: " << maxDifference
+              << " dB" << std::endl;
+
+    return maxDifference == 0 ? 0 : 1;
+}
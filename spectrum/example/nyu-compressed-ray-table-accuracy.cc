@@ -0,0 +1,195 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+/**
+ * This example reports the accuracy of the compressed ray table of the
+ * NYUChannelModel (attribute CompressRayTable). Two channel models with the
+ * same random streams generate the same channel realizations, one of them
+ * stores the ray tables in compressed form. A tx node with a uniform planar
+ * array is connected to a set of rx nodes dropped at random in a square area,
+ * the arrays are steered towards each other with DFT beams and the received
+ * PSD is computed with both channel models. The program prints the mean and
+ * maximum error of the beamforming gain (total and per sub-band) introduced
+ * by the compression and the memory used by the cached channel params of
+ * each channel model.
+ */
+
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/core-module.h"
+#include "ns3/lte-spectrum-value-helper.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/node.h"
+#include "ns3/nyu-channel-condition-model.h"
+#include "ns3/nyu-channel-model.h"
+#include "ns3/nyu-spectrum-propagation-loss-model.h"
+#include "ns3/spectrum-signal-parameters.h"
+#include "ns3/uniform-planar-array.h"
+
+#include <algorithm>
+
+NS_LOG_COMPONENT_DEFINE("NYUCompressedRayTableAccuracy");
+
+using namespace ns3;
+
+/**
+ * Compute the DFT beamforming vector of an antenna array towards a direction
+ * \param antenna the antenna array
+ * \param direction the direction of the beam
+ * \return the beamforming vector
+ */
+static PhasedArrayModel::ComplexVector
+GetDftBeam(Ptr<PhasedArrayModel> antenna, Angles direction)
+{
+    uint64_t totNoArrayElements = antenna->GetNumberOfElements();
+    PhasedArrayModel::ComplexVector antennaWeights(totNoArrayElements);
+    double power = 1.0 / sqrt(totNoArrayElements);
+    for (uint64_t ind = 0; ind < totNoArrayElements; ind++)
+    {
+        Vector loc = antenna->GetElementLocation(ind);
+        double phase = -2 * M_PI *
+                       (sin(direction.GetInclination()) * cos(direction.GetAzimuth()) * loc.x +
+                        sin(direction.GetInclination()) * sin(direction.GetAzimuth()) * loc.y +
+                        cos(direction.GetInclination()) * loc.z);
+        antennaWeights[ind] = exp(std::complex<double>(0, phase)) * power;
+    }
+    return antennaWeights;
+}
+
+int
+main(int argc, char* argv[])
+{
+    double frequency = 28.0e9;    // operating frequency in Hz
+    double area = 200.0;          // side of the drop area in meters
+    uint32_t numLinks = 200;      // number of rx nodes
+    std::string scenario = "Umi"; // NYUSIM propagation scenario
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("frequency", "operating frequency in Hz", frequency);
+    cmd.AddValue("area", "side of the square area where the rx nodes are dropped in meters", area);
+    cmd.AddValue("numLinks", "number of rx nodes", numLinks);
+    cmd.AddValue("scenario", "NYUSIM scenario (Rma, Uma, Umi, InH, InF)", scenario);
+    cmd.Parse(argc, argv);
+
+    RngSeedManager::SetSeed(1);
+    RngSeedManager::SetRun(1);
+
+    // the reference and the compressed channel models, with the same streams
+    Ptr<NYUChannelModel> channelModels[2];
+    Ptr<NYUSpectrumPropagationLossModel> spectrumLossModels[2];
+    for (uint32_t m = 0; m < 2; m++)
+    {
+        Ptr<ChannelConditionModel> conditionModel = CreateObject<NYUUmiChannelConditionModel>();
+        conditionModel->AssignStreams(0);
+        channelModels[m] = CreateObject<NYUChannelModel>();
+        channelModels[m]->SetAttribute("Frequency", DoubleValue(frequency));
+        channelModels[m]->SetAttribute("Scenario", StringValue(scenario));
+        channelModels[m]->SetAttribute("ChannelConditionModel", PointerValue(conditionModel));
+        channelModels[m]->SetAttribute("CompressRayTable", BooleanValue(m == 1));
+        channelModels[m]->AssignStreams(100);
+        spectrumLossModels[m] = CreateObject<NYUSpectrumPropagationLossModel>();
+        spectrumLossModels[m]->SetChannelModel(channelModels[m]);
+    }
+
+    // create the nodes, the mobility models and the antenna arrays
+    NodeContainer nodes;
+    nodes.Create(numLinks + 1);
+    Ptr<MobilityModel> txMob = CreateObject<ConstantPositionMobilityModel>();
+    txMob->SetPosition(Vector(0.0, 0.0, 10.0));
+    nodes.Get(0)->AggregateObject(txMob);
+    Ptr<PhasedArrayModel> txAntenna =
+        CreateObjectWithAttributes<UniformPlanarArray>("NumColumns",
+                                                       UintegerValue(8),
+                                                       "NumRows",
+                                                       UintegerValue(8));
+
+    Ptr<UniformRandomVariable> positionRv = CreateObject<UniformRandomVariable>();
+    positionRv->SetStream(1000);
+
+    // a wideband PSD (100 RBs), to evaluate also the frequency selectivity of the gain
+    std::vector<int> activeRbs(100);
+    for (int i = 0; i < 100; i++)
+    {
+        activeRbs[i] = i;
+    }
+    Ptr<SpectrumSignalParameters> txParams = Create<SpectrumSignalParameters>();
+    txParams->psd =
+        LteSpectrumValueHelper::CreateTxPowerSpectralDensity(2100, 100, 30.0, activeRbs);
+
+    double sumGainError = 0;
+    double maxGainError = 0;
+    double maxSubbandError = 0;
+    for (uint32_t i = 0; i < numLinks; i++)
+    {
+        Ptr<MobilityModel> rxMob = CreateObject<ConstantPositionMobilityModel>();
+        rxMob->SetPosition(Vector(positionRv->GetValue(10.0, area),
+                                  positionRv->GetValue(-area / 2, area / 2),
+                                  1.6));
+        nodes.Get(i + 1)->AggregateObject(rxMob);
+        Ptr<PhasedArrayModel> rxAntenna =
+            CreateObjectWithAttributes<UniformPlanarArray>("NumColumns",
+                                                           UintegerValue(4),
+                                                           "NumRows",
+                                                           UintegerValue(4));
+        txAntenna->SetBeamformingVector(
+            GetDftBeam(txAntenna, Angles(rxMob->GetPosition(), txMob->GetPosition())));
+        rxAntenna->SetBeamformingVector(
+            GetDftBeam(rxAntenna, Angles(txMob->GetPosition(), rxMob->GetPosition())));
+
+        Ptr<SpectrumValue> rxPsds[2];
+        for (uint32_t m = 0; m < 2; m++)
+        {
+            rxPsds[m] = spectrumLossModels[m]->CalcRxPowerSpectralDensity(txParams,
+                                                                          txMob,
+                                                                          rxMob,
+                                                                          txAntenna,
+                                                                          rxAntenna);
+        }
+
+        double gainError = std::abs(10 * log10(Sum(*rxPsds[1]) / Sum(*rxPsds[0])));
+        sumGainError += gainError;
+        maxGainError = std::max(maxGainError, gainError);
+        for (size_t b = 0; b < rxPsds[0]->GetValuesN(); b++)
+        {
+            if ((*rxPsds[0])[b] > 0)
+            {
+                maxSubbandError = std::max(maxSubbandError,
+                                           std::abs(10 * log10((*rxPsds[1])[b] / (*rxPsds[0])[b])));
+            }
+        }
+    }
+
+    std::cout << "Beamforming gain error over " << numLinks << " links: mean "
+              << sumGainError / numLinks << " dB, max " << maxGainError << " dB" << std::endl;
+    std::cout << "Max sub-band gain error: " << maxSubbandError << " dB" << std::endl;
+    for (uint32_t m = 0; m < 2; m++)
+    {
+        size_t size = channelModels[m]->GetCachedChannelParamsSize();
+        size_t numParams = std::max<size_t>(1, channelModels[m]->GetNumCachedChannelParams());
+        std::cout << (m == 0 ? "Reference" : "Compressed") << " channel params: " << size
+                  << " bytes (" << size / numParams << " bytes per link)" << std::endl;
+    }
+
+    Simulator::Destroy();
+    return 0;
+}
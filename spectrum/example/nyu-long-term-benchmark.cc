@@ -0,0 +1,207 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+*   Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+/**
+ * This example benchmarks the computation of the long term component in the
+ * NYUSpectrumPropagationLossModel with the scalar and the Eigen backends.
+ * Two static nodes equipped with uniform planar arrays share the same channel
+ * realization, and the beamforming vector of the tx node is switched between
+ * two DFT beams at each iteration so that the long term component is computed
+ * again every time the received PSD is requested. The program prints the
+ * average time per iteration of each backend and the largest difference between
+ * the received powers they obtain.
+ * The Eigen backend is available only if ns-3 is configured with --enable-eigen.
+ */
+
+#include "ns3/constant-position-mobility-model.h"
+#include "ns3/core-module.h"
+#include "ns3/lte-spectrum-value-helper.h"
+#include "ns3/mobility-model.h"
+#include "ns3/node-container.h"
+#include "ns3/node.h"
+#include "ns3/nyu-channel-condition-model.h"
+#include "ns3/nyu-channel-model.h"
+#include "ns3/nyu-spectrum-propagation-loss-model.h"
+#include "ns3/spectrum-signal-parameters.h"
+#include "ns3/uniform-planar-array.h"
+
+#include <algorithm>
+#include <chrono>
+
+NS_LOG_COMPONENT_DEFINE("NYULongTermBenchmark");
+
+using namespace ns3;
+
+/**
+ * Compute the DFT beamforming vector of an antenna array towards a direction
+ * \param antenna the antenna array
+ * \param direction the direction of the beam
+ * \return the beamforming vector
+ */
+static PhasedArrayModel::ComplexVector
+GetDftBeam(Ptr<PhasedArrayModel> antenna, Angles direction)
+{
+    uint64_t totNoArrayElements = antenna->GetNumberOfElements();
+    PhasedArrayModel::ComplexVector antennaWeights(totNoArrayElements);
+    double power = 1.0 / sqrt(totNoArrayElements);
+    for (uint64_t ind = 0; ind < totNoArrayElements; ind++)
+    {
+        Vector loc = antenna->GetElementLocation(ind);
+        double phase = -2 * M_PI *
+                       (sin(direction.GetInclination()) * cos(direction.GetAzimuth()) * loc.x +
+                        sin(direction.GetInclination()) * sin(direction.GetAzimuth()) * loc.y +
+                        cos(direction.GetInclination()) * loc.z);
+        antennaWeights[ind] = exp(std::complex<double>(0, phase)) * power;
+    }
+    return antennaWeights;
+}
+
+int
+main(int argc, char* argv[])
+{
+    double frequency = 28.0e9;    // operating frequency in Hz
+    double distance = 50.0;       // distance between tx and rx nodes in meters
+    uint32_t txRows = 8;          // number of rows of the tx array
+    uint32_t txColumns = 8;       // number of columns of the tx array
+    uint32_t rxRows = 4;          // number of rows of the rx array
+    uint32_t rxColumns = 4;       // number of columns of the rx array
+    uint32_t iterations = 1000;   // number of long term computations per backend
+    std::string scenario = "Umi"; // NYUSIM propagation scenario
+
+    CommandLine cmd(__FILE__);
+    cmd.AddValue("frequency", "operating frequency in Hz", frequency);
+    cmd.AddValue("distance", "distance between tx and rx nodes in meters", distance);
+    cmd.AddValue("txRows", "number of rows of the tx array", txRows);
+    cmd.AddValue("txColumns", "number of columns of the tx array", txColumns);
+    cmd.AddValue("rxRows", "number of rows of the rx array", rxRows);
+    cmd.AddValue("rxColumns", "number of columns of the rx array", rxColumns);
+    cmd.AddValue("iterations", "number of long term computations per backend", iterations);
+    cmd.AddValue("scenario", "NYUSIM scenario (Rma, Uma, Umi, InH, InF)", scenario);
+    cmd.Parse(argc, argv);
+
+    RngSeedManager::SetSeed(1);
+    RngSeedManager::SetRun(1);
+
+    // a single channel model is shared by the two spectrum models, so that both
+    // backends work on the same channel realization
+    Ptr<NYUChannelModel> channelModel = CreateObject<NYUChannelModel>();
+    channelModel->SetAttribute("Frequency", DoubleValue(frequency));
+    channelModel->SetAttribute("Scenario", StringValue(scenario));
+    channelModel->SetAttribute("ChannelConditionModel",
+                               PointerValue(CreateObject<NYUUmiChannelConditionModel>()));
+
+    // create the nodes, the mobility models and the antenna arrays
+    NodeContainer nodes;
+    nodes.Create(2);
+    Ptr<MobilityModel> txMob = CreateObject<ConstantPositionMobilityModel>();
+    txMob->SetPosition(Vector(0.0, 0.0, 10.0));
+    Ptr<MobilityModel> rxMob = CreateObject<ConstantPositionMobilityModel>();
+    rxMob->SetPosition(Vector(distance, 0.0, 1.6));
+    nodes.Get(0)->AggregateObject(txMob);
+    nodes.Get(1)->AggregateObject(rxMob);
+
+    Ptr<PhasedArrayModel> txAntenna =
+        CreateObjectWithAttributes<UniformPlanarArray>("NumColumns",
+                                                       UintegerValue(txColumns),
+                                                       "NumRows",
+                                                       UintegerValue(txRows));
+    Ptr<PhasedArrayModel> rxAntenna =
+        CreateObjectWithAttributes<UniformPlanarArray>("NumColumns",
+                                                       UintegerValue(rxColumns),
+                                                       "NumRows",
+                                                       UintegerValue(rxRows));
+
+    // two tx beams, the first one towards the rx node and the second one 30 degrees apart
+    Angles txToRx(rxMob->GetPosition(), txMob->GetPosition());
+    PhasedArrayModel::ComplexVector txBeams[2] = {
+        GetDftBeam(txAntenna, txToRx),
+        GetDftBeam(txAntenna, Angles(txToRx.GetAzimuth() + M_PI / 6, txToRx.GetInclination()))};
+    rxAntenna->SetBeamformingVector(
+        GetDftBeam(rxAntenna, Angles(txMob->GetPosition(), rxMob->GetPosition())));
+
+    // a narrow PSD (6 RBs), so that the time is dominated by the long term computation
+    std::vector<int> activeRbs(6);
+    for (int i = 0; i < 6; i++)
+    {
+        activeRbs[i] = i;
+    }
+    Ptr<SpectrumSignalParameters> txParams = Create<SpectrumSignalParameters>();
+    txParams->psd = LteSpectrumValueHelper::CreateTxPowerSpectralDensity(2100, 6, 30.0, activeRbs);
+
+    std::vector<std::string> backends = {"Scalar", "Eigen"};
+    std::vector<std::vector<double>> rxPowers(backends.size());
+    for (size_t b = 0; b < backends.size(); b++)
+    {
+        Ptr<NYUSpectrumPropagationLossModel> spectrumLossModel =
+            CreateObject<NYUSpectrumPropagationLossModel>();
+        spectrumLossModel->SetChannelModel(channelModel);
+        if (backends[b] == "Eigen")
+        {
+            // the Eigen backend is not registered if ns-3 has been built without Eigen
+            if (!spectrumLossModel->SetAttributeFailSafe("LongTermBackend",
+                                                         StringValue(backends[b])))
+            {
+                std::cout << "Eigen backend not available" << std::endl;
+                continue;
+            }
+        }
+        else
+        {
+            spectrumLossModel->SetAttribute("LongTermBackend", StringValue(backends[b]));
+        }
+
+        // the first call generates the channel matrix, it is not part of the measurement
+        txAntenna->SetBeamformingVector(txBeams[1]);
+        spectrumLossModel->CalcRxPowerSpectralDensity(txParams, txMob, rxMob, txAntenna, rxAntenna);
+
+        auto start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            txAntenna->SetBeamformingVector(txBeams[i % 2]);
+            Ptr<SpectrumValue> rxPsd = spectrumLossModel->CalcRxPowerSpectralDensity(txParams,
+                                                                                     txMob,
+                                                                                     rxMob,
+                                                                                     txAntenna,
+                                                                                     rxAntenna);
+            rxPowers[b].push_back(Sum(*rxPsd));
+        }
+        auto stop = std::chrono::steady_clock::now();
+        double elapsedUs = std::chrono::duration<double, std::micro>(stop - start).count();
+        std::cout << backends[b] << " backend: " << elapsedUs / iterations << " us per iteration ("
+                  << txRows * txColumns << "x" << rxRows * rxColumns << " elements)" << std::endl;
+    }
+
+    if (!rxPowers[1].empty())
+    {
+        double maxRelativeError = 0;
+        for (uint32_t i = 0; i < iterations; i++)
+        {
+            maxRelativeError = std::max(maxRelativeError,
+                                        std::abs(rxPowers[1][i] - rxPowers[0][i]) / rxPowers[0][i]);
+        }
+        std::cout << "Max relative difference of the rx power: " << maxRelativeError << std::endl;
+    }
+
+    Simulator::Destroy();
+    return 0;
+}
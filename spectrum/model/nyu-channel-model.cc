@@ -25,6 +25,7 @@
 */
 
 #include "ns3/nyu-channel-model.h"
+#include "ns3/abort.h"
 #include "ns3/angles.h"
 #include "ns3/log.h"
 #include "ns3/phased-array-model.h"
@@ -38,8 +39,13 @@
 #include <ns3/simulator.h>
 #include "ns3/mobility-model.h"
 #include "ns3/pointer.h"
+#include "ns3/uinteger.h"
+#include "ns3/uniform-planar-array.h"
 #include <complex>
+#include <cstring>
 #include <math.h>
+#include <sstream>
+#include <unistd.h>
 
 namespace ns3 {
 
@@ -47,19 +53,287 @@ NS_LOG_COMPONENT_DEFINE ("NYUChannelModel");
 
 NS_OBJECT_ENSURE_REGISTERED (NYUChannelModel);
 
-static const double M_C = 3.0e8; // in m/s
+static const double M_C = 3.0e8; // in m/s, as in NYUSpectrumPropagationLossModel
 static const double frequencyLowerBound = 28; // in GHz
 static const double frequencyUpperBound = 140; // in GHz
 
+/**
+ * Returns the unit direction vector of a ray
+ * \param azimuth the azimuth angle of the ray in radians
+ * \param inclination the inclination angle of the ray in radians
+ * \return the unit direction vector
+ */
+static Vector
+GetRayDirection (double azimuth, double inclination)
+{
+  double sinInclination = sin (inclination);
+  return Vector (sinInclination * cos (azimuth), sinInclination * sin (azimuth), cos (inclination));
+}
+
+/**
+ * Appends the bytes of a value to a buffer
+ * \param buffer the buffer
+ * \param value the value
+ */
+template <class T>
+static void
+AppendValue (std::vector<uint8_t> &buffer, const T &value)
+{
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *> (&value);
+  buffer.insert (buffer.end (), bytes, bytes + sizeof (T));
+}
+
+/**
+ * Appends the size and the elements of a vector to a buffer
+ * \param buffer the buffer
+ * \param values the vector
+ */
+template <class T>
+static void
+AppendVector (std::vector<uint8_t> &buffer, const std::vector<T> &values)
+{
+  AppendValue<uint64_t> (buffer, values.size ());
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *> (values.data ());
+  buffer.insert (buffer.end (), bytes, bytes + values.size () * sizeof (T));
+}
+
+/**
+ * Appends the rows of a matrix to a buffer
+ * \param buffer the buffer
+ * \param values the matrix
+ */
+static void
+AppendMatrix (std::vector<uint8_t> &buffer, const MatrixBasedChannelModel::Double2DVector &values)
+{
+  AppendValue<uint64_t> (buffer, values.size ());
+  for (const auto &row : values)
+    {
+      AppendVector (buffer, row);
+    }
+}
+
+/**
+ * Reads a value written by AppendValue
+ * \param buffer the buffer
+ * \param offset the position of the value, moved after the value
+ * \return the value
+ */
+template <class T>
+static T
+ReadValue (const std::vector<uint8_t> &buffer, size_t &offset)
+{
+  NS_ASSERT_MSG (offset + sizeof (T) <= buffer.size (), "Truncated record");
+  T value;
+  std::memcpy (&value, buffer.data () + offset, sizeof (T));
+  offset += sizeof (T);
+  return value;
+}
+
+/**
+ * Reads a vector written by AppendVector
+ * \param buffer the buffer
+ * \param offset the position of the vector, moved after the vector
+ * \param values set to the vector
+ */
+template <class T>
+static void
+ReadVector (const std::vector<uint8_t> &buffer, size_t &offset, std::vector<T> &values)
+{
+  uint64_t size = ReadValue<uint64_t> (buffer, offset);
+  NS_ASSERT_MSG (offset + size * sizeof (T) <= buffer.size (), "Truncated record");
+  values.resize (size);
+  if (size > 0)
+    {
+      std::memcpy (values.data (), buffer.data () + offset, size * sizeof (T));
+    }
+  offset += size * sizeof (T);
+}
+
+/**
+ * Reads a matrix written by AppendMatrix
+ * \param buffer the buffer
+ * \param offset the position of the matrix, moved after the matrix
+ * \param values set to the matrix
+ */
+static void
+ReadMatrix (const std::vector<uint8_t> &buffer, size_t &offset, MatrixBasedChannelModel::Double2DVector &values)
+{
+  values.resize (ReadValue<uint64_t> (buffer, offset));
+  for (auto &row : values)
+    {
+      ReadVector (buffer, offset, row);
+    }
+}
+
+void
+NYUChannelModel::LruOrder::Touch (uint64_t key)
+{
+  auto it = m_position.find (key);
+  if (it != m_position.end ())
+    {
+      m_order.splice (m_order.begin (), m_order, it->second);
+    }
+  else
+    {
+      m_order.push_front (key);
+      m_position[key] = m_order.begin ();
+    }
+}
+
+void
+NYUChannelModel::LruOrder::Erase (uint64_t key)
+{
+  auto it = m_position.find (key);
+  if (it != m_position.end ())
+    {
+      m_order.erase (it->second);
+      m_position.erase (it);
+    }
+}
+
+uint64_t
+NYUChannelModel::LruOrder::GetOldest () const
+{
+  NS_ASSERT (!m_order.empty ());
+  return m_order.back ();
+}
+
+size_t
+NYUChannelModel::LruOrder::GetSize () const
+{
+  return m_order.size ();
+}
+
+void
+NYUChannelModel::LruOrder::Clear ()
+{
+  m_order.clear ();
+  m_position.clear ();
+}
+
+bool
+NYUChannelModel::LruOrder::Contains (uint64_t key) const
+{
+  return m_position.find (key) != m_position.end ();
+}
+
+const std::list<uint64_t> &
+NYUChannelModel::LruOrder::GetKeys () const
+{
+  return m_order;
+}
+
+/**
+ * Appends to a checkpoint the entries of a cache added or changed since the
+ * previous checkpoint, followed by the keys of the discarded ones. The
+ * entries of the spill file are written when they are evicted, and then
+ * again only if they are read back and evicted once more.
+ * \param map the cache
+ * \param spillFile the spill file of the cache, nullptr if none
+ * \param tracker the entries written to the previous checkpoints
+ * \param serialize appends the record of an entry, given its key and value
+ * \param buffer the buffer
+ */
+template <class Map, class Serialize>
+static void
+AppendCheckpointRecords (const Map &map, Ptr<const NYUChannelSpillFile> spillFile,
+                         NYUCheckpointTracker &tracker, Serialize serialize, std::vector<uint8_t> &buffer)
+{
+  std::vector<uint8_t> changed;
+  std::vector<uint8_t> record;
+  uint64_t numChanged = 0;
+  for (const auto &entry : map)
+    {
+      if (tracker.Update (entry.first, NYUCheckpointTracker::GetVersion (PeekPointer (entry.second), entry.second->m_generatedTime)))
+        {
+          record.clear ();
+          serialize (entry.first, entry.second, record);
+          AppendValue<uint64_t> (changed, entry.first);
+          AppendVector (changed, record);
+          numChanged++;
+        }
+    }
+  if (spillFile)
+    {
+      for (uint64_t key : spillFile->GetKeys ())
+        {
+          if (tracker.Update (key, NYUCheckpointTracker::EXTERNAL_VERSION))
+            {
+              spillFile->Get (key, record);
+              AppendValue<uint64_t> (changed, key);
+              AppendVector (changed, record);
+              numChanged++;
+            }
+        }
+    }
+  std::vector<uint64_t> removed = tracker.EndCheckpoint ();
+
+  AppendValue<uint64_t> (buffer, numChanged);
+  buffer.insert (buffer.end (), changed.begin (), changed.end ());
+  AppendVector (buffer, removed);
+}
+
+/**
+ * Reads the records written by AppendCheckpointRecords
+ * \param buffer the buffer
+ * \param offset the position of the records, moved after them
+ * \param apply called with the key and the record of each added or changed entry
+ * \param remove called with the key of each discarded entry
+ */
+template <class Apply, class Remove>
+static void
+ReadCheckpointRecords (const std::vector<uint8_t> &buffer, size_t &offset, Apply apply, Remove remove)
+{
+  std::vector<uint8_t> record;
+  uint64_t numChanged = ReadValue<uint64_t> (buffer, offset);
+  for (uint64_t i = 0; i < numChanged; i++)
+    {
+      uint64_t key = ReadValue<uint64_t> (buffer, offset);
+      ReadVector (buffer, offset, record);
+      apply (key, record);
+    }
+  std::vector<uint64_t> removed;
+  ReadVector (buffer, offset, removed);
+  for (uint64_t key : removed)
+    {
+      remove (key);
+    }
+}
+
+/**
+ * Returns the update phase of a link, i.e., a fraction in [0, 1) obtained by
+ * hashing the key of the link with the SplitMix64 finalizer
+ * \param key the key of the channel params of the link
+ * \return the update phase
+ */
+static double
+GetUpdatePhase (uint64_t key)
+{
+  uint64_t z = key + 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  z = z ^ (z >> 31);
+  return (z >> 11) * (1.0 / 9007199254740992.0);
+}
+
 NYUChannelModel::NYUChannelModel ()
+  : m_lastAntennaEpoch (0),
+    m_numChannelParamsGenerations (0),
+    m_numChannelMatrixGenerations (0),
+    m_compressRayTable (false),
+    m_maxCachedChannelParams (0),
+    m_maxCachedChannelMatrices (0),
+    m_numSpillFaults (0),
+    m_updatePhaseJitter (false),
+    m_maxUpdatesPerSlot (0),
+    m_currentUpdateSlot (-1),
+    m_numUpdatesInSlot (0),
+    m_numDeferredUpdates (0),
+    m_maxPowerIterations (30)
 {
   NS_LOG_FUNCTION (this);
-  m_normalRv = CreateObject<NormalRandomVariable> ();
-  m_normalRv->SetAttribute ("Mean", DoubleValue (0.0));
-  m_normalRv->SetAttribute ("Variance", DoubleValue (1.0));
-  m_uniformRv = CreateObject<UniformRandomVariable> ();
-  m_expRv = CreateObject<ExponentialRandomVariable> ();
-  m_gammaRv = CreateObject<GammaRandomVariable> ();
+  m_normalRv.Get ()->SetAttribute ("Mean", DoubleValue (0.0));
+  m_normalRv.Get ()->SetAttribute ("Variance", DoubleValue (1.0));
 }
 
 NYUChannelModel::~NYUChannelModel ()
@@ -77,7 +351,18 @@ NYUChannelModel::DoDispose ()
     }
   m_channelMatrixMap.clear ();
   m_channelParamsMap.clear ();
+  m_antennaConfigMap.clear ();
+  m_channelMatrixEpochMap.clear ();
+  m_channelParamsLru.Clear ();
+  m_channelMatrixLru.Clear ();
+  m_channelParamsSpill = nullptr;
+  m_channelMatrixSpill = nullptr;
+  m_pendingUpdates.clear ();
+  m_pendingUpdateOrder.clear ();
+  m_dominantBeamsMap.clear ();
+  m_dominantBeamsLru.Clear ();
   m_channelConditionModel = nullptr;
+  m_profiler = nullptr;
 }
 
 TypeId
@@ -113,10 +398,74 @@ NYUChannelModel::GetTypeId (void)
                    TimeValue (MilliSeconds (0)),
                    MakeTimeAccessor (&NYUChannelModel::m_updatePeriod),
                    MakeTimeChecker ())
+    .AddAttribute ("UpdatePhaseJitter",
+                   "If true, the first realization of each link lasts a fraction of UpdatePeriod "
+                   "which depends on the link, so that the links created at the same time are not "
+                   "updated in the same slot. The fraction is a hash of the node ids, hence no "
+                   "random values are drawn",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&NYUChannelModel::m_updatePhaseJitter),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxUpdatesPerSlot",
+                   "The maximum number of channel params updated per slot because their UpdatePeriod "
+                   "is over. The stale links beyond the budget keep their realization until a later "
+                   "slot, the most stale ones first. The updates due to a change of the channel "
+                   "condition are not limited. If 0, the number is unlimited",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&NYUChannelModel::m_maxUpdatesPerSlot),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("UpdateSlotDuration",
+                   "The duration of the slots of the MaxUpdatesPerSlot budget",
+                   TimeValue (MilliSeconds (1)),
+                   MakeTimeAccessor (&NYUChannelModel::m_updateSlotDuration),
+                   MakeTimeChecker (NanoSeconds (1)))
+    .AddAttribute ("MaxPowerIterations",
+                   "The maximum number of power iterations used by GetDominantBeams",
+                   UintegerValue (30),
+                   MakeUintegerAccessor (&NYUChannelModel::m_maxPowerIterations),
+                   MakeUintegerChecker<uint32_t> (1))
     .AddAttribute ("Blockage",
                    "Enable NYU blockage model", BooleanValue (false),
                    MakeBooleanAccessor (&NYUChannelModel::m_blockage),
-                   MakeBooleanChecker ());
+                   MakeBooleanChecker ())
+    .AddAttribute ("CompressRayTable",
+                   "If true, the ray table of the cached channel params is stored in a compressed "
+                   "form (float delays and powers, 16-bit angles and phases) and the intermediate "
+                   "vectors of the generation procedure are released. In this case the m_angle and "
+                   "m_delay vectors of the params returned by GetParams are empty.",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&NYUChannelModel::m_compressRayTable),
+                   MakeBooleanChecker ())
+    .AddAttribute ("MaxCachedChannelParams",
+                   "The maximum number of channel params kept in memory. When it is exceeded, "
+                   "the least recently used ones are evicted. If 0, the number is unlimited",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&NYUChannelModel::m_maxCachedChannelParams),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("MaxCachedChannelMatrices",
+                   "The maximum number of channel matrices kept in memory. When it is exceeded, "
+                   "the least recently used ones are evicted. If 0, the number is unlimited",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&NYUChannelModel::m_maxCachedChannelMatrices),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("SpillFileName",
+                   "Prefix of the names of the memory-mapped files where the evicted channel params "
+                   "and matrices are written, and from which they are read back when the link is "
+                   "used again, so that their realization is preserved. If empty, the evicted "
+                   "entries are discarded and generated again",
+                   StringValue (""),
+                   MakeStringAccessor (&NYUChannelModel::m_spillFileName),
+                   MakeStringChecker ())
+    .AddAttribute ("Profiler",
+                   "The per-link cost profiler. If not set, the costs are not profiled",
+                   PointerValue (),
+                   MakePointerAccessor (&NYUChannelModel::SetProfiler,
+                                        &NYUChannelModel::GetProfiler),
+                   MakePointerChecker<NYULinkProfiler> ())
+    .AddTraceSource ("ChannelMatrixEvicted",
+                     "Trace fired when a channel matrix is evicted from the cache",
+                     MakeTraceSourceAccessor (&NYUChannelModel::m_channelMatrixEvictedTrace),
+                     "ns3::NYUChannelModel::ChannelMatrixEvictedTracedCallback");
   return tid;
 }
 
@@ -538,8 +887,7 @@ NYUChannelModel::ChannelParamsNeedsUpdate (Ptr<const NYUChannelParams> channelPa
     }
 
   // if the coherence time is over the channel has to be updated
-  if (!m_updatePeriod.IsZero ()
-      && Simulator::Now () - channelParams->m_generatedTime > m_updatePeriod)
+  if (!m_updatePeriod.IsZero () && Simulator::Now () > GetUpdateDueTime (channelParams))
     {
       NS_LOG_DEBUG ("Generation time " << channelParams->m_generatedTime.As (Time::NS) << " now "
                                        << Now ().As (Time::NS));
@@ -549,64 +897,285 @@ NYUChannelModel::ChannelParamsNeedsUpdate (Ptr<const NYUChannelParams> channelPa
   return update;
 }
 
+Time
+NYUChannelModel::GetUpdateDueTime (Ptr<const NYUChannelParams> channelParams) const
+{
+  return channelParams->m_generatedTime
+    + NanoSeconds (static_cast<int64_t> (m_updatePeriod.GetNanoSeconds () * (1 - channelParams->m_updatePhase)));
+}
+
+bool
+NYUChannelModel::ScheduleChannelParamsUpdate (uint64_t channelParamsKey,
+                                              Ptr<const NYUChannelParams> channelParams,
+                                              Ptr<const ChannelCondition> channelCondition)
+{
+  NS_LOG_FUNCTION (this << channelParamsKey);
+
+  if (!ChannelParamsNeedsUpdate (channelParams, channelCondition))
+    {
+      return false;
+    }
+  if (m_maxUpdatesPerSlot == 0
+      || !channelCondition->IsEqual (channelParams->m_losCondition, channelParams->m_o2iCondition))
+    {
+      return true;
+    }
+  return AdmitScheduledUpdate (channelParamsKey, GetUpdateDueTime (channelParams));
+}
+
+bool
+NYUChannelModel::AdmitScheduledUpdate (uint64_t channelParamsKey, Time dueTime)
+{
+  NS_LOG_FUNCTION (this << channelParamsKey << dueTime);
+
+  Time now = Simulator::Now ();
+  int64_t slot = now.GetTimeStep () / m_updateSlotDuration.GetTimeStep ();
+  if (slot != m_currentUpdateSlot)
+    {
+      // new slot, forget the links which have not requested an update since the
+      // beginning of the previous slot, so that they do not hold the budget
+      Time previousSlotStart = TimeStep ((slot - 1) * m_updateSlotDuration.GetTimeStep ());
+      for (auto it = m_pendingUpdates.begin (); it != m_pendingUpdates.end ();)
+        {
+          if (it->second.second < previousSlotStart)
+            {
+              m_pendingUpdateOrder.erase (std::make_pair (it->second.first, it->first));
+              it = m_pendingUpdates.erase (it);
+            }
+          else
+            {
+              ++it;
+            }
+        }
+      m_currentUpdateSlot = slot;
+      m_numUpdatesInSlot = 0;
+    }
+
+  // register the request
+  auto pendingIt = m_pendingUpdates.find (channelParamsKey);
+  if (pendingIt == m_pendingUpdates.end ())
+    {
+      m_pendingUpdates[channelParamsKey] = std::make_pair (dueTime, now);
+      m_pendingUpdateOrder.insert (std::make_pair (dueTime, channelParamsKey));
+    }
+  else
+    {
+      pendingIt->second.second = now;
+    }
+
+  // the remaining budget of the slot is reserved to the most stale links
+  uint32_t remaining = m_maxUpdatesPerSlot - std::min (m_numUpdatesInSlot, m_maxUpdatesPerSlot);
+  uint32_t rank = 0;
+  for (auto it = m_pendingUpdateOrder.begin (); it != m_pendingUpdateOrder.end () && rank < remaining; ++it, ++rank)
+    {
+      if (it->second == channelParamsKey)
+        {
+          m_pendingUpdateOrder.erase (it);
+          m_pendingUpdates.erase (channelParamsKey);
+          m_numUpdatesInSlot++;
+          return true;
+        }
+    }
+
+  NS_LOG_DEBUG ("Update of the channel params with key " << channelParamsKey << " deferred");
+  m_numDeferredUpdates++;
+  return false;
+}
+
+uint64_t
+NYUChannelModel::GetNumDeferredUpdates () const
+{
+  return m_numDeferredUpdates;
+}
+
 bool
 NYUChannelModel::ChannelMatrixNeedsUpdate (Ptr<const NYUChannelParams> channelParams,
-                                           Ptr<const ChannelMatrix> channelMatrix)
+                                           Ptr<const ChannelMatrix> channelMatrix,
+                                           Ptr<const PhasedArrayModel> aAntenna,
+                                           Ptr<const PhasedArrayModel> bAntenna)
 {
+  NS_LOG_FUNCTION (this);
 
   if (channelParams->m_generatedTime > channelMatrix->m_generatedTime)
     {
       return true;
     }
-  else
+
+  // if the orientation or the element configuration of one of the antenna arrays
+  // has changed the channel matrix has to be rebuilt, the channel params are still valid
+  uint64_t channelMatrixKey = GetKey (aAntenna->GetId (), bAntenna->GetId ());
+  auto epochIt = m_channelMatrixEpochMap.find (channelMatrixKey);
+  if (epochIt == m_channelMatrixEpochMap.end ())
     {
-      return false;
+      return true;
+    }
+
+  uint64_t aEpoch = GetAntennaEpoch (aAntenna);
+  uint64_t bEpoch = GetAntennaEpoch (bAntenna);
+  std::pair<uint64_t, uint64_t> currentEpochs = std::make_pair (aEpoch, bEpoch);
+  if (channelMatrix->IsReverse (aAntenna->GetId (), bAntenna->GetId ()))
+    {
+      currentEpochs = std::make_pair (bEpoch, aEpoch);
+    }
+  if (currentEpochs != epochIt->second)
+    {
+      NS_LOG_DEBUG ("Antenna configuration changed, rebuild the channel matrix from the cached channel params");
+      return true;
     }
+
+  return false;
 }
 
-Ptr<const MatrixBasedChannelModel::ChannelMatrix>
-NYUChannelModel::GetChannel (Ptr<const MobilityModel> aMob,
-                             Ptr<const MobilityModel> bMob,
-                             Ptr<const PhasedArrayModel> aAntenna,
-                             Ptr<const PhasedArrayModel> bAntenna)
+uint64_t
+NYUChannelModel::GetAntennaEpoch (Ptr<const PhasedArrayModel> antenna)
+{
+  NS_LOG_FUNCTION (this);
+
+  // the fingerprint of the array configuration is obtained from the number of elements,
+  // the location of the last element (the first one is always in the origin of the array)
+  // and the field pattern of the elements in a fixed direction. Comparing it is O(1),
+  // hence it can be done every time the channel is requested.
+  static const Angles probeDirection (0.3 * M_PI, 0.4 * M_PI);
+
+  uint64_t numElements = antenna->GetNumberOfElements ();
+  Vector lastElementLocation = antenna->GetElementLocation (numElements - 1);
+  std::pair<double, double> probeFieldPattern = antenna->GetElementFieldPattern (probeDirection);
+
+  auto configIt = m_antennaConfigMap.find (antenna->GetId ());
+  if (configIt == m_antennaConfigMap.end ())
+    {
+      AntennaConfig config;
+      config.m_epoch = ++m_lastAntennaEpoch;
+      config.m_numElements = numElements;
+      config.m_lastElementLocation = lastElementLocation;
+      config.m_probeFieldPattern = probeFieldPattern;
+      m_antennaConfigMap[antenna->GetId ()] = config;
+      return config.m_epoch;
+    }
+
+  AntennaConfig &config = configIt->second;
+  if (config.m_numElements != numElements
+      || config.m_lastElementLocation.x != lastElementLocation.x
+      || config.m_lastElementLocation.y != lastElementLocation.y
+      || config.m_lastElementLocation.z != lastElementLocation.z
+      || config.m_probeFieldPattern != probeFieldPattern)
+    {
+      config.m_epoch = ++m_lastAntennaEpoch;
+      NS_LOG_DEBUG ("Antenna " << antenna->GetId () << " reconfigured, new epoch " << config.m_epoch);
+      config.m_numElements = numElements;
+      config.m_lastElementLocation = lastElementLocation;
+      config.m_probeFieldPattern = probeFieldPattern;
+    }
+  return config.m_epoch;
+}
+
+void
+NYUChannelModel::NotifyAntennaReconfigured (Ptr<const PhasedArrayModel> antenna)
+{
+  NS_LOG_FUNCTION (this);
+  // without a configuration no cached channel matrix refers to the array, and
+  // a new epoch is assigned the next time it is seen
+  if (m_antennaConfigMap.find (antenna->GetId ()) == m_antennaConfigMap.end ())
+    {
+      return;
+    }
+  // refresh the fingerprint and then force a new epoch
+  GetAntennaEpoch (antenna);
+  m_antennaConfigMap[antenna->GetId ()].m_epoch = ++m_lastAntennaEpoch;
+}
+
+void
+NYUChannelModel::AddAntennaReference (uint32_t antennaId)
+{
+  auto configIt = m_antennaConfigMap.find (antennaId);
+  if (configIt == m_antennaConfigMap.end ())
+    {
+      // e.g., a matrix read back from the spill file after the configuration has
+      // been dropped: the fingerprint is set by the next call to GetAntennaEpoch
+      configIt = m_antennaConfigMap.emplace (antennaId, AntennaConfig ()).first;
+      configIt->second.m_epoch = ++m_lastAntennaEpoch;
+    }
+  configIt->second.m_numReferences++;
+}
+
+void
+NYUChannelModel::RemoveAntennaReference (uint32_t antennaId)
+{
+  auto configIt = m_antennaConfigMap.find (antennaId);
+  NS_ASSERT_MSG (configIt != m_antennaConfigMap.end () && configIt->second.m_numReferences > 0,
+                 "No reference to the configuration of antenna " << antennaId);
+  if (--configIt->second.m_numReferences == 0)
+    {
+      NS_LOG_DEBUG ("Drop the configuration of antenna " << antennaId);
+      m_antennaConfigMap.erase (configIt);
+    }
+}
+
+void
+NYUChannelModel::UpdateAntennaReferences ()
+{
+  for (auto &entry : m_antennaConfigMap)
+    {
+      entry.second.m_numReferences = 0;
+    }
+  for (const auto &entry : m_channelMatrixMap)
+    {
+      AddAntennaReference (entry.second->m_antennaPair.first);
+      AddAntennaReference (entry.second->m_antennaPair.second);
+    }
+  for (const auto &entry : m_dominantBeamsMap)
+    {
+      AddAntennaReference (entry.second->m_aAntennaId);
+      AddAntennaReference (entry.second->m_bAntennaId);
+    }
+  for (auto it = m_antennaConfigMap.begin (); it != m_antennaConfigMap.end ();)
+    {
+      it = (it->second.m_numReferences == 0) ? m_antennaConfigMap.erase (it) : std::next (it);
+    }
+}
+
+Ptr<NYUChannelModel::NYUChannelParams>
+NYUChannelModel::GetUpdatedChannelParams (Ptr<const ChannelCondition> channelCondition,
+                                          Ptr<const MobilityModel> aMob,
+                                          Ptr<const MobilityModel> bMob)
 {
   NS_LOG_FUNCTION (this);
 
   // Compute the channel params key. The key is reciprocal, i.e., key (a, b) = key (b, a)
   uint64_t channelParamsKey =
     GetKey (aMob->GetObject<Node> ()->GetId (), bMob->GetObject<Node> ()->GetId ());
-  // Compute the channel matrix key. The key is reciprocal, i.e., key (a, b) = key (b, a)
-  uint64_t channelMatrixKey = GetKey (aAntenna->GetId (), bAntenna->GetId ());
-
-  // retrieve the channel condition
-  Ptr<const ChannelCondition> condition = m_channelConditionModel->GetChannelCondition (aMob, bMob);
 
-  // Check if the channel is present in the map and return it, otherwise
-  // generate a new channel
   bool updateParams = false;
-  bool updateMatrix = false;
   bool notFoundParams = false;
-  bool notFoundMatrix = false;
-  Ptr<ChannelMatrix> channelMatrix;
   Ptr<NYUChannelParams> channelParams;
 
   if (m_channelParamsMap.find (channelParamsKey) != m_channelParamsMap.end ())
     {
       channelParams = m_channelParamsMap[channelParamsKey];
       // check if it has to be updated
-      updateParams = ChannelParamsNeedsUpdate (channelParams, condition);
+      updateParams = ScheduleChannelParamsUpdate (channelParamsKey, channelParams, channelCondition);
     }
   else
     {
-      NS_LOG_DEBUG ("channel params not found");
-      notFoundParams = true;
+      // the channel params may have been evicted to the spill file
+      channelParams = FaultInChannelParams (channelParamsKey);
+      if (channelParams)
+        {
+          NS_LOG_DEBUG ("channel params read back from the spill file");
+          updateParams = ScheduleChannelParamsUpdate (channelParamsKey, channelParams, channelCondition);
+        }
+      else
+        {
+          NS_LOG_DEBUG ("channel params not found");
+          notFoundParams = true;
+        }
     }
 
-  // get the NYU Channel parameters
-  Ptr<const ParamsTable> tablenyu = GetNYUTable (condition);
-
   if (notFoundParams || updateParams)
     {
+      // get the NYU Channel parameters
+      Ptr<const ParamsTable> tablenyu = GetNYUTable (channelCondition);
+
       // Step 1: Generate number of time clusters N, spatial AOD Lobes and spatial AOA Lobes, and subpaths in each time cluster
       // Step 2: Generate the intra-cluster subpath delays i.e. Delay of each Subpath within a Time Cluster {rho_mn (ns)}
       // Step 3: Generate the phases (rad) for each Supath in a time cluster
@@ -619,38 +1188,124 @@ NYUChannelModel::GetChannel (Ptr<const MobilityModel> aMob,
       // Step 10: Adjust the multipath parameters (AOA,ZOD,AOA,ZOA) based on LOS/NLOS and
       // combine the Subpaths which cannot be resolved.
       // Step 11: Generate XPD values for each ray
-      channelParams = GenerateChannelParameters (condition, tablenyu, aMob, bMob);
+      std::chrono::steady_clock::time_point start;
+      if (m_profiler)
+        {
+          start = NYULinkProfiler::Now ();
+        }
+      channelParams = GenerateChannelParameters (channelCondition, tablenyu, aMob, bMob);
+      m_numChannelParamsGenerations++;
+      if (notFoundParams && m_updatePhaseJitter)
+        {
+          channelParams->m_updatePhase = GetUpdatePhase (channelParamsKey);
+        }
+      if (m_compressRayTable)
+        {
+          CompressChannelParams (channelParams);
+        }
+      if (m_profiler)
+        {
+          uint32_t aId = aMob->GetObject<Node> ()->GetId ();
+          uint32_t bId = bMob->GetObject<Node> ()->GetId ();
+          m_profiler->Record (NYULinkProfiler::PARAMS_GENERATION, aId, bId, start);
+          m_profiler->RecordParams (aId, bId, channelParams->totalSubpaths,
+                                    GetChannelParamsSize (channelParams));
+        }
       // store or replace the channel parameters
       m_channelParamsMap[channelParamsKey] = channelParams;
     }
+  TouchChannelParams (channelParamsKey);
+
+  return channelParams;
+}
+
+Ptr<const MatrixBasedChannelModel::ChannelMatrix>
+NYUChannelModel::GetChannel (Ptr<const MobilityModel> aMob,
+                             Ptr<const MobilityModel> bMob,
+                             Ptr<const PhasedArrayModel> aAntenna,
+                             Ptr<const PhasedArrayModel> bAntenna)
+{
+  NS_LOG_FUNCTION (this);
+
+  // Compute the channel matrix key. The key is reciprocal, i.e., key (a, b) = key (b, a)
+  uint64_t channelMatrixKey = GetKey (aAntenna->GetId (), bAntenna->GetId ());
+
+  // retrieve the channel condition
+  Ptr<const ChannelCondition> condition = m_channelConditionModel->GetChannelCondition (aMob, bMob);
+
+  // Check if the channel is present in the map and return it, otherwise
+  // generate a new channel
+  bool updateMatrix = false;
+  bool notFoundMatrix = false;
+  Ptr<ChannelMatrix> channelMatrix;
+  Ptr<NYUChannelParams> channelParams = GetUpdatedChannelParams (condition, aMob, bMob);
+
+  // get the NYU Channel parameters
+  Ptr<const ParamsTable> tablenyu = GetNYUTable (condition);
 
   if (m_channelMatrixMap.find (channelMatrixKey) != m_channelMatrixMap.end ())
     {
       // channel matrix present in the map
       NS_LOG_DEBUG ("channel matrix present in the map");
       channelMatrix = m_channelMatrixMap[channelMatrixKey];
-      updateMatrix = ChannelMatrixNeedsUpdate (channelParams, channelMatrix);
+      updateMatrix = ChannelMatrixNeedsUpdate (channelParams, channelMatrix, aAntenna, bAntenna);
     }
   else
     {
-      NS_LOG_DEBUG ("channel matrix not found");
-      notFoundMatrix = true;
+      // the channel matrix may have been evicted to the spill file
+      channelMatrix = FaultInChannelMatrix (channelMatrixKey);
+      if (channelMatrix)
+        {
+          NS_LOG_DEBUG ("channel matrix read back from the spill file");
+          updateMatrix = ChannelMatrixNeedsUpdate (channelParams, channelMatrix, aAntenna, bAntenna);
+        }
+      else
+        {
+          NS_LOG_DEBUG ("channel matrix not found");
+          notFoundMatrix = true;
+        }
     }
 
   // If the channel is not present in the map or if it has to be updated
-  // generate a new realization
+  // generate a new realization. If only the antenna configuration has changed
+  // the cached channel params are reused, so no new random values are drawn.
   if (notFoundMatrix || updateMatrix)
     {
       // channel matrix not found or has to be updated, generate a new one
+      std::chrono::steady_clock::time_point start;
+      if (m_profiler)
+        {
+          start = NYULinkProfiler::Now ();
+        }
       channelMatrix = GetNewChannel (channelParams, tablenyu, aMob, bMob, aAntenna, bAntenna);
+      m_numChannelMatrixGenerations++;
+      if (m_profiler)
+        {
+          uint32_t aId = aMob->GetObject<Node> ()->GetId ();
+          uint32_t bId = bMob->GetObject<Node> ()->GetId ();
+          m_profiler->Record (NYULinkProfiler::MATRIX_GENERATION, aId, bId, start);
+          m_profiler->RecordMatrix (aId, bId, channelMatrixKey,
+                                    channelMatrix->m_channel.GetNumRows ()
+                                    * channelMatrix->m_channel.GetNumCols ()
+                                    * channelMatrix->m_channel.GetNumPages ());
+        }
       channelMatrix->m_antennaPair = std::make_pair (
         aAntenna->GetId (),
         bAntenna
         ->GetId ());       // save antenna pair, with the exact order of s and u antennas at the moment of the channel generation
 
-      // store or replace the channel matrix in the channel map
+      // store or replace the channel matrix in the channel map, together with
+      // the antenna epochs it has been generated with
       m_channelMatrixMap[channelMatrixKey] = channelMatrix;
+      m_channelMatrixEpochMap[channelMatrixKey] = std::make_pair (GetAntennaEpoch (aAntenna),
+                                                                  GetAntennaEpoch (bAntenna));
+      if (notFoundMatrix)
+        {
+          AddAntennaReference (aAntenna->GetId ());
+          AddAntennaReference (bAntenna->GetId ());
+        }
     }
+  TouchChannelMatrix (channelMatrixKey);
 
   return channelMatrix;
 }
@@ -664,17 +1319,1003 @@ NYUChannelModel::GetParams (Ptr<const MobilityModel> aMob, Ptr<const MobilityMod
   uint64_t channelParamsKey =
     GetKey (aMob->GetObject<Node> ()->GetId (), bMob->GetObject<Node> ()->GetId ());
 
+  std::vector<uint8_t> record;
   if (m_channelParamsMap.find (channelParamsKey) != m_channelParamsMap.end ())
     {
       return m_channelParamsMap.find (channelParamsKey)->second;
     }
-  else
+  else if (m_channelParamsSpill && m_channelParamsSpill->Get (channelParamsKey, record))
+    {
+      // the params are read from the spill file but they are moved back to the
+      // map only when the link is used through GetChannel
+      return DeserializeChannelParams (record);
+    }
+  else
     {
       NS_LOG_WARN ("Channel params map not found. Returning a nullptr.");
       return nullptr;
     }
 }
 
+size_t
+NYUChannelModel::GetNumCachedChannelParams () const
+{
+  return m_channelParamsMap.size ();
+}
+
+size_t
+NYUChannelModel::GetNumCachedChannelMatrices () const
+{
+  return m_channelMatrixMap.size ();
+}
+
+size_t
+NYUChannelModel::GetCachedChannelMatricesSize () const
+{
+  size_t size = 0;
+  for (const auto &entry : m_channelMatrixMap)
+    {
+      size += entry.second->m_channel.GetSize () * sizeof (std::complex<double>);
+    }
+  return size;
+}
+
+size_t
+NYUChannelModel::GetNumSpilledChannelParams () const
+{
+  return m_channelParamsSpill ? m_channelParamsSpill->GetNumRecords () : 0;
+}
+
+size_t
+NYUChannelModel::GetNumSpilledChannelMatrices () const
+{
+  return m_channelMatrixSpill ? m_channelMatrixSpill->GetNumRecords () : 0;
+}
+
+uint64_t
+NYUChannelModel::GetNumSpillFaults () const
+{
+  return m_numSpillFaults;
+}
+
+Ptr<NYUChannelSpillFile>
+NYUChannelModel::GetSpillFile (Ptr<NYUChannelSpillFile> &spillFile, const std::string &suffix)
+{
+  if (!spillFile && !m_spillFileName.empty ())
+    {
+      // the models of different carriers, and the replications forked by the
+      // same process, may use the same prefix
+      static uint32_t numSpillFiles = 0;
+      std::ostringstream fileName;
+      fileName << m_spillFileName << "-" << getpid () << "-" << numSpillFiles++ << suffix;
+      NS_LOG_DEBUG ("Opening the spill file " << fileName.str ());
+      spillFile = Create<NYUChannelSpillFile> (fileName.str ());
+    }
+  return spillFile;
+}
+
+void
+NYUChannelModel::TouchChannelParams (uint64_t channelParamsKey)
+{
+  if (m_maxCachedChannelParams == 0)
+    {
+      return;
+    }
+
+  m_channelParamsLru.Touch (channelParamsKey);
+  while (m_channelParamsMap.size () > m_maxCachedChannelParams && m_channelParamsLru.GetSize () > 1)
+    {
+      uint64_t evictedKey = m_channelParamsLru.GetOldest ();
+      Ptr<NYUChannelSpillFile> spillFile = GetSpillFile (m_channelParamsSpill, ".params");
+      if (spillFile)
+        {
+          std::vector<uint8_t> record;
+          SerializeChannelParams (m_channelParamsMap.at (evictedKey), record);
+          spillFile->Put (evictedKey, record);
+        }
+      NS_LOG_DEBUG ("Evicted the channel params with key " << evictedKey);
+      if (m_profiler)
+        {
+          const auto &nodeIds = m_channelParamsMap.at (evictedKey)->m_nodeIds;
+          m_profiler->ReleaseParams (nodeIds.first, nodeIds.second);
+        }
+      m_channelParamsMap.erase (evictedKey);
+      m_channelParamsLru.Erase (evictedKey);
+    }
+}
+
+void
+NYUChannelModel::TouchChannelMatrix (uint64_t channelMatrixKey)
+{
+  if (m_maxCachedChannelMatrices == 0)
+    {
+      return;
+    }
+
+  m_channelMatrixLru.Touch (channelMatrixKey);
+  while (m_channelMatrixMap.size () > m_maxCachedChannelMatrices && m_channelMatrixLru.GetSize () > 1)
+    {
+      uint64_t evictedKey = m_channelMatrixLru.GetOldest ();
+      Ptr<NYUChannelSpillFile> spillFile = GetSpillFile (m_channelMatrixSpill, ".matrices");
+      auto epochIt = m_channelMatrixEpochMap.find (evictedKey);
+      if (spillFile && epochIt != m_channelMatrixEpochMap.end ())
+        {
+          std::vector<uint8_t> record;
+          SerializeChannelMatrix (m_channelMatrixMap.at (evictedKey), epochIt->second, record);
+          spillFile->Put (evictedKey, record);
+        }
+      NS_LOG_DEBUG ("Evicted the channel matrix with key " << evictedKey);
+      if (m_profiler)
+        {
+          const auto &nodeIds = m_channelMatrixMap.at (evictedKey)->m_nodeIds;
+          m_profiler->ReleaseMatrix (nodeIds.first, nodeIds.second, evictedKey);
+        }
+      const auto &antennaPair = m_channelMatrixMap.at (evictedKey)->m_antennaPair;
+      RemoveAntennaReference (antennaPair.first);
+      RemoveAntennaReference (antennaPair.second);
+      m_channelMatrixMap.erase (evictedKey);
+      m_channelMatrixEpochMap.erase (evictedKey);
+      m_channelMatrixLru.Erase (evictedKey);
+      m_channelMatrixEvictedTrace (evictedKey);
+    }
+}
+
+void
+NYUChannelModel::TouchDominantBeams (uint64_t beamsKey)
+{
+  if (m_maxCachedChannelMatrices == 0)
+    {
+      return;
+    }
+
+  m_dominantBeamsLru.Touch (beamsKey);
+  while (m_dominantBeamsMap.size () > m_maxCachedChannelMatrices && m_dominantBeamsLru.GetSize () > 1)
+    {
+      uint64_t evictedKey = m_dominantBeamsLru.GetOldest ();
+      NS_LOG_DEBUG ("Discarded the dominant beams with key " << evictedKey);
+      Ptr<const DominantBeams> evicted = m_dominantBeamsMap.at (evictedKey);
+      RemoveAntennaReference (evicted->m_aAntennaId);
+      RemoveAntennaReference (evicted->m_bAntennaId);
+      m_dominantBeamsMap.erase (evictedKey);
+      m_dominantBeamsLru.Erase (evictedKey);
+    }
+}
+
+Ptr<NYUChannelModel::NYUChannelParams>
+NYUChannelModel::FaultInChannelParams (uint64_t channelParamsKey)
+{
+  std::vector<uint8_t> record;
+  if (!m_channelParamsSpill || !m_channelParamsSpill->Get (channelParamsKey, record))
+    {
+      return nullptr;
+    }
+  m_channelParamsSpill->Erase (channelParamsKey);
+  m_numSpillFaults++;
+  m_channelParamsTracker.Invalidate (channelParamsKey);
+
+  Ptr<NYUChannelParams> channelParams = DeserializeChannelParams (record);
+  m_channelParamsMap[channelParamsKey] = channelParams;
+  if (m_profiler)
+    {
+      m_profiler->RecordParams (channelParams->m_nodeIds.first, channelParams->m_nodeIds.second,
+                                channelParams->totalSubpaths, GetChannelParamsSize (channelParams));
+    }
+  return channelParams;
+}
+
+Ptr<MatrixBasedChannelModel::ChannelMatrix>
+NYUChannelModel::FaultInChannelMatrix (uint64_t channelMatrixKey)
+{
+  std::vector<uint8_t> record;
+  if (!m_channelMatrixSpill || !m_channelMatrixSpill->Get (channelMatrixKey, record))
+    {
+      return nullptr;
+    }
+  m_channelMatrixSpill->Erase (channelMatrixKey);
+  m_numSpillFaults++;
+  m_channelMatrixTracker.Invalidate (channelMatrixKey);
+
+  std::pair<uint64_t, uint64_t> epochs;
+  Ptr<ChannelMatrix> channelMatrix = DeserializeChannelMatrix (record, epochs);
+  m_channelMatrixMap[channelMatrixKey] = channelMatrix;
+  m_channelMatrixEpochMap[channelMatrixKey] = epochs;
+  AddAntennaReference (channelMatrix->m_antennaPair.first);
+  AddAntennaReference (channelMatrix->m_antennaPair.second);
+  if (m_profiler)
+    {
+      m_profiler->RecordMatrix (channelMatrix->m_nodeIds.first, channelMatrix->m_nodeIds.second, channelMatrixKey,
+                                channelMatrix->m_channel.GetNumRows ()
+                                * channelMatrix->m_channel.GetNumCols ()
+                                * channelMatrix->m_channel.GetNumPages ());
+    }
+  return channelMatrix;
+}
+
+void
+NYUChannelModel::SerializeChannelParams (Ptr<const NYUChannelParams> channelParams, std::vector<uint8_t> &buffer)
+{
+  AppendValue<int64_t> (buffer, channelParams->m_generatedTime.GetTimeStep ());
+  AppendValue<uint32_t> (buffer, channelParams->m_nodeIds.first);
+  AppendValue<uint32_t> (buffer, channelParams->m_nodeIds.second);
+  AppendValue<int32_t> (buffer, channelParams->m_losCondition);
+  AppendValue<int32_t> (buffer, channelParams->m_o2iCondition);
+  AppendValue<int32_t> (buffer, channelParams->numberOfTimeClusters);
+  AppendValue<int32_t> (buffer, channelParams->numberOfAoaSpatialLobes);
+  AppendValue<int32_t> (buffer, channelParams->numberOfAodSpatialLobes);
+  AppendValue<int32_t> (buffer, channelParams->totalSubpaths);
+  AppendValue<double> (buffer, channelParams->m_updatePhase);
+  AppendValue<uint8_t> (buffer, channelParams->m_compressedRays ? 1 : 0);
+  if (channelParams->m_compressedRays)
+    {
+      const CompressedRayTable &rays = *channelParams->m_compressedRays;
+      AppendValue<double> (buffer, rays.m_delayOffset);
+      AppendVector (buffer, rays.m_excessDelay);
+      AppendVector (buffer, rays.m_powerDb);
+      for (const auto &angle : rays.m_angle)
+        {
+          AppendVector (buffer, angle);
+        }
+      AppendVector (buffer, rays.m_phase);
+      AppendVector (buffer, rays.m_xpdAmplitude);
+    }
+  else
+    {
+      AppendVector (buffer, channelParams->m_delay);
+      AppendMatrix (buffer, channelParams->m_angle);
+      AppendMatrix (buffer, channelParams->powerSpectrum);
+      AppendMatrix (buffer, channelParams->subpathPhases);
+      AppendMatrix (buffer, channelParams->xpd);
+    }
+}
+
+Ptr<NYUChannelModel::NYUChannelParams>
+NYUChannelModel::DeserializeChannelParams (const std::vector<uint8_t> &buffer)
+{
+  Ptr<NYUChannelParams> channelParams = Create<NYUChannelParams> ();
+  size_t offset = 0;
+  channelParams->m_generatedTime = TimeStep (ReadValue<int64_t> (buffer, offset));
+  channelParams->m_nodeIds.first = ReadValue<uint32_t> (buffer, offset);
+  channelParams->m_nodeIds.second = ReadValue<uint32_t> (buffer, offset);
+  channelParams->m_losCondition = static_cast<ChannelCondition::LosConditionValue> (ReadValue<int32_t> (buffer, offset));
+  channelParams->m_o2iCondition = static_cast<ChannelCondition::O2iConditionValue> (ReadValue<int32_t> (buffer, offset));
+  channelParams->numberOfTimeClusters = ReadValue<int32_t> (buffer, offset);
+  channelParams->numberOfAoaSpatialLobes = ReadValue<int32_t> (buffer, offset);
+  channelParams->numberOfAodSpatialLobes = ReadValue<int32_t> (buffer, offset);
+  channelParams->totalSubpaths = ReadValue<int32_t> (buffer, offset);
+  channelParams->m_updatePhase = ReadValue<double> (buffer, offset);
+  if (ReadValue<uint8_t> (buffer, offset))
+    {
+      Ptr<CompressedRayTable> rays = Create<CompressedRayTable> ();
+      rays->m_delayOffset = ReadValue<double> (buffer, offset);
+      ReadVector (buffer, offset, rays->m_excessDelay);
+      ReadVector (buffer, offset, rays->m_powerDb);
+      for (auto &angle : rays->m_angle)
+        {
+          ReadVector (buffer, offset, angle);
+        }
+      ReadVector (buffer, offset, rays->m_phase);
+      ReadVector (buffer, offset, rays->m_xpdAmplitude);
+      channelParams->m_compressedRays = rays;
+      return channelParams;
+    }
+
+  ReadVector (buffer, offset, channelParams->m_delay);
+  ReadMatrix (buffer, offset, channelParams->m_angle);
+  ReadMatrix (buffer, offset, channelParams->powerSpectrum);
+  ReadMatrix (buffer, offset, channelParams->subpathPhases);
+  ReadMatrix (buffer, offset, channelParams->xpd);
+
+  // the per-ray angles and directions are obtained from m_angle as in GenerateChannelParameters
+  channelParams->rayAoaRadian = channelParams->m_angle[AOA_INDEX];
+  channelParams->rayZoaRadian = channelParams->m_angle[ZOA_INDEX];
+  channelParams->rayAodRadian = channelParams->m_angle[AOD_INDEX];
+  channelParams->rayZodRadian = channelParams->m_angle[ZOD_INDEX];
+  SetRayDirections (channelParams);
+  return channelParams;
+}
+
+void
+NYUChannelModel::SerializeChannelMatrix (Ptr<const ChannelMatrix> channelMatrix,
+                                         const std::pair<uint64_t, uint64_t> &epochs,
+                                         std::vector<uint8_t> &buffer)
+{
+  const Complex3DVector &channel = channelMatrix->m_channel;
+  AppendValue<int64_t> (buffer, channelMatrix->m_generatedTime.GetTimeStep ());
+  AppendValue<uint32_t> (buffer, channelMatrix->m_nodeIds.first);
+  AppendValue<uint32_t> (buffer, channelMatrix->m_nodeIds.second);
+  AppendValue<uint32_t> (buffer, channelMatrix->m_antennaPair.first);
+  AppendValue<uint32_t> (buffer, channelMatrix->m_antennaPair.second);
+  AppendValue<uint64_t> (buffer, epochs.first);
+  AppendValue<uint64_t> (buffer, epochs.second);
+  AppendValue<uint64_t> (buffer, channel.GetNumRows ());
+  AppendValue<uint64_t> (buffer, channel.GetNumCols ());
+  AppendValue<uint64_t> (buffer, channel.GetNumPages ());
+  if (channel.GetSize () > 0)
+    {
+      // the pages of a Complex3DVector are stored contiguously
+      const uint8_t *bytes = reinterpret_cast<const uint8_t *> (channel.GetPagePtr (0));
+      buffer.insert (buffer.end (), bytes, bytes + channel.GetSize () * sizeof (std::complex<double>));
+    }
+}
+
+Ptr<MatrixBasedChannelModel::ChannelMatrix>
+NYUChannelModel::DeserializeChannelMatrix (const std::vector<uint8_t> &buffer,
+                                           std::pair<uint64_t, uint64_t> &epochs)
+{
+  Ptr<ChannelMatrix> channelMatrix = Create<ChannelMatrix> ();
+  size_t offset = 0;
+  channelMatrix->m_generatedTime = TimeStep (ReadValue<int64_t> (buffer, offset));
+  channelMatrix->m_nodeIds.first = ReadValue<uint32_t> (buffer, offset);
+  channelMatrix->m_nodeIds.second = ReadValue<uint32_t> (buffer, offset);
+  channelMatrix->m_antennaPair.first = ReadValue<uint32_t> (buffer, offset);
+  channelMatrix->m_antennaPair.second = ReadValue<uint32_t> (buffer, offset);
+  epochs.first = ReadValue<uint64_t> (buffer, offset);
+  epochs.second = ReadValue<uint64_t> (buffer, offset);
+  uint64_t numRows = ReadValue<uint64_t> (buffer, offset);
+  uint64_t numCols = ReadValue<uint64_t> (buffer, offset);
+  uint64_t numPages = ReadValue<uint64_t> (buffer, offset);
+  Complex3DVector channel (numRows, numCols, numPages);
+  size_t size = numRows * numCols * numPages * sizeof (std::complex<double>);
+  NS_ASSERT_MSG (offset + size <= buffer.size (), "Truncated record");
+  if (size > 0)
+    {
+      std::memcpy (channel.GetPagePtr (0), buffer.data () + offset, size);
+    }
+  channelMatrix->m_channel = channel;
+  return channelMatrix;
+}
+
+void
+NYUChannelModel::SaveCheckpoint (std::vector<uint8_t> &buffer, bool full)
+{
+  NS_LOG_FUNCTION (this << full);
+  if (full)
+    {
+      m_channelParamsTracker.Clear ();
+      m_channelMatrixTracker.Clear ();
+      m_dominantBeamsTracker.Clear ();
+    }
+  AppendValue<uint8_t> (buffer, full ? 1 : 0);
+  m_uniformRv.SaveCheckpoint (buffer);
+  m_normalRv.SaveCheckpoint (buffer);
+  m_expRv.SaveCheckpoint (buffer);
+  AppendValue<uint64_t> (buffer, m_numChannelParamsGenerations);
+  AppendValue<uint64_t> (buffer, m_numChannelMatrixGenerations);
+  AppendValue<uint64_t> (buffer, m_numSpillFaults);
+  AppendValue<uint64_t> (buffer, m_numDeferredUpdates);
+  AppendValue<int64_t> (buffer, m_currentUpdateSlot);
+  AppendValue<uint32_t> (buffer, m_numUpdatesInSlot);
+  AppendValue<uint64_t> (buffer, m_lastAntennaEpoch);
+
+  // the antenna configurations, the pending updates and the usage order of
+  // the caches are small, they are written in full
+  AppendValue<uint64_t> (buffer, m_antennaConfigMap.size ());
+  for (const auto &entry : m_antennaConfigMap)
+    {
+      AppendValue<uint32_t> (buffer, entry.first);
+      AppendValue<uint64_t> (buffer, entry.second.m_epoch);
+      AppendValue<uint64_t> (buffer, entry.second.m_numElements);
+      AppendValue<double> (buffer, entry.second.m_lastElementLocation.x);
+      AppendValue<double> (buffer, entry.second.m_lastElementLocation.y);
+      AppendValue<double> (buffer, entry.second.m_lastElementLocation.z);
+      AppendValue<double> (buffer, entry.second.m_probeFieldPattern.first);
+      AppendValue<double> (buffer, entry.second.m_probeFieldPattern.second);
+    }
+  AppendValue<uint64_t> (buffer, m_pendingUpdates.size ());
+  for (const auto &entry : m_pendingUpdates)
+    {
+      AppendValue<uint64_t> (buffer, entry.first);
+      AppendValue<int64_t> (buffer, entry.second.first.GetTimeStep ());
+      AppendValue<int64_t> (buffer, entry.second.second.GetTimeStep ());
+    }
+  const std::list<uint64_t> &channelParamsOrder = m_channelParamsLru.GetKeys ();
+  AppendVector (buffer, std::vector<uint64_t> (channelParamsOrder.begin (), channelParamsOrder.end ()));
+  const std::list<uint64_t> &channelMatrixOrder = m_channelMatrixLru.GetKeys ();
+  AppendVector (buffer, std::vector<uint64_t> (channelMatrixOrder.begin (), channelMatrixOrder.end ()));
+  const std::list<uint64_t> &dominantBeamsOrder = m_dominantBeamsLru.GetKeys ();
+  AppendVector (buffer, std::vector<uint64_t> (dominantBeamsOrder.begin (), dominantBeamsOrder.end ()));
+
+  AppendCheckpointRecords (m_channelParamsMap, m_channelParamsSpill, m_channelParamsTracker,
+                           [] (uint64_t, Ptr<const NYUChannelParams> channelParams, std::vector<uint8_t> &record)
+                             {
+                               SerializeChannelParams (channelParams, record);
+                             },
+                           buffer);
+  AppendCheckpointRecords (m_channelMatrixMap, m_channelMatrixSpill, m_channelMatrixTracker,
+                           [this] (uint64_t key, Ptr<const ChannelMatrix> channelMatrix, std::vector<uint8_t> &record)
+                             {
+                               auto epochIt = m_channelMatrixEpochMap.find (key);
+                               SerializeChannelMatrix (channelMatrix,
+                                                       epochIt != m_channelMatrixEpochMap.end () ? epochIt->second : std::pair<uint64_t, uint64_t> (0, 0),
+                                                       record);
+                             },
+                           buffer);
+  AppendCheckpointRecords (m_dominantBeamsMap, nullptr, m_dominantBeamsTracker,
+                           [] (uint64_t, Ptr<const DominantBeams> beams, std::vector<uint8_t> &record)
+                             {
+                               AppendValue<int64_t> (record, beams->m_generatedTime.GetTimeStep ());
+                               AppendValue<uint32_t> (record, beams->m_aAntennaId);
+                               AppendValue<uint32_t> (record, beams->m_bAntennaId);
+                               AppendValue<uint64_t> (record, beams->m_aAntennaEpoch);
+                               AppendValue<uint64_t> (record, beams->m_bAntennaEpoch);
+                               AppendValue<double> (record, beams->m_gain);
+                               AppendValue<uint32_t> (record, beams->m_numIterations);
+                               for (const PhasedArrayModel::ComplexVector *w : {&beams->m_aW, &beams->m_bW})
+                                 {
+                                   AppendValue<uint64_t> (record, w->GetSize ());
+                                   for (size_t i = 0; i < w->GetSize (); i++)
+                                     {
+                                       AppendValue<std::complex<double> > (record, (*w)[i]);
+                                     }
+                                 }
+                             },
+                           buffer);
+}
+
+void
+NYUChannelModel::RestoreCheckpoint (const std::vector<uint8_t> &buffer)
+{
+  NS_LOG_FUNCTION (this);
+  size_t offset = 0;
+  if (ReadValue<uint8_t> (buffer, offset))
+    {
+      m_channelParamsMap.clear ();
+      m_channelMatrixMap.clear ();
+      m_channelMatrixEpochMap.clear ();
+      m_dominantBeamsMap.clear ();
+  m_dominantBeamsLru.Clear ();
+      m_channelParamsSpill = nullptr;
+      m_channelMatrixSpill = nullptr;
+      m_channelParamsTracker.Clear ();
+      m_channelMatrixTracker.Clear ();
+      m_dominantBeamsTracker.Clear ();
+    }
+  m_uniformRv.RestoreCheckpoint (buffer, offset);
+  m_normalRv.RestoreCheckpoint (buffer, offset);
+  m_expRv.RestoreCheckpoint (buffer, offset);
+  m_numChannelParamsGenerations = ReadValue<uint64_t> (buffer, offset);
+  m_numChannelMatrixGenerations = ReadValue<uint64_t> (buffer, offset);
+  m_numSpillFaults = ReadValue<uint64_t> (buffer, offset);
+  m_numDeferredUpdates = ReadValue<uint64_t> (buffer, offset);
+  m_currentUpdateSlot = ReadValue<int64_t> (buffer, offset);
+  m_numUpdatesInSlot = ReadValue<uint32_t> (buffer, offset);
+  m_lastAntennaEpoch = ReadValue<uint64_t> (buffer, offset);
+
+  m_antennaConfigMap.clear ();
+  uint64_t numAntennas = ReadValue<uint64_t> (buffer, offset);
+  for (uint64_t i = 0; i < numAntennas; i++)
+    {
+      AntennaConfig &config = m_antennaConfigMap[ReadValue<uint32_t> (buffer, offset)];
+      config.m_epoch = ReadValue<uint64_t> (buffer, offset);
+      config.m_numElements = ReadValue<uint64_t> (buffer, offset);
+      config.m_lastElementLocation.x = ReadValue<double> (buffer, offset);
+      config.m_lastElementLocation.y = ReadValue<double> (buffer, offset);
+      config.m_lastElementLocation.z = ReadValue<double> (buffer, offset);
+      config.m_probeFieldPattern.first = ReadValue<double> (buffer, offset);
+      config.m_probeFieldPattern.second = ReadValue<double> (buffer, offset);
+    }
+  m_pendingUpdates.clear ();
+  m_pendingUpdateOrder.clear ();
+  uint64_t numPendingUpdates = ReadValue<uint64_t> (buffer, offset);
+  for (uint64_t i = 0; i < numPendingUpdates; i++)
+    {
+      uint64_t key = ReadValue<uint64_t> (buffer, offset);
+      Time dueTime = TimeStep (ReadValue<int64_t> (buffer, offset));
+      Time lastRequest = TimeStep (ReadValue<int64_t> (buffer, offset));
+      m_pendingUpdates[key] = std::make_pair (dueTime, lastRequest);
+      m_pendingUpdateOrder.insert (std::make_pair (dueTime, key));
+    }
+  std::vector<uint64_t> channelParamsOrder;
+  ReadVector (buffer, offset, channelParamsOrder);
+  std::vector<uint64_t> channelMatrixOrder;
+  ReadVector (buffer, offset, channelMatrixOrder);
+  std::vector<uint64_t> dominantBeamsOrder;
+  ReadVector (buffer, offset, dominantBeamsOrder);
+
+  ReadCheckpointRecords (
+      buffer, offset,
+      [this] (uint64_t key, const std::vector<uint8_t> &record)
+        {
+          Ptr<NYUChannelParams> channelParams = DeserializeChannelParams (record);
+          m_channelParamsMap[key] = channelParams;
+          if (m_channelParamsSpill)
+            {
+              m_channelParamsSpill->Erase (key);
+            }
+          m_channelParamsTracker.Set (key, NYUCheckpointTracker::GetVersion (PeekPointer (channelParams), channelParams->m_generatedTime));
+        },
+      [this] (uint64_t key)
+        {
+          m_channelParamsMap.erase (key);
+          if (m_channelParamsSpill)
+            {
+              m_channelParamsSpill->Erase (key);
+            }
+          m_channelParamsTracker.Erase (key);
+        });
+  ReadCheckpointRecords (
+      buffer, offset,
+      [this] (uint64_t key, const std::vector<uint8_t> &record)
+        {
+          std::pair<uint64_t, uint64_t> epochs;
+          Ptr<ChannelMatrix> channelMatrix = DeserializeChannelMatrix (record, epochs);
+          m_channelMatrixMap[key] = channelMatrix;
+          m_channelMatrixEpochMap[key] = epochs;
+          if (m_channelMatrixSpill)
+            {
+              m_channelMatrixSpill->Erase (key);
+            }
+          m_channelMatrixTracker.Set (key, NYUCheckpointTracker::GetVersion (PeekPointer (channelMatrix), channelMatrix->m_generatedTime));
+        },
+      [this] (uint64_t key)
+        {
+          m_channelMatrixMap.erase (key);
+          m_channelMatrixEpochMap.erase (key);
+          if (m_channelMatrixSpill)
+            {
+              m_channelMatrixSpill->Erase (key);
+            }
+          m_channelMatrixTracker.Erase (key);
+        });
+  ReadCheckpointRecords (
+      buffer, offset,
+      [this] (uint64_t key, const std::vector<uint8_t> &record)
+        {
+          Ptr<DominantBeams> beams = Create<DominantBeams> ();
+          size_t recordOffset = 0;
+          beams->m_generatedTime = TimeStep (ReadValue<int64_t> (record, recordOffset));
+          beams->m_aAntennaId = ReadValue<uint32_t> (record, recordOffset);
+          beams->m_bAntennaId = ReadValue<uint32_t> (record, recordOffset);
+          beams->m_aAntennaEpoch = ReadValue<uint64_t> (record, recordOffset);
+          beams->m_bAntennaEpoch = ReadValue<uint64_t> (record, recordOffset);
+          beams->m_gain = ReadValue<double> (record, recordOffset);
+          beams->m_numIterations = ReadValue<uint32_t> (record, recordOffset);
+          for (PhasedArrayModel::ComplexVector *w : {&beams->m_aW, &beams->m_bW})
+            {
+              *w = PhasedArrayModel::ComplexVector (ReadValue<uint64_t> (record, recordOffset));
+              for (size_t i = 0; i < w->GetSize (); i++)
+                {
+                  (*w)[i] = ReadValue<std::complex<double> > (record, recordOffset);
+                }
+            }
+          m_dominantBeamsMap[key] = beams;
+          m_dominantBeamsTracker.Set (key, NYUCheckpointTracker::GetVersion (PeekPointer (beams), beams->m_generatedTime));
+        },
+      [this] (uint64_t key)
+        {
+          m_dominantBeamsMap.erase (key);
+          m_dominantBeamsTracker.Erase (key);
+        });
+  NS_ASSERT_MSG (offset == buffer.size (), "Malformed checkpoint of the channel model");
+
+  // restore the usage order of the bounded caches, and move back to the spill
+  // files the entries which were there at the time of the checkpoint
+  m_channelParamsLru.Clear ();
+  for (auto it = channelParamsOrder.rbegin (); it != channelParamsOrder.rend (); ++it)
+    {
+      m_channelParamsLru.Touch (*it);
+    }
+  if (m_maxCachedChannelParams > 0)
+    {
+      for (auto it = m_channelParamsMap.begin (); it != m_channelParamsMap.end ();)
+        {
+          if (m_channelParamsLru.Contains (it->first))
+            {
+              ++it;
+              continue;
+            }
+          Ptr<NYUChannelSpillFile> spillFile = GetSpillFile (m_channelParamsSpill, ".params");
+          NS_ASSERT_MSG (spillFile, "The checkpoint holds spilled channel params but SpillFileName is not set");
+          std::vector<uint8_t> record;
+          SerializeChannelParams (it->second, record);
+          spillFile->Put (it->first, record);
+          m_channelParamsTracker.Set (it->first, NYUCheckpointTracker::EXTERNAL_VERSION);
+          it = m_channelParamsMap.erase (it);
+        }
+    }
+  m_channelMatrixLru.Clear ();
+  for (auto it = channelMatrixOrder.rbegin (); it != channelMatrixOrder.rend (); ++it)
+    {
+      m_channelMatrixLru.Touch (*it);
+    }
+  if (m_maxCachedChannelMatrices > 0)
+    {
+      for (auto it = m_channelMatrixMap.begin (); it != m_channelMatrixMap.end ();)
+        {
+          if (m_channelMatrixLru.Contains (it->first))
+            {
+              ++it;
+              continue;
+            }
+          Ptr<NYUChannelSpillFile> spillFile = GetSpillFile (m_channelMatrixSpill, ".matrices");
+          NS_ASSERT_MSG (spillFile, "The checkpoint holds spilled channel matrices but SpillFileName is not set");
+          std::vector<uint8_t> record;
+          SerializeChannelMatrix (it->second, m_channelMatrixEpochMap[it->first], record);
+          spillFile->Put (it->first, record);
+          m_channelMatrixTracker.Set (it->first, NYUCheckpointTracker::EXTERNAL_VERSION);
+          m_channelMatrixEpochMap.erase (it->first);
+          it = m_channelMatrixMap.erase (it);
+        }
+    }
+  m_dominantBeamsLru.Clear ();
+  for (auto it = dominantBeamsOrder.rbegin (); it != dominantBeamsOrder.rend (); ++it)
+    {
+      m_dominantBeamsLru.Touch (*it);
+    }
+  UpdateAntennaReferences ();
+}
+
+uint64_t
+NYUChannelModel::GetNumChannelParamsGenerations () const
+{
+  return m_numChannelParamsGenerations;
+}
+
+uint64_t
+NYUChannelModel::GetNumChannelMatrixGenerations () const
+{
+  return m_numChannelMatrixGenerations;
+}
+
+Ptr<const NYUChannelModel::CompressedRayTable>
+NYUChannelModel::GetCompressedRayTable (Ptr<const ChannelParams> channelParams)
+{
+  Ptr<const NYUChannelParams> nyuChannelParams = DynamicCast<const NYUChannelParams> (channelParams);
+  if (!nyuChannelParams)
+    {
+      return nullptr;
+    }
+  return nyuChannelParams->m_compressedRays;
+}
+
+bool
+NYUChannelModel::GetRayDirections (Ptr<const ChannelParams> channelParams,
+                                   bool isSameDirection,
+                                   const std::vector<Vector> *&sRayDirections,
+                                   const std::vector<Vector> *&uRayDirections)
+{
+  Ptr<const NYUChannelParams> nyuChannelParams = DynamicCast<const NYUChannelParams> (channelParams);
+  if (!nyuChannelParams || nyuChannelParams->m_compressedRays
+      || nyuChannelParams->m_departureDirections.size () != static_cast<size_t> (nyuChannelParams->totalSubpaths))
+    {
+      return false;
+    }
+  sRayDirections = isSameDirection ? &nyuChannelParams->m_departureDirections : &nyuChannelParams->m_arrivalDirections;
+  uRayDirections = isSameDirection ? &nyuChannelParams->m_arrivalDirections : &nyuChannelParams->m_departureDirections;
+  return true;
+}
+
+size_t
+NYUChannelModel::GetCachedChannelParamsSize () const
+{
+  size_t size = 0;
+  for (const auto &entry : m_channelParamsMap)
+    {
+      size += GetChannelParamsSize (entry.second);
+    }
+  return size;
+}
+
+size_t
+NYUChannelModel::GetChannelParamsSize (Ptr<const NYUChannelParams> p)
+{
+  auto vectorSize = [] (const MatrixBasedChannelModel::DoubleVector &v) {
+    return v.size () * sizeof (double);
+  };
+  auto matrixSize = [&vectorSize] (const MatrixBasedChannelModel::Double2DVector &m) {
+    size_t size = 0;
+    for (const auto &v : m)
+      {
+        size += vectorSize (v);
+      }
+    return size;
+  };
+
+  size_t size = sizeof (NYUChannelParams);
+  size += vectorSize (p->numberOfSubpathInTimeCluster) + vectorSize (p->delayOfTimeCluster)
+    + vectorSize (p->timeClusterPowers) + vectorSize (p->rayAodRadian)
+    + vectorSize (p->rayAoaRadian) + vectorSize (p->rayZodRadian)
+    + vectorSize (p->rayZoaRadian) + vectorSize (p->m_delay);
+  size += matrixSize (p->subpathDelayInTimeCluster) + matrixSize (p->subpathPhases)
+    + matrixSize (p->subpathPowers) + matrixSize (p->absoluteSubpathDelayinTimeCluster)
+    + matrixSize (p->subpathAodZod) + matrixSize (p->subpathAoaZoa)
+    + matrixSize (p->powerSpectrumOld) + matrixSize (p->powerSpectrum)
+    + matrixSize (p->xpd) + matrixSize (p->m_angle);
+  size += (p->m_departureDirections.size () + p->m_arrivalDirections.size ()) * sizeof (Vector);
+  if (p->m_compressedRays)
+    {
+      const CompressedRayTable &rays = *p->m_compressedRays;
+      size += sizeof (CompressedRayTable);
+      size += rays.m_excessDelay.size () * sizeof (float) + rays.m_powerDb.size () * sizeof (float);
+      for (const auto &angle : rays.m_angle)
+        {
+          size += angle.size () * sizeof (int16_t);
+        }
+      size += rays.m_phase.size () * sizeof (std::array<uint16_t, 4>);
+      size += rays.m_xpdAmplitude.size () * sizeof (std::array<float, 3>);
+    }
+  return size;
+}
+
+void
+NYUChannelModel::SetProfiler (Ptr<NYULinkProfiler> profiler)
+{
+  NS_LOG_FUNCTION (this);
+  m_profiler = profiler;
+}
+
+Ptr<NYULinkProfiler>
+NYUChannelModel::GetProfiler () const
+{
+  return m_profiler;
+}
+
+PhasedArrayModel::ComplexVector
+NYUChannelModel::GetSisoRayCoefficients (Ptr<const MobilityModel> aMob,
+                                         Ptr<const MobilityModel> bMob,
+                                         Ptr<const PhasedArrayModel> aAntenna,
+                                         Ptr<const PhasedArrayModel> bAntenna)
+{
+  NS_LOG_FUNCTION (this);
+
+  NS_ASSERT_MSG (aAntenna->GetNumberOfElements () == 1 && bAntenna->GetNumberOfElements () == 1,
+                 "The SISO channel is defined only for single element antennas");
+
+  Ptr<const ChannelCondition> condition = m_channelConditionModel->GetChannelCondition (aMob, bMob);
+  Ptr<const NYUChannelParams> channelParams = GetUpdatedChannelParams (condition, aMob, bMob);
+  return CalcSisoRayCoefficients (channelParams, aMob, bMob, aAntenna, bAntenna);
+}
+
+PhasedArrayModel::ComplexVector
+NYUChannelModel::PeekSisoRayCoefficients (Ptr<const MobilityModel> aMob,
+                                          Ptr<const MobilityModel> bMob,
+                                          Ptr<const PhasedArrayModel> aAntenna,
+                                          Ptr<const PhasedArrayModel> bAntenna) const
+{
+  NS_LOG_FUNCTION (this);
+
+  NS_ASSERT_MSG (aAntenna->GetNumberOfElements () == 1 && bAntenna->GetNumberOfElements () == 1,
+                 "The SISO channel is defined only for single element antennas");
+
+  uint64_t channelParamsKey = GetKey (aMob->GetObject<Node> ()->GetId (), bMob->GetObject<Node> ()->GetId ());
+  auto paramsIt = m_channelParamsMap.find (channelParamsKey);
+  if (paramsIt == m_channelParamsMap.end ())
+    {
+      return PhasedArrayModel::ComplexVector ();
+    }
+  return CalcSisoRayCoefficients (paramsIt->second, aMob, bMob, aAntenna, bAntenna);
+}
+
+Ptr<const MatrixBasedChannelModel::ChannelMatrix>
+NYUChannelModel::PeekChannel (Ptr<const PhasedArrayModel> aAntenna,
+                              Ptr<const PhasedArrayModel> bAntenna) const
+{
+  NS_LOG_FUNCTION (this);
+  auto matrixIt = m_channelMatrixMap.find (GetKey (aAntenna->GetId (), bAntenna->GetId ()));
+  return (matrixIt != m_channelMatrixMap.end ()) ? matrixIt->second : nullptr;
+}
+
+Ptr<const MatrixBasedChannelModel::ChannelParams>
+NYUChannelModel::PeekParams (Ptr<const MobilityModel> aMob, Ptr<const MobilityModel> bMob) const
+{
+  NS_LOG_FUNCTION (this);
+  uint64_t channelParamsKey = GetKey (aMob->GetObject<Node> ()->GetId (), bMob->GetObject<Node> ()->GetId ());
+  auto paramsIt = m_channelParamsMap.find (channelParamsKey);
+  return (paramsIt != m_channelParamsMap.end ()) ? paramsIt->second : nullptr;
+}
+
+PhasedArrayModel::ComplexVector
+NYUChannelModel::CalcSisoRayCoefficients (Ptr<const NYUChannelParams> channelParams,
+                                          Ptr<const MobilityModel> aMob,
+                                          Ptr<const MobilityModel> bMob,
+                                          Ptr<const PhasedArrayModel> aAntenna,
+                                          Ptr<const PhasedArrayModel> bAntenna) const
+{
+  // a is the s node and b is the u node, check if channelParams structure is
+  // generated in direction s-to-u or u-to-s
+  bool isSameDirection = (channelParams->m_nodeIds == std::make_pair (aMob->GetObject<Node> ()->GetId (),
+                                                                      bMob->GetObject<Node> ()->GetId ()));
+  MatrixBasedChannelModel::Double2DVector decodedAngles;
+  const MatrixBasedChannelModel::DoubleVector *rayAodRadian;
+  const MatrixBasedChannelModel::DoubleVector *rayZodRadian;
+  const MatrixBasedChannelModel::DoubleVector *rayAoaRadian;
+  const MatrixBasedChannelModel::DoubleVector *rayZoaRadian;
+  GetRayAngles (channelParams, isSameDirection, decodedAngles, rayAodRadian, rayZodRadian, rayAoaRadian, rayZoaRadian);
+
+  // Geometrical direction used for LOS ray
+  Angles sAngle (bMob->GetPosition (), aMob->GetPosition ());
+  Angles uAngle (aMob->GetPosition (), bMob->GetPosition ());
+  bool los = (channelParams->m_losCondition == ChannelCondition::LOS);
+
+  Vector uLoc = bAntenna->GetElementLocation (0);
+  Vector sLoc = aAntenna->GetElementLocation (0);
+  std::complex<double> weights = bAntenna->GetBeamformingVector ()[0] * aAntenna->GetBeamformingVector ()[0];
+
+  const std::vector<Vector> *sStoredDirections = nullptr;
+  const std::vector<Vector> *uStoredDirections = nullptr;
+  bool storedDirections = GetRayDirections (channelParams, isSameDirection, sStoredDirections, uStoredDirections);
+
+  PhasedArrayModel::ComplexVector rayCoefficients (channelParams->totalSubpaths);
+  for (int nIndex = 0; nIndex < channelParams->totalSubpaths; nIndex++)
+    {
+      // if LOS then ray 1 is AOD and AOA , ZOD and ZOA are aligned
+      Angles rxAngle = (los && nIndex == 0) ? uAngle : Angles ((*rayAoaRadian)[nIndex], (*rayZoaRadian)[nIndex]);
+      Angles txAngle = (los && nIndex == 0) ? sAngle : Angles ((*rayAodRadian)[nIndex], (*rayZodRadian)[nIndex]);
+      Vector rxDirection = (storedDirections && !(los && nIndex == 0)) ? (*uStoredDirections)[nIndex]
+        : GetRayDirection (rxAngle.GetAzimuth (), rxAngle.GetInclination ());
+      Vector txDirection = (storedDirections && !(los && nIndex == 0)) ? (*sStoredDirections)[nIndex]
+        : GetRayDirection (txAngle.GetAzimuth (), txAngle.GetInclination ());
+      double rxPhaseDiff = 2 * M_PI * (rxDirection.x * uLoc.x + rxDirection.y * uLoc.y + rxDirection.z * uLoc.z);
+      double txPhaseDiff = 2 * M_PI * (txDirection.x * sLoc.x + txDirection.y * sLoc.y + txDirection.z * sLoc.z);
+      rayCoefficients[nIndex] = GetRayCoefficient (channelParams, nIndex,
+                                                   bAntenna->GetElementFieldPattern (rxAngle),
+                                                   aAntenna->GetElementFieldPattern (txAngle)) *
+        std::complex<double> (cos (rxPhaseDiff + txPhaseDiff), sin (rxPhaseDiff + txPhaseDiff)) * weights;
+    }
+
+  return rayCoefficients;
+}
+
+std::complex<double>
+NYUChannelModel::GetRayCoefficient (Ptr<const NYUChannelParams> channelParams,
+                                    uint32_t nIndex,
+                                    const std::pair<double, double> &rxFieldPattern,
+                                    const std::pair<double, double> &txFieldPattern) const
+{
+  double rxFieldPatternPhi, rxFieldPatternTheta, txFieldPatternPhi, txFieldPatternTheta;
+  std::tie (rxFieldPatternPhi, rxFieldPatternTheta) = rxFieldPattern;
+  std::tie (txFieldPatternPhi, txFieldPatternTheta) = txFieldPattern;
+
+  if (channelParams->m_compressedRays)
+    {
+      const CompressedRayTable &rays = *channelParams->m_compressedRays;
+      std::complex<double> ray = std::polar (1.0, rays.GetPhase (nIndex, 0)) *
+        rxFieldPatternTheta * txFieldPatternTheta +
+        std::polar (1.0, rays.GetPhase (nIndex, 1)) * static_cast<double> (rays.m_xpdAmplitude[nIndex][1]) *
+        rxFieldPatternTheta * txFieldPatternPhi +
+        std::polar (1.0, rays.GetPhase (nIndex, 2)) * static_cast<double> (rays.m_xpdAmplitude[nIndex][2]) *
+        rxFieldPatternPhi * txFieldPatternTheta +
+        std::polar (1.0, rays.GetPhase (nIndex, 3)) * static_cast<double> (rays.m_xpdAmplitude[nIndex][0]) *
+        rxFieldPatternPhi * txFieldPatternPhi;
+      return ray * sqrt (rays.GetPower (nIndex));
+    }
+
+  std::complex<double> ray = std::complex<double> (cos (channelParams->subpathPhases[nIndex][0]),
+                                                   sin (channelParams->subpathPhases[nIndex][0])) *
+    rxFieldPatternTheta * txFieldPatternTheta +
+    std::complex<double> (cos (channelParams->subpathPhases[nIndex][1]),
+                          sin (channelParams->subpathPhases[nIndex][1])) *
+    std::sqrt (1 / GetDbToPow (channelParams->xpd[nIndex][1])) *
+    rxFieldPatternTheta * txFieldPatternPhi +
+    std::complex<double> (cos (channelParams->subpathPhases[nIndex][2]),
+                          sin (channelParams->subpathPhases[nIndex][2])) *
+    std::sqrt (1 / GetDbToPow (channelParams->xpd[nIndex][2])) *
+    rxFieldPatternPhi * txFieldPatternTheta +
+    std::complex<double> (cos (channelParams->subpathPhases[nIndex][3]),
+                          sin (channelParams->subpathPhases[nIndex][3])) *
+    std::sqrt (1 / GetDbToPow (channelParams->xpd[nIndex][0])) *
+    rxFieldPatternPhi * txFieldPatternPhi;
+
+  return ray * sqrt (channelParams->powerSpectrum[nIndex][1]);
+}
+
+void
+NYUChannelModel::CompressChannelParams (Ptr<NYUChannelParams> channelParams) const
+{
+  NS_LOG_FUNCTION (this);
+
+  uint32_t numRays = channelParams->totalSubpaths;
+  Ptr<CompressedRayTable> rays = Create<CompressedRayTable> ();
+  rays->m_excessDelay.resize (numRays);
+  rays->m_powerDb.resize (numRays);
+  rays->m_phase.resize (numRays);
+  rays->m_xpdAmplitude.resize (numRays);
+  for (auto &angle : rays->m_angle)
+    {
+      angle.resize (numRays);
+    }
+
+  // the delays are stored relative to the first ray, so that the float
+  // precision is spent on the excess delays which determine the frequency
+  // selectivity of the channel
+  rays->m_delayOffset = numRays > 0 ? channelParams->m_delay[0] : 0;
+  for (uint32_t n = 0; n < numRays; n++)
+    {
+      rays->m_excessDelay[n] = static_cast<float> (channelParams->m_delay[n] - rays->m_delayOffset);
+      rays->m_powerDb[n] = static_cast<float> (10 * log10 (channelParams->powerSpectrum[n][1]));
+      for (uint8_t i = 0; i < 4; i++)
+        {
+          rays->m_angle[i][n] = CompressedRayTable::EncodeAngle (channelParams->m_angle[i][n]);
+          rays->m_phase[n][i] = CompressedRayTable::EncodePhase (channelParams->subpathPhases[n][i]);
+        }
+      for (uint8_t i = 0; i < 3; i++)
+        {
+          rays->m_xpdAmplitude[n][i] = static_cast<float> (std::sqrt (1 / GetDbToPow (channelParams->xpd[n][i])));
+        }
+    }
+  channelParams->m_compressedRays = rays;
+
+  // release the memory held by the uncompressed vectors
+  MatrixBasedChannelModel::DoubleVector ().swap (channelParams->numberOfSubpathInTimeCluster);
+  MatrixBasedChannelModel::DoubleVector ().swap (channelParams->delayOfTimeCluster);
+  MatrixBasedChannelModel::DoubleVector ().swap (channelParams->timeClusterPowers);
+  MatrixBasedChannelModel::DoubleVector ().swap (channelParams->rayAodRadian);
+  MatrixBasedChannelModel::DoubleVector ().swap (channelParams->rayAoaRadian);
+  MatrixBasedChannelModel::DoubleVector ().swap (channelParams->rayZodRadian);
+  MatrixBasedChannelModel::DoubleVector ().swap (channelParams->rayZoaRadian);
+  MatrixBasedChannelModel::DoubleVector ().swap (channelParams->m_delay);
+  MatrixBasedChannelModel::Double2DVector ().swap (channelParams->subpathDelayInTimeCluster);
+  MatrixBasedChannelModel::Double2DVector ().swap (channelParams->subpathPhases);
+  MatrixBasedChannelModel::Double2DVector ().swap (channelParams->subpathPowers);
+  MatrixBasedChannelModel::Double2DVector ().swap (channelParams->absoluteSubpathDelayinTimeCluster);
+  MatrixBasedChannelModel::Double2DVector ().swap (channelParams->subpathAodZod);
+  MatrixBasedChannelModel::Double2DVector ().swap (channelParams->subpathAoaZoa);
+  MatrixBasedChannelModel::Double2DVector ().swap (channelParams->powerSpectrumOld);
+  MatrixBasedChannelModel::Double2DVector ().swap (channelParams->powerSpectrum);
+  MatrixBasedChannelModel::Double2DVector ().swap (channelParams->xpd);
+  MatrixBasedChannelModel::Double2DVector ().swap (channelParams->m_angle);
+  std::vector<Vector> ().swap (channelParams->m_departureDirections);
+  std::vector<Vector> ().swap (channelParams->m_arrivalDirections);
+}
+
+void
+NYUChannelModel::GetRayAngles (Ptr<const NYUChannelParams> channelParams,
+                               bool isSameDirection,
+                               MatrixBasedChannelModel::Double2DVector &decodedAngles,
+                               const MatrixBasedChannelModel::DoubleVector *&rayAodRadian,
+                               const MatrixBasedChannelModel::DoubleVector *&rayZodRadian,
+                               const MatrixBasedChannelModel::DoubleVector *&rayAoaRadian,
+                               const MatrixBasedChannelModel::DoubleVector *&rayZoaRadian) const
+{
+  if (channelParams->m_compressedRays)
+    {
+      const CompressedRayTable &rays = *channelParams->m_compressedRays;
+      uint32_t numRays = channelParams->totalSubpaths;
+      decodedAngles.assign (4, MatrixBasedChannelModel::DoubleVector (numRays));
+      uint8_t aodIndex = isSameDirection ? AOD_INDEX : AOA_INDEX;
+      uint8_t zodIndex = isSameDirection ? ZOD_INDEX : ZOA_INDEX;
+      uint8_t aoaIndex = isSameDirection ? AOA_INDEX : AOD_INDEX;
+      uint8_t zoaIndex = isSameDirection ? ZOA_INDEX : ZOD_INDEX;
+      for (uint32_t n = 0; n < numRays; n++)
+        {
+          decodedAngles[AOD_INDEX][n] = rays.GetAngle (aodIndex, n);
+          decodedAngles[ZOD_INDEX][n] = rays.GetAngle (zodIndex, n);
+          decodedAngles[AOA_INDEX][n] = rays.GetAngle (aoaIndex, n);
+          decodedAngles[ZOA_INDEX][n] = rays.GetAngle (zoaIndex, n);
+        }
+      rayAodRadian = &decodedAngles[AOD_INDEX];
+      rayZodRadian = &decodedAngles[ZOD_INDEX];
+      rayAoaRadian = &decodedAngles[AOA_INDEX];
+      rayZoaRadian = &decodedAngles[ZOA_INDEX];
+    }
+  else if (isSameDirection)
+    {
+      rayAodRadian = &channelParams->rayAodRadian;
+      rayZodRadian = &channelParams->rayZodRadian;
+      rayAoaRadian = &channelParams->rayAoaRadian;
+      rayZoaRadian = &channelParams->rayZoaRadian;
+    }
+  else
+    {
+      rayAodRadian = &channelParams->rayAoaRadian;
+      rayAoaRadian = &channelParams->rayAodRadian;
+      rayZodRadian = &channelParams->rayZoaRadian;
+      rayZoaRadian = &channelParams->rayZodRadian;
+    }
+}
+
+void
+NYUChannelModel::SetRayDirections (Ptr<NYUChannelParams> channelParams)
+{
+  channelParams->m_departureDirections.resize (channelParams->totalSubpaths);
+  channelParams->m_arrivalDirections.resize (channelParams->totalSubpaths);
+  for (int i = 0; i < channelParams->totalSubpaths; i++)
+    {
+      channelParams->m_departureDirections[i] = GetRayDirection (channelParams->rayAodRadian[i], channelParams->rayZodRadian[i]);
+      channelParams->m_arrivalDirections[i] = GetRayDirection (channelParams->rayAoaRadian[i], channelParams->rayZoaRadian[i]);
+    }
+}
+
 // Main code to generate channel parameters
 Ptr<NYUChannelModel::NYUChannelParams>
 NYUChannelModel::GenerateChannelParameters (const Ptr<const ChannelCondition> channelCondition,
@@ -837,6 +2478,10 @@ NYUChannelModel::GenerateChannelParameters (const Ptr<const ChannelCondition> ch
   // Stores the total number of subpaths after BW adjustment and excluding weak subpaths
   channelParams->totalSubpaths = channelParams->powerSpectrum.size ();
 
+  // Store the unit direction vector of each SP at both nodes, so that the steering
+  // vectors and the Doppler terms are computed without trigonometric functions
+  SetRayDirections (channelParams);
+
   NS_LOG_DEBUG ("Total Number of SP is:" << channelParams->totalSubpaths);
 
   return channelParams;
@@ -861,32 +2506,6 @@ NYUChannelModel::GetNewChannel (Ptr<const NYUChannelParams> channelParams,
   // save in which order is generated this matrix
   channelMatrix->m_nodeIds =
     std::make_pair (sMob->GetObject<Node> ()->GetId (), uMob->GetObject<Node> ()->GetId ());
-  // check if channelParams structure is generated in direction s-to-u or u-to-s
-  bool isSameDirection = (channelParams->m_nodeIds == channelMatrix->m_nodeIds);
-
-  MatrixBasedChannelModel::DoubleVector rayAodRadian;
-  MatrixBasedChannelModel::DoubleVector rayZodRadian;
-  MatrixBasedChannelModel::DoubleVector rayAoaRadian;
-  MatrixBasedChannelModel::DoubleVector rayZoaRadian;
-
-  // if channel params is generated in the same direction in which we
-  // generate the channel matrix, angles and zenit od departure and arrival are ok,
-  // just set them to corresponding variable that will be used for the generation
-  // of channel matrix, otherwise we need to flip angles and zenits of departure and arrival
-  if (isSameDirection)
-    {
-      rayAodRadian = channelParams->rayAodRadian;
-      rayZodRadian = channelParams->rayZodRadian;
-      rayAoaRadian = channelParams->rayAoaRadian;
-      rayZoaRadian = channelParams->rayZoaRadian;
-    }
-  else
-    {
-      rayAodRadian = channelParams->rayAoaRadian;
-      rayAoaRadian = channelParams->rayAodRadian;
-      rayZodRadian = channelParams->rayZoaRadian;
-      rayZoaRadian = channelParams->rayZodRadian;
-    }
 
   //Step 11: Generate channel coefficients for each ray n and each receiver
   // and transmitter element pair u,s.
@@ -896,95 +2515,28 @@ NYUChannelModel::GetNewChannel (Ptr<const NYUChannelParams> channelParams,
 
   Complex3DVector hUsn(uSize,sSize,channelParams->totalSubpaths); //channel coffecient hUsn[u][s][n];
 
-  // Geometrical direction used for LOS ray
-  Angles sAngle (uMob->GetPosition (), sMob->GetPosition ());
-  Angles uAngle (sMob->GetPosition (), uMob->GetPosition ());
-
-  // The following for loops computes the channel coefficients
-  for (uint64_t uIndex = 0; uIndex < uSize; uIndex++)
+  // The ray amplitude (polarization, XPD and element field patterns) does not depend on the
+  // element index, hence it is computed once per ray together with the ray directions
+  std::vector<std::complex<double>> rayCoefficients;
+  std::vector<Vector> rxRayDirections;
+  std::vector<Vector> txRayDirections;
+  ComputeRayFactors (channelParams, tablenyu->los, sMob, uMob, sAntenna, uAntenna,
+                     rayCoefficients, txRayDirections, rxRayDirections);
+
+  // steering phasors of the rx and tx elements for each ray, uPhasors[u][n] and sPhasors[s][n]
+  Complex2DVector uPhasors = GetSteeringPhasors (uAntenna, rxRayDirections);
+  Complex2DVector sPhasors = GetSteeringPhasors (sAntenna, txRayDirections);
+
+  // The following for loops computes the channel coefficients, the inner loop runs
+  // over the u index which is the contiguous one in the Complex3DVector storage
+  for (int nIndex = 0; nIndex < channelParams->totalSubpaths; nIndex++)
     {
-      Vector uLoc = uAntenna->GetElementLocation (uIndex);
       for (uint64_t sIndex = 0; sIndex < sSize; sIndex++)
         {
-          Vector sLoc = sAntenna->GetElementLocation (sIndex);
-          for (uint8_t nIndex = 0; nIndex < channelParams->totalSubpaths; nIndex++)
+          std::complex<double> txTerm = rayCoefficients[nIndex] * sPhasors (sIndex, nIndex);
+          for (uint64_t uIndex = 0; uIndex < uSize; uIndex++)
             {
-              std::complex<double> rays (0, 0);
-              // if LOS then ray 1 is AOD and AOA , ZOD and ZOA are aligned
-              if (tablenyu->los && nIndex == 0)
-                {
-                  double rxPhaseDiff = 2 * M_PI * (sin (uAngle.GetInclination ()) * cos (uAngle.GetAzimuth ()) * uLoc.x +
-                                                   sin (uAngle.GetInclination ()) * sin (uAngle.GetAzimuth ()) * uLoc.y +
-                                                   cos (uAngle.GetInclination ()) * uLoc.z);
-                  double txPhaseDiff = 2 * M_PI * (sin (sAngle.GetInclination ()) * cos (sAngle.GetAzimuth ()) * sLoc.x +
-                                                   sin (sAngle.GetInclination ()) * sin (sAngle.GetAzimuth ()) * sLoc.y +
-                                                   cos (sAngle.GetInclination ()) * sLoc.z);
-                  double rxFieldPatternPhi, rxFieldPatternTheta, txFieldPatternPhi,txFieldPatternTheta;
-                  std::tie (rxFieldPatternPhi, rxFieldPatternTheta) = uAntenna->GetElementFieldPattern (Angles (uAngle.GetAzimuth (),
-                                                                                                                uAngle.GetInclination ()));
-                  std::tie (txFieldPatternPhi, txFieldPatternTheta) = sAntenna->GetElementFieldPattern (Angles (sAngle.GetAzimuth (),
-                                                                                                                sAngle.GetInclination ()));
-                  rays = (std::complex<double> (cos (channelParams->subpathPhases[nIndex][0]),
-                                                sin (channelParams->subpathPhases[nIndex][0])) *
-                          rxFieldPatternTheta * txFieldPatternTheta +
-                          std::complex<double> (cos (channelParams->subpathPhases[nIndex][1]),
-                                                sin (channelParams->subpathPhases[nIndex][1])) *
-                          std::sqrt (1 / GetDbToPow (channelParams->xpd[nIndex][1])) *
-                          rxFieldPatternTheta * txFieldPatternPhi +
-                          std::complex<double> (cos (channelParams->subpathPhases[nIndex][2]),
-                                                sin (channelParams->subpathPhases[nIndex][2])) *
-                          std::sqrt (1 / GetDbToPow (channelParams->xpd[nIndex][2])) *
-                          rxFieldPatternPhi * txFieldPatternTheta +
-                          std::complex<double> (cos (channelParams->subpathPhases[nIndex][3]),
-                                                sin (channelParams->subpathPhases[nIndex][3])) *
-                          std::sqrt (1 / GetDbToPow (channelParams->xpd[nIndex][0])) *
-                          rxFieldPatternPhi * txFieldPatternPhi) *
-                    std::complex<double> (cos (rxPhaseDiff), sin (rxPhaseDiff)) *
-                    std::complex<double> (cos (txPhaseDiff), sin (txPhaseDiff));
-                  rays *= sqrt (channelParams->powerSpectrum[nIndex][1]);
-                  hUsn(uIndex,sIndex,nIndex) = rays;
-                }
-              else
-                {
-                  double rxPhaseDiff =
-                    2 * M_PI *
-                    (sin (rayZoaRadian[nIndex]) * cos (rayAoaRadian[nIndex]) * uLoc.x +
-                     sin (rayZoaRadian[nIndex]) * sin (rayAoaRadian[nIndex]) * uLoc.y +
-                     cos (rayZoaRadian[nIndex]) * uLoc.z);
-
-                  double txPhaseDiff =
-                    2 * M_PI *
-                    (sin (rayZodRadian[nIndex]) * cos (rayAodRadian[nIndex]) * sLoc.x +
-                     sin (rayZodRadian[nIndex]) * sin (rayAodRadian[nIndex]) * sLoc.y +
-                     cos (rayZodRadian[nIndex]) * sLoc.z);
-                  double rxFieldPatternPhi, rxFieldPatternTheta, txFieldPatternPhi,
-                         txFieldPatternTheta;
-                  std::tie (rxFieldPatternPhi, rxFieldPatternTheta) =
-                    uAntenna->GetElementFieldPattern (
-                      Angles (rayAoaRadian[nIndex], rayZoaRadian[nIndex]));
-                  std::tie (txFieldPatternPhi, txFieldPatternTheta) =
-                    sAntenna->GetElementFieldPattern (
-                      Angles (rayAodRadian[nIndex], rayZodRadian[nIndex]));
-                  rays = (std::complex<double> (cos (channelParams->subpathPhases[nIndex][0]),
-                                                sin (channelParams->subpathPhases[nIndex][0])) *
-                          rxFieldPatternTheta * txFieldPatternTheta +
-                          std::complex<double> (cos (channelParams->subpathPhases[nIndex][1]),
-                                                sin (channelParams->subpathPhases[nIndex][1])) *
-                          std::sqrt (1 / GetDbToPow (channelParams->xpd[nIndex][1])) *
-                          rxFieldPatternTheta * txFieldPatternPhi +
-                          std::complex<double> (cos (channelParams->subpathPhases[nIndex][2]),
-                                                sin (channelParams->subpathPhases[nIndex][2])) *
-                          std::sqrt (1 / GetDbToPow (channelParams->xpd[nIndex][2])) *
-                          rxFieldPatternPhi * txFieldPatternTheta +
-                          std::complex<double> (cos (channelParams->subpathPhases[nIndex][3]),
-                                                sin (channelParams->subpathPhases[nIndex][3])) *
-                          std::sqrt (1 / GetDbToPow (channelParams->xpd[nIndex][0])) *
-                          rxFieldPatternPhi * txFieldPatternPhi) *
-                    std::complex<double> (cos (rxPhaseDiff), sin (rxPhaseDiff)) *
-                    std::complex<double> (cos (txPhaseDiff), sin (txPhaseDiff));
-                  rays *= sqrt (channelParams->powerSpectrum[nIndex][1]);
-                  hUsn(uIndex,sIndex,nIndex) = rays;
-                }
+              hUsn(uIndex,sIndex,nIndex) = txTerm * uPhasors (uIndex, nIndex);
             }
         }
     }
@@ -1013,13 +2565,470 @@ NYUChannelModel::GetNewChannel (Ptr<const NYUChannelParams> channelParams,
   return channelMatrix;
 }
 
+void
+NYUChannelModel::ComputeRayFactors (Ptr<const NYUChannelParams> channelParams,
+                                    bool los,
+                                    Ptr<const MobilityModel> sMob,
+                                    Ptr<const MobilityModel> uMob,
+                                    Ptr<const PhasedArrayModel> sAntenna,
+                                    Ptr<const PhasedArrayModel> uAntenna,
+                                    std::vector<std::complex<double> > &rayCoefficients,
+                                    std::vector<Vector> &sRayDirections,
+                                    std::vector<Vector> &uRayDirections) const
+{
+  NS_LOG_FUNCTION (this);
+
+  // check if channelParams structure is generated in direction s-to-u or u-to-s
+  bool isSameDirection = (channelParams->m_nodeIds == std::make_pair (sMob->GetObject<Node> ()->GetId (),
+                                                                      uMob->GetObject<Node> ()->GetId ()));
+
+  // if channel params is generated in the same direction in which we
+  // generate the channel matrix, angles and zenit od departure and arrival are ok,
+  // just set them to corresponding variable that will be used for the generation
+  // of channel matrix, otherwise we need to flip angles and zenits of departure and arrival
+  MatrixBasedChannelModel::Double2DVector decodedAngles;
+  const MatrixBasedChannelModel::DoubleVector *rayAodRadian;
+  const MatrixBasedChannelModel::DoubleVector *rayZodRadian;
+  const MatrixBasedChannelModel::DoubleVector *rayAoaRadian;
+  const MatrixBasedChannelModel::DoubleVector *rayZoaRadian;
+  GetRayAngles (channelParams, isSameDirection, decodedAngles, rayAodRadian, rayZodRadian, rayAoaRadian, rayZoaRadian);
+
+  // Geometrical direction used for LOS ray
+  Angles sAngle (uMob->GetPosition (), sMob->GetPosition ());
+  Angles uAngle (sMob->GetPosition (), uMob->GetPosition ());
+
+  // the direction vectors stored with the channel params are used when available
+  const std::vector<Vector> *sStoredDirections = nullptr;
+  const std::vector<Vector> *uStoredDirections = nullptr;
+  bool storedDirections = GetRayDirections (channelParams, isSameDirection, sStoredDirections, uStoredDirections);
+
+  rayCoefficients.resize (channelParams->totalSubpaths);
+  uRayDirections.resize (channelParams->totalSubpaths);
+  sRayDirections.resize (channelParams->totalSubpaths);
+  for (int nIndex = 0; nIndex < channelParams->totalSubpaths; nIndex++)
+    {
+      // if LOS then ray 1 is AOD and AOA , ZOD and ZOA are aligned
+      Angles rxAngle = (los && nIndex == 0) ? uAngle : Angles ((*rayAoaRadian)[nIndex], (*rayZoaRadian)[nIndex]);
+      Angles txAngle = (los && nIndex == 0) ? sAngle : Angles ((*rayAodRadian)[nIndex], (*rayZodRadian)[nIndex]);
+      if (storedDirections && !(los && nIndex == 0))
+        {
+          uRayDirections[nIndex] = (*uStoredDirections)[nIndex];
+          sRayDirections[nIndex] = (*sStoredDirections)[nIndex];
+        }
+      else
+        {
+          uRayDirections[nIndex] = GetRayDirection (rxAngle.GetAzimuth (), rxAngle.GetInclination ());
+          sRayDirections[nIndex] = GetRayDirection (txAngle.GetAzimuth (), txAngle.GetInclination ());
+        }
+      rayCoefficients[nIndex] = GetRayCoefficient (channelParams, nIndex,
+                                                   uAntenna->GetElementFieldPattern (rxAngle),
+                                                   sAntenna->GetElementFieldPattern (txAngle));
+    }
+}
+
+void
+NYUChannelModel::GetRayFactors (Ptr<const MobilityModel> sMob,
+                                Ptr<const MobilityModel> uMob,
+                                Ptr<const PhasedArrayModel> sAntenna,
+                                Ptr<const PhasedArrayModel> uAntenna,
+                                std::vector<std::complex<double> > &rayCoefficients,
+                                std::vector<Vector> &sRayDirections,
+                                std::vector<Vector> &uRayDirections)
+{
+  NS_LOG_FUNCTION (this);
+
+  Ptr<const ChannelCondition> condition = m_channelConditionModel->GetChannelCondition (sMob, uMob);
+  Ptr<const NYUChannelParams> channelParams = GetUpdatedChannelParams (condition, sMob, uMob);
+  ComputeRayFactors (channelParams, GetNYUTable (condition)->los, sMob, uMob, sAntenna, uAntenna,
+                     rayCoefficients, sRayDirections, uRayDirections);
+}
+
+Ptr<const NYUChannelModel::ChannelTimeSeries>
+NYUChannelModel::GetChannelTimeSeries (Ptr<const MobilityModel> aMob,
+                                       Ptr<const MobilityModel> bMob,
+                                       Ptr<const PhasedArrayModel> aAntenna,
+                                       Ptr<const PhasedArrayModel> bAntenna,
+                                       Time t0,
+                                       Time dt,
+                                       uint32_t numSamples)
+{
+  NS_LOG_FUNCTION (this << t0 << dt << numSamples);
+  NS_ASSERT_MSG (m_frequency > 0.0, "Set the operating frequency first!");
+  NS_ABORT_MSG_IF (numSamples == 0, "At least one snapshot is needed");
+  // the channel params would be regenerated within a longer window
+  NS_ABORT_MSG_IF (!m_updatePeriod.IsZero () && dt.GetTimeStep () * (numSamples - 1) > m_updatePeriod.GetTimeStep (),
+                   "The window of " << numSamples << " snapshots every " << dt.As (Time::MS)
+                   << " is longer than the UpdatePeriod " << m_updatePeriod.As (Time::MS));
+
+  Ptr<const ChannelCondition> condition = m_channelConditionModel->GetChannelCondition (aMob, bMob);
+  Ptr<const NYUChannelParams> channelParams = GetUpdatedChannelParams (condition, aMob, bMob);
+
+  std::vector<std::complex<double> > rayCoefficients;
+  std::vector<Vector> sRayDirections;
+  std::vector<Vector> uRayDirections;
+  ComputeRayFactors (channelParams, GetNYUTable (condition)->los, aMob, bMob, aAntenna, bAntenna,
+                     rayCoefficients, sRayDirections, uRayDirections);
+  Complex2DVector uPhasors = GetSteeringPhasors (bAntenna, uRayDirections);
+  Complex2DVector sPhasors = GetSteeringPhasors (aAntenna, sRayDirections);
+
+  Ptr<ChannelTimeSeries> series = Create<ChannelTimeSeries> ();
+  series->m_t0 = t0;
+  series->m_dt = dt;
+  series->m_numSamples = numSamples;
+  series->m_numRows = bAntenna->GetNumberOfElements ();
+  series->m_numCols = aAntenna->GetNumberOfElements ();
+  series->m_numRays = channelParams->totalSubpaths;
+  series->m_nodeIds = std::make_pair (aMob->GetObject<Node> ()->GetId (), bMob->GetObject<Node> ()->GetId ());
+  series->m_delay.resize (series->m_numRays);
+  for (size_t nIndex = 0; nIndex < series->m_numRays; nIndex++)
+    {
+      series->m_delay[nIndex] = channelParams->m_compressedRays ? channelParams->m_compressedRays->GetDelay (nIndex)
+        : channelParams->m_delay[nIndex];
+    }
+
+  size_t pageSize = series->m_numRows * series->m_numCols;
+  series->m_cube.resize (pageSize * series->m_numRays);
+  series->m_doppler.resize (numSamples * series->m_numRays);
+
+  // Doppler frequency of each ray, as in NYUSpectrumPropagationLossModel::CalcBeamformingGain
+  Vector sSpeed = aMob->GetVelocity ();
+  Vector uSpeed = bMob->GetVelocity ();
+  double factor = 2 * M_PI * m_frequency / M_C;
+
+  for (size_t nIndex = 0; nIndex < series->m_numRays; nIndex++)
+    {
+      // the coefficients of the ray without the Doppler phase, H(u, s, n)
+      std::complex<double> *page = series->m_cube.data () + nIndex * pageSize;
+      for (size_t sIndex = 0; sIndex < series->m_numCols; sIndex++)
+        {
+          std::complex<double> txTerm = rayCoefficients[nIndex] * sPhasors (sIndex, nIndex);
+          for (size_t uIndex = 0; uIndex < series->m_numRows; uIndex++)
+            {
+              page[uIndex + series->m_numRows * sIndex] = txTerm * uPhasors (uIndex, nIndex);
+            }
+        }
+
+      // the Doppler phase of the ray evolves by the same step between consecutive snapshots
+      const Vector &kU = uRayDirections[nIndex];
+      const Vector &kS = sRayDirections[nIndex];
+      double doppler = factor * ((kU.x * uSpeed.x + kU.y * uSpeed.y + kU.z * uSpeed.z)
+                                 + (kS.x * sSpeed.x + kS.y * sSpeed.y + kS.z * sSpeed.z));
+      std::complex<double> phasor = std::polar (1.0, doppler * t0.GetSeconds ());
+      std::complex<double> step = std::polar (1.0, doppler * dt.GetSeconds ());
+      for (uint32_t k = 0; k < numSamples; k++)
+        {
+          // recompute the phasor periodically to avoid the accumulation of rounding errors
+          if (k > 0 && k % 1024 == 0)
+            {
+              phasor = std::polar (1.0, doppler * (t0.GetSeconds () + k * dt.GetSeconds ()));
+            }
+          series->m_doppler[k * series->m_numRays + nIndex] = phasor;
+          phasor *= step;
+        }
+    }
+
+  return series;
+}
+
+Ptr<const NYUChannelModel::DominantBeams>
+NYUChannelModel::GetDominantBeams (Ptr<const MobilityModel> aMob,
+                                   Ptr<const MobilityModel> bMob,
+                                   Ptr<const PhasedArrayModel> aAntenna,
+                                   Ptr<const PhasedArrayModel> bAntenna)
+{
+  NS_LOG_FUNCTION (this);
+
+  Ptr<const ChannelCondition> condition = m_channelConditionModel->GetChannelCondition (aMob, bMob);
+  Ptr<const NYUChannelParams> channelParams = GetUpdatedChannelParams (condition, aMob, bMob);
+
+  size_t sSize = aAntenna->GetNumberOfElements ();
+  size_t uSize = bAntenna->GetNumberOfElements ();
+
+  // the beams are reciprocal, the ones cached for b-to-a are swapped
+  uint64_t beamsKey = GetKey (aAntenna->GetId (), bAntenna->GetId ());
+  Ptr<const DominantBeams> cached;
+  auto it = m_dominantBeamsMap.find (beamsKey);
+  if (it != m_dominantBeamsMap.end ())
+    {
+      cached = it->second;
+      if (cached->m_aAntennaId != aAntenna->GetId ())
+        {
+          Ptr<DominantBeams> swapped = Create<DominantBeams> (*cached);
+          std::swap (swapped->m_aAntennaId, swapped->m_bAntennaId);
+          std::swap (swapped->m_aAntennaEpoch, swapped->m_bAntennaEpoch);
+          std::swap (swapped->m_aW, swapped->m_bW);
+          cached = swapped;
+        }
+      if (cached->m_generatedTime == channelParams->m_generatedTime
+          && cached->m_aAntennaEpoch == GetAntennaEpoch (aAntenna)
+          && cached->m_bAntennaEpoch == GetAntennaEpoch (bAntenna)
+          && cached->m_aW.GetSize () == sSize && cached->m_bW.GetSize () == uSize)
+        {
+          NS_LOG_DEBUG ("dominant beams found in the map");
+          TouchDominantBeams (beamsKey);
+          return cached;
+        }
+    }
+
+  std::vector<std::complex<double> > rayCoefficients;
+  std::vector<Vector> sRayDirections;
+  std::vector<Vector> uRayDirections;
+  ComputeRayFactors (channelParams, GetNYUTable (condition)->los, aMob, bMob, aAntenna, bAntenna,
+                     rayCoefficients, sRayDirections, uRayDirections);
+  Complex2DVector uPhasors = GetSteeringPhasors (bAntenna, uRayDirections);
+  Complex2DVector sPhasors = GetSteeringPhasors (aAntenna, sRayDirections);
+  size_t numRays = rayCoefficients.size ();
+
+  // start from the previous beam of a if it is available, otherwise from the
+  // beam matched to the strongest ray
+  std::vector<std::complex<double> > sW (sSize);
+  if (cached && cached->m_aW.GetSize () == sSize)
+    {
+      for (size_t sIndex = 0; sIndex < sSize; sIndex++)
+        {
+          sW[sIndex] = cached->m_aW[sIndex];
+        }
+    }
+  else
+    {
+      size_t strongest = 0;
+      for (size_t nIndex = 1; nIndex < numRays; nIndex++)
+        {
+          if (std::norm (rayCoefficients[nIndex]) > std::norm (rayCoefficients[strongest]))
+            {
+              strongest = nIndex;
+            }
+        }
+      for (size_t sIndex = 0; sIndex < sSize; sIndex++)
+        {
+          sW[sIndex] = std::conj (sPhasors (sIndex, strongest)) / std::sqrt (static_cast<double> (sSize));
+        }
+    }
+
+  // H sW = sum_n c_n (sum_s S(s, n) sW_s) U(:, n), hence each product with H
+  // (or H^H) goes through the N ray weights
+  std::vector<std::complex<double> > rayWeights (numRays);
+  std::vector<std::complex<double> > hs (uSize);
+  auto multiplyH = [&] () {
+    for (size_t nIndex = 0; nIndex < numRays; nIndex++)
+      {
+        std::complex<double> sum (0.0, 0.0);
+        for (size_t sIndex = 0; sIndex < sSize; sIndex++)
+          {
+            sum += sPhasors (sIndex, nIndex) * sW[sIndex];
+          }
+        rayWeights[nIndex] = rayCoefficients[nIndex] * sum;
+      }
+    std::fill (hs.begin (), hs.end (), std::complex<double> (0.0, 0.0));
+    double norm = 0;
+    for (size_t nIndex = 0; nIndex < numRays; nIndex++)
+      {
+        for (size_t uIndex = 0; uIndex < uSize; uIndex++)
+          {
+            hs[uIndex] += uPhasors (uIndex, nIndex) * rayWeights[nIndex];
+          }
+      }
+    for (size_t uIndex = 0; uIndex < uSize; uIndex++)
+      {
+        norm += std::norm (hs[uIndex]);
+      }
+    return norm;
+  };
+
+  // power iteration on H^H H, since sW has unit norm ||H sW||^2 is the
+  // Rayleigh quotient, which converges to the squared dominant singular value
+  double gain = multiplyH ();
+  uint32_t iteration = 0;
+  while (iteration < m_maxPowerIterations && gain > 0)
+    {
+      iteration++;
+      for (size_t nIndex = 0; nIndex < numRays; nIndex++)
+        {
+          std::complex<double> sum (0.0, 0.0);
+          for (size_t uIndex = 0; uIndex < uSize; uIndex++)
+            {
+              sum += std::conj (uPhasors (uIndex, nIndex)) * hs[uIndex];
+            }
+          rayWeights[nIndex] = std::conj (rayCoefficients[nIndex]) * sum;
+        }
+      double norm = 0;
+      for (size_t sIndex = 0; sIndex < sSize; sIndex++)
+        {
+          sW[sIndex] = std::complex<double> (0.0, 0.0);
+          for (size_t nIndex = 0; nIndex < numRays; nIndex++)
+            {
+              sW[sIndex] += std::conj (sPhasors (sIndex, nIndex)) * rayWeights[nIndex];
+            }
+          norm += std::norm (sW[sIndex]);
+        }
+      norm = std::sqrt (norm);
+      for (size_t sIndex = 0; sIndex < sSize; sIndex++)
+        {
+          sW[sIndex] /= norm;
+        }
+      double previousGain = gain;
+      gain = multiplyH ();
+      if (gain - previousGain <= 1e-9 * gain)
+        {
+          break;
+        }
+    }
+  NS_LOG_DEBUG ("dominant beams computed with " << iteration << " power iterations, gain " << gain);
+
+  Ptr<DominantBeams> beams = Create<DominantBeams> ();
+  beams->m_generatedTime = channelParams->m_generatedTime;
+  beams->m_aAntennaId = aAntenna->GetId ();
+  beams->m_bAntennaId = bAntenna->GetId ();
+  beams->m_aAntennaEpoch = GetAntennaEpoch (aAntenna);
+  beams->m_bAntennaEpoch = GetAntennaEpoch (bAntenna);
+  beams->m_aW = PhasedArrayModel::ComplexVector (sSize);
+  beams->m_bW = PhasedArrayModel::ComplexVector (uSize);
+  for (size_t sIndex = 0; sIndex < sSize; sIndex++)
+    {
+      beams->m_aW[sIndex] = sW[sIndex];
+    }
+  // the long term component is bW^T H aW, hence the beam of b is the conjugate
+  // of the dominant left singular vector H aW / ||H aW||
+  double hsNorm = std::sqrt (gain);
+  for (size_t uIndex = 0; uIndex < uSize; uIndex++)
+    {
+      beams->m_bW[uIndex] = hsNorm > 0 ? std::conj (hs[uIndex]) / hsNorm : std::complex<double> (0.0, 0.0);
+    }
+  beams->m_gain = gain;
+  beams->m_numIterations = iteration;
+  if (!cached)
+    {
+      AddAntennaReference (aAntenna->GetId ());
+      AddAntennaReference (bAntenna->GetId ());
+    }
+  m_dominantBeamsMap[beamsKey] = beams;
+  TouchDominantBeams (beamsKey);
+  return beams;
+}
+
+bool
+NYUChannelModel::GetUpaLattice (Ptr<const PhasedArrayModel> antenna,
+                                uint32_t &numRows,
+                                uint32_t &numColumns,
+                                Vector &rowStep,
+                                Vector &columnStep) const
+{
+  NS_LOG_FUNCTION (this);
+
+  if (!DynamicCast<const UniformPlanarArray> (antenna))
+    {
+      return false;
+    }
+
+  UintegerValue uintValue;
+  antenna->GetAttribute ("NumColumns", uintValue);
+  numColumns = uintValue.Get ();
+  antenna->GetAttribute ("NumRows", uintValue);
+  numRows = uintValue.Get ();
+  if (numColumns * numRows != antenna->GetNumberOfElements () || numColumns * numRows < 2)
+    {
+      return false;
+    }
+
+  // element (row, col) has index row * numColumns + col, the element 0 is the origin of the array
+  Vector origin = antenna->GetElementLocation (0);
+  columnStep = Vector (0, 0, 0);
+  rowStep = Vector (0, 0, 0);
+  if (numColumns > 1)
+    {
+      columnStep = antenna->GetElementLocation (1) - origin;
+    }
+  if (numRows > 1)
+    {
+      rowStep = antenna->GetElementLocation (numColumns) - origin;
+    }
+
+  // make sure that the element locations lie on the lattice
+  const double tolerance = 1e-9;
+  for (uint32_t row = 0; row < numRows; row++)
+    {
+      for (uint32_t col = 0; col < numColumns; col++)
+        {
+          Vector loc = antenna->GetElementLocation (row * numColumns + col);
+          Vector expected = Vector (origin.x + row * rowStep.x + col * columnStep.x,
+                                    origin.y + row * rowStep.y + col * columnStep.y,
+                                    origin.z + row * rowStep.z + col * columnStep.z);
+          if (CalculateDistance (loc, expected) > tolerance)
+            {
+              NS_LOG_DEBUG ("Element locations do not follow the UPA lattice");
+              return false;
+            }
+        }
+    }
+  return true;
+}
+
+MatrixBasedChannelModel::Complex2DVector
+NYUChannelModel::GetSteeringPhasors (Ptr<const PhasedArrayModel> antenna,
+                                     const std::vector<Vector> &rayDirections) const
+{
+  NS_LOG_FUNCTION (this);
+
+  uint64_t size = antenna->GetNumberOfElements ();
+  Complex2DVector phasors (size, rayDirections.size ());
+
+  uint32_t numRows = 0;
+  uint32_t numColumns = 0;
+  Vector rowStep;
+  Vector columnStep;
+  if (GetUpaLattice (antenna, numRows, numColumns, rowStep, columnStep))
+    {
+      // The steering vector of a UPA is the Kronecker product of a row and a column
+      // steering vector, hence only numRows + numColumns phasors per ray are computed
+      // and the remaining ones are obtained by multiplication
+      Vector origin = antenna->GetElementLocation (0);
+      std::vector<std::complex<double>> rowPhasors (numRows);
+      std::vector<std::complex<double>> columnPhasors (numColumns);
+      for (size_t nIndex = 0; nIndex < rayDirections.size (); nIndex++)
+        {
+          const Vector &k = rayDirections[nIndex];
+          double originPhase = 2 * M_PI * (k.x * origin.x + k.y * origin.y + k.z * origin.z);
+          double rowPhase = 2 * M_PI * (k.x * rowStep.x + k.y * rowStep.y + k.z * rowStep.z);
+          double columnPhase = 2 * M_PI * (k.x * columnStep.x + k.y * columnStep.y + k.z * columnStep.z);
+          for (uint32_t row = 0; row < numRows; row++)
+            {
+              rowPhasors[row] = std::polar (1.0, originPhase + row * rowPhase);
+            }
+          for (uint32_t col = 0; col < numColumns; col++)
+            {
+              columnPhasors[col] = std::polar (1.0, col * columnPhase);
+            }
+          for (uint32_t row = 0; row < numRows; row++)
+            {
+              for (uint32_t col = 0; col < numColumns; col++)
+                {
+                  phasors (row * numColumns + col, nIndex) = rowPhasors[row] * columnPhasors[col];
+                }
+            }
+        }
+    }
+  else
+    {
+      for (uint64_t index = 0; index < size; index++)
+        {
+          Vector loc = antenna->GetElementLocation (index);
+          for (size_t nIndex = 0; nIndex < rayDirections.size (); nIndex++)
+            {
+              const Vector &k = rayDirections[nIndex];
+              phasors (index, nIndex) = std::polar (1.0, 2 * M_PI * (k.x * loc.x + k.y * loc.y + k.z * loc.z));
+            }
+        }
+    }
+  return phasors;
+}
+
 int64_t
 NYUChannelModel::AssignStreams (int64_t stream)
 {
   NS_LOG_FUNCTION (this << stream);
-  m_normalRv->SetStream (stream);
-  m_uniformRv->SetStream (stream + 1);
-  m_expRv->SetStream (stream + 2);
+  m_normalRv.SetStream (stream);
+  m_uniformRv.SetStream (stream + 1);
+  m_expRv.SetStream (stream + 2);
   return 3;
 }
 
@@ -1027,10 +3036,17 @@ int
 NYUChannelModel::GetPoissionDist (double lambda) const
 {
   NS_LOG_FUNCTION (this << lambda);
-  std::random_device rd;
-  std::mt19937 gen (rd ());
-  std::poisson_distribution<int> distribution (lambda);
-  double value = distribution (gen);
+  // Knuth's method, drawing from the uniform random variable of the model so
+  // that the channels are reproducible and can be checkpointed. The means of
+  // the NYUSIM distributions are small, so few values are drawn.
+  double threshold = std::exp (-lambda);
+  double product = m_uniformRv.GetValue (0, 1);
+  int value = 0;
+  while (product > threshold)
+    {
+      product *= m_uniformRv.GetValue (0, 1);
+      value++;
+    }
   NS_LOG_DEBUG (" Value in Pois Dist is:" << value);
   return value;
 }
@@ -1039,7 +3055,7 @@ int
 NYUChannelModel::GetDiscreteUniformDist (const double min, const double max) const
 {
   NS_LOG_FUNCTION (this << min << max);
-  int value = m_uniformRv->GetInteger (min, max);
+  int value = m_uniformRv.GetInteger (min, max);
   NS_LOG_DEBUG (" Value in Uniform Dist is:" << (double) value << ",min is:" << min
                                              << ", max is:" << max);
   return value;
@@ -1049,7 +3065,7 @@ double
 NYUChannelModel::GetUniformDist (const double min, const double max) const
 {
   NS_LOG_FUNCTION (this << min << max);
-  double value = m_uniformRv->GetValue (min, max);
+  double value = m_uniformRv.GetValue (min, max);
   NS_LOG_DEBUG (" Value in Uniform Dist is:" << (double) value << ",min is:" << min
                                              << ", max is:" << max);
   return value;
@@ -1059,8 +3075,8 @@ double
 NYUChannelModel::GetExponentialDist (double lambda) const
 {
   NS_LOG_FUNCTION (this << lambda);
-  m_expRv->SetAttribute ("Mean", DoubleValue (lambda));
-  double value = m_expRv->GetValue ();
+  // no bound, as in the attributes of the random variable
+  double value = m_expRv.GetValue (lambda, 0);
   NS_LOG_DEBUG ("Value in Exp Dist is:" << value);
   return value;
 }
@@ -1070,9 +3086,36 @@ NYUChannelModel::GetGammaDist (double alpha, double beta) const
 {
   double value = 0;
   NS_LOG_FUNCTION (this << alpha << beta);
-  m_gammaRv->SetAttribute ("Alpha", DoubleValue (alpha));
-  m_gammaRv->SetAttribute ("Beta", DoubleValue (beta));
-  value = m_gammaRv->GetValue ();
+  // the method of Marsaglia and Tsang, as in GammaRandomVariable, drawing from
+  // the normal and uniform random variables of the model: the number of values
+  // drawn depends on alpha, hence a GammaRandomVariable could not be replayed by
+  // the checkpoints
+  double boost = 1;
+  if (alpha < 1)
+    {
+      boost = std::pow (m_uniformRv.GetValue (0, 1), 1 / alpha);
+      alpha += 1;
+    }
+  double d = alpha - 1.0 / 3;
+  double c = 1 / std::sqrt (9 * d);
+  while (true)
+    {
+      double x;
+      double v;
+      do
+        {
+          x = m_normalRv.GetValue ();
+          v = 1 + c * x;
+        }
+      while (v <= 0);
+      v = v * v * v;
+      double u = m_uniformRv.GetValue (0, 1);
+      if (u < 1 - 0.0331 * x * x * x * x || std::log (u) < 0.5 * x * x + d * (1 - v + std::log (v)))
+        {
+          value = beta * d * v * boost;
+          break;
+        }
+    }
   NS_LOG_DEBUG ("Value in Gamma Dist is:" << value);
   return value;
 }
@@ -1081,10 +3124,15 @@ int
 NYUChannelModel::GetBinomialDist (double trials, double success) const
 {
   NS_LOG_FUNCTION (this << trials << success);
-  std::random_device rd;
-  std::mt19937 gen (rd ());
-  std::binomial_distribution<int> distribution (trials,success);
-  double value = distribution (gen);
+  // the sum of Bernoulli trials drawn from the uniform random variable of the model
+  int value = 0;
+  for (int trial = 0; trial < trials; trial++)
+    {
+      if (m_uniformRv.GetValue (0, 1) < success)
+        {
+          value++;
+        }
+    }
   NS_LOG_DEBUG (" Value in Binomial Dist is:" << value);
   return value;
 }
@@ -1516,7 +3564,7 @@ NYUChannelModel::GetClusterPowers (MatrixBasedChannelModel::DoubleVector getClus
 
   for (i = 0; i < numTC; i++)
     {
-      shadowing = sigmaCluster * m_normalRv->GetValue ();
+      shadowing = sigmaCluster * m_normalRv.GetValue ();
       z.push_back (shadowing);
     }
 
@@ -1593,7 +3641,7 @@ NYUChannelModel::GetSubpathPowers (MatrixBasedChannelModel::Double2DVector subpa
       // Shadowing values for all SP in a TC
       for (j = 0; j < numberOfSubpathInTimeCluster; j++)
         {
-          shadowing = sigmaSubpath * m_normalRv->GetValue ();
+          shadowing = sigmaSubpath * m_normalRv.GetValue ();
           u.push_back (shadowing);
         }
 
@@ -1769,7 +3817,7 @@ NYUChannelModel::GetSubpathMappingAndAngles (int numberOfSpatialLobes,
   // compute mean elevation and azimuth angles
   for (i = 0; i < numberOfSpatialLobes; i++)
     {
-      tmp_mean_elev_angle = mean + sigma * m_normalRv->GetValue ();
+      tmp_mean_elev_angle = mean + sigma * m_normalRv.GetValue ();
       tmp_mean_azi_angle = theta_min_array[i] + (theta_max_array[i] - theta_min_array[i]) * GetUniformDist (0, 1);
       mean_ElevationAngles.push_back (tmp_mean_elev_angle);
       mean_AzimuthAngles.push_back (tmp_mean_azi_angle);
@@ -1794,7 +3842,7 @@ NYUChannelModel::GetSubpathMappingAndAngles (int numberOfSpatialLobes,
           // Azimuth Distribution Spread
           if (azimuthDistributionType.compare ("Gaussian") == 0)
             {
-              deltaAzi = stdRMSLobeAzimuthSpread * m_normalRv->GetValue ();
+              deltaAzi = stdRMSLobeAzimuthSpread * m_normalRv.GetValue ();
             }
           else if (azimuthDistributionType.compare ("Laplacian") == 0)
             {
@@ -1810,7 +3858,7 @@ NYUChannelModel::GetSubpathMappingAndAngles (int numberOfSpatialLobes,
           // Elevation Distribution Spread
           if (elevationDistributionType.compare ("Gaussian") == 0)
             {
-              deltaElev = stdRMSLobeElevationSpread * m_normalRv->GetValue ();
+              deltaElev = stdRMSLobeElevationSpread * m_normalRv.GetValue ();
             }
           else if (elevationDistributionType.compare ("Laplacian") == 0)
             {
@@ -2206,9 +4254,9 @@ NYUChannelModel::GetXpdPerSubpath (double totalNumberOfSubpaths, double xpdMean,
 
   for (i = 0; i < totalNumberOfSubpaths; i++)
     {
-      phi_phi = m_normalRv->GetValue () * xpdSd;
+      phi_phi = m_normalRv.GetValue () * xpdSd;
       theta_phi = xpdMean;
-      phi_theta = xpdMean + m_normalRv->GetValue () * xpdSd;
+      phi_theta = xpdMean + m_normalRv.GetValue () * xpdSd;
       XPD.push_back ({phi_phi, theta_phi, phi_theta});
     }
 
@@ -33,9 +33,17 @@
 #include <ns3/nstime.h>
 #include <ns3/random-variable-stream.h>
 #include <ns3/boolean.h>
+#include <ns3/traced-callback.h>
 #include <unordered_map>
+#include <array>
+#include <cmath>
+#include <list>
+#include <set>
 #include <ns3/nyu-channel-condition-model.h>
 #include <ns3/matrix-based-channel-model.h>
+#include <ns3/nyu-link-profiler.h>
+#include <ns3/nyu-channel-spill-file.h>
+#include <ns3/nyu-checkpoint.h>
 
 namespace ns3 {
 
@@ -145,6 +153,227 @@ public:
   Ptr<const ChannelParams> GetParams (Ptr<const MobilityModel> aMob,
                                       Ptr<const MobilityModel> bMob) const override;
 
+  /**
+   * Computes the channel coefficient of each ray between two single element
+   * antennas directly from the ray table, i.e., sqrt(power) times the element
+   * field patterns combined with the polarization phasors and the antenna weights.
+   * The channel params are looked up (and generated or updated if needed) as in
+   * GetChannel, but no ChannelMatrix is generated or stored. The coefficients
+   * are equivalent to the long term component of the 1x1 channel matrix generated
+   * with a as the s node and b as the u node.
+   *
+   * \param aMob mobility model of the a device
+   * \param bMob mobility model of the b device
+   * \param aAntenna single element antenna of the a device
+   * \param bAntenna single element antenna of the b device
+   * \return the channel coefficient of each ray
+   */
+  PhasedArrayModel::ComplexVector GetSisoRayCoefficients (Ptr<const MobilityModel> aMob,
+                                                          Ptr<const MobilityModel> bMob,
+                                                          Ptr<const PhasedArrayModel> aAntenna,
+                                                          Ptr<const PhasedArrayModel> bAntenna);
+
+  /**
+   * Computes the same coefficients of GetSisoRayCoefficients from the channel
+   * params currently held in memory, without any side effect: the channel
+   * params are not generated, updated, read back from the spill file or marked
+   * as used, hence the coefficients may be outdated.
+   *
+   * \param aMob mobility model of the a device
+   * \param bMob mobility model of the b device
+   * \param aAntenna single element antenna of the a device
+   * \param bAntenna single element antenna of the b device
+   * \return the channel coefficient of each ray, empty if the channel params are not in memory
+   */
+  PhasedArrayModel::ComplexVector PeekSisoRayCoefficients (Ptr<const MobilityModel> aMob,
+                                                           Ptr<const MobilityModel> bMob,
+                                                           Ptr<const PhasedArrayModel> aAntenna,
+                                                           Ptr<const PhasedArrayModel> bAntenna) const;
+
+  /**
+   * Returns the channel matrix of a pair of antenna arrays if it is currently
+   * held in memory, without any side effect: the matrix is not generated,
+   * updated, read back from the spill file or marked as used, hence it may
+   * be outdated.
+   *
+   * \param aAntenna antenna array of the a device
+   * \param bAntenna antenna array of the b device
+   * \return the channel matrix, nullptr if it is not in memory
+   */
+  Ptr<const ChannelMatrix> PeekChannel (Ptr<const PhasedArrayModel> aAntenna,
+                                        Ptr<const PhasedArrayModel> bAntenna) const;
+
+  /**
+   * Returns the channel params of a pair of nodes if they are currently held
+   * in memory, without any side effect, hence they may be outdated.
+   *
+   * \param aMob mobility model of the a device
+   * \param bMob mobility model of the b device
+   * \return the channel params, nullptr if they are not in memory
+   */
+  Ptr<const ChannelParams> PeekParams (Ptr<const MobilityModel> aMob,
+                                       Ptr<const MobilityModel> bMob) const;
+
+  /**
+   * Returns the factorized representation of the channel matrix generated with
+   * s as the s node and u as the u node, i.e., the channel matrix is
+   * H(u, s, n) = c_n * exp (j 2 pi k_{u,n} . r_u) * exp (j 2 pi k_{s,n} . r_s),
+   * where c_n is the ray coefficient, k_{u,n} and k_{s,n} are the unit
+   * direction vectors of ray n at the u and s nodes and r_u and r_s are the
+   * element locations in wavelengths. The channel params are looked up (and
+   * generated or updated if needed) as in GetChannel, but no ChannelMatrix is
+   * generated or stored.
+   *
+   * \param sMob mobility model of the s node
+   * \param uMob mobility model of the u node
+   * \param sAntenna antenna array of the s node
+   * \param uAntenna antenna array of the u node
+   * \param rayCoefficients the ray coefficients c_n
+   * \param sRayDirections the unit direction vectors k_{s,n}
+   * \param uRayDirections the unit direction vectors k_{u,n}
+   */
+  void GetRayFactors (Ptr<const MobilityModel> sMob,
+                      Ptr<const MobilityModel> uMob,
+                      Ptr<const PhasedArrayModel> sAntenna,
+                      Ptr<const PhasedArrayModel> uAntenna,
+                      std::vector<std::complex<double> > &rayCoefficients,
+                      std::vector<Vector> &sRayDirections,
+                      std::vector<Vector> &uRayDirections);
+
+  /**
+   * Snapshots of the channel matrix of a link at equally spaced time instants.
+   * The snapshots differ only by the Doppler phase of each ray, hence the
+   * channel cube is stored once, together with the phasor of each ray in each
+   * snapshot, and the snapshots are computed on access.
+   */
+  struct ChannelTimeSeries : public SimpleRefCount<ChannelTimeSeries>
+  {
+    Time m_t0; //!< the time instant of the first snapshot
+    Time m_dt; //!< the interval between two consecutive snapshots
+    uint32_t m_numSamples = 0; //!< the number of snapshots
+    size_t m_numRows = 0; //!< the number of elements of the u antenna
+    size_t m_numCols = 0; //!< the number of elements of the s antenna
+    size_t m_numRays = 0; //!< the number of rays
+    std::pair<uint32_t, uint32_t> m_nodeIds; //!< the ids of the s and u nodes
+    MatrixBasedChannelModel::DoubleVector m_delay; //!< the delay of each ray in ns
+    std::vector<std::complex<double> > m_cube; //!< the channel without the Doppler phase, with the layout of a Complex3DVector (u, s, n)
+    std::vector<std::complex<double> > m_doppler; //!< the numSamples x numRays Doppler phasors, the ray index is the contiguous one
+
+    /**
+     * Returns the Doppler phasor of a ray in a snapshot
+     * \param k the index of the snapshot
+     * \param n the index of the ray
+     * \return the phasor
+     */
+    std::complex<double> GetDoppler (uint32_t k, size_t n) const
+    {
+      return m_doppler[k * m_numRays + n];
+    }
+
+    /**
+     * Returns a coefficient of a snapshot
+     * \param k the index of the snapshot
+     * \param u the index of the u element
+     * \param s the index of the s element
+     * \param n the index of the ray
+     * \return the coefficient H_k(u, s, n)
+     */
+    std::complex<double> operator() (uint32_t k, size_t u, size_t s, size_t n) const
+    {
+      return m_cube[u + m_numRows * (s + m_numCols * n)] * GetDoppler (k, n);
+    }
+
+    /**
+     * Computes a snapshot
+     * \param k the index of the snapshot
+     * \param sample set to the snapshot, with the layout of a Complex3DVector (u, s, n)
+     */
+    void GetSample (uint32_t k, std::vector<std::complex<double> > &sample) const
+    {
+      size_t pageSize = m_numRows * m_numCols;
+      sample.resize (m_cube.size ());
+      for (size_t n = 0; n < m_numRays; n++)
+        {
+          std::complex<double> phasor = GetDoppler (k, n);
+          for (size_t i = n * pageSize; i < (n + 1) * pageSize; i++)
+            {
+              sample[i] = m_cube[i] * phasor;
+            }
+        }
+    }
+  };
+
+  /**
+   * Returns the channel matrix of a link at the time instants t0 + k dt,
+   * for k = 0, ..., numSamples - 1, computed in a single pass over the
+   * current channel params. The ray coefficients and the steering phasors are
+   * computed once, and the snapshots differ only by the Doppler phase of each
+   * ray, which evolves with the velocities of the nodes as in
+   * NYUSpectrumPropagationLossModel. The channel params (and hence the
+   * positions, the ray table and the large scale parameters) are those valid
+   * at the current simulation time, and they are not updated within the window,
+   * which hence cannot be longer than UpdatePeriod. No ChannelMatrix is
+   * generated or stored: the series holds the channel cube once and the Doppler
+   * phasor of each ray in each snapshot.
+   *
+   * \param aMob mobility model of the a device, used as the s node
+   * \param bMob mobility model of the b device, used as the u node
+   * \param aAntenna antenna of the a device
+   * \param bAntenna antenna of the b device
+   * \param t0 the time instant of the first snapshot
+   * \param dt the interval between two consecutive snapshots
+   * \param numSamples the number of snapshots
+   * \return the snapshots of the channel matrix
+   */
+  Ptr<const ChannelTimeSeries> GetChannelTimeSeries (Ptr<const MobilityModel> aMob,
+                                                     Ptr<const MobilityModel> bMob,
+                                                     Ptr<const PhasedArrayModel> aAntenna,
+                                                     Ptr<const PhasedArrayModel> bAntenna,
+                                                     Time t0,
+                                                     Time dt,
+                                                     uint32_t numSamples);
+
+  /**
+   * The dominant singular vectors of the narrowband channel matrix of a link
+   */
+  struct DominantBeams : public SimpleRefCount<DominantBeams>
+  {
+    Time m_generatedTime; //!< the generation time of the channel params the beams have been computed from
+    uint32_t m_aAntennaId = 0; //!< the id of the antenna array of the a device
+    uint32_t m_bAntennaId = 0; //!< the id of the antenna array of the b device
+    uint64_t m_aAntennaEpoch = 0; //!< the configuration epoch of the antenna array of the a device
+    uint64_t m_bAntennaEpoch = 0; //!< the configuration epoch of the antenna array of the b device
+    PhasedArrayModel::ComplexVector m_aW; //!< the beamforming vector of the a device, i.e., the dominant right singular vector
+    PhasedArrayModel::ComplexVector m_bW; //!< the beamforming vector of the b device, i.e., the conjugate of the dominant left singular vector
+    double m_gain = 0; //!< the squared dominant singular value, i.e., the power gain |bW^T H aW|^2
+    uint32_t m_numIterations = 0; //!< the number of power iterations done to compute the beams
+  };
+
+  /**
+   * Returns the beamforming vectors which maximize the single stream gain of the
+   * narrowband channel matrix H = sum_n H(u, s, n) generated with a as the s
+   * node and b as the u node, i.e., its dominant right singular vector for a
+   * and the conjugate of its dominant left singular vector for b. They are
+   * computed by power iteration on H^H H, with each product evaluated on the
+   * factorized representation of the channel (see GetRayFactors) in
+   * O ((U + S) N) operations, hence the channel matrix is never generated.
+   * The beams are cached per pair of antenna arrays and computed again only
+   * when the channel params are regenerated or one of the arrays is
+   * reconfigured (see GetAntennaEpoch), starting from the previous ones. At
+   * most MaxCachedChannelMatrices beams are cached, the least recently used
+   * ones are discarded.
+   *
+   * \param aMob mobility model of the a device
+   * \param bMob mobility model of the b device
+   * \param aAntenna antenna array of the a device
+   * \param bAntenna antenna array of the b device
+   * \return the dominant beams
+   */
+  Ptr<const DominantBeams> GetDominantBeams (Ptr<const MobilityModel> aMob,
+                                             Ptr<const MobilityModel> bMob,
+                                             Ptr<const PhasedArrayModel> aAntenna,
+                                             Ptr<const PhasedArrayModel> bAntenna);
+
   /**
    * \brief Assign a fixed random variable stream number to the random variables
    * used by this model.
@@ -154,6 +383,250 @@ public:
    */
   int64_t AssignStreams (int64_t stream);
 
+  /**
+   * Returns the number of channel params currently stored in m_channelParamsMap
+   * \return the number of cached channel params
+   */
+  size_t GetNumCachedChannelParams () const;
+
+  /**
+   * Returns the number of channel matrices currently stored in m_channelMatrixMap
+   * \return the number of cached channel matrices
+   */
+  size_t GetNumCachedChannelMatrices () const;
+
+  /**
+   * Returns the memory held by the coefficients of the channel matrices
+   * currently stored in m_channelMatrixMap
+   * \return the size of the cached channel matrices in bytes
+   */
+  size_t GetCachedChannelMatricesSize () const;
+
+  /**
+   * TracedCallback signature for the eviction of a channel matrix
+   * \param channelMatrixKey the key of the evicted channel matrix, i.e., the
+   *        reciprocal key of the ids of its antenna arrays
+   */
+  typedef void (*ChannelMatrixEvictedTracedCallback) (uint64_t channelMatrixKey);
+
+  /**
+   * Returns the number of channel params generated since the creation of the model
+   * \return the number of calls to GenerateChannelParameters
+   */
+  uint64_t GetNumChannelParamsGenerations () const;
+
+  /**
+   * Returns the number of channel matrices generated since the creation of the model
+   * \return the number of calls to GetNewChannel
+   */
+  uint64_t GetNumChannelMatrixGenerations () const;
+
+  /**
+   * Returns the number of channel params evicted from m_channelParamsMap and
+   * currently stored in the spill file
+   * \return the number of spilled channel params
+   */
+  size_t GetNumSpilledChannelParams () const;
+
+  /**
+   * Returns the number of channel matrices evicted from m_channelMatrixMap and
+   * currently stored in the spill file
+   * \return the number of spilled channel matrices
+   */
+  size_t GetNumSpilledChannelMatrices () const;
+
+  /**
+   * Returns the number of channel params and matrices read back from the spill
+   * files since the creation of the model
+   * \return the number of faults of the spilled entries
+   */
+  uint64_t GetNumSpillFaults () const;
+
+  /**
+   * Returns the number of times the update of stale channel params has been
+   * deferred to a later slot because of the MaxUpdatesPerSlot budget
+   * \return the number of deferred updates
+   */
+  uint64_t GetNumDeferredUpdates () const;
+
+  /**
+   * Appends the state of the model to a checkpoint, see NYUCheckpoint. An
+   * incremental checkpoint contains the channel params, channel matrices and
+   * dominant beams generated since the previous one, including the ones
+   * evicted to the spill files, and the keys of the discarded ones. The
+   * channel condition model is shared with the other models and is added to
+   * the checkpoint on its own.
+   * \param buffer the buffer
+   * \param full if false, only the changes since the previous checkpoint are written
+   */
+  void SaveCheckpoint (std::vector<uint8_t> &buffer, bool full);
+
+  /**
+   * Restores the state of the model from a buffer written by SaveCheckpoint.
+   * The entries which were in the spill files at the time of the checkpoint
+   * are written to new spill files, so that the following evictions are the
+   * same as in the checkpointed run.
+   * \param buffer the buffer
+   */
+  void RestoreCheckpoint (const std::vector<uint8_t> &buffer);
+
+  /**
+   * Notify the model that the configuration of an antenna array has changed in
+   * a way that is not visible through its element locations or field pattern
+   * (e.g., a new antenna element with the same pattern in the probe direction).
+   * The channel matrices involving the antenna are rebuilt at the next call to
+   * GetChannel reusing the cached channel parameters.
+   * \param antenna the antenna array that has been reconfigured
+   */
+  void NotifyAntennaReconfigured (Ptr<const PhasedArrayModel> antenna);
+
+  /**
+   * Compressed ray table of a cached link, used when the attribute CompressRayTable
+   * is true. The delays are stored as float relative to the delay of the first ray,
+   * the angles as 16-bit fixed point, the powers as float dB, the polarization
+   * phases as 16-bit fractions of 2 pi and the XPD terms as float amplitudes.
+   * The values are decoded when they are used.
+   */
+  struct CompressedRayTable : public SimpleRefCount<CompressedRayTable>
+  {
+    double m_delayOffset = 0; //!< delay of the first ray in ns
+    std::vector<float> m_excessDelay; //!< delay of each ray relative to m_delayOffset in ns
+    std::vector<float> m_powerDb; //!< power of each ray in dB
+    std::vector<int16_t> m_angle[4]; //!< AOA, ZOA, AOD and ZOD of each ray in fixed point, indexed as m_angle of ChannelParams
+    std::vector<std::array<uint16_t, 4> > m_phase; //!< the four polarization phases of each ray
+    std::vector<std::array<float, 3> > m_xpdAmplitude; //!< sqrt (1 / XPD) of each ray, in the order of NYUChannelParams::xpd
+
+    /**
+     * Get the delay of a ray
+     * \param n the index of the ray
+     * \return the delay in ns
+     */
+    double GetDelay (uint32_t n) const
+    {
+      return m_delayOffset + m_excessDelay[n];
+    }
+
+    /**
+     * Get the power of a ray
+     * \param n the index of the ray
+     * \return the power in linear scale
+     */
+    double GetPower (uint32_t n) const
+    {
+      return std::pow (10.0, m_powerDb[n] / 10.0);
+    }
+
+    /**
+     * Get an angle of a ray
+     * \param index the angle index (AOA_INDEX, ZOA_INDEX, AOD_INDEX or ZOD_INDEX)
+     * \param n the index of the ray
+     * \return the angle in radians
+     */
+    double GetAngle (uint8_t index, uint32_t n) const
+    {
+      return DecodeAngle (m_angle[index][n]);
+    }
+
+    /**
+     * Get a polarization phase of a ray
+     * \param n the index of the ray
+     * \param p the index of the polarization phase
+     * \return the phase in radians
+     */
+    double GetPhase (uint32_t n, uint8_t p) const
+    {
+      return DecodePhase (m_phase[n][p]);
+    }
+
+    /**
+     * Encode an angle in 16-bit fixed point. The angle is first reduced to (-2 pi, 2 pi),
+     * which preserves its sine and cosine, and the resolution is about 1.9e-4 rad.
+     * \param angle the angle in radians
+     * \return the encoded angle
+     */
+    static int16_t EncodeAngle (double angle)
+    {
+      return static_cast<int16_t> (std::lround (std::fmod (angle, 2 * M_PI) * 32767.0 / (2 * M_PI)));
+    }
+
+    /**
+     * Decode an angle encoded with EncodeAngle
+     * \param angle the encoded angle
+     * \return the angle in radians
+     */
+    static double DecodeAngle (int16_t angle)
+    {
+      return angle * (2 * M_PI) / 32767.0;
+    }
+
+    /**
+     * Encode a phase as a 16-bit fraction of 2 pi, the resolution is about 9.6e-5 rad
+     * \param phase the phase in radians
+     * \return the encoded phase
+     */
+    static uint16_t EncodePhase (double phase)
+    {
+      double turns = phase / (2 * M_PI);
+      turns -= std::floor (turns);
+      return static_cast<uint16_t> (std::lround (turns * 65536.0) & 0xFFFF);
+    }
+
+    /**
+     * Decode a phase encoded with EncodePhase
+     * \param phase the encoded phase
+     * \return the phase in radians, in [0, 2 pi)
+     */
+    static double DecodePhase (uint16_t phase)
+    {
+      return phase * (2 * M_PI) / 65536.0;
+    }
+  };
+
+  /**
+   * Returns the compressed ray table of channel params generated by a NYUChannelModel
+   * \param channelParams the channel params
+   * \return the compressed ray table, or nullptr if the ray table of the channel params
+   *         is not compressed
+   */
+  static Ptr<const CompressedRayTable> GetCompressedRayTable (Ptr<const ChannelParams> channelParams);
+
+  /**
+   * Returns the unit direction vectors of the rays of channel params generated
+   * by a NYUChannelModel. The vectors are computed once from the ray angles when
+   * the channel params are generated, so that the steering and Doppler phases
+   * are obtained with dot products. They are not stored if the ray table is
+   * compressed.
+   * \param channelParams the channel params
+   * \param isSameDirection true if the channel params were generated with the
+   *        s node as the a node, otherwise departure and arrival are swapped
+   * \param sRayDirections set to the direction vectors at the s node, i.e., from the AOD and ZOD
+   * \param uRayDirections set to the direction vectors at the u node, i.e., from the AOA and ZOA
+   * \return false if the direction vectors are not available
+   */
+  static bool GetRayDirections (Ptr<const ChannelParams> channelParams,
+                                bool isSameDirection,
+                                const std::vector<Vector> *&sRayDirections,
+                                const std::vector<Vector> *&uRayDirections);
+
+  /**
+   * Returns an estimate of the memory used by the cached channel params, i.e.,
+   * the size of the elements of the vectors they hold
+   * \return the size of the cached channel params in bytes
+   */
+  size_t GetCachedChannelParamsSize () const;
+
+  /**
+   * Set the per-link cost profiler
+   * \param profiler the profiler, or nullptr to disable the profiling
+   */
+  void SetProfiler (Ptr<NYULinkProfiler> profiler);
+
+  /**
+   * Returns the per-link cost profiler
+   * \return the profiler, nullptr if the profiling is disabled
+   */
+  Ptr<NYULinkProfiler> GetProfiler () const;
+
   /**
    * The measurements conducted by NYU are at 28,73 and 140 GHz. For other
    * frequencies a linear intrerpolation is done.
@@ -481,6 +954,10 @@ protected:
     MatrixBasedChannelModel::Double2DVector powerSpectrumOld; //!< value containing SP characteristics: AbsoluteDelay(in ns),Power (relative to 1mW),Phases (radians),AOD (in degrees),ZOD (in degrees),AOA (in degrees),ZOA (in degrees)
     MatrixBasedChannelModel::Double2DVector powerSpectrum; //!<value containg SP characteristics - Adjusted according to RF bandwidth
     MatrixBasedChannelModel::Double2DVector xpd; //!< value containing the XPD (Cross Polarization Discriminator) in dB for each Ray
+    std::vector<Vector> m_departureDirections; //!< unit direction vector of each ray at the first node of m_nodeIds, from the AOD and ZOD
+    std::vector<Vector> m_arrivalDirections; //!< unit direction vector of each ray at the second node of m_nodeIds, from the AOA and ZOA
+    double m_updatePhase = 0; //!< fraction of the update period by which the first realization of the link is shortened, to stagger the updates of the links
+    Ptr<const CompressedRayTable> m_compressedRays; //!< if not null, the ray table is stored only in this compressed form and the vectors above are empty
   };
 
   struct ParamsTable : public SimpleRefCount<ParamsTable>
@@ -581,6 +1058,30 @@ protected:
    * \return the channel realization
    */
 
+  /**
+   * Computes the factors of the channel matrix that do not depend on the
+   * element index, i.e., the ray coefficients and the ray directions at the
+   * s and u nodes
+   * \param channelParams the channel parameters previously generated for the pair of nodes s and u
+   * \param los true if the first ray is the LOS ray
+   * \param sMob the mobility model of node s
+   * \param uMob the mobility model of node u
+   * \param sAntenna the antenna array of node s
+   * \param uAntenna the antenna array of node u
+   * \param rayCoefficients the ray coefficients
+   * \param sRayDirections the unit direction vectors of the rays at node s
+   * \param uRayDirections the unit direction vectors of the rays at node u
+   */
+  void ComputeRayFactors (Ptr<const NYUChannelParams> channelParams,
+                          bool los,
+                          Ptr<const MobilityModel> sMob,
+                          Ptr<const MobilityModel> uMob,
+                          Ptr<const PhasedArrayModel> sAntenna,
+                          Ptr<const PhasedArrayModel> uAntenna,
+                          std::vector<std::complex<double> > &rayCoefficients,
+                          std::vector<Vector> &sRayDirections,
+                          std::vector<Vector> &uRayDirections) const;
+
   virtual Ptr<ChannelMatrix>
   GetNewChannel (Ptr<const NYUChannelParams> channelParams,
                  Ptr<const ParamsTable> tablenyu,
@@ -588,6 +1089,205 @@ protected:
                  const Ptr<const MobilityModel> uMob,
                  Ptr<const PhasedArrayModel> sAntenna,
                  Ptr<const PhasedArrayModel> uAntenna) const;
+  /**
+   * Computes the coefficients of GetSisoRayCoefficients from given channel params
+   * \param channelParams the channel params of the link
+   * \param aMob mobility model of the a device
+   * \param bMob mobility model of the b device
+   * \param aAntenna single element antenna of the a device
+   * \param bAntenna single element antenna of the b device
+   * \return the channel coefficient of each ray
+   */
+  PhasedArrayModel::ComplexVector CalcSisoRayCoefficients (Ptr<const NYUChannelParams> channelParams,
+                                                           Ptr<const MobilityModel> aMob,
+                                                           Ptr<const MobilityModel> bMob,
+                                                           Ptr<const PhasedArrayModel> aAntenna,
+                                                           Ptr<const PhasedArrayModel> bAntenna) const;
+  /**
+   * Looks for the channel params associated to the aMob and bMob pair in m_channelParamsMap.
+   * If not found or if they have to be updated, it generates new channel params using the
+   * method GenerateChannelParameters and updates m_channelParamsMap.
+   * \param channelCondition the channel condition between a and b
+   * \param aMob mobility model of the a device
+   * \param bMob mobility model of the b device
+   * \return the channel params
+   */
+  Ptr<NYUChannelParams> GetUpdatedChannelParams (Ptr<const ChannelCondition> channelCondition,
+                                                 Ptr<const MobilityModel> aMob,
+                                                 Ptr<const MobilityModel> bMob);
+
+  /**
+   * Replaces the ray table of the channel params with its compressed form. The
+   * vectors which are not needed once the channel params are generated are released.
+   * \param channelParams the channel params
+   */
+  void CompressChannelParams (Ptr<NYUChannelParams> channelParams) const;
+
+  /**
+   * Writes the channel params in a compact binary form. Only the values used
+   * after the generation of the channel params are written, i.e., the ones
+   * kept by CompressChannelParams, without loss of precision.
+   * \param channelParams the channel params
+   * \param buffer the buffer where the channel params are appended
+   */
+  static void SerializeChannelParams (Ptr<const NYUChannelParams> channelParams, std::vector<uint8_t> &buffer);
+
+  /**
+   * Reads channel params written by SerializeChannelParams
+   * \param buffer the buffer
+   * \return the channel params
+   */
+  static Ptr<NYUChannelParams> DeserializeChannelParams (const std::vector<uint8_t> &buffer);
+
+  /**
+   * Writes a channel matrix, together with the antenna epochs it has been
+   * generated with, in a compact binary form
+   * \param channelMatrix the channel matrix
+   * \param epochs the antenna epochs, in the order of m_antennaPair
+   * \param buffer the buffer where the channel matrix is appended
+   */
+  static void SerializeChannelMatrix (Ptr<const ChannelMatrix> channelMatrix,
+                                      const std::pair<uint64_t, uint64_t> &epochs,
+                                      std::vector<uint8_t> &buffer);
+
+  /**
+   * Reads a channel matrix written by SerializeChannelMatrix
+   * \param buffer the buffer
+   * \param epochs set to the antenna epochs of the channel matrix
+   * \return the channel matrix
+   */
+  static Ptr<ChannelMatrix> DeserializeChannelMatrix (const std::vector<uint8_t> &buffer,
+                                                      std::pair<uint64_t, uint64_t> &epochs);
+
+  /**
+   * Looks for channel params in the spill file and moves them back to
+   * m_channelParamsMap
+   * \param channelParamsKey the key of the channel params
+   * \return the channel params, nullptr if they are not in the spill file
+   */
+  Ptr<NYUChannelParams> FaultInChannelParams (uint64_t channelParamsKey);
+
+  /**
+   * Looks for a channel matrix in the spill file and moves it back to
+   * m_channelMatrixMap and m_channelMatrixEpochMap
+   * \param channelMatrixKey the key of the channel matrix
+   * \return the channel matrix, nullptr if it is not in the spill file
+   */
+  Ptr<ChannelMatrix> FaultInChannelMatrix (uint64_t channelMatrixKey);
+
+  /**
+   * Marks an entry of m_channelParamsMap as the most recently used one and
+   * evicts the least recently used entries exceeding MaxCachedChannelParams,
+   * writing them to the spill file if SpillFileName is set
+   * \param channelParamsKey the key of the used channel params
+   */
+  void TouchChannelParams (uint64_t channelParamsKey);
+
+  /**
+   * Marks an entry of m_channelMatrixMap as the most recently used one and
+   * evicts the least recently used entries exceeding MaxCachedChannelMatrices,
+   * writing them to the spill file if SpillFileName is set
+   * \param channelMatrixKey the key of the used channel matrix
+   */
+  void TouchChannelMatrix (uint64_t channelMatrixKey);
+
+  /**
+   * Marks an entry of m_dominantBeamsMap as the most recently used one and
+   * discards the least recently used entries exceeding MaxCachedChannelMatrices
+   * \param beamsKey the key of the used dominant beams
+   */
+  void TouchDominantBeams (uint64_t beamsKey);
+
+  /**
+   * Returns the spill file with the given suffix, creating it if needed
+   * \param spillFile the spill file
+   * \param suffix the suffix appended to SpillFileName
+   * \return the spill file, nullptr if SpillFileName is empty
+   */
+  Ptr<NYUChannelSpillFile> GetSpillFile (Ptr<NYUChannelSpillFile> &spillFile, const std::string &suffix);
+
+  /**
+   * Returns an estimate of the memory used by channel params, i.e., the size
+   * of the elements of the vectors they hold
+   * \param channelParams the channel params
+   * \return the size of the channel params in bytes
+   */
+  static size_t GetChannelParamsSize (Ptr<const NYUChannelParams> channelParams);
+
+  /**
+   * Get the departure and arrival angles of the rays, decoding them if the
+   * ray table is compressed
+   * \param channelParams the channel params
+   * \param isSameDirection true if the channel params were generated with the
+   *        s node as the a node, otherwise departure and arrival are swapped
+   * \param decodedAngles storage for the decoded angles, used only if the ray
+   *        table is compressed
+   * \param rayAodRadian set to the AOD of each ray
+   * \param rayZodRadian set to the ZOD of each ray
+   * \param rayAoaRadian set to the AOA of each ray
+   * \param rayZoaRadian set to the ZOA of each ray
+   *
+   * The angles of an uncompressed ray table are not copied, the returned
+   * pointers refer to the vectors of the channel params.
+   */
+  void GetRayAngles (Ptr<const NYUChannelParams> channelParams,
+                     bool isSameDirection,
+                     MatrixBasedChannelModel::Double2DVector &decodedAngles,
+                     const MatrixBasedChannelModel::DoubleVector *&rayAodRadian,
+                     const MatrixBasedChannelModel::DoubleVector *&rayZodRadian,
+                     const MatrixBasedChannelModel::DoubleVector *&rayAoaRadian,
+                     const MatrixBasedChannelModel::DoubleVector *&rayZoaRadian) const;
+
+  /**
+   * Computes from the ray angles the unit direction vector of each ray at both
+   * nodes and stores them in the channel params
+   * \param channelParams the channel params
+   */
+  static void SetRayDirections (Ptr<NYUChannelParams> channelParams);
+
+  /**
+   * Combines the four polarization phases of a ray with the XPD and the element
+   * field patterns of the rx and tx antennas, and scales the result by the ray amplitude.
+   * The phase terms due to the element locations are not included.
+   * \param channelParams the channel params
+   * \param nIndex the index of the ray
+   * \param rxFieldPattern the (phi, theta) field pattern of the rx element in the ray direction
+   * \param txFieldPattern the (phi, theta) field pattern of the tx element in the ray direction
+   * \return the complex amplitude of the ray
+   */
+  std::complex<double> GetRayCoefficient (Ptr<const NYUChannelParams> channelParams,
+                                          uint32_t nIndex,
+                                          const std::pair<double, double> &rxFieldPattern,
+                                          const std::pair<double, double> &txFieldPattern) const;
+
+  /**
+   * Checks if the elements of an antenna array lie on a uniform planar lattice, i.e.,
+   * the antenna is a UniformPlanarArray and the location of the element with index
+   * row * numColumns + col is origin + row * rowStep + col * columnStep
+   * \param antenna the antenna array
+   * \param numRows the number of rows of the array
+   * \param numColumns the number of columns of the array
+   * \param rowStep the displacement between two adjacent rows, normalized by the wavelength
+   * \param columnStep the displacement between two adjacent columns, normalized by the wavelength
+   * \return true if the array is a uniform planar lattice, false otherwise
+   */
+  bool GetUpaLattice (Ptr<const PhasedArrayModel> antenna,
+                      uint32_t &numRows,
+                      uint32_t &numColumns,
+                      Vector &rowStep,
+                      Vector &columnStep) const;
+
+  /**
+   * Computes the steering phasor exp(j 2 pi k_n . d_u) of each element u of an antenna
+   * array for each ray direction k_n. For uniform planar arrays the phasors are obtained
+   * as the Kronecker product of per-ray row and column phasors.
+   * \param antenna the antenna array
+   * \param rayDirections the unit vector of the direction of each ray
+   * \return the steering phasors, the rows are the antenna elements and the columns the rays
+   */
+  Complex2DVector GetSteeringPhasors (Ptr<const PhasedArrayModel> antenna,
+                                      const std::vector<Vector> &rayDirections) const;
+
   /**
    * Check if the channel params has to be updated
    * \param channelParams channel params
@@ -596,27 +1296,191 @@ protected:
    */
   bool ChannelParamsNeedsUpdate (Ptr<const NYUChannelParams> channelParams,
                                  Ptr<const ChannelCondition> channelCondition) const;
+
+  /**
+   * Returns the time after which the channel params have to be updated, i.e.,
+   * their generation time plus the update period, shortened by the update
+   * phase of the link for the first realization
+   * \param channelParams channel params
+   * \return the time after which the channel params are stale
+   */
+  Time GetUpdateDueTime (Ptr<const NYUChannelParams> channelParams) const;
+
+  /**
+   * Check if the channel params have to be updated now. The params whose channel
+   * condition has changed are always updated, while the ones whose update period
+   * is over are updated only if AdmitScheduledUpdate allows it, otherwise the
+   * current realization is used until a later slot
+   * \param channelParamsKey the key of the channel params
+   * \param channelParams channel params
+   * \param channelCondition the channel condition
+   * \return true if the channel params have to be updated now
+   */
+  bool ScheduleChannelParamsUpdate (uint64_t channelParamsKey,
+                                    Ptr<const NYUChannelParams> channelParams,
+                                    Ptr<const ChannelCondition> channelCondition);
+
+  /**
+   * Enforces the MaxUpdatesPerSlot budget. A stale link is updated only if the
+   * budget of the current slot is not exhausted and the link is among the most
+   * stale links which have requested an update in the current or in the
+   * previous slot, so that the updates are spread over the slots in order of
+   * staleness
+   * \param channelParamsKey the key of the channel params
+   * \param dueTime the time after which the channel params are stale
+   * \return true if the update is admitted in the current slot
+   */
+  bool AdmitScheduledUpdate (uint64_t channelParamsKey, Time dueTime);
   /**
    * Check if the channel matrix has to be updated (it needs update when the channel params generation
-   * time is more recent than channel matrix generation time
+   * time is more recent than channel matrix generation time or when the configuration epoch of
+   * one of the two antenna arrays differs from the one used to generate the channel matrix)
    * \param channelParams channel params structure
    * \param channelMatrix channel matrix structure
+   * \param aAntenna antenna of the a device
+   * \param bAntenna antenna of the b device
    * \return true if the channel matrix has to be updated, false otherwise
    */
   bool ChannelMatrixNeedsUpdate (Ptr<const NYUChannelParams> channelParams,
-                                 Ptr<const ChannelMatrix> channelMatrix);
+                                 Ptr<const ChannelMatrix> channelMatrix,
+                                 Ptr<const PhasedArrayModel> aAntenna,
+                                 Ptr<const PhasedArrayModel> bAntenna);
+
+  /**
+   * Returns the configuration epoch of an antenna array. A new epoch is assigned
+   * when the array is first seen and every time it is seen with a different number
+   * of elements, element locations or element field pattern (e.g., after a change of
+   * the bearing, downtilt or polarization slant angles), or after
+   * NotifyAntennaReconfigured. The epochs are never reused, hence a configuration
+   * can be dropped when no cached channel matrix or dominant beams refer to it: a
+   * matrix read back from the spill file afterwards sees a new epoch and is rebuilt
+   * from the cached channel params.
+   * \param antenna the antenna array
+   * \return the configuration epoch of the antenna array
+   */
+  uint64_t GetAntennaEpoch (Ptr<const PhasedArrayModel> antenna);
+
+  /**
+   * Records that a cached channel matrix or dominant beams refer to the
+   * configuration of an antenna array
+   * \param antennaId the id of the antenna array
+   */
+  void AddAntennaReference (uint32_t antennaId);
+
+  /**
+   * Records that a cached channel matrix or dominant beams no longer refer to the
+   * configuration of an antenna array, and drops the configuration if it was the
+   * last reference
+   * \param antennaId the id of the antenna array
+   */
+  void RemoveAntennaReference (uint32_t antennaId);
+
+  /**
+   * Recomputes the references to the antenna configurations from the cached
+   * channel matrices and dominant beams, and drops the configurations without
+   * references
+   */
+  void UpdateAntennaReferences ();
+
+  /**
+   * Configuration of an antenna array as seen by the last call to GetAntennaEpoch
+   */
+  struct AntennaConfig
+  {
+    uint64_t m_epoch = 0; //!< configuration epoch of the antenna array
+    uint64_t m_numElements = 0; //!< number of antenna elements
+    Vector m_lastElementLocation; //!< location of the last element, it captures spacing and orientation of the array
+    std::pair<double, double> m_probeFieldPattern; //!< element field pattern in a fixed probe direction, it captures the element orientation
+    uint32_t m_numReferences = 0; //!< number of cached channel matrices and dominant beams referring to the configuration
+  };
+
+  /**
+   * Keys of a cache, ordered from the most to the least recently used
+   */
+  class LruOrder
+  {
+  public:
+    /**
+     * Moves a key to the front of the order, adding it if needed
+     * \param key the key
+     */
+    void Touch (uint64_t key);
+    /**
+     * Removes a key from the order
+     * \param key the key
+     */
+    void Erase (uint64_t key);
+    /**
+     * Returns the least recently used key
+     * \return the key at the back of the order
+     */
+    uint64_t GetOldest () const;
+    /**
+     * Returns the number of keys
+     * \return the number of keys
+     */
+    size_t GetSize () const;
+    /**
+     * Removes all the keys
+     */
+    void Clear ();
+    /**
+     * Returns true if a key is in the order
+     * \param key the key
+     * \return true if the key is in the order
+     */
+    bool Contains (uint64_t key) const;
+    /**
+     * Returns the keys
+     * \return the keys, from the most to the least recently used
+     */
+    const std::list<uint64_t> &GetKeys () const;
+
+  private:
+    std::list<uint64_t> m_order; //!< the keys, from the most to the least recently used
+    std::unordered_map<uint64_t, std::list<uint64_t>::iterator> m_position; //!< the position of each key in m_order
+  };
 
   std::unordered_map<uint64_t, Ptr<ChannelMatrix> > m_channelMatrixMap; //!< map containing the channel realizations per pair of PhasedAntennaArray instances, the key of this map is reciprocal uniquely identifies a pair of PhasedAntennaArrays
   std::unordered_map<uint64_t, Ptr<NYUChannelParams> > m_channelParamsMap; //!< map containing the common channel parameters per pair of nodes, the key of this map is reciprocal and uniquely identifies a pair of nodes
+  std::unordered_map<uint32_t, AntennaConfig> m_antennaConfigMap; //!< map containing the last seen configuration of each PhasedArrayModel instance referred by a cached channel matrix or dominant beams, the key of this map is the antenna id
+  std::unordered_map<uint64_t, std::pair<uint64_t, uint64_t> > m_channelMatrixEpochMap; //!< map containing the antenna epochs used to generate each channel matrix, in the same order of m_antennaPair, the key of this map is the same of m_channelMatrixMap
+  uint64_t m_lastAntennaEpoch; //!< the last epoch assigned to an antenna configuration
+  uint64_t m_numChannelParamsGenerations; //!< number of generated channel params
+  uint64_t m_numChannelMatrixGenerations; //!< number of generated channel matrices
+  bool m_compressRayTable; //!< if true the ray table of the cached channel params is compressed
+  uint32_t m_maxCachedChannelParams; //!< the maximum number of entries of m_channelParamsMap, 0 if unlimited
+  uint32_t m_maxCachedChannelMatrices; //!< the maximum number of entries of m_channelMatrixMap, 0 if unlimited
+  std::string m_spillFileName; //!< the prefix of the names of the spill files, empty if the evicted entries are discarded
+  LruOrder m_channelParamsLru; //!< the usage order of the entries of m_channelParamsMap
+  LruOrder m_channelMatrixLru; //!< the usage order of the entries of m_channelMatrixMap
+  Ptr<NYUChannelSpillFile> m_channelParamsSpill; //!< the spill file of the evicted channel params
+  Ptr<NYUChannelSpillFile> m_channelMatrixSpill; //!< the spill file of the evicted channel matrices
+  uint64_t m_numSpillFaults; //!< number of entries read back from the spill files
+  bool m_updatePhaseJitter; //!< if true, the first realization of each link lasts a random fraction of the update period
+  uint32_t m_maxUpdatesPerSlot; //!< the maximum number of updates of stale channel params per slot, 0 if unlimited
+  Time m_updateSlotDuration; //!< the duration of the slots of the update budget
+  int64_t m_currentUpdateSlot; //!< index of the current slot of the update budget
+  uint32_t m_numUpdatesInSlot; //!< number of updates admitted in the current slot
+  std::unordered_map<uint64_t, std::pair<Time, Time> > m_pendingUpdates; //!< due time and time of the last request of the stale links waiting for an update, indexed by the key of the channel params
+  std::set<std::pair<Time, uint64_t> > m_pendingUpdateOrder; //!< the stale links waiting for an update, from the most stale one
+  uint64_t m_numDeferredUpdates; //!< number of update requests deferred to a later slot
+  std::unordered_map<uint64_t, Ptr<const DominantBeams> > m_dominantBeamsMap; //!< the dominant beams of each pair of antenna arrays
+  LruOrder m_dominantBeamsLru; //!< the usage order of the entries of m_dominantBeamsMap
+  NYUCheckpointTracker m_channelParamsTracker; //!< the channel params written to the checkpoints
+  NYUCheckpointTracker m_channelMatrixTracker; //!< the channel matrices written to the checkpoints
+  NYUCheckpointTracker m_dominantBeamsTracker; //!< the dominant beams written to the checkpoints
+  uint32_t m_maxPowerIterations; //!< the maximum number of power iterations to compute the dominant beams
+  Ptr<NYULinkProfiler> m_profiler; //!< the per-link cost profiler, nullptr if disabled
+  TracedCallback<uint64_t> m_channelMatrixEvictedTrace; //!< trace fired when a channel matrix is evicted from m_channelMatrixMap
   Time m_updatePeriod; //!< the channel update period in ms
   double m_frequency; //!< the operating frequency in Hz
   double m_rfBandwidth; //!< the operating rf bandwidth in Hz
   std::string m_scenario; //!< the NYU scenario
   Ptr<ChannelConditionModel> m_channelConditionModel; //!< the channel condition model
-  Ptr<UniformRandomVariable> m_uniformRv; //!< uniform random variable
-  Ptr<NormalRandomVariable> m_normalRv; //!< normal random variable
-  Ptr<ExponentialRandomVariable> m_expRv; //!< exponential random variable
-  Ptr<GammaRandomVariable> m_gammaRv;//!< gamma random variable
+  NYUCheckpointRandomVariable<UniformRandomVariable> m_uniformRv; //!< uniform random variable
+  NYUCheckpointRandomVariable<NormalRandomVariable> m_normalRv; //!< normal random variable
+  NYUCheckpointRandomVariable<ExponentialRandomVariable> m_expRv; //!< exponential random variable
   // parameters for the blockage model
   bool m_blockage; //!< enables the blockage
 };
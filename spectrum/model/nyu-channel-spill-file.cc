@@ -0,0 +1,260 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+#include "ns3/nyu-channel-spill-file.h"
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("NYUChannelSpillFile");
+
+/// initial size of the spill file
+static const uint64_t spillFileInitialSize = 1 << 20;
+
+/// number of forks done by this process, counted by the handler registered with pthread_atfork
+static uint64_t g_numForks = 0;
+
+/**
+ * Counts a fork, called in the parent process
+ */
+static void
+CountFork ()
+{
+  g_numForks++;
+}
+
+NYUChannelSpillFile::NYUChannelSpillFile (const std::string &fileName)
+  : m_fileName (fileName),
+    m_fd (-1),
+    m_data (nullptr),
+    m_fileSize (0),
+    m_end (0),
+    m_ownerPid (getpid ()),
+    m_unlinked (false),
+    m_numForks (g_numForks),
+    m_frozenEnd (0)
+{
+  NS_LOG_FUNCTION (this << fileName);
+  static int atForkRegistered = pthread_atfork (nullptr, &CountFork, nullptr);
+  NS_ABORT_MSG_IF (atForkRegistered != 0, "Cannot register the fork handler of the spill files");
+  m_fd = open (fileName.c_str (), O_RDWR | O_CREAT | O_TRUNC, 0600);
+  if (m_fd < 0)
+    {
+      NS_FATAL_ERROR ("Cannot open the spill file " << fileName << ": " << std::strerror (errno));
+    }
+}
+
+NYUChannelSpillFile::~NYUChannelSpillFile ()
+{
+  NS_LOG_FUNCTION (this);
+  if (m_data)
+    {
+      munmap (m_data, m_fileSize);
+    }
+  if (m_fd >= 0)
+    {
+      close (m_fd);
+      // a forked child must not remove the file of its parent
+      if (getpid () == m_ownerPid && !m_unlinked)
+        {
+          unlink (m_fileName.c_str ());
+        }
+    }
+}
+
+void
+NYUChannelSpillFile::CheckFork ()
+{
+  if (getpid () != m_ownerPid)
+    {
+      // the file belongs to the parent process, which may still use it: the
+      // records written before the fork are copied to a file of this process
+      std::string fileName = m_fileName + "." + std::to_string (getpid ());
+      NS_LOG_DEBUG ("Forked process, copy the spill file " << m_fileName << " to " << fileName);
+      int fd = open (fileName.c_str (), O_RDWR | O_CREAT | O_TRUNC, 0600);
+      if (fd < 0)
+        {
+          NS_FATAL_ERROR ("Cannot open the spill file " << fileName << ": " << std::strerror (errno));
+        }
+      int parentFd = m_fd;
+      uint8_t *parentData = m_data;
+      uint64_t parentFileSize = m_fileSize;
+      m_fileName = fileName;
+      m_fd = fd;
+      m_data = nullptr;
+      m_fileSize = 0;
+      m_ownerPid = getpid ();
+      m_numForks = g_numForks;
+      m_frozenEnd = 0;
+      if (m_end > 0)
+        {
+          Grow (m_end);
+          std::memcpy (m_data, parentData, m_end);
+        }
+      if (parentData)
+        {
+          munmap (parentData, parentFileSize);
+        }
+      close (parentFd);
+      // the copy stays readable through m_fd and the mapping until they are released
+      unlink (m_fileName.c_str ());
+      m_unlinked = true;
+    }
+  else if (m_numForks != g_numForks)
+    {
+      // the children read the records written before the fork from this file
+      // until they copy them, hence their space is never reused
+      m_numForks = g_numForks;
+      m_frozenEnd = m_end;
+      m_freeSlots.clear ();
+    }
+}
+
+void
+NYUChannelSpillFile::Grow (uint64_t minSize)
+{
+  NS_LOG_FUNCTION (this << minSize);
+  uint64_t newSize = std::max (std::max (2 * m_fileSize, minSize), spillFileInitialSize);
+  if (m_data)
+    {
+      munmap (m_data, m_fileSize);
+      m_data = nullptr;
+    }
+  if (ftruncate (m_fd, newSize) != 0)
+    {
+      NS_FATAL_ERROR ("Cannot resize the spill file " << m_fileName << ": " << std::strerror (errno));
+    }
+  void *data = mmap (nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+  if (data == MAP_FAILED)
+    {
+      NS_FATAL_ERROR ("Cannot map the spill file " << m_fileName << ": " << std::strerror (errno));
+    }
+  m_data = static_cast<uint8_t *> (data);
+  m_fileSize = newSize;
+}
+
+void
+NYUChannelSpillFile::Put (uint64_t key, const std::vector<uint8_t> &record)
+{
+  NS_LOG_FUNCTION (this << key << record.size ());
+  CheckFork ();
+  Erase (key);
+
+  // reuse the smallest free slot which can hold the record, otherwise
+  // append a new slot at the end of the file
+  Slot slot;
+  slot.m_size = record.size ();
+  auto freeIt = m_freeSlots.lower_bound (record.size ());
+  if (freeIt != m_freeSlots.end ())
+    {
+      slot.m_capacity = freeIt->first;
+      slot.m_offset = freeIt->second;
+      m_freeSlots.erase (freeIt);
+    }
+  else
+    {
+      slot.m_capacity = record.size ();
+      slot.m_offset = m_end;
+      if (m_end + slot.m_capacity > m_fileSize)
+        {
+          Grow (m_end + slot.m_capacity);
+        }
+      m_end += slot.m_capacity;
+    }
+
+  if (!record.empty ())
+    {
+      std::memcpy (m_data + slot.m_offset, record.data (), record.size ());
+    }
+  m_slots[key] = slot;
+}
+
+bool
+NYUChannelSpillFile::Get (uint64_t key, std::vector<uint8_t> &record) const
+{
+  NS_LOG_FUNCTION (this << key);
+  auto it = m_slots.find (key);
+  if (it == m_slots.end ())
+    {
+      return false;
+    }
+  record.assign (m_data + it->second.m_offset, m_data + it->second.m_offset + it->second.m_size);
+  return true;
+}
+
+void
+NYUChannelSpillFile::Erase (uint64_t key)
+{
+  NS_LOG_FUNCTION (this << key);
+  CheckFork ();
+  auto it = m_slots.find (key);
+  if (it == m_slots.end ())
+    {
+      return;
+    }
+  if (it->second.m_capacity > 0 && it->second.m_offset >= m_frozenEnd)
+    {
+      m_freeSlots.emplace (it->second.m_capacity, it->second.m_offset);
+    }
+  m_slots.erase (it);
+}
+
+size_t
+NYUChannelSpillFile::GetNumRecords () const
+{
+  return m_slots.size ();
+}
+
+std::vector<uint64_t>
+NYUChannelSpillFile::GetKeys () const
+{
+  std::vector<uint64_t> keys;
+  keys.reserve (m_slots.size ());
+  for (const auto &slot : m_slots)
+    {
+      keys.push_back (slot.first);
+    }
+  return keys;
+}
+
+uint64_t
+NYUChannelSpillFile::GetFileSize () const
+{
+  return m_fileSize;
+}
+
+std::string
+NYUChannelSpillFile::GetFileName () const
+{
+  return m_fileName;
+}
+
+} // namespace ns3
@@ -0,0 +1,157 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+#ifndef NYU_CHANNEL_SPILL_FILE_H
+#define NYU_CHANNEL_SPILL_FILE_H
+
+#include <ns3/simple-ref-count.h>
+#include <sys/types.h>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup spectrum
+ * \brief Memory-mapped file holding the records evicted from the caches of
+ * the NYU channel model
+ *
+ * Each record is an opaque byte buffer identified by a 64-bit key. The
+ * records are written to a file mapped in memory, which grows by doubling its
+ * size when needed, so that the capacity of the second tier of the cache is
+ * bounded by the disk rather than by the RAM. The space of the erased records
+ * is reused for new records of the same or smaller size. The file is a
+ * scratch file: it is truncated when opened and removed when the object is
+ * destroyed by the process which created it.
+ *
+ * The file can be shared with forked processes. After a fork the creator no
+ * longer reuses the space of the records written before the fork, and a child
+ * keeps reading them from the shared file until its first change, when it
+ * copies them to a file of its own, named after the original one followed by
+ * the child pid. The copy is removed from the directory as soon as it is
+ * mapped, so that it does not outlive the child even if the child exits
+ * without destroying its objects.
+ */
+class NYUChannelSpillFile : public SimpleRefCount<NYUChannelSpillFile>
+{
+public:
+  /**
+   * Creates the file and maps it in memory
+   * \param fileName the name of the file
+   */
+  NYUChannelSpillFile (const std::string &fileName);
+
+  /**
+   * Unmaps and removes the file
+   */
+  ~NYUChannelSpillFile ();
+
+  /**
+   * Stores a record, replacing the one with the same key, if any
+   * \param key the key of the record
+   * \param record the content of the record
+   */
+  void Put (uint64_t key, const std::vector<uint8_t> &record);
+
+  /**
+   * Reads a record
+   * \param key the key of the record
+   * \param record set to the content of the record
+   * \return false if there is no record with this key
+   */
+  bool Get (uint64_t key, std::vector<uint8_t> &record) const;
+
+  /**
+   * Removes a record, if present
+   * \param key the key of the record
+   */
+  void Erase (uint64_t key);
+
+  /**
+   * Returns the number of records in the file
+   * \return the number of records
+   */
+  size_t GetNumRecords () const;
+
+  /**
+   * Returns the keys of the records in the file
+   * \return the keys, in no particular order
+   */
+  std::vector<uint64_t> GetKeys () const;
+
+  /**
+   * Returns the size of the file
+   * \return the size of the file in bytes
+   */
+  uint64_t GetFileSize () const;
+
+  /**
+   * Returns the name of the file
+   * \return the name of the file
+   */
+  std::string GetFileName () const;
+
+private:
+  /**
+   * Position of a record in the file
+   */
+  struct Slot
+  {
+    uint64_t m_offset; //!< offset of the record from the beginning of the file
+    uint64_t m_size; //!< size of the record
+    uint64_t m_capacity; //!< size of the space reserved for the record
+  };
+
+  /**
+   * Enlarges the file and maps it again
+   * \param minSize the minimum size of the file
+   */
+  void Grow (uint64_t minSize);
+
+  /**
+   * Called before changing the records. In a forked child, copies the records
+   * to a new file owned by the child. In the owner process, if a fork happened
+   * since the last call, stops reusing the space of the current records, which
+   * the children may still read from the file.
+   */
+  void CheckFork ();
+
+  std::string m_fileName; //!< the name of the file
+  int m_fd; //!< the file descriptor
+  uint8_t *m_data; //!< the memory where the file is mapped, nullptr if the file is empty
+  uint64_t m_fileSize; //!< the size of the file
+  uint64_t m_end; //!< the end of the last slot
+  std::unordered_map<uint64_t, Slot> m_slots; //!< the slot of each record, indexed by the key of the record
+  std::multimap<uint64_t, uint64_t> m_freeSlots; //!< the offsets of the free slots, indexed by their capacity
+  pid_t m_ownerPid; //!< the process which created the file, the only one which changes and removes it
+  bool m_unlinked; //!< true if the file has already been removed from the directory
+  uint64_t m_numForks; //!< the number of forks of the owner process at the last call to CheckFork
+  uint64_t m_frozenEnd; //!< the space before this offset may be read by a forked child, hence it is not reused
+};
+
+} // namespace ns3
+
+#endif /* NYU_CHANNEL_SPILL_FILE_H */
@@ -0,0 +1,354 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+#include "ns3/nyu-fidelity-controller.h"
+#include "ns3/log.h"
+#include "ns3/abort.h"
+#include "ns3/double.h"
+#include "ns3/uinteger.h"
+#include "ns3/simulator.h"
+#include "ns3/trace-source-accessor.h"
+#include <algorithm>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("NYUFidelityController");
+
+NS_OBJECT_ENSURE_REGISTERED (NYUFidelityController);
+
+NYUFidelityController::NYUFidelityController ()
+  : m_initialMaxLossDb (0),
+    m_rayBudget (0),
+    m_frequencyDecimation (1),
+    m_maxLossDb (0),
+    m_lastNumReceptions (0)
+{
+  NS_LOG_FUNCTION (this);
+}
+
+NYUFidelityController::~NYUFidelityController ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+NYUFidelityController::DoDispose ()
+{
+  NS_LOG_FUNCTION (this);
+  m_evaluateEvent.Cancel ();
+  m_models.clear ();
+  m_channels.clear ();
+}
+
+TypeId
+NYUFidelityController::GetTypeId (void)
+{
+  static TypeId tid =
+    TypeId ("ns3::NYUFidelityController")
+    .SetGroupName ("Spectrum")
+    .SetParent<Object> ()
+    .AddConstructor<NYUFidelityController> ()
+    .AddAttribute ("TargetRealTimeRatio",
+                   "The target number of simulated seconds per wall-clock second",
+                   DoubleValue (1.0),
+                   MakeDoubleAccessor (&NYUFidelityController::m_targetRealTimeRatio),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("Hysteresis",
+                   "The fidelity is increased only if the measured ratio exceeds the target "
+                   "by more than this relative margin",
+                   DoubleValue (0.2),
+                   MakeDoubleAccessor (&NYUFidelityController::m_hysteresis),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("ControlInterval",
+                   "The simulated time between two evaluations of the simulation speed",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&NYUFidelityController::m_controlInterval),
+                   MakeTimeChecker ())
+    .AddAttribute ("MaxRayBudget",
+                   "The maximum number of rays set at the first reduction of the ray budget",
+                   UintegerValue (64),
+                   MakeUintegerAccessor (&NYUFidelityController::m_maxRayBudget),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MinRayBudget",
+                   "The lowest maximum number of rays the controller can set",
+                   UintegerValue (8),
+                   MakeUintegerAccessor (&NYUFidelityController::m_minRayBudget),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MaxFrequencyDecimation",
+                   "The highest frequency decimation the controller can set",
+                   UintegerValue (4),
+                   MakeUintegerAccessor (&NYUFidelityController::m_maxFrequencyDecimation),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("MaxCullingLossDb",
+                   "The interferer culling threshold in dB set at the first reduction of the threshold",
+                   DoubleValue (200.0),
+                   MakeDoubleAccessor (&NYUFidelityController::m_maxCullingLossDb),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("MinCullingLossDb",
+                   "The lowest interferer culling threshold in dB the controller can set",
+                   DoubleValue (140.0),
+                   MakeDoubleAccessor (&NYUFidelityController::m_minCullingLossDb),
+                   MakeDoubleChecker<double> ())
+    .AddAttribute ("CullingStepDb",
+                   "The step in dB used to change the interferer culling threshold",
+                   DoubleValue (10.0),
+                   MakeDoubleAccessor (&NYUFidelityController::m_cullingStepDb),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("MaxUpdatePeriod",
+                   "The longest channel update period the controller can set. The update period "
+                   "is changed only if it is not zero in the channel models",
+                   TimeValue (MilliSeconds (100)),
+                   MakeTimeAccessor (&NYUFidelityController::m_maxUpdatePeriod),
+                   MakeTimeChecker ())
+    .AddTraceSource ("Adjustment",
+                     "Trace fired every time a fidelity knob is changed",
+                     MakeTraceSourceAccessor (&NYUFidelityController::m_adjustmentTrace),
+                     "ns3::NYUFidelityController::AdjustmentTracedCallback");
+  return tid;
+}
+
+void
+NYUFidelityController::AddSpectrumPropagationLossModel (Ptr<NYUSpectrumPropagationLossModel> model)
+{
+  NS_LOG_FUNCTION (this);
+  m_models.push_back (model);
+}
+
+void
+NYUFidelityController::AddSpectrumChannel (Ptr<SpectrumChannel> channel)
+{
+  NS_LOG_FUNCTION (this);
+  m_channels.push_back (channel);
+}
+
+void
+NYUFidelityController::Start ()
+{
+  NS_LOG_FUNCTION (this);
+  NS_ASSERT_MSG (m_controlInterval.IsStrictlyPositive (), "The control interval must be positive");
+  NS_ABORT_MSG_IF (m_minRayBudget > m_maxRayBudget,
+                   "MinRayBudget (" << m_minRayBudget << ") is larger than MaxRayBudget (" << m_maxRayBudget << ")");
+  NS_ABORT_MSG_IF (m_minCullingLossDb > m_maxCullingLossDb,
+                   "MinCullingLossDb (" << m_minCullingLossDb << ") is larger than MaxCullingLossDb (" << m_maxCullingLossDb << ")");
+
+  // the full fidelity configuration: all the rays, one gain per subband and the
+  // culling threshold and update period configured by the user
+  m_rayBudget = 0;
+  m_frequencyDecimation = 1;
+  if (!m_channels.empty ())
+    {
+      DoubleValue maxLossDb;
+      m_channels.front ()->GetAttribute ("MaxLossDb", maxLossDb);
+      m_initialMaxLossDb = maxLossDb.Get ();
+      m_maxLossDb = m_initialMaxLossDb;
+    }
+  if (!m_models.empty ())
+    {
+      TimeValue updatePeriod;
+      m_models.front ()->GetChannelModelAttribute ("UpdatePeriod", updatePeriod);
+      m_initialUpdatePeriod = updatePeriod.Get ();
+      m_updatePeriod = m_initialUpdatePeriod;
+    }
+
+  m_lastWallTime = std::chrono::steady_clock::now ();
+  m_lastSimTime = Simulator::Now ();
+  m_lastNumReceptions = 0;
+  for (const auto &model : m_models)
+    {
+      m_lastNumReceptions += model->GetNumReceptions ();
+    }
+  m_evaluateEvent.Cancel ();
+  m_evaluateEvent = Simulator::Schedule (m_controlInterval, &NYUFidelityController::Evaluate, this);
+}
+
+void
+NYUFidelityController::Evaluate ()
+{
+  NS_LOG_FUNCTION (this);
+
+  auto wallTime = std::chrono::steady_clock::now ();
+  double elapsedWall = std::chrono::duration<double> (wallTime - m_lastWallTime).count ();
+  double elapsedSim = (Simulator::Now () - m_lastSimTime).GetSeconds ();
+  uint64_t numReceptions = 0;
+  for (const auto &model : m_models)
+    {
+      numReceptions += model->GetNumReceptions ();
+    }
+
+  double realTimeRatio = (elapsedWall > 0) ? elapsedSim / elapsedWall : m_targetRealTimeRatio;
+  double receptionCost = (numReceptions > m_lastNumReceptions) ? elapsedWall / (numReceptions - m_lastNumReceptions) : 0;
+  NS_LOG_DEBUG ("Simulated seconds per wall-clock second " << realTimeRatio
+                << ", wall-clock seconds per reception " << receptionCost);
+
+  if (realTimeRatio < m_targetRealTimeRatio)
+    {
+      if (!Degrade (realTimeRatio, receptionCost))
+        {
+          NS_LOG_WARN ("Target ratio " << m_targetRealTimeRatio << " not met at the lowest fidelity");
+        }
+    }
+  else if (realTimeRatio > m_targetRealTimeRatio * (1 + m_hysteresis))
+    {
+      Restore (realTimeRatio, receptionCost);
+    }
+
+  m_lastWallTime = std::chrono::steady_clock::now ();
+  m_lastSimTime = Simulator::Now ();
+  m_lastNumReceptions = numReceptions;
+  m_evaluateEvent = Simulator::Schedule (m_controlInterval, &NYUFidelityController::Evaluate, this);
+}
+
+bool
+NYUFidelityController::Degrade (double realTimeRatio, double receptionCost)
+{
+  NS_LOG_FUNCTION (this << realTimeRatio << receptionCost);
+
+  // fewer rays in the per-subband loop
+  if (!m_models.empty () && (m_rayBudget == 0 || m_rayBudget > m_minRayBudget))
+    {
+      uint32_t rayBudget = (m_rayBudget == 0) ? m_maxRayBudget : std::max (m_minRayBudget, m_rayBudget / 2);
+      m_adjustmentTrace ("MaxRays", m_rayBudget, rayBudget, realTimeRatio, receptionCost);
+      SetRayBudget (rayBudget);
+      return true;
+    }
+
+  // coarser frequency resolution of the gain
+  if (!m_models.empty () && m_frequencyDecimation < m_maxFrequencyDecimation)
+    {
+      uint32_t frequencyDecimation = std::min (m_maxFrequencyDecimation, m_frequencyDecimation * 2);
+      m_adjustmentTrace ("FrequencyDecimation", m_frequencyDecimation, frequencyDecimation, realTimeRatio, receptionCost);
+      SetFrequencyDecimation (frequencyDecimation);
+      return true;
+    }
+
+  // cull more interferers
+  if (!m_channels.empty () && m_maxLossDb > m_minCullingLossDb)
+    {
+      double maxLossDb = (m_maxLossDb > m_maxCullingLossDb) ? m_maxCullingLossDb : std::max (m_minCullingLossDb, m_maxLossDb - m_cullingStepDb);
+      m_adjustmentTrace ("MaxLossDb", m_maxLossDb, maxLossDb, realTimeRatio, receptionCost);
+      SetMaxLossDb (maxLossDb);
+      return true;
+    }
+
+  // update the channel less often
+  if (!m_models.empty () && !m_initialUpdatePeriod.IsZero () && m_updatePeriod < m_maxUpdatePeriod)
+    {
+      Time updatePeriod = Min (m_maxUpdatePeriod, NanoSeconds (m_updatePeriod.GetNanoSeconds () * 2));
+      m_adjustmentTrace ("UpdatePeriod", m_updatePeriod.GetSeconds (), updatePeriod.GetSeconds (), realTimeRatio, receptionCost);
+      SetUpdatePeriod (updatePeriod);
+      return true;
+    }
+
+  return false;
+}
+
+bool
+NYUFidelityController::Restore (double realTimeRatio, double receptionCost)
+{
+  NS_LOG_FUNCTION (this << realTimeRatio << receptionCost);
+
+  // the knobs are restored in the reverse order in which they are degraded
+  if (m_updatePeriod > m_initialUpdatePeriod)
+    {
+      Time updatePeriod = Max (m_initialUpdatePeriod, NanoSeconds (m_updatePeriod.GetNanoSeconds () / 2));
+      m_adjustmentTrace ("UpdatePeriod", m_updatePeriod.GetSeconds (), updatePeriod.GetSeconds (), realTimeRatio, receptionCost);
+      SetUpdatePeriod (updatePeriod);
+      return true;
+    }
+
+  if (m_maxLossDb < m_initialMaxLossDb)
+    {
+      double maxLossDb = m_maxLossDb + m_cullingStepDb;
+      if (maxLossDb > m_maxCullingLossDb || maxLossDb > m_initialMaxLossDb)
+        {
+          maxLossDb = m_initialMaxLossDb;
+        }
+      m_adjustmentTrace ("MaxLossDb", m_maxLossDb, maxLossDb, realTimeRatio, receptionCost);
+      SetMaxLossDb (maxLossDb);
+      return true;
+    }
+
+  if (m_frequencyDecimation > 1)
+    {
+      uint32_t frequencyDecimation = m_frequencyDecimation / 2;
+      m_adjustmentTrace ("FrequencyDecimation", m_frequencyDecimation, frequencyDecimation, realTimeRatio, receptionCost);
+      SetFrequencyDecimation (frequencyDecimation);
+      return true;
+    }
+
+  if (m_rayBudget != 0)
+    {
+      uint32_t rayBudget = (m_rayBudget * 2 > m_maxRayBudget) ? 0 : m_rayBudget * 2;
+      m_adjustmentTrace ("MaxRays", m_rayBudget, rayBudget, realTimeRatio, receptionCost);
+      SetRayBudget (rayBudget);
+      return true;
+    }
+
+  return false;
+}
+
+void
+NYUFidelityController::SetRayBudget (uint32_t rayBudget)
+{
+  NS_LOG_FUNCTION (this << rayBudget);
+  m_rayBudget = rayBudget;
+  for (const auto &model : m_models)
+    {
+      model->SetAttribute ("MaxRays", UintegerValue (rayBudget));
+    }
+}
+
+void
+NYUFidelityController::SetFrequencyDecimation (uint32_t frequencyDecimation)
+{
+  NS_LOG_FUNCTION (this << frequencyDecimation);
+  m_frequencyDecimation = frequencyDecimation;
+  for (const auto &model : m_models)
+    {
+      model->SetAttribute ("FrequencyDecimation", UintegerValue (frequencyDecimation));
+    }
+}
+
+void
+NYUFidelityController::SetMaxLossDb (double maxLossDb)
+{
+  NS_LOG_FUNCTION (this << maxLossDb);
+  m_maxLossDb = maxLossDb;
+  for (const auto &channel : m_channels)
+    {
+      channel->SetAttribute ("MaxLossDb", DoubleValue (maxLossDb));
+    }
+}
+
+void
+NYUFidelityController::SetUpdatePeriod (Time updatePeriod)
+{
+  NS_LOG_FUNCTION (this << updatePeriod);
+  m_updatePeriod = updatePeriod;
+  for (const auto &model : m_models)
+    {
+      model->SetChannelModelAttribute ("UpdatePeriod", TimeValue (updatePeriod));
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,192 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+#ifndef NYU_FIDELITY_CONTROLLER_H
+#define NYU_FIDELITY_CONTROLLER_H
+
+#include <ns3/object.h>
+#include <ns3/nstime.h>
+#include <ns3/event-id.h>
+#include <ns3/traced-callback.h>
+#include <ns3/spectrum-channel.h>
+#include <ns3/nyu-spectrum-propagation-loss-model.h>
+#include <chrono>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup spectrum
+ * \brief Adaptive fidelity controller for the NYU channel model
+ *
+ * The controller periodically measures the ratio between the simulated time and
+ * the wall-clock time, and the wall-clock cost of each received PSD computed by the
+ * attached NYUSpectrumPropagationLossModel instances. If the ratio is below the target
+ * the fidelity is reduced by one step, acting on the following knobs in this order:
+ * the maximum number of rays (MaxRays of NYUSpectrumPropagationLossModel), the
+ * frequency resolution of the gain (FrequencyDecimation of NYUSpectrumPropagationLossModel),
+ * the interferer culling threshold (MaxLossDb of the attached SpectrumChannel instances)
+ * and the update period of the channel (UpdatePeriod of NYUChannelModel). If the ratio is
+ * above the target by more than the hysteresis, the fidelity is increased by one step in
+ * the reverse order. Each knob is kept within the bounds set through the attributes.
+ * Every adjustment is reported through the Adjustment trace source.
+ * A new ray budget drops the long term components cached by the models, so that
+ * it applies to all the links from the next reception on. Start aborts if
+ * MinRayBudget is larger than MaxRayBudget or MinCullingLossDb is larger than
+ * MaxCullingLossDb.
+ */
+class NYUFidelityController : public Object
+{
+public:
+  /**
+   * Constructor
+   */
+  NYUFidelityController ();
+
+  /**
+   * Destructor
+   */
+  ~NYUFidelityController () override;
+
+  void DoDispose () override;
+
+  /**
+   * Get the type ID
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId ();
+
+  /**
+   * Adds a spectrum propagation loss model to the ones controlled. The update
+   * period is set on its channel model.
+   * \param model the spectrum propagation loss model
+   */
+  void AddSpectrumPropagationLossModel (Ptr<NYUSpectrumPropagationLossModel> model);
+
+  /**
+   * Adds a spectrum channel whose interferer culling threshold is controlled
+   * \param channel the spectrum channel
+   */
+  void AddSpectrumChannel (Ptr<SpectrumChannel> channel);
+
+  /**
+   * Starts the periodic evaluation. The current values of the knobs of the
+   * attached objects are taken as the full fidelity configuration.
+   */
+  void Start ();
+
+  /**
+   * TracedCallback signature for the fidelity adjustments
+   * \param knob the name of the adjusted knob
+   * \param oldValue the value of the knob before the adjustment
+   * \param newValue the value of the knob after the adjustment
+   * \param realTimeRatio the measured simulated seconds per wall-clock second
+   * \param receptionCost the measured wall-clock seconds per received PSD
+   */
+  typedef void (*AdjustmentTracedCallback) (std::string knob, double oldValue, double newValue,
+                                            double realTimeRatio, double receptionCost);
+
+private:
+  /**
+   * Measures the simulation speed over the last control interval, adjusts
+   * the fidelity if needed and schedules the next evaluation
+   */
+  void Evaluate ();
+
+  /**
+   * Reduces the fidelity by one step
+   * \param realTimeRatio the measured simulated seconds per wall-clock second
+   * \param receptionCost the measured wall-clock seconds per received PSD
+   * \return false if all the knobs are already at their lowest fidelity
+   */
+  bool Degrade (double realTimeRatio, double receptionCost);
+
+  /**
+   * Increases the fidelity by one step
+   * \param realTimeRatio the measured simulated seconds per wall-clock second
+   * \param receptionCost the measured wall-clock seconds per received PSD
+   * \return false if all the knobs are already at full fidelity
+   */
+  bool Restore (double realTimeRatio, double receptionCost);
+
+  /**
+   * Sets the maximum number of rays on all the spectrum propagation loss models
+   * \param rayBudget the maximum number of rays, 0 for no limit
+   */
+  void SetRayBudget (uint32_t rayBudget);
+
+  /**
+   * Sets the frequency decimation on all the spectrum propagation loss models
+   * \param frequencyDecimation the number of subbands sharing the same gain
+   */
+  void SetFrequencyDecimation (uint32_t frequencyDecimation);
+
+  /**
+   * Sets the interferer culling threshold on all the spectrum channels
+   * \param maxLossDb the maximum loss in dB
+   */
+  void SetMaxLossDb (double maxLossDb);
+
+  /**
+   * Sets the update period on the channel models of all the spectrum propagation loss models
+   * \param updatePeriod the update period
+   */
+  void SetUpdatePeriod (Time updatePeriod);
+
+  std::vector<Ptr<NYUSpectrumPropagationLossModel> > m_models; //!< the controlled spectrum propagation loss models
+  std::vector<Ptr<SpectrumChannel> > m_channels; //!< the controlled spectrum channels
+
+  // configuration
+  double m_targetRealTimeRatio; //!< the target simulated seconds per wall-clock second
+  double m_hysteresis; //!< relative margin above the target before the fidelity is increased
+  Time m_controlInterval; //!< the simulated time between two evaluations
+  uint32_t m_maxRayBudget; //!< the ray budget set at the first reduction step
+  uint32_t m_minRayBudget; //!< the lowest ray budget
+  uint32_t m_maxFrequencyDecimation; //!< the highest frequency decimation
+  double m_maxCullingLossDb; //!< the culling threshold set at the first reduction step
+  double m_minCullingLossDb; //!< the lowest culling threshold
+  double m_cullingStepDb; //!< the culling threshold step
+  Time m_maxUpdatePeriod; //!< the longest update period
+
+  // full fidelity values, read at Start
+  double m_initialMaxLossDb; //!< the culling threshold of the spectrum channels
+  Time m_initialUpdatePeriod; //!< the update period of the channel models
+
+  // current values of the knobs
+  uint32_t m_rayBudget; //!< the current ray budget, 0 for no limit
+  uint32_t m_frequencyDecimation; //!< the current frequency decimation
+  double m_maxLossDb; //!< the current culling threshold
+  Time m_updatePeriod; //!< the current update period
+
+  // measurements
+  std::chrono::steady_clock::time_point m_lastWallTime; //!< wall-clock time of the last evaluation
+  Time m_lastSimTime; //!< simulated time of the last evaluation
+  uint64_t m_lastNumReceptions; //!< number of received PSDs at the last evaluation
+  EventId m_evaluateEvent; //!< the next evaluation
+
+  TracedCallback<std::string, double, double, double, double> m_adjustmentTrace; //!< trace of the adjustments
+};
+
+} // namespace ns3
+
+#endif /* NYU_FIDELITY_CONTROLLER_H */
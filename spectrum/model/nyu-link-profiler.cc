@@ -0,0 +1,310 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+#include "ns3/nyu-link-profiler.h"
+#include "ns3/log.h"
+#include "ns3/boolean.h"
+#include "ns3/string.h"
+#include "ns3/uinteger.h"
+#include "ns3/simulator.h"
+#include "ns3/matrix-based-channel-model.h"
+#include <algorithm>
+#include <complex>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace ns3 {
+
+NS_LOG_COMPONENT_DEFINE ("NYULinkProfiler");
+
+NS_OBJECT_ENSURE_REGISTERED (NYULinkProfiler);
+
+/// names of the profiled stages, in the order of NYULinkProfiler::Stage
+static const char *stageNames[NYULinkProfiler::NUM_STAGES] = {
+  "params", "matrix", "longTerm", "bfGain"
+};
+
+double
+NYULinkProfiler::LinkCost::GetTotalSeconds () const
+{
+  double total = 0;
+  for (uint32_t s = 0; s < NUM_STAGES; s++)
+    {
+      total += m_seconds[s];
+    }
+  return total;
+}
+
+size_t
+NYULinkProfiler::LinkCost::GetTotalBytes () const
+{
+  size_t total = m_paramsBytes;
+  for (const auto &matrix : m_matrixBytes)
+    {
+      total += matrix.second;
+    }
+  return total;
+}
+
+NYULinkProfiler::NYULinkProfiler ()
+  : m_recordedSeconds (0)
+{
+  NS_LOG_FUNCTION (this);
+  // the event holds a reference, so the profiler outlives the models which
+  // drop it and the report is produced when the simulator is destroyed
+  m_dumpEvent = Simulator::ScheduleDestroy (&NYULinkProfiler::DumpAtEnd, Ptr<NYULinkProfiler> (this));
+}
+
+NYULinkProfiler::~NYULinkProfiler ()
+{
+  NS_LOG_FUNCTION (this);
+}
+
+void
+NYULinkProfiler::DoDispose ()
+{
+  NS_LOG_FUNCTION (this);
+  m_dumpEvent.Cancel ();
+  m_links.clear ();
+}
+
+TypeId
+NYULinkProfiler::GetTypeId (void)
+{
+  static TypeId tid =
+    TypeId ("ns3::NYULinkProfiler")
+    .SetGroupName ("Spectrum")
+    .SetParent<Object> ()
+    .AddConstructor<NYULinkProfiler> ()
+    .AddAttribute ("TopN",
+                   "The number of links printed in the report at the end of the simulation",
+                   UintegerValue (10),
+                   MakeUintegerAccessor (&NYULinkProfiler::m_topN),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("CsvFileName",
+                   "The name of the CSV file with the cost of all the links, written at the end "
+                   "of the simulation. If empty no file is written",
+                   StringValue (""),
+                   MakeStringAccessor (&NYULinkProfiler::m_csvFileName),
+                   MakeStringChecker ())
+    .AddAttribute ("ReportAtEnd",
+                   "If true the report and the CSV file are produced when the simulator is destroyed",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&NYULinkProfiler::m_reportAtEnd),
+                   MakeBooleanChecker ());
+  return tid;
+}
+
+std::chrono::steady_clock::time_point
+NYULinkProfiler::Now ()
+{
+  return std::chrono::steady_clock::now ();
+}
+
+NYULinkProfiler::LinkCost &
+NYULinkProfiler::GetLinkCost (uint32_t aId, uint32_t bId)
+{
+  uint64_t key = MatrixBasedChannelModel::GetKey (aId, bId);
+  auto it = m_links.find (key);
+  if (it == m_links.end ())
+    {
+      it = m_links.emplace (key, LinkCost ()).first;
+      it->second.m_nodeA = std::min (aId, bId);
+      it->second.m_nodeB = std::max (aId, bId);
+    }
+  return it->second;
+}
+
+void
+NYULinkProfiler::Record (Stage stage, uint32_t aId, uint32_t bId,
+                         std::chrono::steady_clock::time_point start)
+{
+  std::chrono::duration<double> elapsed = Now () - start;
+  LinkCost &cost = GetLinkCost (aId, bId);
+  cost.m_seconds[stage] += elapsed.count ();
+  cost.m_count[stage]++;
+  m_recordedSeconds += elapsed.count ();
+}
+
+void
+NYULinkProfiler::RecordExclusive (Stage stage, uint32_t aId, uint32_t bId,
+                                  std::chrono::steady_clock::time_point start, double recordedAtStart)
+{
+  std::chrono::duration<double> elapsed = Now () - start;
+  double seconds = std::max (0.0, elapsed.count () - (m_recordedSeconds - recordedAtStart));
+  LinkCost &cost = GetLinkCost (aId, bId);
+  cost.m_seconds[stage] += seconds;
+  cost.m_count[stage]++;
+  m_recordedSeconds += seconds;
+}
+
+double
+NYULinkProfiler::GetRecordedSeconds () const
+{
+  return m_recordedSeconds;
+}
+
+void
+NYULinkProfiler::RecordParams (uint32_t aId, uint32_t bId, uint32_t numRays, size_t bytes)
+{
+  LinkCost &cost = GetLinkCost (aId, bId);
+  cost.m_numRays = numRays;
+  cost.m_paramsBytes = bytes;
+}
+
+void
+NYULinkProfiler::RecordMatrix (uint32_t aId, uint32_t bId, uint64_t antennaKey, uint32_t numElements)
+{
+  LinkCost &cost = GetLinkCost (aId, bId);
+  cost.m_maxMatrixElements = std::max (cost.m_maxMatrixElements, numElements);
+  cost.m_matrixBytes[antennaKey] = numElements * sizeof (std::complex<double>);
+}
+
+void
+NYULinkProfiler::ReleaseParams (uint32_t aId, uint32_t bId)
+{
+  auto it = m_links.find (MatrixBasedChannelModel::GetKey (aId, bId));
+  if (it != m_links.end ())
+    {
+      it->second.m_paramsBytes = 0;
+    }
+}
+
+void
+NYULinkProfiler::ReleaseMatrix (uint32_t aId, uint32_t bId, uint64_t antennaKey)
+{
+  auto it = m_links.find (MatrixBasedChannelModel::GetKey (aId, bId));
+  if (it != m_links.end ())
+    {
+      it->second.m_matrixBytes.erase (antennaKey);
+    }
+}
+
+std::vector<NYULinkProfiler::LinkCost>
+NYULinkProfiler::GetLinkCosts () const
+{
+  std::vector<LinkCost> costs;
+  costs.reserve (m_links.size ());
+  for (const auto &entry : m_links)
+    {
+      costs.push_back (entry.second);
+    }
+  std::sort (costs.begin (), costs.end (), [] (const LinkCost &x, const LinkCost &y) {
+    return x.GetTotalSeconds () > y.GetTotalSeconds ();
+  });
+  return costs;
+}
+
+void
+NYULinkProfiler::PrintReport (std::ostream &os, uint32_t topN) const
+{
+  std::vector<LinkCost> costs = GetLinkCosts ();
+  double totalSeconds = 0;
+  for (const auto &cost : costs)
+    {
+      totalSeconds += cost.GetTotalSeconds ();
+    }
+
+  os << "NYU link profiler: " << costs.size () << " links, " << totalSeconds << " s" << std::endl;
+  os << std::setw (12) << "link" << std::setw (12) << "time [ms]" << std::setw (8) << "share";
+  for (uint32_t s = 0; s < NUM_STAGES; s++)
+    {
+      os << std::setw (10) << stageNames[s];
+    }
+  os << std::setw (8) << "rays" << std::setw (10) << "elements" << std::setw (12) << "bytes" << std::endl;
+
+  for (uint32_t i = 0; i < std::min<size_t> (topN, costs.size ()); i++)
+    {
+      const LinkCost &cost = costs[i];
+      std::ostringstream link;
+      link << cost.m_nodeA << "-" << cost.m_nodeB;
+      double share = totalSeconds > 0 ? cost.GetTotalSeconds () / totalSeconds : 0;
+      os << std::setw (12) << link.str ()
+         << std::setw (12) << std::fixed << std::setprecision (3) << cost.GetTotalSeconds () * 1e3
+         << std::setw (7) << std::setprecision (1) << share * 100 << "%";
+      // number of runs of each stage
+      for (uint32_t s = 0; s < NUM_STAGES; s++)
+        {
+          os << std::setw (10) << cost.m_count[s];
+        }
+      os << std::setw (8) << cost.m_numRays << std::setw (10) << cost.m_maxMatrixElements
+         << std::setw (12) << cost.GetTotalBytes () << std::endl;
+      os.unsetf (std::ios_base::floatfield);
+    }
+}
+
+void
+NYULinkProfiler::WriteCsv (std::ostream &os) const
+{
+  os << "nodeA,nodeB,totalSeconds";
+  for (uint32_t s = 0; s < NUM_STAGES; s++)
+    {
+      os << "," << stageNames[s] << "Seconds," << stageNames[s] << "Count";
+    }
+  os << ",numRays,maxMatrixElements,paramsBytes,matrixBytes" << std::endl;
+
+  for (const auto &cost : GetLinkCosts ())
+    {
+      os << cost.m_nodeA << "," << cost.m_nodeB << "," << cost.GetTotalSeconds ();
+      for (uint32_t s = 0; s < NUM_STAGES; s++)
+        {
+          os << "," << cost.m_seconds[s] << "," << cost.m_count[s];
+        }
+      os << "," << cost.m_numRays << "," << cost.m_maxMatrixElements << "," << cost.m_paramsBytes
+         << "," << cost.GetTotalBytes () - cost.m_paramsBytes << std::endl;
+    }
+}
+
+void
+NYULinkProfiler::Reset ()
+{
+  NS_LOG_FUNCTION (this);
+  m_links.clear ();
+  m_recordedSeconds = 0;
+}
+
+void
+NYULinkProfiler::DumpAtEnd ()
+{
+  NS_LOG_FUNCTION (this);
+  if (!m_reportAtEnd || m_links.empty ())
+    {
+      return;
+    }
+
+  PrintReport (std::cout, m_topN);
+  if (!m_csvFileName.empty ())
+    {
+      std::ofstream csv (m_csvFileName);
+      if (!csv.is_open ())
+        {
+          NS_LOG_ERROR ("Can't open file " << m_csvFileName);
+          return;
+        }
+      WriteCsv (csv);
+    }
+}
+
+} // namespace ns3
@@ -0,0 +1,225 @@
+/*
+*	Copyright (c) 2023 New York University and NYU WIRELESS
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy of this
+*	software and associated documentation files (the “Software”), to deal in the Software
+*	without restriction, including without limitation the rights to use, copy, modify,
+*	merge, publish, distribute, sublicense, and/or sell copies of the Software, and to permit
+*	persons to whom the Software is furnished to do so, subject to the following conditions:
+*	
+*	The above copyright notice and this permission notice shall be included in all copies
+*	or substantial portions of the Software. Users are encouraged to cite NYU WIRELESS 
+*	publications regarding this work.
+*	
+*	THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND,
+*	EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+*	OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+*	BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN
+*	AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR
+*	IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+*	THE SOFTWARE.
+*/
+
+#ifndef NYU_LINK_PROFILER_H
+#define NYU_LINK_PROFILER_H
+
+#include <ns3/object.h>
+#include <ns3/event-id.h>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+/**
+ * \ingroup spectrum
+ * \brief Per-link cost profiler for the NYU channel model
+ *
+ * When set through the Profiler attribute of NYUChannelModel and
+ * NYUSpectrumPropagationLossModel, the profiler attributes the wall-clock time
+ * of each stage of the channel computation (generation of the channel params,
+ * generation of the channel matrix, long term component and beamforming gain)
+ * to the pair of nodes of the link, together with the number of times each
+ * stage has run, the number of rays, the size of the channel matrices and the
+ * memory held in the caches for the link. At the end of the simulation the
+ * TopN most expensive links are printed on the standard output and, if
+ * CsvFileName is not empty, all the links are written to a CSV file. The
+ * event producing the report keeps a reference to the profiler until the
+ * simulator is destroyed.
+ * If the attribute is not set the models only check a null pointer.
+ */
+class NYULinkProfiler : public Object
+{
+public:
+  /**
+   * The profiled stages of the channel computation
+   */
+  enum Stage
+  {
+    PARAMS_GENERATION, //!< generation of the channel params (NYUChannelModel)
+    MATRIX_GENERATION, //!< generation of the channel matrix (NYUChannelModel)
+    LONG_TERM, //!< computation of the long term component (NYUSpectrumPropagationLossModel)
+    BEAMFORMING_GAIN, //!< computation of the received PSD (NYUSpectrumPropagationLossModel)
+    NUM_STAGES
+  };
+
+  /**
+   * The cost attributed to a link
+   */
+  struct LinkCost
+  {
+    uint32_t m_nodeA {0}; //!< the lower node id of the link
+    uint32_t m_nodeB {0}; //!< the higher node id of the link
+    double m_seconds[NUM_STAGES] {}; //!< wall-clock seconds spent in each stage
+    uint64_t m_count[NUM_STAGES] {}; //!< number of times each stage has run
+    uint32_t m_numRays {0}; //!< number of rays of the last generated channel params
+    uint32_t m_maxMatrixElements {0}; //!< largest number of elements (u x s x rays) of a channel matrix of the link
+    size_t m_paramsBytes {0}; //!< memory held by the cached channel params of the link
+    std::unordered_map<uint64_t, size_t> m_matrixBytes; //!< memory held by the cached channel matrices of the link, per antenna pair
+
+    /**
+     * \return the total wall-clock seconds attributed to the link
+     */
+    double GetTotalSeconds () const;
+
+    /**
+     * \return the total memory in bytes held in the caches for the link
+     */
+    size_t GetTotalBytes () const;
+  };
+
+  /**
+   * Constructor
+   */
+  NYULinkProfiler ();
+
+  /**
+   * Destructor
+   */
+  ~NYULinkProfiler () override;
+
+  void DoDispose () override;
+
+  /**
+   * Get the type ID
+   * \return the object TypeId
+   */
+  static TypeId GetTypeId ();
+
+  /**
+   * \return the current value of the wall clock used by the profiler
+   */
+  static std::chrono::steady_clock::time_point Now ();
+
+  /**
+   * Attributes the time elapsed since start to a stage of a link
+   * \param stage the profiled stage
+   * \param aId the id of the first node
+   * \param bId the id of the second node
+   * \param start the wall-clock time at which the stage started
+   */
+  void Record (Stage stage, uint32_t aId, uint32_t bId, std::chrono::steady_clock::time_point start);
+
+  /**
+   * Attributes the time elapsed since start to a stage of a link, excluding
+   * the time recorded for any stage in the meantime, e.g., the generation of
+   * the channel params triggered while computing the long term component
+   * \param stage the profiled stage
+   * \param aId the id of the first node
+   * \param bId the id of the second node
+   * \param start the wall-clock time at which the stage started
+   * \param recordedAtStart the value of GetRecordedSeconds at start
+   */
+  void RecordExclusive (Stage stage, uint32_t aId, uint32_t bId,
+                        std::chrono::steady_clock::time_point start, double recordedAtStart);
+
+  /**
+   * \return the total wall-clock seconds recorded so far for all the links and stages
+   */
+  double GetRecordedSeconds () const;
+
+  /**
+   * Records the size of newly generated channel params
+   * \param aId the id of the first node
+   * \param bId the id of the second node
+   * \param numRays the number of rays
+   * \param bytes the memory held by the channel params
+   */
+  void RecordParams (uint32_t aId, uint32_t bId, uint32_t numRays, size_t bytes);
+
+  /**
+   * Records the size of a newly generated channel matrix
+   * \param aId the id of the first node
+   * \param bId the id of the second node
+   * \param antennaKey the reciprocal key of the antenna pair of the matrix
+   * \param numElements the number of complex coefficients of the matrix
+   */
+  void RecordMatrix (uint32_t aId, uint32_t bId, uint64_t antennaKey, uint32_t numElements);
+
+  /**
+   * Records that the channel params of a link are no longer held in memory,
+   * e.g., because they have been evicted from the cache
+   * \param aId the id of the first node
+   * \param bId the id of the second node
+   */
+  void ReleaseParams (uint32_t aId, uint32_t bId);
+
+  /**
+   * Records that a channel matrix of a link is no longer held in memory,
+   * e.g., because it has been evicted from the cache
+   * \param aId the id of the first node
+   * \param bId the id of the second node
+   * \param antennaKey the reciprocal key of the antenna pair of the matrix
+   */
+  void ReleaseMatrix (uint32_t aId, uint32_t bId, uint64_t antennaKey);
+
+  /**
+   * \return the cost of each profiled link
+   */
+  std::vector<LinkCost> GetLinkCosts () const;
+
+  /**
+   * Prints the most expensive links, sorted by total wall-clock time
+   * \param os the output stream
+   * \param topN the number of links to print
+   */
+  void PrintReport (std::ostream &os, uint32_t topN) const;
+
+  /**
+   * Writes the cost of all the links in CSV format
+   * \param os the output stream
+   */
+  void WriteCsv (std::ostream &os) const;
+
+  /**
+   * Clears all the collected costs
+   */
+  void Reset ();
+
+private:
+  /**
+   * \param aId the id of the first node
+   * \param bId the id of the second node
+   * \return the entry of the link, created if needed
+   */
+  LinkCost &GetLinkCost (uint32_t aId, uint32_t bId);
+
+  /**
+   * Prints the report and writes the CSV file, called when the simulator is destroyed
+   */
+  void DumpAtEnd ();
+
+  std::unordered_map<uint64_t, LinkCost> m_links; //!< the cost of each link, the key is reciprocal
+  double m_recordedSeconds; //!< total wall-clock seconds recorded for all the links and stages
+  uint32_t m_topN; //!< number of links printed in the report
+  std::string m_csvFileName; //!< name of the CSV file, no file is written if empty
+  bool m_reportAtEnd; //!< if true the report is produced when the simulator is destroyed
+  EventId m_dumpEvent; //!< the event producing the report
+};
+
+} // namespace ns3
+
+#endif /* NYU_LINK_PROFILER_H */
@@ -34,19 +34,338 @@
 #include "ns3/string.h"
 #include "ns3/simulator.h"
 #include "ns3/pointer.h"
+#include "ns3/boolean.h"
+#include "ns3/enum.h"
+#include "ns3/uinteger.h"
+#include "ns3/mobility-model.h"
+#include "ns3/propagation-loss-model.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <functional>
+#include <limits>
 #include <map>
+#include <mutex>
+#include <thread>
+#include <unistd.h>
+
+#ifdef HAVE_EIGEN3
+#include <Eigen/Dense>
+#endif
 
 namespace ns3 {
 
 NS_LOG_COMPONENT_DEFINE ("NYUSpectrumPropagationLossModel");
 
+static const double M_C = 3.0e8; // in m/s, as in NYUChannelModel
+
 NS_OBJECT_ENSURE_REGISTERED (NYUSpectrumPropagationLossModel);
 
+/**
+ * \return the checker of the LongTermBackend attribute, the Eigen backend can be
+ * selected only if ns-3 has been configured with Eigen
+ */
+static Ptr<const AttributeChecker>
+MakeLongTermBackendChecker ()
+{
+#ifdef HAVE_EIGEN3
+  return MakeEnumChecker (NYUSpectrumPropagationLossModel::SCALAR, "Scalar",
+                          NYUSpectrumPropagationLossModel::EIGEN, "Eigen");
+#else
+  return MakeEnumChecker (NYUSpectrumPropagationLossModel::SCALAR, "Scalar");
+#endif
+}
+
+/**
+ * Returns the locations of the elements of an antenna array
+ * \param antenna the antenna array
+ * \return the element locations, in multiples of the wavelength
+ */
+static std::vector<Vector>
+GetElementLocations (Ptr<const PhasedArrayModel> antenna)
+{
+  std::vector<Vector> locations (antenna->GetNumberOfElements ());
+  for (size_t e = 0; e < locations.size (); e++)
+    {
+      locations[e] = antenna->GetElementLocation (e);
+    }
+  return locations;
+}
+
+/**
+ * Computes the power gain of an array with beamforming vector w for a plane
+ * wave with unit direction vector k, i.e., |sum_e w_e exp (j 2 pi k . r_e)|^2
+ * \param locations the element locations
+ * \param w the beamforming vector
+ * \param k the unit direction vector of the plane wave
+ * \return the power gain
+ */
+static double
+GetArrayGain (const std::vector<Vector> &locations,
+              const PhasedArrayModel::ComplexVector &w,
+              const Vector &k)
+{
+  std::complex<double> sum (0.0, 0.0);
+  for (size_t e = 0; e < locations.size (); e++)
+    {
+      sum += w[e] * std::polar (1.0, 2 * M_PI * (k.x * locations[e].x + k.y * locations[e].y + k.z * locations[e].z));
+    }
+  return std::norm (sum);
+}
+
+/**
+ * Computes the power gain of an array steered towards the unit direction
+ * vector kSteer with a normalized conjugate beamforming vector, for a plane
+ * wave with unit direction vector k
+ * \param locations the element locations
+ * \param k the unit direction vector of the plane wave
+ * \param kSteer the unit direction vector the array is steered to
+ * \return the power gain
+ */
+static double
+GetSteeredArrayGain (const std::vector<Vector> &locations, const Vector &k, const Vector &kSteer)
+{
+  Vector kDiff = k - kSteer;
+  std::complex<double> sum (0.0, 0.0);
+  for (const Vector &location : locations)
+    {
+      sum += std::polar (1.0, 2 * M_PI * (kDiff.x * location.x + kDiff.y * location.y + kDiff.z * location.z));
+    }
+  return std::norm (sum) / locations.size ();
+}
+
+/**
+ * Computes, for each ray, the mean element phase of an array and the terms of
+ * the third order expansion of the array response in the relative frequency
+ * offset d, i.e., moments[n][k] = sum_e w_e exp (j psi_e) (j psi_e)^k / k!,
+ * where psi_e is the phase of element e minus the mean phase
+ * \param locations the element locations of the antenna array
+ * \param w the beamforming vector of the array
+ * \param rayDirections the unit direction vector of each ray
+ * \param moments the terms of the expansion of each ray
+ * \param meanPhase the mean element phase of each ray
+ * \param maxPhase the largest |psi_e| of each ray
+ */
+static void
+GetArrayResponseExpansion (const std::vector<Vector> &locations,
+                           const PhasedArrayModel::ComplexVector &w,
+                           const std::vector<Vector> &rayDirections,
+                           std::vector<std::array<std::complex<double>, 4> > &moments,
+                           std::vector<double> &meanPhase,
+                           std::vector<double> &maxPhase)
+{
+  size_t numElements = locations.size ();
+
+  moments.assign (rayDirections.size (), std::array<std::complex<double>, 4> ());
+  meanPhase.assign (rayDirections.size (), 0.0);
+  maxPhase.assign (rayDirections.size (), 0.0);
+  std::vector<double> phases (numElements);
+  const std::complex<double> j (0.0, 1.0);
+  for (size_t nIndex = 0; nIndex < rayDirections.size (); nIndex++)
+    {
+      const Vector &k = rayDirections[nIndex];
+      for (size_t e = 0; e < numElements; e++)
+        {
+          phases[e] = 2 * M_PI * (k.x * locations[e].x + k.y * locations[e].y + k.z * locations[e].z);
+          meanPhase[nIndex] += phases[e];
+        }
+      meanPhase[nIndex] /= numElements;
+
+      std::array<std::complex<double>, 4> &m = moments[nIndex];
+      for (size_t e = 0; e < numElements; e++)
+        {
+          double psi = phases[e] - meanPhase[nIndex];
+          maxPhase[nIndex] = std::max (maxPhase[nIndex], std::abs (psi));
+          std::complex<double> term = w[e] * std::polar (1.0, psi);
+          m[0] += term;
+          term *= j * psi;
+          m[1] += term;
+          term *= j * psi / 2.0;
+          m[2] += term;
+          term *= j * psi / 3.0;
+          m[3] += term;
+        }
+    }
+}
+
+/**
+ * Computes the array response of a ray at the relative frequency offset d
+ * without the mean element phase, i.e., sum_e w_e exp (j (1 + d) psi_e),
+ * where psi_e is the phase of element e minus the mean phase
+ * \param locations the element locations of the antenna array
+ * \param w the beamforming vector of the array
+ * \param k the unit direction vector of the ray
+ * \param meanPhase the mean element phase of the ray
+ * \param scale the frequency scaling 1 + d
+ * \return the array response
+ */
+static std::complex<double>
+GetCenteredArrayResponse (const std::vector<Vector> &locations,
+                          const PhasedArrayModel::ComplexVector &w,
+                          const Vector &k,
+                          double meanPhase,
+                          double scale)
+{
+  std::complex<double> sum (0.0, 0.0);
+  for (size_t e = 0; e < locations.size (); e++)
+    {
+      double psi = 2 * M_PI * (k.x * locations[e].x + k.y * locations[e].y + k.z * locations[e].z) - meanPhase;
+      sum += w[e] * std::polar (1.0, scale * psi);
+    }
+  return sum;
+}
+
+/**
+ * A fixed set of threads that run the iterations of a loop. The threads are
+ * created once and wait for the next loop, and the calling thread runs
+ * iterations too. The iterations are taken in order, but each iteration
+ * writes only its own output, hence the result does not depend on the thread
+ * which runs it.
+ */
+class NYUSpectrumPropagationLossModel::BatchThreadPool
+{
+public:
+  /**
+   * Constructor
+   * \param numThreads the number of threads running the loops, including the calling one
+   */
+  BatchThreadPool (uint32_t numThreads)
+    : m_pid (getpid ())
+  {
+    for (uint32_t i = 1; i < numThreads; i++)
+      {
+        m_threads.emplace_back (&BatchThreadPool::DoWork, this);
+      }
+  }
+
+  ~BatchThreadPool ()
+  {
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_stop = true;
+    }
+    m_startCv.notify_all ();
+    for (std::thread &thread : m_threads)
+      {
+        thread.join ();
+      }
+  }
+
+  /**
+   * \return the process which created the threads
+   */
+  pid_t GetPid () const
+  {
+    return m_pid;
+  }
+
+  /**
+   * Runs work (i) for i in [0, numItems) and returns when all the iterations are done
+   * \param numItems the number of iterations
+   * \param work the body of the loop
+   */
+  void Run (size_t numItems, const std::function<void (size_t)> &work)
+  {
+    {
+      std::lock_guard<std::mutex> lock (m_mutex);
+      m_work = &work;
+      m_numItems = numItems;
+      m_nextItem = 0;
+      m_numActive = m_threads.size ();
+      m_generation++;
+    }
+    m_startCv.notify_all ();
+    RunItems ();
+    std::unique_lock<std::mutex> lock (m_mutex);
+    m_doneCv.wait (lock, [this] { return m_numActive == 0; });
+    m_work = nullptr;
+  }
+
+private:
+  /**
+   * Runs the iterations of the current loop until there are none left
+   */
+  void RunItems ()
+  {
+    for (size_t i = m_nextItem++; i < m_numItems; i = m_nextItem++)
+      {
+        (*m_work) (i);
+      }
+  }
+
+  /**
+   * The body of the threads
+   */
+  void DoWork ()
+  {
+    uint64_t generation = 0;
+    while (true)
+      {
+        {
+          std::unique_lock<std::mutex> lock (m_mutex);
+          m_startCv.wait (lock, [this, generation] { return m_stop || m_generation != generation; });
+          if (m_stop)
+            {
+              return;
+            }
+          generation = m_generation;
+        }
+        RunItems ();
+        {
+          std::lock_guard<std::mutex> lock (m_mutex);
+          m_numActive--;
+        }
+        m_doneCv.notify_one ();
+      }
+  }
+
+  pid_t m_pid; //!< the process which created the threads
+  std::vector<std::thread> m_threads; //!< the threads, besides the calling one
+  std::mutex m_mutex; //!< protects the state of the current loop
+  std::condition_variable m_startCv; //!< notified when a loop starts or the pool is destroyed
+  std::condition_variable m_doneCv; //!< notified when a thread has finished the current loop
+  const std::function<void (size_t)> *m_work {nullptr}; //!< the body of the current loop
+  size_t m_numItems {0}; //!< the number of iterations of the current loop
+  std::atomic<size_t> m_nextItem {0}; //!< the next iteration to run
+  size_t m_numActive {0}; //!< the number of threads still running the current loop
+  uint64_t m_generation {0}; //!< the number of loops started
+  bool m_stop {false}; //!< true when the threads have to terminate
+};
+
 NYUSpectrumPropagationLossModel::NYUSpectrumPropagationLossModel ()
+  : m_maxRays (0),
+    m_batchReceptions (false),
+    m_numBatchThreads (0)
 {
   NS_LOG_FUNCTION (this);
 }
 
+NYUSpectrumPropagationLossModel::BatchThreadPool &
+NYUSpectrumPropagationLossModel::GetBatchThreadPool () const
+{
+  ReleaseForkedBatchThreadPool ();
+  if (!m_batchThreadPool)
+    {
+      uint32_t numThreads = m_numBatchThreads > 0 ? m_numBatchThreads : std::max (1u, std::thread::hardware_concurrency ());
+      m_batchThreadPool.reset (new BatchThreadPool (numThreads));
+    }
+  return *m_batchThreadPool;
+}
+
+void
+NYUSpectrumPropagationLossModel::ReleaseForkedBatchThreadPool () const
+{
+  if (m_batchThreadPool && m_batchThreadPool->GetPid () != getpid ())
+    {
+      // in a forked child the threads of the pool do not exist and its mutex may
+      // have been copied while locked, hence the pool is leaked rather than
+      // destroyed, and a new one is created when needed
+      NS_LOG_DEBUG ("Release the batch threads of the parent process");
+      m_batchThreadPool.release ();
+    }
+}
+
 NYUSpectrumPropagationLossModel::~NYUSpectrumPropagationLossModel ()
 {
   NS_LOG_FUNCTION (this);
@@ -56,8 +375,20 @@ void
 NYUSpectrumPropagationLossModel::DoDispose ()
 {
   m_longTermMap.clear ();
+  ReleaseForkedBatchThreadPool ();
+  m_batchThreadPool.reset ();
+  m_batchReceivers.clear ();
+  m_batchResults.clear ();
+  m_batchParams = nullptr;
+  Ptr<NYUChannelModel> nyuChannelModel = DynamicCast<NYUChannelModel> (m_channelModel);
+  if (nyuChannelModel)
+    {
+      nyuChannelModel->TraceDisconnectWithoutContext ("ChannelMatrixEvicted",
+                                                      MakeCallback (&NYUSpectrumPropagationLossModel::NotifyChannelMatrixEvicted, this));
+    }
   m_channelModel->Dispose ();
   m_channelModel = nullptr;
+  m_profiler = nullptr;
 }
 
 TypeId
@@ -73,6 +404,84 @@ NYUSpectrumPropagationLossModel::GetTypeId (void)
                    MakePointerAccessor (&NYUSpectrumPropagationLossModel::SetChannelModel,
                                         &NYUSpectrumPropagationLossModel::GetChannelModel),
                    MakePointerChecker<MatrixBasedChannelModel> ())
+    .AddAttribute ("SisoFastPath",
+                   "If true and both devices have a single antenna element, the gain is computed "
+                   "directly from the NYU ray table, without generating and caching the channel matrix "
+                   "and the long term component. Used only with the NYUChannelModel",
+                   BooleanValue (true),
+                   MakeBooleanAccessor (&NYUSpectrumPropagationLossModel::m_sisoFastPath),
+                   MakeBooleanChecker ())
+    .AddAttribute ("LongTermBackend",
+                   "The implementation used to compute the long term component. Eigen is "
+                   "available only if ns-3 has been configured with Eigen support",
+                   EnumValue (NYUSpectrumPropagationLossModel::SCALAR),
+                   MakeEnumAccessor (&NYUSpectrumPropagationLossModel::m_longTermBackend),
+                   MakeLongTermBackendChecker ())
+    .AddAttribute ("RayPruning",
+                   "If true, the rays whose beamformed power is more than RayPruningThreshold "
+                   "below the strongest ray are not used to compute the subband gains",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&NYUSpectrumPropagationLossModel::m_rayPruning),
+                   MakeBooleanChecker ())
+    .AddAttribute ("RayPruningThreshold",
+                   "The ray pruning threshold in dB, relative to the beamformed power of the strongest ray",
+                   DoubleValue (-40.0),
+                   MakeDoubleAccessor (&NYUSpectrumPropagationLossModel::m_rayPruningThreshold),
+                   MakeDoubleChecker<double> (-300.0, 0.0))
+    .AddAttribute ("MaxRays",
+                   "The maximum number of rays used to compute the subband gains, the strongest "
+                   "ones after beamforming are kept. If 0 all the rays are used",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&NYUSpectrumPropagationLossModel::SetMaxRays,
+                                         &NYUSpectrumPropagationLossModel::GetMaxRays),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("FrequencyDecimation",
+                   "The gain is computed every FrequencyDecimation subbands and reused for the "
+                   "subbands in between. If 1 the gain is computed for every subband",
+                   UintegerValue (1),
+                   MakeUintegerAccessor (&NYUSpectrumPropagationLossModel::m_frequencyDecimation),
+                   MakeUintegerChecker<uint32_t> (1))
+    .AddAttribute ("BeamSquint",
+                   "If true, the long term component of each ray is evaluated at the center "
+                   "frequency of each subband, to model the beam squint of wideband large arrays. "
+                   "Used only with the NYUChannelModel and with multi element antennas",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&NYUSpectrumPropagationLossModel::m_beamSquint),
+                   MakeBooleanChecker ())
+    .AddAttribute ("BeamSquintMaxPhase",
+                   "The beam squint is modelled through a third order expansion of the array "
+                   "responses in the relative frequency offset d of the subband, whose error is "
+                   "at most (|d| psiMax)^4 / 24 of the array gain, where psiMax (rad) is the phase "
+                   "spread of the elements of both arrays for a ray. For the rays and subbands "
+                   "where |d| psiMax is larger than this value, the array responses are computed "
+                   "exactly from the element phases",
+                   DoubleValue (0.5),
+                   MakeDoubleAccessor (&NYUSpectrumPropagationLossModel::m_beamSquintMaxPhase),
+                   MakeDoubleChecker<double> (0.0))
+    .AddAttribute ("BatchReceptions",
+                   "If true, the first rx PSD requested for a transmission is computed together with "
+                   "the ones of the receivers of the previous transmission of the same antenna array "
+                   "whose channel is in memory, using NumBatchThreads threads, and the following "
+                   "requests at the same time are served from the results if their channel and beams "
+                   "are unchanged. The channels are retrieved on the simulator thread only for the "
+                   "requested PSDs and in request order, hence the results do not depend on batching "
+                   "or on the number of threads",
+                   BooleanValue (false),
+                   MakeBooleanAccessor (&NYUSpectrumPropagationLossModel::m_batchReceptions),
+                   MakeBooleanChecker ())
+    .AddAttribute ("NumBatchThreads",
+                   "The number of threads computing the rx PSDs when BatchReceptions is true, "
+                   "and the cross gains of CalcCrossGains. If 0, the number of cores is used",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&NYUSpectrumPropagationLossModel::m_numBatchThreads),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Profiler",
+                   "The per-link cost profiler, also set on the channel model if it is a "
+                   "NYUChannelModel. If not set, the costs are not profiled",
+                   PointerValue (),
+                   MakePointerAccessor (&NYUSpectrumPropagationLossModel::SetProfiler,
+                                        &NYUSpectrumPropagationLossModel::GetProfiler),
+                   MakePointerChecker<NYULinkProfiler> ())
   ;
   return tid;
 }
@@ -80,7 +489,97 @@ NYUSpectrumPropagationLossModel::GetTypeId (void)
 void
 NYUSpectrumPropagationLossModel::SetChannelModel (Ptr<MatrixBasedChannelModel> channel)
 {
+  Ptr<NYUChannelModel> nyuChannelModel = DynamicCast<NYUChannelModel> (m_channelModel);
+  if (nyuChannelModel)
+    {
+      nyuChannelModel->TraceDisconnectWithoutContext ("ChannelMatrixEvicted",
+                                                      MakeCallback (&NYUSpectrumPropagationLossModel::NotifyChannelMatrixEvicted, this));
+    }
+  // the cached long terms refer to the matrices of the previous model
+  m_longTermMap.clear ();
   m_channelModel = channel;
+  nyuChannelModel = DynamicCast<NYUChannelModel> (m_channelModel);
+  if (nyuChannelModel)
+    {
+      // the long term of a matrix is dropped with the matrix, otherwise it
+      // would keep the evicted matrix in memory
+      nyuChannelModel->TraceConnectWithoutContext ("ChannelMatrixEvicted",
+                                                   MakeCallback (&NYUSpectrumPropagationLossModel::NotifyChannelMatrixEvicted, this));
+      if (m_profiler)
+        {
+          nyuChannelModel->SetProfiler (m_profiler);
+        }
+    }
+}
+
+void
+NYUSpectrumPropagationLossModel::NotifyChannelMatrixEvicted (uint64_t channelMatrixKey)
+{
+  NS_LOG_FUNCTION (this << channelMatrixKey);
+  m_longTermMap.erase (channelMatrixKey);
+}
+
+size_t
+NYUSpectrumPropagationLossModel::GetNumCachedLongTerms () const
+{
+  return m_longTermMap.size ();
+}
+
+size_t
+NYUSpectrumPropagationLossModel::GetCachedLongTermsSize () const
+{
+  size_t size = 0;
+  for (const auto &entry : m_longTermMap)
+    {
+      // the channel matrix is shared with the channel model and not counted here
+      const LongTerm &longTerm = *entry.second;
+      size += (longTerm.m_longTerm.GetSize () + longTerm.m_sW.GetSize () + longTerm.m_uW.GetSize ())
+              * sizeof (std::complex<double>);
+      size += longTerm.m_squintPoly.size () * sizeof (std::array<std::complex<double>, 4>)
+              + longTerm.m_squintPhase.size () * sizeof (double)
+              + longTerm.m_squintRays.size () * sizeof (SquintRay)
+              + (longTerm.m_sLocations.size () + longTerm.m_uLocations.size ()) * sizeof (Vector);
+    }
+  return size;
+}
+
+void
+NYUSpectrumPropagationLossModel::SetMaxRays (uint32_t maxRays)
+{
+  NS_LOG_FUNCTION (this << maxRays);
+  if (maxRays != m_maxRays)
+    {
+      // the cached long terms and rx PSDs were computed with the previous ray budget
+      m_longTermMap.clear ();
+      m_batchReceivers.clear ();
+      m_batchResults.clear ();
+      m_batchParams = nullptr;
+    }
+  m_maxRays = maxRays;
+}
+
+uint32_t
+NYUSpectrumPropagationLossModel::GetMaxRays () const
+{
+  return m_maxRays;
+}
+
+void
+NYUSpectrumPropagationLossModel::SetProfiler (Ptr<NYULinkProfiler> profiler)
+{
+  NS_LOG_FUNCTION (this);
+  m_profiler = profiler;
+  Ptr<NYUChannelModel> nyuChannelModel = DynamicCast<NYUChannelModel> (m_channelModel);
+  if (nyuChannelModel)
+    {
+      nyuChannelModel->SetProfiler (m_profiler);
+    }
+}
+
+Ptr<NYULinkProfiler>
+NYUSpectrumPropagationLossModel::GetProfiler () const
+{
+  return m_profiler;
 }
 
 Ptr<MatrixBasedChannelModel>
@@ -109,6 +608,114 @@ NYUSpectrumPropagationLossModel::GetChannelModelAttribute (const std::string &na
   m_channelModel->GetAttribute (name, value);
 }
 
+NYUSpectrumPropagationLossModel::RayPruningStats
+NYUSpectrumPropagationLossModel::GetRayPruningStats () const
+{
+  return m_rayPruningStats;
+}
+
+void
+NYUSpectrumPropagationLossModel::ResetRayPruningStats ()
+{
+  m_rayPruningStats = RayPruningStats ();
+}
+
+uint64_t
+NYUSpectrumPropagationLossModel::GetNumReceptions () const
+{
+  return m_numReceptions;
+}
+
+void
+NYUSpectrumPropagationLossModel::SaveCheckpoint (std::vector<uint8_t> &buffer, bool full)
+{
+  NS_LOG_FUNCTION (this << full);
+  NYUCheckpoint::Append<uint64_t> (buffer, m_numReceptions);
+  NYUCheckpoint::Append<uint64_t> (buffer, m_rayPruningStats.m_numLongTerms);
+  NYUCheckpoint::Append<uint64_t> (buffer, m_rayPruningStats.m_totalRays);
+  NYUCheckpoint::Append<uint64_t> (buffer, m_rayPruningStats.m_prunedRays);
+  NYUCheckpoint::Append<double> (buffer, m_rayPruningStats.m_maxPrunedFraction);
+  NYUCheckpoint::Append<double> (buffer, m_rayPruningStats.m_sumPrunedFraction);
+}
+
+void
+NYUSpectrumPropagationLossModel::RestoreCheckpoint (const std::vector<uint8_t> &buffer)
+{
+  NS_LOG_FUNCTION (this);
+  size_t offset = 0;
+  m_numReceptions = NYUCheckpoint::Read<uint64_t> (buffer, offset);
+  m_rayPruningStats.m_numLongTerms = NYUCheckpoint::Read<uint64_t> (buffer, offset);
+  m_rayPruningStats.m_totalRays = NYUCheckpoint::Read<uint64_t> (buffer, offset);
+  m_rayPruningStats.m_prunedRays = NYUCheckpoint::Read<uint64_t> (buffer, offset);
+  m_rayPruningStats.m_maxPrunedFraction = NYUCheckpoint::Read<double> (buffer, offset);
+  m_rayPruningStats.m_sumPrunedFraction = NYUCheckpoint::Read<double> (buffer, offset);
+  NS_ASSERT_MSG (offset == buffer.size (), "Malformed checkpoint of the spectrum propagation loss model");
+
+  // the cached items point to the channel matrices replaced by the restore
+  m_longTermMap.clear ();
+  m_batchReceivers.clear ();
+  m_batchResults.clear ();
+  m_batchParams = nullptr;
+}
+
+void
+NYUSpectrumPropagationLossModel::PruneRays (PhasedArrayModel::ComplexVector &longTerm, bool updateStats) const
+{
+  NS_LOG_FUNCTION (this);
+
+  size_t numRays = longTerm.GetSize ();
+  double maxPower = 0;
+  double sumAmplitude = 0;
+  for (size_t cIndex = 0; cIndex < numRays; cIndex++)
+    {
+      maxPower = std::max (maxPower, std::norm (longTerm[cIndex]));
+      sumAmplitude += std::abs (longTerm[cIndex]);
+    }
+
+  double powerThreshold = 0;
+  if (m_rayPruning)
+    {
+      powerThreshold = maxPower * std::pow (10.0, m_rayPruningThreshold / 10.0);
+    }
+  if (m_maxRays > 0 && numRays > m_maxRays)
+    {
+      // the power of the m_maxRays-th strongest ray
+      std::vector<double> powers (numRays);
+      for (size_t cIndex = 0; cIndex < numRays; cIndex++)
+        {
+          powers[cIndex] = std::norm (longTerm[cIndex]);
+        }
+      std::nth_element (powers.begin (), powers.begin () + m_maxRays - 1, powers.end (), std::greater<double> ());
+      powerThreshold = std::max (powerThreshold, powers[m_maxRays - 1]);
+    }
+  double prunedAmplitude = 0;
+  uint64_t prunedRays = 0;
+  for (size_t cIndex = 0; cIndex < numRays; cIndex++)
+    {
+      if (std::norm (longTerm[cIndex]) < powerThreshold)
+        {
+          prunedAmplitude += std::abs (longTerm[cIndex]);
+          longTerm[cIndex] = 0;
+          prunedRays++;
+        }
+    }
+
+  // fraction of the sum of the ray amplitudes that has been removed. For every subband
+  // the absolute error of the amplitude gain is at most prunedAmplitude, but this is
+  // not a bound on the relative error, since the kept rays may combine destructively
+  double prunedFraction = (sumAmplitude > 0) ? prunedAmplitude / sumAmplitude : 0;
+  NS_LOG_DEBUG ("Pruned " << prunedRays << " rays out of " << numRays << ", pruned amplitude fraction " << prunedFraction);
+  if (!updateStats)
+    {
+      return;
+    }
+  m_rayPruningStats.m_numLongTerms++;
+  m_rayPruningStats.m_totalRays += numRays;
+  m_rayPruningStats.m_prunedRays += prunedRays;
+  m_rayPruningStats.m_maxPrunedFraction = std::max (m_rayPruningStats.m_maxPrunedFraction, prunedFraction);
+  m_rayPruningStats.m_sumPrunedFraction += prunedFraction;
+}
+
 PhasedArrayModel::ComplexVector
 NYUSpectrumPropagationLossModel::CalcLongTerm (Ptr<const MatrixBasedChannelModel::ChannelMatrix> params,
                                                const PhasedArrayModel::ComplexVector &sW,
@@ -128,59 +735,178 @@ NYUSpectrumPropagationLossModel::CalcLongTerm (Ptr<const MatrixBasedChannelModel
     // only the small scale fading needs to be updated if the large scale parameters and antenna
     // weights remain unchanged. here we calculate long term uW * Husn * sW, the result is an array
     // of values per cluster
-    return params->m_channel.MultiplyByLeftAndRightMatrix(uW.Transpose(), sW);
+    size_t numRays = params->m_channel.GetNumPages ();
+    PhasedArrayModel::ComplexVector longTerm (numRays);
+    if (m_longTermBackend == EIGEN)
+      {
+#ifdef HAVE_EIGEN3
+        // the cube is stored column-major page after page, i.e., it is a U x (S N) matrix
+        Eigen::Map<const Eigen::MatrixXcd> h (params->m_channel.GetPagePtr (0), uAntennaNum, sAntennaNum * numRays);
+        Eigen::Map<const Eigen::VectorXcd> u (uW.GetPagePtr (0), uAntennaNum);
+        Eigen::Map<const Eigen::VectorXcd> s (sW.GetPagePtr (0), sAntennaNum);
+        Eigen::VectorXcd uH = h.transpose () * u;
+        Eigen::Map<const Eigen::MatrixXcd> uHMatrix (uH.data (), sAntennaNum, numRays);
+        Eigen::Map<Eigen::VectorXcd> result (longTerm.GetPagePtr (0), numRays);
+        result.noalias () = uHMatrix.transpose () * s;
+        return longTerm;
+#else
+        NS_FATAL_ERROR ("The Eigen long term backend requires ns-3 to be configured with Eigen support");
+#endif
+      }
+
+    for (size_t nIndex = 0; nIndex < numRays; nIndex++)
+      {
+        std::complex<double> rayLongTerm (0.0, 0.0);
+        for (size_t sIndex = 0; sIndex < sAntennaNum; sIndex++)
+          {
+            std::complex<double> uH (0.0, 0.0);
+            for (size_t uIndex = 0; uIndex < uAntennaNum; uIndex++)
+              {
+                uH += uW[uIndex] * params->m_channel (uIndex, sIndex, nIndex);
+              }
+            rayLongTerm += uH * sW[sIndex];
+          }
+        longTerm[nIndex] = rayLongTerm;
+      }
+    return longTerm;
 }
 
 Ptr<SpectrumValue>
 NYUSpectrumPropagationLossModel::CalcBeamformingGain (Ptr<SpectrumValue> txPsd,
                                                       PhasedArrayModel::ComplexVector longTerm,
-                                                      Ptr<const MatrixBasedChannelModel::ChannelMatrix> channelMatrix,
+                                                      bool isSameDirection,
                                                       Ptr<const MatrixBasedChannelModel::ChannelParams> channelParams,
                                                       const ns3::Vector &sSpeed,
-                                                      const ns3::Vector &uSpeed) const
+                                                      const ns3::Vector &uSpeed,
+                                                      Ptr<const LongTerm> squintTerms) const
 {
   NS_LOG_FUNCTION (this);
 
-  Ptr<SpectrumValue> tempPsd = Copy<SpectrumValue> (txPsd);
+  BeamformingGainTask task = PrepareBeamformingGain (txPsd, longTerm, isSameDirection, channelParams, sSpeed, uSpeed, squintTerms);
+  ApplyBeamformingGain (task);
+  return task.m_psd;
+}
+
+NYUSpectrumPropagationLossModel::BeamformingGainTask
+NYUSpectrumPropagationLossModel::PrepareBeamformingGain (Ptr<const SpectrumValue> txPsd,
+                                                         PhasedArrayModel::ComplexVector longTerm,
+                                                         bool isSameDirection,
+                                                         Ptr<const MatrixBasedChannelModel::ChannelParams> channelParams,
+                                                         const ns3::Vector &sSpeed,
+                                                         const ns3::Vector &uSpeed,
+                                                         Ptr<const LongTerm> squintTerms) const
+{
+  NS_LOG_FUNCTION (this);
+
+  BeamformingGainTask task;
+  task.m_psd = Copy<SpectrumValue> (txPsd);
+  task.m_longTerm = longTerm;
+  task.m_isSameDirection = isSameDirection;
+  task.m_channelParams = channelParams;
+  // the direction vectors of the rays are stored with the channel params, unless
+  // the ray table is compressed
+  task.m_hasDirections = NYUChannelModel::GetRayDirections (channelParams, isSameDirection, task.m_sRayDirections, task.m_uRayDirections);
+  task.m_rays = NYUChannelModel::GetCompressedRayTable (channelParams);
+  task.m_sSpeed = sSpeed;
+  task.m_uSpeed = uSpeed;
+  task.m_squintTerms = squintTerms;
+  task.m_time = Simulator::Now ().GetSeconds ();
+  task.m_frequency = GetFrequency ();
+  return task;
+}
+
+void
+NYUSpectrumPropagationLossModel::ApplyBeamformingGain (BeamformingGainTask &task) const
+{
+  // no logging and no Ptr copies here, since this method may run on the batch threads
+  std::chrono::steady_clock::time_point start;
+  if (m_profiler)
+    {
+      start = NYULinkProfiler::Now ();
+    }
+
+  SpectrumValue *tempPsd = PeekPointer (task.m_psd);
+  const PhasedArrayModel::ComplexVector &longTerm = task.m_longTerm;
+  bool isSameDirection = task.m_isSameDirection;
+  const MatrixBasedChannelModel::ChannelParams *channelParams = PeekPointer (task.m_channelParams);
+  const Vector &sSpeed = task.m_sSpeed;
+  const Vector &uSpeed = task.m_uSpeed;
+  const LongTerm *squintTerms = PeekPointer (task.m_squintTerms);
 
-  //channel[rx][tx][cluster]
-  uint16_t numRays = channelMatrix->m_channel.GetNumPages();
+  // one long term component per ray
+  uint16_t numRays = longTerm.GetSize ();
 
   // compute the doppler term
   // NOTE the update of Doppler is simplified by only taking the center angle of
   // each cluster in to consideration.
-  double slotTime = Simulator::Now ().GetSeconds ();
-  double factor = 2 * M_PI * slotTime * GetFrequency () / 3e8;
+  double slotTime = task.m_time;
+  double factor = 2 * M_PI * slotTime * task.m_frequency / M_C;
   PhasedArrayModel::ComplexVector doppler(numRays);
 
-  // check if channelParams structure is generated in direction s-to-u or u-to-s
-  bool isSameDirection = (channelParams->m_nodeIds == channelMatrix->m_nodeIds);
-
   MatrixBasedChannelModel::DoubleVector zoa;
   MatrixBasedChannelModel::DoubleVector zod;
   MatrixBasedChannelModel::DoubleVector aoa;
   MatrixBasedChannelModel::DoubleVector aod;
+  MatrixBasedChannelModel::DoubleVector delay;
+
+  const std::vector<Vector> *sRayDirections = task.m_sRayDirections;
+  const std::vector<Vector> *uRayDirections = task.m_uRayDirections;
+  bool hasDirections = task.m_hasDirections;
 
-  // if channel params is generated in the same direction in which we
+  // if the ray table is compressed, the angles and the delays are decoded here
+  const NYUChannelModel::CompressedRayTable *rays = PeekPointer (task.m_rays);
+  if (rays)
+    {
+      zoa.resize (numRays);
+      zod.resize (numRays);
+      aoa.resize (numRays);
+      aod.resize (numRays);
+      delay.resize (numRays);
+      for (uint16_t cIndex = 0; cIndex < numRays; cIndex++)
+        {
+          zoa[cIndex] = rays->GetAngle (isSameDirection ? MatrixBasedChannelModel::ZOA_INDEX : MatrixBasedChannelModel::ZOD_INDEX, cIndex);
+          zod[cIndex] = rays->GetAngle (isSameDirection ? MatrixBasedChannelModel::ZOD_INDEX : MatrixBasedChannelModel::ZOA_INDEX, cIndex);
+          aoa[cIndex] = rays->GetAngle (isSameDirection ? MatrixBasedChannelModel::AOA_INDEX : MatrixBasedChannelModel::AOD_INDEX, cIndex);
+          aod[cIndex] = rays->GetAngle (isSameDirection ? MatrixBasedChannelModel::AOD_INDEX : MatrixBasedChannelModel::AOA_INDEX, cIndex);
+          delay[cIndex] = rays->GetDelay (cIndex);
+        }
+    }
+  // the angles are needed only if the direction vectors of the rays are not stored.
+  // If channel params is generated in the same direction in which we
   // generate the channel matrix, angles and zenit od departure and arrival are ok,
   // just set them to corresponding variable that will be used for the generation
   // of channel matrix, otherwise we need to flip angles and zenits of departure and arrival
-  if (isSameDirection)
+  else if (!hasDirections)
     {
-      zoa = channelParams->m_angle[MatrixBasedChannelModel::ZOA_INDEX];
-      zod = channelParams->m_angle[MatrixBasedChannelModel::ZOD_INDEX];
-      aoa = channelParams->m_angle[MatrixBasedChannelModel::AOA_INDEX];
-      aod = channelParams->m_angle[MatrixBasedChannelModel::AOD_INDEX];
+      if (isSameDirection)
+        {
+          zoa = channelParams->m_angle[MatrixBasedChannelModel::ZOA_INDEX];
+          zod = channelParams->m_angle[MatrixBasedChannelModel::ZOD_INDEX];
+          aoa = channelParams->m_angle[MatrixBasedChannelModel::AOA_INDEX];
+          aod = channelParams->m_angle[MatrixBasedChannelModel::AOD_INDEX];
+        }
+      else
+        {
+          zod = channelParams->m_angle[MatrixBasedChannelModel::ZOA_INDEX];
+          zoa = channelParams->m_angle[MatrixBasedChannelModel::ZOD_INDEX];
+          aod = channelParams->m_angle[MatrixBasedChannelModel::AOA_INDEX];
+          aoa = channelParams->m_angle[MatrixBasedChannelModel::AOD_INDEX];
+        }
     }
-  else
+  const MatrixBasedChannelModel::DoubleVector &rayDelay = rays ? delay : channelParams->m_delay;
+
+  // the rays with a null long term component (e.g., pruned) do not contribute to the gain
+  std::vector<uint16_t> activeRays;
+  activeRays.reserve (numRays);
+  for (uint16_t cIndex = 0; cIndex < numRays; cIndex++)
     {
-      zod = channelParams->m_angle[MatrixBasedChannelModel::ZOA_INDEX];
-      zoa = channelParams->m_angle[MatrixBasedChannelModel::ZOD_INDEX];
-      aod = channelParams->m_angle[MatrixBasedChannelModel::AOA_INDEX];
-      aoa = channelParams->m_angle[MatrixBasedChannelModel::AOD_INDEX];
+      if (longTerm[cIndex] != std::complex<double> (0.0, 0.0))
+        {
+          activeRays.push_back (cIndex);
+        }
     }
 
-  for (uint8_t cIndex = 0; cIndex < numRays; cIndex++)
+  for (uint16_t cIndex : activeRays)
     {
       // Compute alpha and D as described in 3GPP TR 37.885 v15.3.0, Sec. 6.2.3
       // These terms account for an additional Doppler contribution due to the
@@ -193,13 +919,24 @@ NYUSpectrumPropagationLossModel::CalcBeamformingGain (Ptr<SpectrumValue> txPsd,
       // By default, m_vScatt is set to 0, so there is no additional Doppler
       // contribution.
 
-      //cluster angle angle[direction][n], where direction = 0(aoa), 1(zoa).
-      double tempDoppler = factor * ((sin (zoa [cIndex]) * cos (aoa [cIndex] ) * uSpeed.x
-                                      + sin (zoa [cIndex] ) * sin (aoa [cIndex] ) * uSpeed.y
-                                      + cos (zoa [cIndex] ) * uSpeed.z)
-                                     + (sin (zod [cIndex] ) * cos (aod [cIndex] ) * sSpeed.x
-                                        + sin (zod [cIndex] ) * sin (aod [cIndex] ) * sSpeed.y
-                                        + cos (zod [cIndex] ) * sSpeed.z));
+      double tempDoppler;
+      if (hasDirections)
+        {
+          const Vector &uDirection = (*uRayDirections)[cIndex];
+          const Vector &sDirection = (*sRayDirections)[cIndex];
+          tempDoppler = factor * ((uDirection.x * uSpeed.x + uDirection.y * uSpeed.y + uDirection.z * uSpeed.z)
+                                  + (sDirection.x * sSpeed.x + sDirection.y * sSpeed.y + sDirection.z * sSpeed.z));
+        }
+      else
+        {
+          //cluster angle angle[direction][n], where direction = 0(aoa), 1(zoa).
+          tempDoppler = factor * ((sin (zoa [cIndex]) * cos (aoa [cIndex] ) * uSpeed.x
+                                   + sin (zoa [cIndex] ) * sin (aoa [cIndex] ) * uSpeed.y
+                                   + cos (zoa [cIndex] ) * uSpeed.z)
+                                  + (sin (zod [cIndex] ) * cos (aod [cIndex] ) * sSpeed.x
+                                     + sin (zod [cIndex] ) * sin (aod [cIndex] ) * sSpeed.y
+                                     + cos (zod [cIndex] ) * sSpeed.z));
+        }
       doppler[cIndex] =  std::complex<double> (cos (tempDoppler), sin (tempDoppler));
     }
 
@@ -209,35 +946,109 @@ NYUSpectrumPropagationLossModel::CalcBeamformingGain (Ptr<SpectrumValue> txPsd,
   // to obtain the beamforming gain
   auto vit = tempPsd->ValuesBegin (); // psd iterator
   auto sbit = tempPsd->ConstBandsBegin (); // band iterator
+  double subbandGainNorm = 0; // gain of the last computed sub-band
+  uint32_t bandsSinceUpdate = m_frequencyDecimation; // number of active sub-bands since the last computed one
+  double fc = task.m_frequency; // carrier frequency, used as the reference of the beam squint expansion
+  double lastFsb = 0; // center frequency of the last computed sub-band
+  double lastDf = 0; // frequency step between the last two computed sub-bands
+  std::vector<std::complex<double> > squintPhasor; // linear phase term of each active ray
+  std::vector<std::complex<double> > squintStep; // phase increment of each active ray
   while (vit != tempPsd->ValuesEnd ())
     {
       if ((*vit) != 0.00)
         {
-          std::complex<double> subsbandGain (0.0, 0.0);
-          double fsb = (*sbit).fc; // center frequency of the sub-band
-          for (uint8_t cIndex = 0; cIndex < numRays; cIndex++)
+          if (bandsSinceUpdate >= m_frequencyDecimation)
             {
-              double delay = -2 * M_PI * fsb * (channelParams->m_delay[cIndex]) * 1e-9;
-              subsbandGain = subsbandGain + longTerm[cIndex] * std::complex<double> (cos (delay), sin (delay)) * doppler[cIndex];
+              std::complex<double> subsbandGain (0.0, 0.0);
+              double fsb = (*sbit).fc; // center frequency of the sub-band
+              if (squintTerms)
+                {
+                  // the array responses are evaluated at fsb through their expansion in
+                  // the relative frequency offset, while the linear phase terms are
+                  // advanced from the previous computed sub-band by a phasor recurrence
+                  double offset = (fsb - fc) / fc;
+                  if (squintPhasor.empty ())
+                    {
+                      squintPhasor.resize (activeRays.size ());
+                      squintStep.resize (activeRays.size ());
+                      for (size_t i = 0; i < activeRays.size (); i++)
+                        {
+                          uint16_t cIndex = activeRays[i];
+                          squintPhasor[i] = std::polar (1.0, squintTerms->m_squintPhase[cIndex] * offset
+                                                        - 2 * M_PI * fsb * rayDelay[cIndex] * 1e-9) * doppler[cIndex];
+                        }
+                    }
+                  else
+                    {
+                      double df = fsb - lastFsb;
+                      bool updateStep = std::abs (df - lastDf) > 1e-9 * std::abs (df);
+                      for (size_t i = 0; i < activeRays.size (); i++)
+                        {
+                          if (updateStep)
+                            {
+                              uint16_t cIndex = activeRays[i];
+                              squintStep[i] = std::polar (1.0, (squintTerms->m_squintPhase[cIndex] / fc
+                                                                - 2 * M_PI * rayDelay[cIndex] * 1e-9) * df);
+                            }
+                          squintPhasor[i] *= squintStep[i];
+                        }
+                      lastDf = df;
+                    }
+                  lastFsb = fsb;
+
+                  for (size_t i = 0; i < activeRays.size (); i++)
+                    {
+                      std::complex<double> response;
+                      const SquintRay &ray = squintTerms->m_squintRays[activeRays[i]];
+                      if (std::abs (offset) * ray.m_maxPhase > m_beamSquintMaxPhase)
+                        {
+                          // the expansion is not accurate enough, the element phases are scaled exactly
+                          response = ray.m_scale
+                            * GetCenteredArrayResponse (squintTerms->m_sLocations, squintTerms->m_sW,
+                                                        ray.m_sDirection, ray.m_sMeanPhase, 1 + offset)
+                            * GetCenteredArrayResponse (squintTerms->m_uLocations, squintTerms->m_uW,
+                                                        ray.m_uDirection, ray.m_uMeanPhase, 1 + offset);
+                        }
+                      else
+                        {
+                          const std::array<std::complex<double>, 4> &poly = squintTerms->m_squintPoly[activeRays[i]];
+                          response = ((poly[3] * offset + poly[2]) * offset + poly[1]) * offset + poly[0];
+                        }
+                      subsbandGain += response * squintPhasor[i];
+                    }
+                }
+              else
+                {
+                  for (uint16_t cIndex : activeRays)
+                    {
+                      double delayPhase = -2 * M_PI * fsb * (rayDelay[cIndex]) * 1e-9;
+                      subsbandGain = subsbandGain + longTerm[cIndex] * std::complex<double> (cos (delayPhase), sin (delayPhase)) * doppler[cIndex];
+                    }
+                }
+              subbandGainNorm = norm (subsbandGain);
+              bandsSinceUpdate = 0;
             }
-          *vit = (*vit) * (norm (subsbandGain));
+          *vit = (*vit) * subbandGainNorm;
+          bandsSinceUpdate++;
         }
       vit++;
       sbit++;
     }
-  return tempPsd;
+  if (m_profiler)
+    {
+      task.m_elapsed = NYULinkProfiler::Now () - start;
+    }
 }
 
-PhasedArrayModel::ComplexVector
-NYUSpectrumPropagationLossModel::GetLongTerm (Ptr<const MatrixBasedChannelModel::ChannelMatrix> channelMatrix,
-                                              Ptr<const PhasedArrayModel> aPhasedArrayModel,
-                                              Ptr<const PhasedArrayModel> bPhasedArrayModel) const
+Ptr<const NYUSpectrumPropagationLossModel::LongTerm>
+NYUSpectrumPropagationLossModel::FindLongTerm (Ptr<const MatrixBasedChannelModel::ChannelMatrix> channelMatrix,
+                                               Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                                               Ptr<const PhasedArrayModel> bPhasedArrayModel,
+                                               PhasedArrayModel::ComplexVector &sW,
+                                               PhasedArrayModel::ComplexVector &uW) const
 {
-  PhasedArrayModel::ComplexVector longTerm; // vector containing the long term component for each cluster
-
   // check if the channel matrix was generated considering a as the s-node and
   // b as the u-node or viceversa
-  PhasedArrayModel::ComplexVector sW, uW;
   if (!channelMatrix->IsReverse (aPhasedArrayModel->GetId (), bPhasedArrayModel->GetId ()))
     {
       sW = aPhasedArrayModel->GetBeamformingVector ();
@@ -249,49 +1060,359 @@ NYUSpectrumPropagationLossModel::GetLongTerm (Ptr<const MatrixBasedChannelModel:
       uW = aPhasedArrayModel->GetBeamformingVector ();
     }
 
-  bool update = false; // indicates whether the long term has to be updated
-  bool notFound = false; // indicates if the long term has not been computed yet
-
   // compute the long term key, the key is unique for each tx-rx pair
   uint64_t longTermId = MatrixBasedChannelModel::GetKey (aPhasedArrayModel->GetId (), bPhasedArrayModel->GetId ());
 
   // look for the long term in the map and check if it is valid
-  if (m_longTermMap.find (longTermId) != m_longTermMap.end ())
+  auto longTermIt = m_longTermMap.find (longTermId);
+  if (longTermIt == m_longTermMap.end ())
     {
-      NS_LOG_DEBUG ("found the long term component in the map");
-      longTerm = m_longTermMap[longTermId]->m_longTerm;
-
-      // check if the channel matrix has been updated
-      // or the s beam has been changed
-      // or the u beam has been changed
-      update = (m_longTermMap[longTermId]->m_channel->m_generatedTime != channelMatrix->m_generatedTime
-                || m_longTermMap[longTermId]->m_sW != sW
-                || m_longTermMap[longTermId]->m_uW != uW);
-
+      NS_LOG_DEBUG ("long term component NOT found");
+      return nullptr;
     }
-  else
+  NS_LOG_DEBUG ("found the long term component in the map");
+  Ptr<const LongTerm> longTermItem = longTermIt->second;
+
+  // check if the channel matrix has been updated (a matrix rebuilt after an antenna
+  // reconfiguration may have the same generation time of the previous one)
+  // or the s beam has been changed
+  // or the u beam has been changed
+  if (longTermItem->m_channel != channelMatrix
+      || longTermItem->m_channel->m_generatedTime != channelMatrix->m_generatedTime
+      || longTermItem->m_sW != sW
+      || longTermItem->m_uW != uW
+      || (m_beamSquint && longTermItem->m_squintPoly.empty ()))
     {
-      NS_LOG_DEBUG ("long term component NOT found");
-      notFound = true;
+      return nullptr;
     }
+  return longTermItem;
+}
 
-  if (update || notFound)
+Ptr<const NYUSpectrumPropagationLossModel::LongTerm>
+NYUSpectrumPropagationLossModel::GetLongTerm (Ptr<const MatrixBasedChannelModel::ChannelMatrix> channelMatrix,
+                                              Ptr<const MobilityModel> a,
+                                              Ptr<const MobilityModel> b,
+                                              Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                                              Ptr<const PhasedArrayModel> bPhasedArrayModel) const
+{
+  PhasedArrayModel::ComplexVector sW, uW;
+  Ptr<const LongTerm> longTermItem = FindLongTerm (channelMatrix, aPhasedArrayModel, bPhasedArrayModel, sW, uW);
+
+  if (!longTermItem)
     {
       NS_LOG_DEBUG ("compute the long term");
+      std::chrono::steady_clock::time_point start;
+      if (m_profiler)
+        {
+          start = NYULinkProfiler::Now ();
+        }
       // compute the long term component
-      longTerm = CalcLongTerm (channelMatrix, sW, uW);
+      PhasedArrayModel::ComplexVector longTerm = CalcLongTerm (channelMatrix, sW, uW);
+      if (m_rayPruning || m_maxRays > 0)
+        {
+          PruneRays (longTerm);
+        }
 
       // store the long term
-      Ptr<LongTerm> longTermItem = Create<LongTerm> ();
-      longTermItem->m_longTerm = longTerm;
-      longTermItem->m_channel = channelMatrix;
-      longTermItem->m_sW = sW;
-      longTermItem->m_uW = uW;
+      Ptr<LongTerm> newLongTermItem = Create<LongTerm> ();
+      newLongTermItem->m_longTerm = longTerm;
+      newLongTermItem->m_channel = channelMatrix;
+      newLongTermItem->m_sW = sW;
+      newLongTermItem->m_uW = uW;
+      if (m_beamSquint)
+        {
+          bool reverse = channelMatrix->IsReverse (aPhasedArrayModel->GetId (), bPhasedArrayModel->GetId ());
+          CalcSquintTerms (newLongTermItem, reverse ? b : a, reverse ? a : b,
+                           reverse ? bPhasedArrayModel : aPhasedArrayModel,
+                           reverse ? aPhasedArrayModel : bPhasedArrayModel);
+        }
+      if (m_profiler)
+        {
+          m_profiler->Record (NYULinkProfiler::LONG_TERM, channelMatrix->m_nodeIds.first,
+                              channelMatrix->m_nodeIds.second, start);
+        }
+
+      m_longTermMap[MatrixBasedChannelModel::GetKey (aPhasedArrayModel->GetId (), bPhasedArrayModel->GetId ())] = newLongTermItem;
+      longTermItem = newLongTermItem;
+    }
+
+  return longTermItem;
+}
+
+void
+NYUSpectrumPropagationLossModel::CalcSquintTerms (Ptr<LongTerm> longTerm,
+                                                  Ptr<const MobilityModel> sMob,
+                                                  Ptr<const MobilityModel> uMob,
+                                                  Ptr<const PhasedArrayModel> sPhasedArrayModel,
+                                                  Ptr<const PhasedArrayModel> uPhasedArrayModel) const
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<NYUChannelModel> nyuChannelModel = DynamicCast<NYUChannelModel> (m_channelModel);
+  if (!nyuChannelModel)
+    {
+      NS_LOG_WARN ("The beam squint is modelled only with the NYUChannelModel");
+      return;
+    }
+
+  // factorized representation of the channel matrix
+  std::vector<std::complex<double> > rayCoefficients;
+  std::vector<Vector> sRayDirections;
+  std::vector<Vector> uRayDirections;
+  nyuChannelModel->GetRayFactors (sMob, uMob, sPhasedArrayModel, uPhasedArrayModel,
+                                  rayCoefficients, sRayDirections, uRayDirections);
+  size_t numRays = rayCoefficients.size ();
+  NS_ASSERT_MSG (numRays == longTerm->m_longTerm.GetSize (), "The ray factors do not match the channel matrix");
+
+  std::vector<std::array<std::complex<double>, 4> > sMoments;
+  std::vector<std::array<std::complex<double>, 4> > uMoments;
+  std::vector<double> sMeanPhase;
+  std::vector<double> uMeanPhase;
+  std::vector<double> sMaxPhase;
+  std::vector<double> uMaxPhase;
+  longTerm->m_sLocations = GetElementLocations (sPhasedArrayModel);
+  longTerm->m_uLocations = GetElementLocations (uPhasedArrayModel);
+  GetArrayResponseExpansion (longTerm->m_sLocations, longTerm->m_sW, sRayDirections, sMoments, sMeanPhase, sMaxPhase);
+  GetArrayResponseExpansion (longTerm->m_uLocations, longTerm->m_uW, uRayDirections, uMoments, uMeanPhase, uMaxPhase);
+
+  // product of the two expansions, truncated to the third order
+  longTerm->m_squintPoly.assign (numRays, std::array<std::complex<double>, 4> ());
+  longTerm->m_squintPhase.resize (numRays);
+  longTerm->m_squintRays.resize (numRays);
+  for (size_t nIndex = 0; nIndex < numRays; nIndex++)
+    {
+      double phase = sMeanPhase[nIndex] + uMeanPhase[nIndex];
+      std::complex<double> scale = rayCoefficients[nIndex] * std::polar (1.0, phase);
+      for (size_t order = 0; order < 4; order++)
+        {
+          std::complex<double> coefficient (0.0, 0.0);
+          for (size_t sOrder = 0; sOrder <= order; sOrder++)
+            {
+              coefficient += sMoments[nIndex][sOrder] * uMoments[nIndex][order - sOrder];
+            }
+          longTerm->m_squintPoly[nIndex][order] = scale * coefficient;
+        }
+      longTerm->m_squintPhase[nIndex] = phase;
+
+      SquintRay &ray = longTerm->m_squintRays[nIndex];
+      ray.m_scale = scale;
+      ray.m_sDirection = sRayDirections[nIndex];
+      ray.m_uDirection = uRayDirections[nIndex];
+      ray.m_sMeanPhase = sMeanPhase[nIndex];
+      ray.m_uMeanPhase = uMeanPhase[nIndex];
+      ray.m_maxPhase = sMaxPhase[nIndex] + uMaxPhase[nIndex];
+    }
+}
+
+double
+NYUSpectrumPropagationLossModel::CalcWidebandGain (Ptr<const MobilityModel> a,
+                                                   Ptr<const MobilityModel> b,
+                                                   Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                                                   Ptr<const PhasedArrayModel> bPhasedArrayModel,
+                                                   RsrpBeamforming beamforming) const
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<NYUChannelModel> nyuChannelModel = DynamicCast<NYUChannelModel> (m_channelModel);
+  if (!nyuChannelModel)
+    {
+      NS_FATAL_ERROR ("The wideband gain can be computed only with the NYUChannelModel");
+    }
+
+  // factorized representation of the channel matrix, with a as the s node
+  std::vector<std::complex<double> > rayCoefficients;
+  std::vector<Vector> aRayDirections;
+  std::vector<Vector> bRayDirections;
+  nyuChannelModel->GetRayFactors (a, b, aPhasedArrayModel, bPhasedArrayModel,
+                                  rayCoefficients, aRayDirections, bRayDirections);
+  size_t numRays = rayCoefficients.size ();
+  if (numRays == 0)
+    {
+      return 0.0;
+    }
 
-      m_longTermMap[longTermId] = longTermItem;
+  std::vector<Vector> aLocations;
+  std::vector<Vector> bLocations;
+  if (beamforming != OMNI_RSRP)
+    {
+      aLocations = GetElementLocations (aPhasedArrayModel);
+      bLocations = GetElementLocations (bPhasedArrayModel);
     }
 
-  return longTerm;
+  size_t strongestRay = 0;
+  for (size_t nIndex = 1; nIndex < numRays; nIndex++)
+    {
+      if (std::norm (rayCoefficients[nIndex]) > std::norm (rayCoefficients[strongestRay]))
+        {
+          strongestRay = nIndex;
+        }
+    }
+
+  double gain = 0.0;
+  for (size_t nIndex = 0; nIndex < numRays; nIndex++)
+    {
+      double rayGain = std::norm (rayCoefficients[nIndex]);
+      switch (beamforming)
+        {
+        case OMNI_RSRP:
+          break;
+        case CURRENT_BEAMS_RSRP:
+          rayGain *= GetArrayGain (aLocations, aPhasedArrayModel->GetBeamformingVector (), aRayDirections[nIndex])
+                     * GetArrayGain (bLocations, bPhasedArrayModel->GetBeamformingVector (), bRayDirections[nIndex]);
+          break;
+        case STRONGEST_RAY_RSRP:
+          rayGain *= GetSteeredArrayGain (aLocations, aRayDirections[nIndex], aRayDirections[strongestRay])
+                     * GetSteeredArrayGain (bLocations, bRayDirections[nIndex], bRayDirections[strongestRay]);
+          break;
+        default:
+          NS_FATAL_ERROR ("Unknown beamforming for the wideband gain");
+        }
+      gain += rayGain;
+    }
+  return gain;
+}
+
+double
+NYUSpectrumPropagationLossModel::CalcRsrp (double txPowerDbm,
+                                           Ptr<MobilityModel> a,
+                                           Ptr<MobilityModel> b,
+                                           Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                                           Ptr<const PhasedArrayModel> bPhasedArrayModel,
+                                           Ptr<PropagationLossModel> pathLossModel,
+                                           RsrpBeamforming beamforming) const
+{
+  NS_LOG_FUNCTION (this << txPowerDbm);
+  NS_ASSERT_MSG (pathLossModel, "The propagation loss model is needed to compute the RSRP");
+  double rxPowerDbm = pathLossModel->CalcRxPower (txPowerDbm, a, b);
+  double gain = CalcWidebandGain (a, b, aPhasedArrayModel, bPhasedArrayModel, beamforming);
+  if (gain <= 0.0)
+    {
+      return -std::numeric_limits<double>::infinity ();
+    }
+  return rxPowerDbm + 10 * std::log10 (gain);
+}
+
+NYUSpectrumPropagationLossModel::CrossGainMatrix
+NYUSpectrumPropagationLossModel::CalcCrossGains (Ptr<const MobilityModel> gnbMobility,
+                                                 Ptr<const PhasedArrayModel> gnbPhasedArrayModel,
+                                                 const std::vector<Ptr<const MobilityModel> > &ueMobilities,
+                                                 const std::vector<Ptr<const PhasedArrayModel> > &uePhasedArrayModels,
+                                                 const std::vector<PhasedArrayModel::ComplexVector> &precoders,
+                                                 Ptr<const SpectrumModel> spectrumModel) const
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<NYUChannelModel> nyuChannelModel = DynamicCast<NYUChannelModel> (m_channelModel);
+  if (!nyuChannelModel)
+    {
+      NS_FATAL_ERROR ("The cross gains can be computed only with the NYUChannelModel");
+    }
+  NS_ASSERT_MSG (ueMobilities.size () == uePhasedArrayModels.size () && ueMobilities.size () == precoders.size (),
+                 "One antenna array and one precoder per user are needed");
+  NS_ASSERT_MSG (spectrumModel && spectrumModel->GetNumBands () > 0, "The subbands of the cross gains are needed");
+
+  size_t numUsers = ueMobilities.size ();
+  size_t gnbSize = gnbPhasedArrayModel->GetNumberOfElements ();
+  for (const PhasedArrayModel::ComplexVector &precoder : precoders)
+    {
+      NS_ASSERT_MSG (precoder.GetSize () == gnbSize, "The size of the precoders does not match the gNB array");
+    }
+
+  CrossGainMatrix crossGains;
+  crossGains.m_numUsers = numUsers;
+  crossGains.m_numBands = spectrumModel->GetNumBands ();
+  crossGains.m_widebandGains.assign (numUsers * numUsers, 0.0);
+  crossGains.m_subbandGains.assign (numUsers * numUsers * crossGains.m_numBands, 0.0);
+
+  // data of each user, the ray factors are computed with the gNB as the s node
+  struct UserLink
+  {
+    std::vector<std::complex<double> > m_rayCoefficients;
+    std::vector<Vector> m_gnbRayDirections;
+    std::vector<Vector> m_ueRayDirections;
+    std::vector<Vector> m_ueLocations;
+    PhasedArrayModel::ComplexVector m_ueW;
+    BeamformingGainTask m_task; // the subband gains of each precoder are computed in its PSD
+  };
+  std::vector<UserLink> links (numUsers);
+  std::vector<Vector> gnbLocations = GetElementLocations (gnbPhasedArrayModel);
+  uint32_t gnbId = gnbMobility->GetObject<Node> ()->GetId ();
+
+  // the channels are retrieved on the simulator thread, in the order of the users
+  Ptr<SpectrumValue> ones = Create<SpectrumValue> (spectrumModel);
+  (*ones) = 1.0;
+  for (size_t k = 0; k < numUsers; k++)
+    {
+      UserLink &link = links[k];
+      nyuChannelModel->GetRayFactors (gnbMobility, ueMobilities[k], gnbPhasedArrayModel, uePhasedArrayModels[k],
+                                      link.m_rayCoefficients, link.m_gnbRayDirections, link.m_ueRayDirections);
+      link.m_ueLocations = GetElementLocations (uePhasedArrayModels[k]);
+      link.m_ueW = uePhasedArrayModels[k]->GetBeamformingVector ();
+      Ptr<const MatrixBasedChannelModel::ChannelParams> channelParams = m_channelModel->GetParams (gnbMobility, ueMobilities[k]);
+      bool isSameDirection = (channelParams->m_nodeIds == std::make_pair (gnbId, ueMobilities[k]->GetObject<Node> ()->GetId ()));
+      link.m_task = PrepareBeamformingGain (ones, PhasedArrayModel::ComplexVector (), isSameDirection, channelParams,
+                                            gnbMobility->GetVelocity (), ueMobilities[k]->GetVelocity (), nullptr);
+    }
+
+  // the gains at user k are computed from the response of its array and of the
+  // gNB array with each precoder, for each ray
+  auto computeUserGains = [&] (size_t k) {
+    UserLink &link = links[k];
+    size_t numRays = link.m_rayCoefficients.size ();
+    std::vector<std::complex<double> > ueResponse (numRays);
+    std::vector<std::complex<double> > gnbPhasors (gnbSize * numRays);
+    for (size_t nIndex = 0; nIndex < numRays; nIndex++)
+      {
+        const Vector &uDirection = link.m_ueRayDirections[nIndex];
+        std::complex<double> response (0.0, 0.0);
+        for (size_t uIndex = 0; uIndex < link.m_ueLocations.size (); uIndex++)
+          {
+            const Vector &r = link.m_ueLocations[uIndex];
+            response += link.m_ueW[uIndex] * std::polar (1.0, 2 * M_PI * (uDirection.x * r.x + uDirection.y * r.y + uDirection.z * r.z));
+          }
+        ueResponse[nIndex] = link.m_rayCoefficients[nIndex] * response;
+        const Vector &sDirection = link.m_gnbRayDirections[nIndex];
+        for (size_t sIndex = 0; sIndex < gnbSize; sIndex++)
+          {
+            const Vector &r = gnbLocations[sIndex];
+            gnbPhasors[nIndex * gnbSize + sIndex] = std::polar (1.0, 2 * M_PI * (sDirection.x * r.x + sDirection.y * r.y + sDirection.z * r.z));
+          }
+      }
+    for (size_t j = 0; j < numUsers; j++)
+      {
+        const PhasedArrayModel::ComplexVector &precoder = precoders[j];
+        BeamformingGainTask &task = link.m_task;
+        task.m_longTerm = PhasedArrayModel::ComplexVector (numRays);
+        for (size_t nIndex = 0; nIndex < numRays; nIndex++)
+          {
+            std::complex<double> response (0.0, 0.0);
+            for (size_t sIndex = 0; sIndex < gnbSize; sIndex++)
+              {
+                response += precoder[sIndex] * gnbPhasors[nIndex * gnbSize + sIndex];
+              }
+            task.m_longTerm[nIndex] = ueResponse[nIndex] * response;
+          }
+
+        // the PSD of the user is reset to ones, so that it holds the gain in each subband
+        std::fill (task.m_psd->ValuesBegin (), task.m_psd->ValuesEnd (), 1.0);
+        ApplyBeamformingGain (task);
+        double gain = 0.0;
+        auto vit = task.m_psd->ConstValuesBegin ();
+        for (size_t b = 0; b < crossGains.m_numBands; b++, vit++)
+          {
+            crossGains.m_subbandGains[(k * numUsers + j) * crossGains.m_numBands + b] = *vit;
+            gain += *vit;
+          }
+        crossGains.m_widebandGains[k * numUsers + j] = gain / crossGains.m_numBands;
+      }
+  };
+
+  if (numUsers > 1)
+    {
+      GetBatchThreadPool ().Run (numUsers, computeUserGains);
+    }
+  else if (numUsers == 1)
+    {
+      computeUserGains (0);
+    }
+  return crossGains;
 }
 
 Ptr<SpectrumValue>
@@ -300,6 +1421,33 @@ NYUSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<const Spectru
                                                                Ptr<const MobilityModel> b,
                                                                Ptr<const PhasedArrayModel> aPhasedArrayModel,
                                                                Ptr<const PhasedArrayModel> bPhasedArrayModel) const
+{
+  NS_LOG_FUNCTION (this);
+  m_numReceptions++;
+
+  if (m_batchReceptions)
+    {
+      return GetBatchedRxPsd (params, a, b, aPhasedArrayModel, bPhasedArrayModel);
+    }
+
+  BeamformingGainTask task = PrepareRxPsd (params, a, b, aPhasedArrayModel, bPhasedArrayModel);
+
+  // apply the beamforming gain
+  ApplyBeamformingGain (task);
+  if (m_profiler)
+    {
+      m_profiler->Record (NYULinkProfiler::BEAMFORMING_GAIN, task.m_aId, task.m_bId, NYULinkProfiler::Now () - task.m_elapsed);
+    }
+
+  return task.m_psd;
+}
+
+NYUSpectrumPropagationLossModel::BeamformingGainTask
+NYUSpectrumPropagationLossModel::PrepareRxPsd (Ptr<const SpectrumSignalParameters> params,
+                                               Ptr<const MobilityModel> a,
+                                               Ptr<const MobilityModel> b,
+                                               Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                                               Ptr<const PhasedArrayModel> bPhasedArrayModel) const
 {
   NS_LOG_FUNCTION (this);
   uint32_t aId = a->GetObject<Node> ()->GetId (); // id of the node a
@@ -308,24 +1456,229 @@ NYUSpectrumPropagationLossModel::DoCalcRxPowerSpectralDensity (Ptr<const Spectru
   NS_ASSERT (aId != bId);
   NS_ASSERT_MSG (a->GetDistanceFrom (b) > 0.0, "The position of a and b devices cannot be the same");
 
-  Ptr<SpectrumValue> rxPsd = Copy<SpectrumValue>(params->psd);
-
   // retrieve the antenna of device a
   NS_ASSERT_MSG (aPhasedArrayModel, "Antenna not found for node " << aId);
 
   // retrieve the antenna of the device b
   NS_ASSERT_MSG (bPhasedArrayModel, "Antenna not found for device " << bId);
 
-  Ptr<const MatrixBasedChannelModel::ChannelMatrix> channelMatrix = m_channelModel->GetChannel (a, b, aPhasedArrayModel, bPhasedArrayModel);
-  Ptr<const MatrixBasedChannelModel::ChannelParams> channelParams = m_channelModel->GetParams (a, b);
+  BeamformingGainTask task;
 
-  // retrieve the long term component
-  PhasedArrayModel::ComplexVector longTerm = GetLongTerm (channelMatrix, aPhasedArrayModel, bPhasedArrayModel);
+  // SISO fast path: with single element antennas the long term component of
+  // each ray is the ray coefficient itself, no need for the channel matrix
+  Ptr<NYUChannelModel> nyuChannelModel = DynamicCast<NYUChannelModel> (m_channelModel);
+  if (m_sisoFastPath && nyuChannelModel
+      && aPhasedArrayModel->GetNumberOfElements () == 1 && bPhasedArrayModel->GetNumberOfElements () == 1)
+    {
+      // with the SISO fast path the ray coefficients take the place of the long term.
+      // The generation of the channel params they may trigger is profiled separately
+      std::chrono::steady_clock::time_point start;
+      double recordedAtStart = 0;
+      if (m_profiler)
+        {
+          start = NYULinkProfiler::Now ();
+          recordedAtStart = m_profiler->GetRecordedSeconds ();
+        }
+      PhasedArrayModel::ComplexVector rayCoefficients = nyuChannelModel->GetSisoRayCoefficients (a, b, aPhasedArrayModel, bPhasedArrayModel);
+      if (m_rayPruning || m_maxRays > 0)
+        {
+          PruneRays (rayCoefficients);
+        }
+      Ptr<const MatrixBasedChannelModel::ChannelParams> channelParams = m_channelModel->GetParams (a, b);
+      if (m_profiler)
+        {
+          m_profiler->RecordExclusive (NYULinkProfiler::LONG_TERM, aId, bId, start, recordedAtStart);
+        }
 
-  // apply the beamforming gain
-  rxPsd = CalcBeamformingGain (rxPsd, longTerm, channelMatrix, channelParams, a->GetVelocity (), b->GetVelocity ());
+      // the coefficients are computed with a as the s node and b as the u node
+      bool isSameDirection = (channelParams->m_nodeIds == std::make_pair (aId, bId));
+      task = PrepareBeamformingGain (params->psd, rayCoefficients, isSameDirection, channelParams, a->GetVelocity (), b->GetVelocity (), nullptr);
+    }
+  else
+    {
+      Ptr<const MatrixBasedChannelModel::ChannelMatrix> channelMatrix = m_channelModel->GetChannel (a, b, aPhasedArrayModel, bPhasedArrayModel);
+      Ptr<const MatrixBasedChannelModel::ChannelParams> channelParams = m_channelModel->GetParams (a, b);
+
+      // retrieve the long term component
+      Ptr<const LongTerm> longTermItem = GetLongTerm (channelMatrix, a, b, aPhasedArrayModel, bPhasedArrayModel);
+      const PhasedArrayModel::ComplexVector &longTerm = longTermItem->m_longTerm;
+
+      // check if channelParams structure is generated in direction s-to-u or u-to-s
+      bool isSameDirection = (channelParams->m_nodeIds == channelMatrix->m_nodeIds);
+
+      Ptr<const LongTerm> squintTerms = (m_beamSquint && !longTermItem->m_squintPoly.empty ()) ? longTermItem : nullptr;
+      task = PrepareBeamformingGain (params->psd, longTerm, isSameDirection, channelParams, a->GetVelocity (), b->GetVelocity (), squintTerms);
+    }
+  task.m_aId = aId;
+  task.m_bId = bId;
+  return task;
+}
 
-  return rxPsd;
+bool
+NYUSpectrumPropagationLossModel::PeekRxPsd (Ptr<const SpectrumSignalParameters> params,
+                                            Ptr<const MobilityModel> a,
+                                            Ptr<const MobilityModel> b,
+                                            Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                                            Ptr<const PhasedArrayModel> bPhasedArrayModel,
+                                            BeamformingGainTask &task) const
+{
+  NS_LOG_FUNCTION (this);
+  Ptr<const NYUChannelModel> nyuChannelModel = DynamicCast<const NYUChannelModel> (m_channelModel);
+  if (!nyuChannelModel)
+    {
+      return false;
+    }
+  uint32_t aId = a->GetObject<Node> ()->GetId ();
+  uint32_t bId = b->GetObject<Node> ()->GetId ();
+  Ptr<const MatrixBasedChannelModel::ChannelParams> channelParams = nyuChannelModel->PeekParams (a, b);
+  if (!channelParams)
+    {
+      return false;
+    }
+
+  if (m_sisoFastPath && aPhasedArrayModel->GetNumberOfElements () == 1 && bPhasedArrayModel->GetNumberOfElements () == 1)
+    {
+      PhasedArrayModel::ComplexVector rayCoefficients = nyuChannelModel->PeekSisoRayCoefficients (a, b, aPhasedArrayModel, bPhasedArrayModel);
+      if (m_rayPruning || m_maxRays > 0)
+        {
+          PruneRays (rayCoefficients, false);
+        }
+      bool isSameDirection = (channelParams->m_nodeIds == std::make_pair (aId, bId));
+      task = PrepareBeamformingGain (params->psd, rayCoefficients, isSameDirection, channelParams, a->GetVelocity (), b->GetVelocity (), nullptr);
+    }
+  else
+    {
+      Ptr<const MatrixBasedChannelModel::ChannelMatrix> channelMatrix = nyuChannelModel->PeekChannel (aPhasedArrayModel, bPhasedArrayModel);
+      if (!channelMatrix)
+        {
+          return false;
+        }
+      PhasedArrayModel::ComplexVector sW, uW;
+      Ptr<const LongTerm> longTermItem = FindLongTerm (channelMatrix, aPhasedArrayModel, bPhasedArrayModel, sW, uW);
+      if (!longTermItem)
+        {
+          return false;
+        }
+      bool isSameDirection = (channelParams->m_nodeIds == channelMatrix->m_nodeIds);
+      Ptr<const LongTerm> squintTerms = (m_beamSquint && !longTermItem->m_squintPoly.empty ()) ? longTermItem : nullptr;
+      task = PrepareBeamformingGain (params->psd, longTermItem->m_longTerm, isSameDirection, channelParams, a->GetVelocity (), b->GetVelocity (), squintTerms);
+    }
+  task.m_aId = aId;
+  task.m_bId = bId;
+  return true;
+}
+
+bool
+NYUSpectrumPropagationLossModel::HaveSameInputs (const BeamformingGainTask &lhs, const BeamformingGainTask &rhs)
+{
+  return lhs.m_channelParams == rhs.m_channelParams
+    && lhs.m_isSameDirection == rhs.m_isSameDirection
+    && lhs.m_squintTerms == rhs.m_squintTerms
+    && lhs.m_sSpeed == rhs.m_sSpeed
+    && lhs.m_uSpeed == rhs.m_uSpeed
+    && lhs.m_time == rhs.m_time
+    && lhs.m_frequency == rhs.m_frequency
+    && lhs.m_longTerm.GetSize () == rhs.m_longTerm.GetSize ()
+    && lhs.m_longTerm == rhs.m_longTerm;
+}
+
+Ptr<SpectrumValue>
+NYUSpectrumPropagationLossModel::GetBatchedRxPsd (Ptr<const SpectrumSignalParameters> params,
+                                                  Ptr<const MobilityModel> a,
+                                                  Ptr<const MobilityModel> b,
+                                                  Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                                                  Ptr<const PhasedArrayModel> bPhasedArrayModel) const
+{
+  NS_LOG_FUNCTION (this);
+
+  uint32_t aArrayId = aPhasedArrayModel->GetId ();
+  uint32_t bArrayId = bPhasedArrayModel->GetId ();
+  bool newBatch = (params != m_batchParams || aArrayId != m_batchTxArrayId || Simulator::Now () != m_batchTime);
+  if (newBatch)
+    {
+      // the receivers of the previous batch which have not been requested are
+      // not expected to receive the next transmissions of that array
+      if (!m_batchResults.empty ())
+        {
+          std::vector<BatchReceiver> &previousReceivers = m_batchReceivers[m_batchTxArrayId];
+          previousReceivers.erase (std::remove_if (previousReceivers.begin (), previousReceivers.end (),
+                                                   [this] (const BatchReceiver &receiver) {
+                                                     return m_batchResults.count (receiver.m_phasedArrayModel->GetId ()) > 0;
+                                                   }),
+                                   previousReceivers.end ());
+          m_batchResults.clear ();
+        }
+      m_batchParams = params;
+      m_batchTxArrayId = aArrayId;
+      m_batchTime = Simulator::Now ();
+    }
+
+  // the channel of the requested PSD is always retrieved, so that the channel
+  // model sees the same requests, in the same order, as without batching
+  BeamformingGainTask task = PrepareRxPsd (params, a, b, aPhasedArrayModel, bPhasedArrayModel);
+  if (!newBatch)
+    {
+      auto resultIt = m_batchResults.find (bArrayId);
+      if (resultIt != m_batchResults.end ())
+        {
+          bool valid = HaveSameInputs (resultIt->second, task);
+          Ptr<SpectrumValue> rxPsd = resultIt->second.m_psd;
+          m_batchResults.erase (resultIt);
+          if (valid)
+            {
+              NS_LOG_DEBUG ("rx PSD of array " << bArrayId << " computed in the batch");
+              return rxPsd;
+            }
+          NS_LOG_DEBUG ("the channel or the beams of array " << bArrayId << " changed since the batch");
+        }
+    }
+
+  std::vector<BatchReceiver> &receivers = m_batchReceivers[aArrayId];
+  if (std::none_of (receivers.begin (), receivers.end (),
+                    [bArrayId] (const BatchReceiver &receiver) { return receiver.m_phasedArrayModel->GetId () == bArrayId; }))
+    {
+      receivers.push_back ({b, bPhasedArrayModel});
+    }
+  std::vector<BeamformingGainTask> tasks;
+  std::vector<uint32_t> taskArrayIds; // the id of the receiving array of each task
+  tasks.push_back (task);
+  taskArrayIds.push_back (bArrayId);
+  if (newBatch)
+    {
+      // the other receivers are computed only from the channels already in memory
+      for (const BatchReceiver &receiver : receivers)
+        {
+          BeamformingGainTask speculativeTask;
+          if (receiver.m_phasedArrayModel->GetId () != bArrayId
+              && PeekRxPsd (params, a, receiver.m_mobility, aPhasedArrayModel, receiver.m_phasedArrayModel, speculativeTask))
+            {
+              tasks.push_back (speculativeTask);
+              taskArrayIds.push_back (receiver.m_phasedArrayModel->GetId ());
+            }
+        }
+    }
+
+  if (tasks.size () > 1)
+    {
+      GetBatchThreadPool ().Run (tasks.size (), [this, &tasks] (size_t i) { ApplyBeamformingGain (tasks[i]); });
+    }
+  else
+    {
+      ApplyBeamformingGain (tasks[0]);
+    }
+
+  for (size_t i = 0; i < tasks.size (); i++)
+    {
+      if (m_profiler)
+        {
+          m_profiler->Record (NYULinkProfiler::BEAMFORMING_GAIN, tasks[i].m_aId, tasks[i].m_bId, NYULinkProfiler::Now () - tasks[i].m_elapsed);
+        }
+      if (i > 0)
+        {
+          m_batchResults[taskArrayIds[i]] = tasks[i];
+        }
+    }
+  return tasks[0].m_psd;
 }
 
 
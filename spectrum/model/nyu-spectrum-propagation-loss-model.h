@@ -28,15 +28,21 @@
 #define NYU_SPECTRUM_PROPAGATION_LOSS_H
 
 #include <complex.h>
+#include <array>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include "ns3/matrix-based-channel-model.h"
 #include "ns3/random-variable-stream.h"
 #include "ns3/phased-array-spectrum-propagation-loss-model.h"
+#include "ns3/nyu-link-profiler.h"
+#include "ns3/nyu-channel-model.h"
+#include "ns3/nstime.h"
 
 namespace ns3 {
 
 class NetDevice;
+class PropagationLossModel;
 
 /**
  * \ingroup spectrum
@@ -73,6 +79,25 @@ public:
    */
   static TypeId GetTypeId ();
 
+  /**
+   * The implementations available to compute the long term component
+   */
+  enum LongTermBackend
+  {
+    SCALAR, //!< plain loops over the channel coefficients
+    EIGEN //!< matrix-vector products on the channel cube through Eigen, needs ns-3 configured with Eigen
+  };
+
+  /**
+   * The beamforming vectors assumed by CalcRsrp
+   */
+  enum RsrpBeamforming
+  {
+    OMNI_RSRP, //!< a single element at both nodes, i.e., no array gain
+    CURRENT_BEAMS_RSRP, //!< the beamforming vectors currently set on the antenna arrays
+    STRONGEST_RAY_RSRP //!< both arrays steered towards the strongest ray of the link
+  };
+
   /**
    * Set the channel model object
    * \param channel a pointer to an object implementing the MatrixBasedChannelModel interface
@@ -101,6 +126,210 @@ public:
    */
   void GetChannelModelAttribute (const std::string &name, AttributeValue &value) const;
 
+  /**
+   * Statistics of the ray pruning, collected each time a long term component is pruned
+   */
+  struct RayPruningStats
+  {
+    uint64_t m_numLongTerms = 0; //!< number of pruned long term components
+    uint64_t m_totalRays = 0; //!< total number of rays of the pruned long term components
+    uint64_t m_prunedRays = 0; //!< number of rays removed from the per-subband loop
+    double m_maxPrunedFraction = 0; //!< the largest fraction of the total ray amplitude removed from a long term
+    double m_sumPrunedFraction = 0; //!< sum of the pruned amplitude fractions, to compute the average
+  };
+
+  /**
+   * Returns the ray pruning statistics collected since the creation of the
+   * model or since the last call to ResetRayPruningStats
+   * \return the ray pruning statistics
+   */
+  RayPruningStats GetRayPruningStats () const;
+
+  /**
+   * Resets the ray pruning statistics
+   */
+  void ResetRayPruningStats ();
+
+  /**
+   * Returns the number of received PSDs computed by the model
+   * \return the number of calls to DoCalcRxPowerSpectralDensity
+   */
+  uint64_t GetNumReceptions () const;
+
+  /**
+   * Appends the counters of the model to a checkpoint, see NYUCheckpoint. The
+   * long term components are not written: they are a function of the channel
+   * matrices, which are checkpointed by the channel model, and they are
+   * recomputed after a restore. The recomputed ones are counted again in the
+   * ray pruning statistics.
+   * \param buffer the buffer
+   * \param full unused, the counters are always written in full
+   */
+  void SaveCheckpoint (std::vector<uint8_t> &buffer, bool full);
+
+  /**
+   * Restores the counters of the model from a buffer written by
+   * SaveCheckpoint and drops the cached long term components
+   * \param buffer the buffer
+   */
+  void RestoreCheckpoint (const std::vector<uint8_t> &buffer);
+
+  /**
+   * Sets the maximum number of rays used to compute the subband gains. The
+   * cached long term components have been pruned with the previous value,
+   * hence they are dropped if the value changes.
+   * \param maxRays the maximum number of rays, 0 for no limit
+   */
+  void SetMaxRays (uint32_t maxRays);
+
+  /**
+   * Returns the maximum number of rays used to compute the subband gains
+   * \return the maximum number of rays, 0 for no limit
+   */
+  uint32_t GetMaxRays () const;
+
+  /**
+   * Set the per-link cost profiler. The profiler is also set on the channel
+   * model, if it is a NYUChannelModel, so that all the stages of a link are
+   * attributed in the same profiler
+   * \param profiler the profiler, or nullptr to disable the profiling
+   */
+  void SetProfiler (Ptr<NYULinkProfiler> profiler);
+
+  /**
+   * Returns the per-link cost profiler
+   * \return the profiler, nullptr if the profiling is disabled
+   */
+  Ptr<NYULinkProfiler> GetProfiler () const;
+
+  /**
+   * Returns the number of long term components currently cached. With a
+   * NYUChannelModel the long term of a channel matrix is dropped when the
+   * matrix is evicted, hence they are at most MaxCachedChannelMatrices
+   * \return the number of cached long term components
+   */
+  size_t GetNumCachedLongTerms () const;
+
+  /**
+   * Returns the memory held by the cached long term components, excluding the
+   * channel matrices they refer to
+   * \return the size of the cached long term components in bytes
+   */
+  size_t GetCachedLongTermsSize () const;
+
+  /**
+   * Computes the wideband gain of the small scale fading and of the antenna
+   * arrays between node a and node b, i.e., the sum over the rays of the
+   * beamformed power of each ray. The cross terms between the rays are neglected,
+   * since they average out over a bandwidth larger than the coherence bandwidth.
+   * The gain is computed from the NYU ray table through
+   * NYUChannelModel::GetRayFactors, hence no ChannelMatrix and no long term
+   * component are generated or cached. The channel params of the link are
+   * generated or updated if needed, as for a transmission, and they are the
+   * ones used by the following transmissions on the link. Used only with the
+   * NYUChannelModel.
+   * \param a first node mobility model
+   * \param b second node mobility model
+   * \param aPhasedArrayModel the antenna array of the first node
+   * \param bPhasedArrayModel the antenna array of the second node
+   * \param beamforming the beamforming vectors to consider
+   * \return the wideband gain in linear units
+   */
+  double CalcWidebandGain (Ptr<const MobilityModel> a,
+                           Ptr<const MobilityModel> b,
+                           Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                           Ptr<const PhasedArrayModel> bPhasedArrayModel,
+                           RsrpBeamforming beamforming) const;
+
+  /**
+   * Computes the wideband reference signal received power between node a and
+   * node b as the transmitted power, minus the large scale loss of the
+   * propagation loss model, plus the wideband gain computed by CalcWidebandGain.
+   * The same gain model is applied to every link, whether its channel params
+   * already exist or not, so that the RSRP of different cells can be compared.
+   * Meant to rank many candidate cells (e.g., for cell selection or handover)
+   * without building their channel matrices.
+   * \param txPowerDbm the transmitted power in dBm
+   * \param a first node mobility model
+   * \param b second node mobility model
+   * \param aPhasedArrayModel the antenna array of the first node
+   * \param bPhasedArrayModel the antenna array of the second node
+   * \param pathLossModel the propagation loss model of the link
+   * \param beamforming the beamforming vectors to consider
+   * \return the received power in dBm, -infinity if no power is received
+   */
+  double CalcRsrp (double txPowerDbm,
+                   Ptr<MobilityModel> a,
+                   Ptr<MobilityModel> b,
+                   Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                   Ptr<const PhasedArrayModel> bPhasedArrayModel,
+                   Ptr<PropagationLossModel> pathLossModel,
+                   RsrpBeamforming beamforming) const;
+
+  /**
+   * The beamformed gains between the precoders and the channels of a set of
+   * co-scheduled users
+   */
+  struct CrossGainMatrix
+  {
+    size_t m_numUsers = 0; //!< the number of users K
+    size_t m_numBands = 0; //!< the number of subbands
+    std::vector<double> m_widebandGains; //!< the K x K wideband gains, i.e., the mean of the subband gains, row major
+    std::vector<double> m_subbandGains; //!< the K x K x m_numBands subband gains, the subband index is the contiguous one
+
+    /**
+     * Returns the wideband gain at a user of a precoder
+     * \param k the index of the user
+     * \param j the index of the precoder
+     * \return the wideband gain in linear units
+     */
+    double GetGain (size_t k, size_t j) const
+    {
+      return m_widebandGains[k * m_numUsers + j];
+    }
+
+    /**
+     * Returns the gain in a subband at a user of a precoder
+     * \param k the index of the user
+     * \param j the index of the precoder
+     * \param b the index of the subband
+     * \return the subband gain in linear units
+     */
+    double GetSubbandGain (size_t k, size_t j, size_t b) const
+    {
+      return m_subbandGains[(k * m_numUsers + j) * m_numBands + b];
+    }
+  };
+
+  /**
+   * Computes the cross gain matrix of K co-scheduled users for MU-MIMO, i.e.,
+   * the gain at user k of the precoder j of the gNB, with user k using the
+   * current beamforming vector of its antenna array. The long term component of
+   * each ray is c_n A_{k,n} P_{j,n}, where A_{k,n} is the response of the array
+   * of user k and P_{j,n} the one of the gNB array with precoder j, both
+   * computed from NYUChannelModel::GetRayFactors, hence no ChannelMatrix is
+   * generated and the ray tables are read once per user. The gain in each
+   * subband is the coherent sum of the rays, with their delays and Doppler
+   * shifts, as in DoCalcRxPowerSpectralDensity, and the wideband gain is the
+   * mean of the subband gains. The channels are retrieved on the simulator
+   * thread, then the gains of each user are computed in parallel with
+   * NumBatchThreads threads, in a single PSD per user which is reused for all
+   * the precoders. Used only with the NYUChannelModel.
+   * \param gnbMobility the mobility model of the gNB
+   * \param gnbPhasedArrayModel the antenna array of the gNB
+   * \param ueMobilities the mobility models of the K users
+   * \param uePhasedArrayModels the antenna arrays of the K users
+   * \param precoders the K beamforming vectors of the gNB
+   * \param spectrumModel the subbands of the subband gains
+   * \return the cross gain matrix
+   */
+  CrossGainMatrix CalcCrossGains (Ptr<const MobilityModel> gnbMobility,
+                                  Ptr<const PhasedArrayModel> gnbPhasedArrayModel,
+                                  const std::vector<Ptr<const MobilityModel> > &ueMobilities,
+                                  const std::vector<Ptr<const PhasedArrayModel> > &uePhasedArrayModels,
+                                  const std::vector<PhasedArrayModel::ComplexVector> &precoders,
+                                  Ptr<const SpectrumModel> spectrumModel) const;
+
   /**
    * \brief Computes the received PSD.
    *
@@ -114,6 +343,13 @@ public:
    * To reduce the computational load, the long term component associated with
    * a certain channel is cached and recomputed only when the channel realization
    * is updated, or when the beamforming vectors change.
+   * If both devices have a single antenna element and the SisoFastPath attribute
+   * is set, the per-ray coefficients are computed directly from the NYU ray table
+   * and neither the channel matrix nor the long term component are generated or cached.
+   * If the RayPruning attribute is set, the rays whose beamformed power is below
+   * RayPruningThreshold with respect to the strongest ray are not used in the
+   * per-subband loop. Similarly, if MaxRays is not zero, only the MaxRays strongest
+   * rays are used.
    *
    * \param txPsd tx PSD
    * \param a first node mobility model
@@ -129,6 +365,22 @@ public:
                                                    Ptr<const PhasedArrayModel> bPhasedArrayModel) const override;
 
 private:
+  class BatchThreadPool;
+
+  /**
+   * The terms of a ray needed to evaluate its array responses exactly when the
+   * beam squint expansion is not accurate enough
+   */
+  struct SquintRay
+  {
+    std::complex<double> m_scale; //!< the ray coefficient times the phase term of the mean element phases
+    Vector m_sDirection; //!< the unit direction vector of the ray at the s node
+    Vector m_uDirection; //!< the unit direction vector of the ray at the u node
+    double m_sMeanPhase; //!< the mean element phase of the s array
+    double m_uMeanPhase; //!< the mean element phase of the u array
+    double m_maxPhase; //!< the largest element phase around the mean of the s array plus the one of the u array
+  };
+
   /**
    * Data structure that stores the long term component for a tx-rx pair
    */
@@ -138,6 +390,11 @@ private:
     Ptr<const MatrixBasedChannelModel::ChannelMatrix> m_channel; //!< pointer to the channel matrix used to compute the long term
     PhasedArrayModel::ComplexVector m_sW; //!< the beamforming vector for the node s used to compute the long term
     PhasedArrayModel::ComplexVector m_uW; //!< the beamforming vector for the node u used to compute the long term
+    std::vector<std::array<std::complex<double>, 4> > m_squintPoly; //!< for each ray, the coefficients of the polynomial in the relative frequency offset that gives the long term component at that offset, without the linear phase term; empty if the beam squint is not modelled
+    std::vector<double> m_squintPhase; //!< for each ray, the linear phase term of the long term component per unit of relative frequency offset
+    std::vector<SquintRay> m_squintRays; //!< for each ray, the terms of the exact array responses
+    std::vector<Vector> m_sLocations; //!< the element locations of the s array, used by the exact array responses
+    std::vector<Vector> m_uLocations; //!< the element locations of the u array, used by the exact array responses
   };
 
   /**
@@ -146,20 +403,73 @@ private:
   */
   double GetFrequency () const;
 
+  /**
+   * Looks for a valid long term component in m_longTermMap, i.e., one computed
+   * from the same channel matrix with the current beamforming vectors
+   * \param channelMatrix the channel matrix
+   * \param aPhasedArrayModel the antenna array of the tx device
+   * \param bPhasedArrayModel the antenna array of the rx device
+   * \param sW set to the current beamforming vector of the s node of the matrix
+   * \param uW set to the current beamforming vector of the u node of the matrix
+   * \return the long term component, nullptr if there is no valid one
+   */
+  Ptr<const LongTerm> FindLongTerm (Ptr<const MatrixBasedChannelModel::ChannelMatrix> channelMatrix,
+                                    Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                                    Ptr<const PhasedArrayModel> bPhasedArrayModel,
+                                    PhasedArrayModel::ComplexVector &sW,
+                                    PhasedArrayModel::ComplexVector &uW) const;
+
   /**
    * Looks for the long term component in m_longTermMap. If found, checks
    * whether it has to be updated. If not found or if it has to be updated,
-   * calls the method CalcLongTerm to compute it.
+   * calls the method CalcLongTerm to compute it, and CalcSquintTerms if
+   * BeamSquint is enabled.
    * \param channelMatrix the channel matrix
+   * \param a mobility model of the tx device
+   * \param b mobility model of the rx device
    * \param aPhasedArrayModel the antenna array of the tx device
    * \param bPhasedArrayModel the antenna array of the rx device
-   * \return vector containing the long term component for each cluster
+   * \return the long term component for each cluster
+   */
+  Ptr<const LongTerm> GetLongTerm (Ptr<const MatrixBasedChannelModel::ChannelMatrix> channelMatrix,
+                                   Ptr<const MobilityModel> a,
+                                   Ptr<const MobilityModel> b,
+                                   Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                                   Ptr<const PhasedArrayModel> bPhasedArrayModel) const;
+
+  /**
+   * Computes the terms used to model the beam squint, i.e., the frequency
+   * dependence of the array responses. From the factorized representation of
+   * the channel matrix (see NYUChannelModel::GetRayFactors) the long term
+   * component of ray n at frequency f = fc (1 + d) is
+   * c_n A_{u,n}(1 + d) A_{s,n}(1 + d), where A(x) = sum_e w_e exp (j x phi_e)
+   * is the array response with the element phases phi_e scaled by the
+   * frequency. Each array response is written as exp (j x phiMean) times a sum
+   * over the centered phases phi_e - phiMean, which is expanded to the third
+   * order in d. Hence, per ray, a linear phase term and a polynomial are stored,
+   * at a cost of O (U + S) per ray, and the long term component at any
+   * frequency costs O (1) per ray. The truncation error of the expansion is at
+   * most (|d| psiMax)^4 / 24 times the product of the l1 norms of the
+   * beamforming vectors, where psiMax is the largest centered element phase of
+   * the s array plus the one of the u array. For the subbands where |d| psiMax
+   * exceeds BeamSquintMaxPhase the array responses of the ray are computed
+   * exactly from the element phases instead, at a cost of O (U + S).
+   * \param longTerm the long term item, its beamforming vectors must be set
+   * \param sMob mobility model of the s device
+   * \param uMob mobility model of the u device
+   * \param sPhasedArrayModel the antenna array of the s device
+   * \param uPhasedArrayModel the antenna array of the u device
    */
-  PhasedArrayModel::ComplexVector GetLongTerm (Ptr<const MatrixBasedChannelModel::ChannelMatrix> channelMatrix,
-                                               Ptr<const PhasedArrayModel> aPhasedArrayModel,
-                                               Ptr<const PhasedArrayModel> bPhasedArrayModel) const;
+  void CalcSquintTerms (Ptr<LongTerm> longTerm,
+                        Ptr<const MobilityModel> sMob,
+                        Ptr<const MobilityModel> uMob,
+                        Ptr<const PhasedArrayModel> sPhasedArrayModel,
+                        Ptr<const PhasedArrayModel> uPhasedArrayModel) const;
   /**
-   * Computes the long term component
+   * Computes the long term component uW^T H_n sW of each ray n. The channel cube is
+   * seen as a U x (S N) matrix: it is first multiplied by uW, which gives the S x N
+   * matrix uW^T H, and then the result is multiplied by sW. The products are done
+   * either with plain loops or with Eigen, depending on the LongTermBackend attribute.
    * \param channelMatrix the channel matrix H
    * \param sW the beamforming vector of the s device
    * \param uW the beamforming vector of the u device
@@ -170,24 +480,226 @@ private:
                                                 const PhasedArrayModel::ComplexVector &uW) const;
 
   /**
-   * Computes the beamforming gain and applies it to the tx PSD
+   * Sets to zero the long term component of the rays whose beamformed power is
+   * more than RayPruningThreshold dB below the one of the strongest ray (if RayPruning
+   * is set) and of the rays beyond the MaxRays strongest ones (if MaxRays is not zero),
+   * so that they are skipped by CalcBeamformingGain, and updates the pruning statistics.
+   * The amplitude of each subband gain changes at most by the sum of the magnitudes
+   * of the removed components. The statistics track this sum as a fraction of the
+   * sum of the magnitudes of all the components (pruned amplitude fraction).
+   * \param longTerm the long term component of each ray
+   * \param updateStats if false the pruning statistics are not updated
+   */
+  void PruneRays (PhasedArrayModel::ComplexVector &longTerm, bool updateStats = true) const;
+
+  /**
+   * Computes the beamforming gain and applies it to the tx PSD, the rays with a
+   * null long term component are skipped. If FrequencyDecimation is k > 1, the
+   * gain is computed every k active subbands and reused for the following ones.
+   * If squintTerms is not null the long term component of each ray is evaluated
+   * at the center frequency of each subband, and the linear phase terms (array
+   * phase center, delay and Doppler) are advanced from one subband to the next
+   * by a phasor recurrence, so that no trigonometric function is evaluated per
+   * ray and subband when the subbands are evenly spaced
    * \param txPsd the tx PSD
    * \param longTerm the long term component
-   * \param channelMatrix The channel matrix structure
+   * \param isSameDirection true if the channel params have been generated in the
+   *        s-to-u direction of the long term component
    * \param channelParams The channel params structure
    * \param sSpeed speed of the first node
    * \param uSpeed speed of the second node
+   * \param squintTerms the long term item holding the beam squint terms, or nullptr
    * \return the rx PSD
    */
   Ptr<SpectrumValue> CalcBeamformingGain (Ptr<SpectrumValue> txPsd,
                                           PhasedArrayModel::ComplexVector longTerm,
-                                          Ptr<const MatrixBasedChannelModel::ChannelMatrix> channelMatrix,
+                                          bool isSameDirection,
                                           Ptr<const MatrixBasedChannelModel::ChannelParams> channelParams,
                                           const Vector &sSpeed, 
-                                          const Vector &uSpeed) const;
+                                          const Vector &uSpeed,
+                                          Ptr<const LongTerm> squintTerms = nullptr) const;
+
+  /**
+   * Data structure that stores everything CalcBeamformingGain needs for a link.
+   * It is filled on the simulator thread, so that the gain can then be applied
+   * by ApplyBeamformingGain on any thread without creating or releasing
+   * references to objects shared with other links
+   */
+  struct BeamformingGainTask
+  {
+    Ptr<SpectrumValue> m_psd; //!< the PSD to which the gain is applied, owned by the task
+    PhasedArrayModel::ComplexVector m_longTerm; //!< the long term component of each ray
+    bool m_isSameDirection {true}; //!< true if the channel params have been generated in the s-to-u direction
+    Ptr<const MatrixBasedChannelModel::ChannelParams> m_channelParams; //!< the channel params
+    bool m_hasDirections {false}; //!< true if the direction vectors of the rays are available
+    const std::vector<Vector> *m_sRayDirections {nullptr}; //!< the direction vectors of the rays at the s node
+    const std::vector<Vector> *m_uRayDirections {nullptr}; //!< the direction vectors of the rays at the u node
+    Ptr<const NYUChannelModel::CompressedRayTable> m_rays; //!< the compressed ray table, or nullptr
+    Vector m_sSpeed; //!< speed of the s node
+    Vector m_uSpeed; //!< speed of the u node
+    Ptr<const LongTerm> m_squintTerms; //!< the long term item holding the beam squint terms, or nullptr
+    double m_time {0}; //!< the simulation time in seconds, used for the Doppler term
+    double m_frequency {0}; //!< the operating frequency in Hz
+    uint32_t m_aId {0}; //!< the id of the node a, used by the profiler
+    uint32_t m_bId {0}; //!< the id of the node b, used by the profiler
+    std::chrono::steady_clock::duration m_elapsed {}; //!< the time spent in ApplyBeamformingGain
+  };
+
+  /**
+   * Fills a BeamformingGainTask with the inputs of CalcBeamformingGain
+   * \param txPsd the tx PSD, copied into the task
+   * \param longTerm the long term component
+   * \param isSameDirection true if the channel params have been generated in the
+   *        s-to-u direction of the long term component
+   * \param channelParams The channel params structure
+   * \param sSpeed speed of the first node
+   * \param uSpeed speed of the second node
+   * \param squintTerms the long term item holding the beam squint terms, or nullptr
+   * \return the task
+   */
+  BeamformingGainTask PrepareBeamformingGain (Ptr<const SpectrumValue> txPsd,
+                                              PhasedArrayModel::ComplexVector longTerm,
+                                              bool isSameDirection,
+                                              Ptr<const MatrixBasedChannelModel::ChannelParams> channelParams,
+                                              const Vector &sSpeed,
+                                              const Vector &uSpeed,
+                                              Ptr<const LongTerm> squintTerms) const;
+
+  /**
+   * Applies the beamforming gain of CalcBeamformingGain to the PSD of the task.
+   * It only reads the task and the attributes of this object, hence it can be
+   * called concurrently for different tasks
+   * \param task the task, its PSD is modified
+   */
+  void ApplyBeamformingGain (BeamformingGainTask &task) const;
+
+  /**
+   * Retrieves the channel and the long term component of a link (or its ray
+   * coefficients, with the SISO fast path) and prepares the computation of its
+   * rx PSD. This step may generate new channel realizations, hence it is
+   * always run on the simulator thread
+   * \param params the spectrum signal parameters
+   * \param a sender mobility
+   * \param b receiver mobility
+   * \param aPhasedArrayModel the antenna array of the sender
+   * \param bPhasedArrayModel the antenna array of the receiver
+   * \return the task computing the rx PSD
+   */
+  BeamformingGainTask PrepareRxPsd (Ptr<const SpectrumSignalParameters> params,
+                                    Ptr<const MobilityModel> a,
+                                    Ptr<const MobilityModel> b,
+                                    Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                                    Ptr<const PhasedArrayModel> bPhasedArrayModel) const;
+
+  /**
+   * Prepares the computation of the rx PSD of a link as PrepareRxPsd, but only
+   * from the channel and the long term component currently held in memory by
+   * the NYUChannelModel and by this object. It has no side effect: nothing is
+   * generated, updated, read back from the spill files or marked as used, no
+   * random value is drawn and no statistic is updated. The inputs may be
+   * outdated, hence the result must be checked with HaveSameInputs against the
+   * task returned by PrepareRxPsd when the PSD is requested
+   * \param params the spectrum signal parameters
+   * \param a sender mobility
+   * \param b receiver mobility
+   * \param aPhasedArrayModel the antenna array of the sender
+   * \param bPhasedArrayModel the antenna array of the receiver
+   * \param task set to the task computing the rx PSD
+   * \return false if the channel model is not a NYUChannelModel or the channel
+   *         or the long term component of the link are not in memory
+   */
+  bool PeekRxPsd (Ptr<const SpectrumSignalParameters> params,
+                  Ptr<const MobilityModel> a,
+                  Ptr<const MobilityModel> b,
+                  Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                  Ptr<const PhasedArrayModel> bPhasedArrayModel,
+                  BeamformingGainTask &task) const;
+
+  /**
+   * Checks if two tasks compute the same rx PSD, i.e., if they have the same
+   * long term component (which depends on the channel matrix and on the
+   * beamforming vectors of both arrays), the same channel params, the same
+   * node speeds and the same time
+   * \param lhs the first task
+   * \param rhs the second task
+   * \return true if the tasks have the same inputs
+   */
+  static bool HaveSameInputs (const BeamformingGainTask &lhs, const BeamformingGainTask &rhs);
+
+  /**
+   * Computes the rx PSD when BatchReceptions is enabled. The first request for
+   * a transmission computes, besides the requested PSD, the PSDs of the
+   * receivers that received the previous transmission of the same antenna
+   * array, in parallel. The channels of these receivers are only looked up
+   * with PeekRxPsd, hence the channel model sees the same requests as without
+   * batching. Each following request for the same transmission retrieves its
+   * channel with PrepareRxPsd, and it is served from the results only if the
+   * inputs are unchanged (e.g., the receiver has not changed its beam and its
+   * channel has not been updated), otherwise its PSD is computed again. The
+   * receivers that are not requested are forgotten when the next transmission
+   * starts.
+   * \param params the spectrum signal parameters
+   * \param a sender mobility
+   * \param b receiver mobility
+   * \param aPhasedArrayModel the antenna array of the sender
+   * \param bPhasedArrayModel the antenna array of the receiver
+   * \return the received PSD
+   */
+  Ptr<SpectrumValue> GetBatchedRxPsd (Ptr<const SpectrumSignalParameters> params,
+                                      Ptr<const MobilityModel> a,
+                                      Ptr<const MobilityModel> b,
+                                      Ptr<const PhasedArrayModel> aPhasedArrayModel,
+                                      Ptr<const PhasedArrayModel> bPhasedArrayModel) const;
+
+  /**
+   * Returns the threads computing the batched rx PSDs and the cross gains,
+   * creating them on first use
+   * \return the thread pool
+   */
+  BatchThreadPool &GetBatchThreadPool () const;
+
+  /**
+   * Drops the batch thread pool inherited from the parent process after a fork
+   */
+  void ReleaseForkedBatchThreadPool () const;
+
+  /**
+   * Drops the long term component of a channel matrix evicted by the
+   * NYUChannelModel, connected to its ChannelMatrixEvicted trace source
+   * \param channelMatrixKey the key of the evicted channel matrix
+   */
+  void NotifyChannelMatrixEvicted (uint64_t channelMatrixKey);
+
+  /**
+   * Data structure that stores a receiver of the transmissions of an antenna array
+   */
+  struct BatchReceiver
+  {
+    Ptr<const MobilityModel> m_mobility; //!< the mobility model of the receiver
+    Ptr<const PhasedArrayModel> m_phasedArrayModel; //!< the antenna array of the receiver
+  };
 
   mutable std::unordered_map < uint64_t, Ptr<const LongTerm> > m_longTermMap; //!< map containing the long term components
   Ptr<MatrixBasedChannelModel> m_channelModel; //!< the model to generate the channel matrix
+  bool m_sisoFastPath; //!< if true, the gain between single element antennas is computed without channel matrices
+  LongTermBackend m_longTermBackend; //!< the implementation used to compute the long term component
+  bool m_rayPruning; //!< if true, the weak rays are removed from the per-subband loop
+  double m_rayPruningThreshold; //!< the ray pruning threshold in dB, relative to the strongest ray
+  mutable RayPruningStats m_rayPruningStats; //!< the ray pruning statistics
+  uint32_t m_maxRays; //!< maximum number of rays used to compute the subband gains, 0 for no limit
+  uint32_t m_frequencyDecimation; //!< number of consecutive subbands sharing the same gain
+  bool m_beamSquint; //!< if true, the frequency dependence of the array responses is modelled
+  double m_beamSquintMaxPhase; //!< the largest phase spread, times the relative frequency offset, for which the beam squint expansion is used
+  mutable uint64_t m_numReceptions {0}; //!< number of computed received PSDs
+  bool m_batchReceptions; //!< if true, the rx PSDs of a transmission are computed together, in parallel
+  uint32_t m_numBatchThreads; //!< number of threads computing the batched rx PSDs and the cross gains, 0 for the number of cores
+  mutable std::unique_ptr<BatchThreadPool> m_batchThreadPool; //!< the threads computing the batched rx PSDs and the cross gains
+  mutable std::unordered_map<uint32_t, std::vector<BatchReceiver> > m_batchReceivers; //!< the receivers of the last transmission of each antenna array, indexed by the id of the array, in order of request
+  mutable Ptr<const SpectrumSignalParameters> m_batchParams; //!< the transmission of the current batch
+  mutable uint32_t m_batchTxArrayId {0}; //!< the id of the transmitting antenna array of the current batch
+  mutable Time m_batchTime; //!< the time of the current batch
+  mutable std::unordered_map<uint32_t, BeamformingGainTask> m_batchResults; //!< the tasks of the rx PSDs of the current batch not requested yet, with the PSD already computed, indexed by the id of the receiving antenna array
+  Ptr<NYULinkProfiler> m_profiler; //!< the per-link cost profiler, nullptr if disabled
 };
 } // namespace ns3
 